@@ -0,0 +1,449 @@
+#include "bcn.h"
+
+#include <math.h>
+#include <string.h>
+
+// BC7 interpolation weights for 4-bit indices, out of 64
+static const int kWeights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+static int clampInt(int v, int min, int max)
+{
+	return v < min ? min : (v > max ? max : v);
+}
+
+// mean of the block and the direction along which its colors vary the most, from power iteration on the covariance
+static void computePrincipalAxis(float mean[4], float axis[4], const unsigned char pixels[64], int channels)
+{
+	for (int c = 0; c < 4; c++)
+		mean[c] = axis[c] = 0;
+
+	for (int i = 0; i < 16; i++)
+		for (int c = 0; c < channels; c++)
+			mean[c] += pixels[i * 4 + c];
+
+	for (int c = 0; c < channels; c++)
+		mean[c] /= 16;
+
+	float covariance[4][4] = {};
+
+	for (int i = 0; i < 16; i++)
+		for (int c = 0; c < channels; c++)
+			for (int d = 0; d < channels; d++)
+				covariance[c][d] += (pixels[i * 4 + c] - mean[c]) * (pixels[i * 4 + d] - mean[d]);
+
+	// the diagonal is a good start; a start orthogonal to the axis would converge to the wrong one
+	for (int c = 0; c < channels; c++)
+		axis[c] = covariance[c][c] + 1e-3f;
+
+	for (int iteration = 0; iteration < 8; iteration++)
+	{
+		float next[4] = {};
+
+		for (int c = 0; c < channels; c++)
+			for (int d = 0; d < channels; d++)
+				next[c] += covariance[c][d] * axis[d];
+
+		float length = 0;
+		for (int c = 0; c < channels; c++)
+			length += next[c] * next[c];
+
+		// a flat block has no axis; any direction works
+		if (length < 1e-12f)
+			break;
+
+		length = 1 / sqrtf(length);
+
+		for (int c = 0; c < channels; c++)
+			axis[c] = next[c] * length;
+	}
+}
+
+// endpoints at the extremes of the block colors projected on the principal axis
+static void computeEndpoints(float e0[4], float e1[4], const unsigned char pixels[64], int channels)
+{
+	float mean[4], axis[4];
+	computePrincipalAxis(mean, axis, pixels, channels);
+
+	float minT = 0, maxT = 0;
+
+	for (int i = 0; i < 16; i++)
+	{
+		float t = 0;
+		for (int c = 0; c < channels; c++)
+			t += (pixels[i * 4 + c] - mean[c]) * axis[c];
+
+		minT = t < minT ? t : minT;
+		maxT = t > maxT ? t : maxT;
+	}
+
+	for (int c = 0; c < 4; c++)
+	{
+		e0[c] = mean[c] + axis[c] * maxT;
+		e1[c] = mean[c] + axis[c] * minT;
+	}
+}
+
+// least squares endpoints for the given per-pixel weights of e1 (out of 1); returns false if the weights don't
+// determine both endpoints, e.g. when every pixel uses the same index
+static bool refineEndpoints(float e0[4], float e1[4], const unsigned char pixels[64], const float weights[16], int channels)
+{
+	float aa = 0, bb = 0, ab = 0;
+	float ax[4] = {}, bx[4] = {};
+
+	for (int i = 0; i < 16; i++)
+	{
+		float b = weights[i], a = 1 - b;
+
+		aa += a * a;
+		bb += b * b;
+		ab += a * b;
+
+		for (int c = 0; c < channels; c++)
+		{
+			ax[c] += a * pixels[i * 4 + c];
+			bx[c] += b * pixels[i * 4 + c];
+		}
+	}
+
+	float det = aa * bb - ab * ab;
+
+	if (fabsf(det) < 1e-6f)
+		return false;
+
+	for (int c = 0; c < channels; c++)
+	{
+		e0[c] = (ax[c] * bb - bx[c] * ab) / det;
+		e1[c] = (bx[c] * aa - ax[c] * ab) / det;
+	}
+
+	return true;
+}
+
+static uint16_t packColor565(const float color[4])
+{
+	int r = clampInt(int(color[0] * 31 / 255 + 0.5f), 0, 31);
+	int g = clampInt(int(color[1] * 63 / 255 + 0.5f), 0, 63);
+	int b = clampInt(int(color[2] * 31 / 255 + 0.5f), 0, 31);
+
+	return uint16_t((r << 11) | (g << 5) | b);
+}
+
+static void unpackColor565(int rgb[3], uint16_t color)
+{
+	int r = color >> 11, g = (color >> 5) & 63, b = color & 31;
+
+	rgb[0] = (r << 3) | (r >> 2);
+	rgb[1] = (g << 2) | (g >> 4);
+	rgb[2] = (b << 3) | (b >> 2);
+}
+
+static void getPaletteBC1(int palette[4][4], uint16_t c0, uint16_t c1)
+{
+	unpackColor565(palette[0], c0);
+	unpackColor565(palette[1], c1);
+
+	for (int c = 0; c < 3; c++)
+	{
+		if (c0 > c1)
+		{
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+		else
+		{
+			palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+			palette[3][c] = 0;
+		}
+	}
+
+	palette[0][3] = palette[1][3] = palette[2][3] = 255;
+	palette[3][3] = c0 > c1 ? 255 : 0;
+}
+
+// picks the closest palette entry for every pixel; returns the total squared error
+static int fitIndicesBC1(int indices[16], uint16_t c0, uint16_t c1, const unsigned char pixels[64])
+{
+	// endpoints are swapped into 4-color order afterwards; the palette is the same either way
+	uint16_t hi = c0 > c1 ? c0 : c1, lo = c0 > c1 ? c1 : c0;
+
+	int palette[4][4];
+	getPaletteBC1(palette, hi, lo);
+
+	// equal endpoints select 3-color mode, whose last entry is black
+	int entries = hi == lo ? 3 : 4;
+
+	int total = 0;
+
+	for (int i = 0; i < 16; i++)
+	{
+		int best = 0, bestError = 1 << 30;
+
+		for (int j = 0; j < entries; j++)
+		{
+			int error = 0;
+			for (int c = 0; c < 3; c++)
+				error += (pixels[i * 4 + c] - palette[j][c]) * (pixels[i * 4 + c] - palette[j][c]);
+
+			if (error < bestError)
+				best = j, bestError = error;
+		}
+
+		// indices are relative to c0/c1 as given
+		indices[i] = c0 > c1 || hi == lo ? best : best ^ 1;
+		total += bestError;
+	}
+
+	return total;
+}
+
+void encodeBlockBC1(unsigned char block[8], const unsigned char pixels[64])
+{
+	float e0[4], e1[4];
+	computeEndpoints(e0, e1, pixels, 3);
+
+	uint16_t c0 = packColor565(e0), c1 = packColor565(e1);
+
+	int indices[16];
+	int error = fitIndicesBC1(indices, c0, c1, pixels);
+
+	// weight of c1 for indices 0..3 of the 4-color palette
+	static const float kWeights[4] = { 0, 1, 1.f / 3, 2.f / 3 };
+
+	float weights[16];
+	for (int i = 0; i < 16; i++)
+		weights[i] = kWeights[indices[i]];
+
+	if (c0 != c1 && refineEndpoints(e0, e1, pixels, weights, 3))
+	{
+		uint16_t r0 = packColor565(e0), r1 = packColor565(e1);
+
+		int refined[16];
+		int refinedError = fitIndicesBC1(refined, r0, r1, pixels);
+
+		if (refinedError < error)
+		{
+			c0 = r0, c1 = r1;
+			memcpy(indices, refined, sizeof(indices));
+		}
+	}
+
+	// 4-color mode needs c0 > c1; swapping the endpoints swaps indices 0/1 and 2/3
+	if (c0 < c1)
+	{
+		uint16_t t = c0;
+		c0 = c1, c1 = t;
+
+		for (int i = 0; i < 16; i++)
+			indices[i] ^= 1;
+	}
+
+	uint32_t bits = 0;
+	for (int i = 0; i < 16; i++)
+		bits |= uint32_t(indices[i]) << (i * 2);
+
+	block[0] = uint8_t(c0), block[1] = uint8_t(c0 >> 8);
+	block[2] = uint8_t(c1), block[3] = uint8_t(c1 >> 8);
+	block[4] = uint8_t(bits), block[5] = uint8_t(bits >> 8), block[6] = uint8_t(bits >> 16), block[7] = uint8_t(bits >> 24);
+}
+
+void decodeBlockBC1(unsigned char pixels[64], const unsigned char block[8])
+{
+	uint16_t c0 = uint16_t(block[0] | (block[1] << 8));
+	uint16_t c1 = uint16_t(block[2] | (block[3] << 8));
+	uint32_t bits = block[4] | (block[5] << 8) | (block[6] << 16) | (uint32_t(block[7]) << 24);
+
+	int palette[4][4];
+	getPaletteBC1(palette, c0, c1);
+
+	for (int i = 0; i < 16; i++)
+		for (int c = 0; c < 4; c++)
+			pixels[i * 4 + c] = uint8_t(palette[(bits >> (i * 2)) & 3][c]);
+}
+
+static void writeBits(unsigned char* block, uint32_t& offset, uint32_t count, uint32_t value)
+{
+	for (uint32_t i = 0; i < count; i++, offset++)
+		if ((value >> i) & 1)
+			block[offset >> 3] |= uint8_t(1 << (offset & 7));
+}
+
+static uint32_t readBits(const unsigned char* block, uint32_t& offset, uint32_t count)
+{
+	uint32_t value = 0;
+
+	for (uint32_t i = 0; i < count; i++, offset++)
+		value |= uint32_t((block[offset >> 3] >> (offset & 7)) & 1) << i;
+
+	return value;
+}
+
+// 7 bits per channel and a shared p-bit as the lowest bit of all channels; picks the p-bit with the smaller error
+static void quantizeEndpointBC7(int quantized[4], int& pbit, const float endpoint[4])
+{
+	int bestError = 1 << 30;
+
+	for (int p = 0; p < 2; p++)
+	{
+		int q[4], error = 0;
+
+		for (int c = 0; c < 4; c++)
+		{
+			q[c] = clampInt(int((endpoint[c] - p) / 2 + 0.5f), 0, 127);
+
+			int value = q[c] * 2 + p;
+			int delta = int(endpoint[c] + 0.5f) - value;
+
+			error += delta * delta;
+		}
+
+		if (error < bestError)
+		{
+			bestError = error;
+			pbit = p;
+			memcpy(quantized, q, sizeof(q));
+		}
+	}
+}
+
+static int fitIndicesBC7(int indices[16], const int e0[4], const int e1[4], const unsigned char pixels[64])
+{
+	int palette[16][4];
+
+	for (int j = 0; j < 16; j++)
+		for (int c = 0; c < 4; c++)
+			palette[j][c] = ((64 - kWeights4[j]) * e0[c] + kWeights4[j] * e1[c] + 32) >> 6;
+
+	int total = 0;
+
+	for (int i = 0; i < 16; i++)
+	{
+		int best = 0, bestError = 1 << 30;
+
+		for (int j = 0; j < 16; j++)
+		{
+			int error = 0;
+			for (int c = 0; c < 4; c++)
+				error += (pixels[i * 4 + c] - palette[j][c]) * (pixels[i * 4 + c] - palette[j][c]);
+
+			if (error < bestError)
+				best = j, bestError = error;
+		}
+
+		indices[i] = best;
+		total += bestError;
+	}
+
+	return total;
+}
+
+static int quantizeAndFitBC7(int q0[4], int q1[4], int& p0, int& p1, int indices[16], const float e0[4], const float e1[4], const unsigned char pixels[64])
+{
+	quantizeEndpointBC7(q0, p0, e0);
+	quantizeEndpointBC7(q1, p1, e1);
+
+	int v0[4], v1[4];
+	for (int c = 0; c < 4; c++)
+	{
+		v0[c] = q0[c] * 2 + p0;
+		v1[c] = q1[c] * 2 + p1;
+	}
+
+	return fitIndicesBC7(indices, v0, v1, pixels);
+}
+
+void encodeBlockBC7(unsigned char block[16], const unsigned char pixels[64])
+{
+	float e0[4], e1[4];
+	computeEndpoints(e0, e1, pixels, 4);
+
+	int q0[4], q1[4], p0, p1, indices[16];
+	int error = quantizeAndFitBC7(q0, q1, p0, p1, indices, e0, e1, pixels);
+
+	float weights[16];
+	for (int i = 0; i < 16; i++)
+		weights[i] = kWeights4[indices[i]] / 64.f;
+
+	if (refineEndpoints(e0, e1, pixels, weights, 4))
+	{
+		int r0[4], r1[4], rp0, rp1, refined[16];
+		int refinedError = quantizeAndFitBC7(r0, r1, rp0, rp1, refined, e0, e1, pixels);
+
+		if (refinedError < error)
+		{
+			memcpy(q0, r0, sizeof(q0));
+			memcpy(q1, r1, sizeof(q1));
+			p0 = rp0, p1 = rp1;
+			memcpy(indices, refined, sizeof(indices));
+		}
+	}
+
+	// the first index is stored without its top bit, so it has to be below 8; swapping the endpoints flips the indices
+	if (indices[0] >= 8)
+	{
+		for (int c = 0; c < 4; c++)
+		{
+			int t = q0[c];
+			q0[c] = q1[c], q1[c] = t;
+		}
+
+		int t = p0;
+		p0 = p1, p1 = t;
+
+		for (int i = 0; i < 16; i++)
+			indices[i] = 15 - indices[i];
+	}
+
+	memset(block, 0, 16);
+
+	uint32_t offset = 0;
+	writeBits(block, offset, 7, 1 << 6); // mode 6
+
+	for (int c = 0; c < 4; c++)
+	{
+		writeBits(block, offset, 7, q0[c]);
+		writeBits(block, offset, 7, q1[c]);
+	}
+
+	writeBits(block, offset, 1, p0);
+	writeBits(block, offset, 1, p1);
+
+	for (int i = 0; i < 16; i++)
+		writeBits(block, offset, i == 0 ? 3 : 4, indices[i]);
+}
+
+void decodeBlockBC7(unsigned char pixels[64], const unsigned char block[16])
+{
+	if ((block[0] & 0x7f) != 1 << 6)
+	{
+		for (int i = 0; i < 16; i++)
+			pixels[i * 4 + 0] = 255, pixels[i * 4 + 1] = 0, pixels[i * 4 + 2] = 255, pixels[i * 4 + 3] = 255;
+
+		return;
+	}
+
+	uint32_t offset = 7;
+
+	int e0[4], e1[4];
+
+	for (int c = 0; c < 4; c++)
+	{
+		e0[c] = int(readBits(block, offset, 7)) << 1;
+		e1[c] = int(readBits(block, offset, 7)) << 1;
+	}
+
+	int p0 = int(readBits(block, offset, 1)), p1 = int(readBits(block, offset, 1));
+
+	for (int c = 0; c < 4; c++)
+	{
+		e0[c] |= p0;
+		e1[c] |= p1;
+	}
+
+	for (int i = 0; i < 16; i++)
+	{
+		int index = int(readBits(block, offset, i == 0 ? 3 : 4));
+
+		for (int c = 0; c < 4; c++)
+			pixels[i * 4 + c] = uint8_t(((64 - kWeights4[index]) * e0[c] + kWeights4[index] * e1[c] + 32) >> 6);
+	}
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Block compression for 4x4 blocks of 8-bit RGBA pixels (64 bytes, rows top to bottom). Encoders fit the endpoints to
+// the principal axis of the block colors and refine them with a least squares fit to the chosen indices; they are
+// meant for offline conversion, not for runtime compression
+
+// BC1 without alpha: two RGB565 endpoints and 2-bit indices, 8 bytes per block. Alpha is ignored
+void encodeBlockBC1(unsigned char block[8], const unsigned char pixels[64]);
+void decodeBlockBC1(unsigned char pixels[64], const unsigned char block[8]);
+
+// BC7 mode 6 only: two RGBA7 endpoints with a p-bit each and 4-bit indices, 16 bytes per block. Blocks in other modes
+// decode to magenta
+void encodeBlockBC7(unsigned char block[16], const unsigned char pixels[64]);
+void decodeBlockBC7(unsigned char pixels[64], const unsigned char block[16]);
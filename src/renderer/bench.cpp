@@ -0,0 +1,58 @@
+// CPU-only benchmarks; unlike the renderer they need neither a GPU nor a window, so they run anywhere perf does
+#include "mesh.h"
+#include "scenegen.h"
+#include "normals.h"
+#include "vertexremap.h"
+#include "texturefile.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int main(int argc, const char** argv)
+{
+	// the texture benchmark generates an image when none is given
+	if (argc < 3 && !(argc == 2 && strcmp(argv[1], "-texbench") == 0))
+	{
+		printf("Usage: %s -meshbench <mesh.obj> [quantization bits]\n", argv[0]);
+		printf("       %s -objbench <mesh.obj|corpus files...>\n", argv[0]);
+		printf("       %s -scenebench <scene:...> [out.obj]\n", argv[0]);
+		printf("       %s -normalbench <mesh.obj|mesh.mesh|scene:...>\n", argv[0]);
+		printf("       %s -remapbench <mesh.obj|mesh.mesh|scene:...>\n", argv[0]);
+		printf("       %s -texbench [image.tga|image.ppm]\n", argv[0]);
+		return 1;
+	}
+
+	if (strcmp(argv[1], "-meshbench") == 0)
+	{
+		benchmarkMesh(argv[2], argc > 3 ? atoi(argv[3]) : 0);
+		return 0;
+	}
+
+	if (strcmp(argv[1], "-objbench") == 0)
+	{
+		benchmarkObj(argv + 2, argc - 2);
+		return 0;
+	}
+
+	if (strcmp(argv[1], "-scenebench") == 0)
+	{
+		benchmarkScene(argv[2], argc > 3 ? argv[3] : "scenebench.obj");
+		return 0;
+	}
+
+	if (strcmp(argv[1], "-normalbench") == 0)
+	{
+		benchmarkNormals(argv[2]);
+		return 0;
+	}
+
+	if (strcmp(argv[1], "-remapbench") == 0)
+		return benchmarkVertexRemap(argv[2]) ? 0 : 1;
+
+	if (strcmp(argv[1], "-texbench") == 0)
+		return benchmarkTextures(argc > 2 ? argv[2] : 0) ? 0 : 1;
+
+	printf("Unknown benchmark %s\n", argv[1]);
+	return 1;
+}
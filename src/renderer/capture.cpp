@@ -0,0 +1,139 @@
+#ifndef _CRT_SECURE_NO_WARNINGS
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include "capture.h"
+#include "files.h"
+
+#include <assert.h>
+#include <string.h>
+
+bool openCapture(CaptureWriter& writer, const char* path, const CaptureHeader& header)
+{
+	writer.file = fopen(path, "wb");
+	if (!writer.file)
+		return false;
+
+	CaptureHeader fileHeader = header;
+	fileHeader.magic = kCaptureMagic;
+	fileHeader.version = kCaptureVersion;
+	fileHeader.source[sizeof(fileHeader.source) - 1] = 0;
+
+	fwrite(&fileHeader, sizeof(fileHeader), 1, writer.file);
+
+	writer.lastDraws.clear();
+	writer.frames = 0;
+	writer.size = sizeof(fileHeader);
+
+	return true;
+}
+
+void writeCaptureFrame(CaptureWriter& writer, const CaptureFrame& frame, const CaptureDraw* draws, size_t drawCount)
+{
+	assert(writer.file);
+
+	CaptureFrame fileFrame = frame;
+	fileFrame.drawCount = uint32_t(drawCount);
+
+	// the first frame always stores its draws
+	bool same = writer.frames > 0 && writer.lastDraws.size() == drawCount && (drawCount == 0 || memcmp(writer.lastDraws.data(), draws, drawCount * sizeof(CaptureDraw)) == 0);
+
+	fileFrame.flags = same ? (frame.flags | CaptureFrameSameDraws) : (frame.flags & ~CaptureFrameSameDraws);
+
+	fwrite(&fileFrame, sizeof(fileFrame), 1, writer.file);
+	writer.size += sizeof(fileFrame);
+
+	if (!same)
+	{
+		if (drawCount)
+			fwrite(draws, sizeof(CaptureDraw), drawCount, writer.file);
+
+		writer.size += drawCount * sizeof(CaptureDraw);
+		writer.lastDraws.assign(draws, draws + drawCount);
+	}
+
+	writer.frames++;
+}
+
+void closeCapture(CaptureWriter& writer)
+{
+	if (!writer.file)
+		return;
+
+	fclose(writer.file);
+	writer.file = NULL;
+}
+
+bool loadCapture(Capture& result, const char* path)
+{
+	MappedFile file;
+	if (!mapFile(file, path))
+		return false;
+
+	const char* data = static_cast<const char*>(file.data);
+	size_t offset = 0;
+
+	bool ok = file.size >= sizeof(CaptureHeader);
+
+	if (ok)
+	{
+		memcpy(&result.header, data, sizeof(CaptureHeader));
+		offset += sizeof(CaptureHeader);
+
+		ok = result.header.magic == kCaptureMagic && result.header.version == kCaptureVersion && memchr(result.header.source, 0, sizeof(result.header.source)) != 0;
+	}
+
+	result.frames.clear();
+	result.firstDraw.clear();
+	result.draws.clear();
+
+	while (ok && offset < file.size)
+	{
+		CaptureFrame frame;
+
+		if (file.size - offset < sizeof(frame))
+		{
+			ok = false;
+			break;
+		}
+
+		memcpy(&frame, data + offset, sizeof(frame));
+		offset += sizeof(frame);
+
+		if (frame.flags & CaptureFrameSameDraws)
+		{
+			// repeats the previous frame, which has to exist and have as many draws
+			ok = !result.frames.empty() && result.frames.back().drawCount == frame.drawCount;
+
+			if (ok)
+			{
+				result.firstDraw.push_back(result.firstDraw.back());
+				result.frames.push_back(frame);
+			}
+
+			continue;
+		}
+
+		if ((file.size - offset) / sizeof(CaptureDraw) < frame.drawCount)
+		{
+			ok = false;
+			break;
+		}
+
+		size_t firstDraw = result.draws.size();
+
+		result.draws.resize(firstDraw + frame.drawCount);
+
+		if (frame.drawCount)
+			memcpy(&result.draws[firstDraw], data + offset, frame.drawCount * sizeof(CaptureDraw));
+
+		offset += frame.drawCount * sizeof(CaptureDraw);
+
+		result.firstDraw.push_back(uint32_t(firstDraw));
+		result.frames.push_back(frame);
+	}
+
+	unmapFile(file);
+
+	return ok;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <vector>
+
+// Per-frame command stream capture: the camera, viewport, pipeline selection and the indexed draws of every frame, in
+// the order they were recorded. The mesh isn't stored; the header names the source the renderer loaded and its sizes,
+// and replay loads it the same way and refuses to run if the sizes differ. Frames that draw the same commands as the
+// previous frame only store their header, so captures of a still or slowly moving camera stay small.
+//
+// Layout: CaptureHeader, then per frame a CaptureFrame followed by drawCount CaptureDraw entries unless CaptureFrameSameDraws is set
+const uint32_t kCaptureMagic = 0x50414352; // 'RCAP'
+const uint32_t kCaptureVersion = 1;
+
+struct CaptureHeader
+{
+	uint32_t magic;
+	uint32_t version;
+
+	char source[256]; // mesh path or scene spec, as passed to the renderer
+	float smoothingAngle; // -1 if normals were not regenerated
+
+	// mesh after loading and index size selection; replay checks these
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	uint32_t indexSize;
+	uint32_t submeshCount;
+};
+
+enum CaptureShading
+{
+	CaptureShadingForward,
+	CaptureShadingVisibility, // the draws went to the visibility buffer and were resolved in a second pass
+};
+
+enum CaptureFrameFlags
+{
+	CaptureFrameSameDraws = 1 << 0, // draws are identical to the previous frame and are not stored
+};
+
+struct CaptureFrame
+{
+	float camera[3];
+	uint32_t width, height; // viewport
+
+	// PipelineVariant of the draws
+	uint32_t vertexFormat;
+	uint32_t lightingMode;
+	uint32_t vertexInput;
+
+	uint32_t shading;
+	uint32_t flags;
+
+	uint32_t drawCount;
+};
+
+// An indexed draw and the material it uses; same fields as DrawCommand, so GPU culled draws can be stored as culling produced them
+struct CaptureDraw
+{
+	uint32_t material;
+
+	uint32_t indexCount;
+	uint32_t instanceCount;
+	uint32_t firstIndex;
+	int32_t vertexOffset;
+	uint32_t firstInstance;
+};
+
+struct CaptureWriter
+{
+	FILE* file;
+
+	std::vector<CaptureDraw> lastDraws;
+
+	uint32_t frames;
+	uint64_t size; // bytes written
+};
+
+// Returns false if the file can't be created
+bool openCapture(CaptureWriter& writer, const char* path, const CaptureHeader& header);
+void writeCaptureFrame(CaptureWriter& writer, const CaptureFrame& frame, const CaptureDraw* draws, size_t drawCount);
+void closeCapture(CaptureWriter& writer);
+
+struct Capture
+{
+	CaptureHeader header;
+
+	std::vector<CaptureFrame> frames;
+	std::vector<uint32_t> firstDraw; // per frame; frames with the same draws share them
+	std::vector<CaptureDraw> draws;
+};
+
+// Validates the header and that every frame is complete; draw ranges are validated against the mesh on replay
+bool loadCapture(Capture& result, const char* path);
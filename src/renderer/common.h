@@ -0,0 +1,19 @@
+#pragma once
+
+#include <assert.h>
+#include <stdio.h>
+
+#include <vector>
+
+#include <volk.h>
+
+#define VK_CHECK(call) \
+	do{ \
+		VkResult result_ = call;\
+		assert(result_ == VK_SUCCESS);\
+		(void)result_;\
+	}while (0)
+
+#ifndef ARRAYSIZE
+#define ARRAYSIZE(array) (sizeof(array) / sizeof((array)[0]))
+#endif
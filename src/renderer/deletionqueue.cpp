@@ -0,0 +1,62 @@
+#include "common.h"
+#include "deletionqueue.h"
+
+void createDeletionQueue(DeletionQueue& result, DestroyObjectCallback destroy, void* context)
+{
+	result.entries.clear();
+	result.destroy = destroy;
+	result.context = context;
+}
+
+void destroyDeviceObject(void* context, VkObjectType type, uint64_t handle)
+{
+	VkDevice device = static_cast<VkDevice>(context);
+
+	switch (type)
+	{
+	case VK_OBJECT_TYPE_BUFFER: vkDestroyBuffer(device, (VkBuffer)handle, VK_NULL_HANDLE); break;
+	case VK_OBJECT_TYPE_IMAGE: vkDestroyImage(device, (VkImage)handle, VK_NULL_HANDLE); break;
+	case VK_OBJECT_TYPE_DEVICE_MEMORY: vkFreeMemory(device, (VkDeviceMemory)handle, VK_NULL_HANDLE); break;
+	case VK_OBJECT_TYPE_IMAGE_VIEW: vkDestroyImageView(device, (VkImageView)handle, VK_NULL_HANDLE); break;
+	case VK_OBJECT_TYPE_FRAMEBUFFER: vkDestroyFramebuffer(device, (VkFramebuffer)handle, VK_NULL_HANDLE); break;
+	case VK_OBJECT_TYPE_DESCRIPTOR_POOL: vkDestroyDescriptorPool(device, (VkDescriptorPool)handle, VK_NULL_HANDLE); break;
+	case VK_OBJECT_TYPE_PIPELINE: vkDestroyPipeline(device, (VkPipeline)handle, VK_NULL_HANDLE); break;
+	case VK_OBJECT_TYPE_SHADER_MODULE: vkDestroyShaderModule(device, (VkShaderModule)handle, VK_NULL_HANDLE); break;
+	case VK_OBJECT_TYPE_SEMAPHORE: vkDestroySemaphore(device, (VkSemaphore)handle, VK_NULL_HANDLE); break;
+	case VK_OBJECT_TYPE_FENCE: vkDestroyFence(device, (VkFence)handle, VK_NULL_HANDLE); break;
+	case VK_OBJECT_TYPE_SWAPCHAIN_KHR: vkDestroySwapchainKHR(device, (VkSwapchainKHR)handle, VK_NULL_HANDLE); break;
+	default: assert(!"Unsupported object type");
+	}
+}
+
+void deferDestroy(DeletionQueue& queue, uint64_t value, VkObjectType type, uint64_t handle)
+{
+	if (!handle)
+		return;
+
+	DeletionQueue::Entry entry = { value, type, handle };
+	queue.entries.push_back(entry);
+}
+
+size_t flushDeletionQueue(DeletionQueue& queue, uint64_t completedValue)
+{
+	size_t write = 0;
+	size_t destroyed = 0;
+
+	for (size_t i = 0; i < queue.entries.size(); i++)
+	{
+		const DeletionQueue::Entry& entry = queue.entries[i];
+
+		if (entry.value <= completedValue)
+		{
+			queue.destroy(queue.context, entry.type, entry.handle);
+			destroyed++;
+		}
+		else
+			queue.entries[write++] = entry;
+	}
+
+	queue.entries.resize(write);
+
+	return destroyed;
+}
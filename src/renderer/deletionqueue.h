@@ -0,0 +1,31 @@
+#pragma once
+
+typedef void (*DestroyObjectCallback)(void* context, VkObjectType type, uint64_t handle);
+
+// Objects that may still be referenced by submitted work; each is destroyed once the timeline reaches its value.
+// Destruction goes through a callback so that the queue can be driven by a simulated timeline without a device
+struct DeletionQueue
+{
+	struct Entry
+	{
+		uint64_t value;
+		VkObjectType type;
+		uint64_t handle;
+	};
+
+	std::vector<Entry> entries; // in the order objects were retired; values are not required to be sorted
+
+	DestroyObjectCallback destroy;
+	void* context;
+};
+
+void createDeletionQueue(DeletionQueue& result, DestroyObjectCallback destroy, void* context);
+
+// Default callback; context is the VkDevice
+void destroyDeviceObject(void* context, VkObjectType type, uint64_t handle);
+
+// handle is a Vulkan non-dispatchable handle cast with (uint64_t), which works for both 32 and 64-bit handle types
+void deferDestroy(DeletionQueue& queue, uint64_t value, VkObjectType type, uint64_t handle);
+
+// Destroys every object whose value is <= completedValue in retirement order; returns the number of destroyed objects
+size_t flushDeletionQueue(DeletionQueue& queue, uint64_t completedValue);
@@ -0,0 +1,334 @@
+#include "common.h"
+#include "device.h"
+
+#include <string.h>
+
+static std::vector<VkQueueFamilyProperties> getQueueFamilyProperties(VkPhysicalDevice physicalDevice)
+{
+	uint32_t queueCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueCount, VK_NULL_HANDLE);
+
+	std::vector<VkQueueFamilyProperties> queues(queueCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueCount, queues.data());
+
+	return queues;
+}
+
+static uint32_t findQueueFamily(const std::vector<VkQueueFamilyProperties>& queues, VkQueueFlags required, VkQueueFlags excluded)
+{
+	for (uint32_t i = 0; i < queues.size(); i++)
+	{
+		if ((queues[i].queueFlags & required) == required && (queues[i].queueFlags & excluded) == 0)
+			return i;
+	}
+
+	return VK_QUEUE_FAMILY_IGNORED;
+}
+
+uint32_t getGraphicsQueueFamily(VkPhysicalDevice physicalDevice)
+{
+	std::vector<VkQueueFamilyProperties> queues = getQueueFamilyProperties(physicalDevice);
+
+	return findQueueFamily(queues, VK_QUEUE_GRAPHICS_BIT, 0);
+}
+
+QueueFamilies getQueueFamilies(VkPhysicalDevice physicalDevice)
+{
+	std::vector<VkQueueFamilyProperties> queues = getQueueFamilyProperties(physicalDevice);
+
+	QueueFamilies result = {};
+	result.graphics = findQueueFamily(queues, VK_QUEUE_GRAPHICS_BIT, 0);
+	result.compute = findQueueFamily(queues, VK_QUEUE_COMPUTE_BIT, VK_QUEUE_GRAPHICS_BIT);
+	result.transfer = findQueueFamily(queues, VK_QUEUE_TRANSFER_BIT, VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT);
+
+	// graphics and compute queues support transfers even if they don't report the bit, so an async compute queue is the next best thing
+	if (result.transfer == VK_QUEUE_FAMILY_IGNORED)
+		result.transfer = result.compute;
+
+	if (result.compute == VK_QUEUE_FAMILY_IGNORED)
+		result.compute = result.graphics;
+
+	if (result.transfer == VK_QUEUE_FAMILY_IGNORED)
+		result.transfer = result.graphics;
+
+	return result;
+}
+
+bool supportsExtension(VkPhysicalDevice physicalDevice, const char* name)
+{
+	uint32_t extensionCount = 0;
+	VK_CHECK(vkEnumerateDeviceExtensionProperties(physicalDevice, VK_NULL_HANDLE, &extensionCount, VK_NULL_HANDLE));
+
+	std::vector<VkExtensionProperties> extensions(extensionCount);
+	VK_CHECK(vkEnumerateDeviceExtensionProperties(physicalDevice, VK_NULL_HANDLE, &extensionCount, extensions.data()));
+
+	for (uint32_t i = 0; i < extensionCount; i++)
+	{
+		if (strcmp(extensions[i].extensionName, name) == 0)
+			return true;
+	}
+
+	return false;
+}
+
+bool supportsDynamicRendering(VkPhysicalDevice physicalDevice)
+{
+#ifdef VK_KHR_dynamic_rendering
+	if (!supportsExtension(physicalDevice, VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME) ||
+		!supportsExtension(physicalDevice, VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME) ||
+		!supportsExtension(physicalDevice, VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME))
+		return false;
+
+	VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR };
+
+	VkPhysicalDeviceFeatures2 features = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2 };
+	features.pNext = &dynamicRenderingFeatures;
+
+	vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+
+	return dynamicRenderingFeatures.dynamicRendering == VK_TRUE;
+#else
+	return false;
+#endif
+}
+
+bool supportsTimelineSemaphores(VkPhysicalDevice physicalDevice)
+{
+#ifdef VK_KHR_timeline_semaphore
+	if (!supportsExtension(physicalDevice, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME))
+		return false;
+
+	VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineFeatures = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR };
+
+	VkPhysicalDeviceFeatures2 features = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2 };
+	features.pNext = &timelineFeatures;
+
+	vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+
+	return timelineFeatures.timelineSemaphore == VK_TRUE;
+#else
+	return false;
+#endif
+}
+
+bool supportsBufferDeviceAddress(VkPhysicalDevice physicalDevice)
+{
+#ifdef VK_KHR_buffer_device_address
+	if (!supportsExtension(physicalDevice, VK_KHR_BUFFER_DEVICE_ADDRESS_EXTENSION_NAME))
+		return false;
+
+	VkPhysicalDeviceBufferDeviceAddressFeaturesKHR addressFeatures = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES_KHR };
+
+	VkPhysicalDeviceFeatures2 features = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2 };
+	features.pNext = &addressFeatures;
+
+	vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+
+	return addressFeatures.bufferDeviceAddress == VK_TRUE;
+#else
+	return false;
+#endif
+}
+
+bool supportsDrawIndirectCount(VkPhysicalDevice physicalDevice)
+{
+#ifdef VK_KHR_draw_indirect_count
+	// compacted draws carry their record index in firstInstance
+	VkPhysicalDeviceFeatures features;
+	vkGetPhysicalDeviceFeatures(physicalDevice, &features);
+
+	return supportsExtension(physicalDevice, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME) && features.drawIndirectFirstInstance;
+#else
+	return false;
+#endif
+}
+
+bool supportsVisibilityBuffer(VkPhysicalDevice physicalDevice)
+{
+	// gl_PrimitiveID in fragment shaders needs geometryShader; the resolve pass reads ids as an rg32ui storage image
+	VkPhysicalDeviceFeatures features;
+	vkGetPhysicalDeviceFeatures(physicalDevice, &features);
+
+	return features.geometryShader && features.shaderStorageImageExtendedFormats;
+}
+
+bool supportsMemoryBudget(VkPhysicalDevice physicalDevice)
+{
+#ifdef VK_EXT_memory_budget
+	return supportsExtension(physicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+#else
+	return false;
+#endif
+}
+
+bool supportsTextureCompressionBC(VkPhysicalDevice physicalDevice)
+{
+	// BC formats are universal on desktop GPUs and rare on mobile ones, which get textures decoded on the CPU instead
+	VkPhysicalDeviceFeatures features;
+	vkGetPhysicalDeviceFeatures(physicalDevice, &features);
+
+	return features.textureCompressionBC == VK_TRUE;
+}
+
+VkSampleCountFlagBits getSampleCount(VkPhysicalDevice physicalDevice, uint32_t requested)
+{
+	VkPhysicalDeviceProperties props;
+	vkGetPhysicalDeviceProperties(physicalDevice, &props);
+
+	VkSampleCountFlags supported = props.limits.framebufferColorSampleCounts & props.limits.framebufferDepthSampleCounts;
+
+	VkSampleCountFlagBits result = VK_SAMPLE_COUNT_1_BIT;
+
+	// sample count bits are the sample counts themselves
+	for (uint32_t samples = 2; samples <= requested && samples <= VK_SAMPLE_COUNT_64_BIT; samples *= 2)
+		if (supported & samples)
+			result = VkSampleCountFlagBits(samples);
+
+	return result;
+}
+
+VkDevice createDevice(VkPhysicalDevice physicalDevice, const QueueFamilies& families, bool swapchain, bool dynamicRendering, bool timelineSemaphores, bool bufferDeviceAddress, bool drawIndirectCount, bool visibilityBuffer, bool memoryBudget, bool textureCompressionBC)
+{
+	float queuePriorities[] = { 1.0f };
+
+	uint32_t familyIndices[] = { families.graphics, families.compute, families.transfer };
+
+	VkDeviceQueueCreateInfo queueInfos[ARRAYSIZE(familyIndices)] = {};
+	uint32_t queueInfoCount = 0;
+
+	for (size_t i = 0; i < ARRAYSIZE(familyIndices); i++)
+	{
+		bool duplicate = false;
+		for (uint32_t j = 0; j < queueInfoCount; j++)
+			duplicate |= queueInfos[j].queueFamilyIndex == familyIndices[i];
+
+		if (duplicate)
+			continue;
+
+		VkDeviceQueueCreateInfo& queueInfo = queueInfos[queueInfoCount++];
+		queueInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+		queueInfo.queueFamilyIndex = familyIndices[i];
+		queueInfo.queueCount = 1;
+		queueInfo.pQueuePriorities = queuePriorities;
+	}
+
+	std::vector<const char*> extensions;
+
+	// headless devices don't present; the swapchain extension needs the surface extensions on the instance
+	if (swapchain)
+		extensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+
+	VkPhysicalDeviceFeatures features = {};
+	features.drawIndirectFirstInstance = drawIndirectCount;
+	features.geometryShader = visibilityBuffer;
+	features.shaderStorageImageExtendedFormats = visibilityBuffer;
+	features.textureCompressionBC = textureCompressionBC;
+
+	VkDeviceCreateInfo deviceInfo = { VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO };
+	deviceInfo.queueCreateInfoCount = queueInfoCount;
+	deviceInfo.pQueueCreateInfos = queueInfos;
+	deviceInfo.pEnabledFeatures = &features;
+
+#ifdef VK_KHR_dynamic_rendering
+	VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR };
+	dynamicRenderingFeatures.dynamicRendering = VK_TRUE;
+
+	if (dynamicRendering)
+	{
+		extensions.push_back(VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME);
+		extensions.push_back(VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME);
+		extensions.push_back(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+
+		dynamicRenderingFeatures.pNext = const_cast<void*>(deviceInfo.pNext);
+		deviceInfo.pNext = &dynamicRenderingFeatures;
+	}
+#else
+	assert(!dynamicRendering);
+#endif
+
+#ifdef VK_KHR_timeline_semaphore
+	VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineFeatures = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR };
+	timelineFeatures.timelineSemaphore = VK_TRUE;
+
+	if (timelineSemaphores)
+	{
+		extensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+
+		timelineFeatures.pNext = const_cast<void*>(deviceInfo.pNext);
+		deviceInfo.pNext = &timelineFeatures;
+	}
+#else
+	assert(!timelineSemaphores);
+#endif
+
+#ifdef VK_KHR_buffer_device_address
+	VkPhysicalDeviceBufferDeviceAddressFeaturesKHR addressFeatures = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES_KHR };
+	addressFeatures.bufferDeviceAddress = VK_TRUE;
+
+	if (bufferDeviceAddress)
+	{
+		extensions.push_back(VK_KHR_BUFFER_DEVICE_ADDRESS_EXTENSION_NAME);
+
+		addressFeatures.pNext = const_cast<void*>(deviceInfo.pNext);
+		deviceInfo.pNext = &addressFeatures;
+	}
+#else
+	assert(!bufferDeviceAddress);
+#endif
+
+#ifdef VK_KHR_draw_indirect_count
+	if (drawIndirectCount)
+		extensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+#else
+	assert(!drawIndirectCount);
+#endif
+
+#ifdef VK_EXT_memory_budget
+	if (memoryBudget)
+		extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+#else
+	assert(!memoryBudget);
+#endif
+
+	deviceInfo.enabledExtensionCount = uint32_t(extensions.size());
+	deviceInfo.ppEnabledExtensionNames = extensions.data();
+
+	VkDevice device = 0;
+	VK_CHECK(vkCreateDevice(physicalDevice, &deviceInfo, VK_NULL_HANDLE, &device));
+
+	return device;
+}
+
+VkSemaphore createTimelineSemaphore(VkDevice device, uint64_t initialValue)
+{
+#ifdef VK_KHR_timeline_semaphore
+	VkSemaphoreTypeCreateInfoKHR typeInfo = { VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR };
+	typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+	typeInfo.initialValue = initialValue;
+
+	VkSemaphoreCreateInfo createInfo = { VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO };
+	createInfo.pNext = &typeInfo;
+
+	VkSemaphore semaphore = 0;
+	VK_CHECK(vkCreateSemaphore(device, &createInfo, VK_NULL_HANDLE, &semaphore));
+
+	return semaphore;
+#else
+	assert(!"Timeline semaphores are not available in this build");
+	return 0;
+#endif
+}
+
+void waitTimelineSemaphore(VkDevice device, VkSemaphore semaphore, uint64_t value)
+{
+#ifdef VK_KHR_timeline_semaphore
+	VkSemaphoreWaitInfoKHR waitInfo = { VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR };
+	waitInfo.semaphoreCount = 1;
+	waitInfo.pSemaphores = &semaphore;
+	waitInfo.pValues = &value;
+
+	VK_CHECK(vkWaitSemaphoresKHR(device, &waitInfo, ~0ull));
+#else
+	assert(!"Timeline semaphores are not available in this build");
+#endif
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+// Queue families used by the renderer; compute and transfer fall back to the graphics family when the device
+// has no dedicated family for them, so all three are always valid if graphics is
+struct QueueFamilies
+{
+	uint32_t graphics;
+	uint32_t compute; // async compute: a compute family without graphics when available
+	uint32_t transfer; // DMA: a transfer family without graphics/compute when available
+};
+
+uint32_t getGraphicsQueueFamily(VkPhysicalDevice physicalDevice);
+QueueFamilies getQueueFamilies(VkPhysicalDevice physicalDevice);
+
+bool supportsExtension(VkPhysicalDevice physicalDevice, const char* name);
+bool supportsDynamicRendering(VkPhysicalDevice physicalDevice);
+bool supportsTimelineSemaphores(VkPhysicalDevice physicalDevice);
+bool supportsBufferDeviceAddress(VkPhysicalDevice physicalDevice);
+bool supportsDrawIndirectCount(VkPhysicalDevice physicalDevice); // also requires drawIndirectFirstInstance, which is enabled with it
+bool supportsVisibilityBuffer(VkPhysicalDevice physicalDevice); // geometryShader and shaderStorageImageExtendedFormats, enabled together
+bool supportsMemoryBudget(VkPhysicalDevice physicalDevice);
+bool supportsTextureCompressionBC(VkPhysicalDevice physicalDevice);
+
+// Highest sample count up to requested that color and depth framebuffers both support
+VkSampleCountFlagBits getSampleCount(VkPhysicalDevice physicalDevice, uint32_t requested);
+
+// Creates one queue per distinct family in families
+VkDevice createDevice(VkPhysicalDevice physicalDevice, const QueueFamilies& families, bool swapchain, bool dynamicRendering, bool timelineSemaphores, bool bufferDeviceAddress, bool drawIndirectCount, bool visibilityBuffer, bool memoryBudget, bool textureCompressionBC);
+
+VkSemaphore createTimelineSemaphore(VkDevice device, uint64_t initialValue);
+void waitTimelineSemaphore(VkDevice device, VkSemaphore semaphore, uint64_t value);
@@ -0,0 +1,309 @@
+#include "common.h"
+#include "shaders.h"
+#include "swapchain.h"
+#include "resources.h"
+#include "mesh.h"
+#include "scenegen.h"
+#include "drawbench.h"
+#include "timer.h"
+
+#include <string.h>
+
+static const uint32_t kDrawImageSize = 512;
+static const uint32_t kDrawFrames = 50;
+
+struct DrawMode
+{
+	const char* name;
+	uint32_t vertexInput;
+	bool bindPerDraw; // binds the vertex buffer at the mesh offset for every draw, like meshes in separate buffers
+};
+
+static void beginOffscreen(VkCommandBuffer commandBuffer, const RenderTargetInfo& target, VkFramebuffer framebuffer, const Image& image)
+{
+	VkClearValue clearColor = {};
+
+	if (target.renderPass)
+	{
+		VkRenderPassBeginInfo passBeginInfo = { VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO };
+		passBeginInfo.renderPass = target.renderPass;
+		passBeginInfo.framebuffer = framebuffer;
+		passBeginInfo.renderArea.extent.width = image.width;
+		passBeginInfo.renderArea.extent.height = image.height;
+		passBeginInfo.clearValueCount = 1;
+		passBeginInfo.pClearValues = &clearColor;
+
+		vkCmdBeginRenderPass(commandBuffer, &passBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		return;
+	}
+
+#ifdef VK_KHR_dynamic_rendering
+	VkRenderingAttachmentInfoKHR colorAttachment = { VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR };
+	colorAttachment.imageView = image.imageView;
+	colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	colorAttachment.clearValue = clearColor;
+
+	VkRenderingInfoKHR renderingInfo = { VK_STRUCTURE_TYPE_RENDERING_INFO_KHR };
+	renderingInfo.renderArea.extent.width = image.width;
+	renderingInfo.renderArea.extent.height = image.height;
+	renderingInfo.layerCount = 1;
+	renderingInfo.colorAttachmentCount = 1;
+	renderingInfo.pColorAttachments = &colorAttachment;
+
+	vkCmdBeginRenderingKHR(commandBuffer, &renderingInfo);
+#else
+	assert(!"Dynamic rendering is not available in this build");
+#endif
+}
+
+static void endOffscreen(VkCommandBuffer commandBuffer, const RenderTargetInfo& target)
+{
+	if (target.renderPass)
+		vkCmdEndRenderPass(commandBuffer);
+#ifdef VK_KHR_dynamic_rendering
+	else
+		vkCmdEndRenderingKHR(commandBuffer);
+#endif
+}
+
+// Records a full frame: clear, one draw per submesh, and a copy of the image to readback
+static void recordDraws(VkCommandBuffer commandBuffer, const RenderTargetInfo& target, VkFramebuffer framebuffer, const Image& image, const Buffer& readback, VkDeviceSize readbackOffset,
+	VkPipeline pipeline, VkPipelineLayout layout, const Mesh& mesh, const Buffer& vb, const Buffer& ib, uint64_t vertexAddress, const DrawMode& mode)
+{
+	VkImageMemoryBarrier beginBarrier = { VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+	beginBarrier.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	beginBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	beginBarrier.newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	beginBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	beginBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	beginBarrier.image = image.image;
+	beginBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	beginBarrier.subresourceRange.levelCount = 1;
+	beginBarrier.subresourceRange.layerCount = 1;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_DEPENDENCY_BY_REGION_BIT, 0, 0, 0, 0, 1, &beginBarrier);
+
+	beginOffscreen(commandBuffer, target, framebuffer, image);
+
+	VkViewport viewport = { 0, float(image.height), float(image.width), -float(image.height), 0, 1 };
+	VkRect2D scissor = { {0, 0}, {image.width, image.height} };
+
+	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+
+	// the scene fits the view volume of a camera at the origin, see generateScene
+	Globals globals = { { 0.f, 0.f, -0.5f, 0.f }, { 1.f, 1.f, 1.f, 1.f }, vertexAddress };
+	vkCmdPushConstants(commandBuffer, layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(globals), &globals);
+
+	if (mode.vertexInput == VertexInputAttributes && !mode.bindPerDraw)
+	{
+		VkDeviceSize offset = 0;
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vb.buffer, &offset);
+	}
+
+	vkCmdBindIndexBuffer(commandBuffer, ib.buffer, 0, mesh.indexSize == sizeof(uint16_t) ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32);
+
+	uint32_t currentMaterial = ~0u;
+
+	for (size_t i = 0; i < mesh.submeshes.size(); i++)
+	{
+		const Submesh& submesh = mesh.submeshes[i];
+
+		if (submesh.material != currentMaterial)
+		{
+			const Material& material = mesh.materials[submesh.material];
+			vkCmdPushConstants(commandBuffer, layout, VK_SHADER_STAGE_VERTEX_BIT, offsetof(Globals, diffuseColor), sizeof(material.diffuse), material.diffuse);
+
+			currentMaterial = submesh.material;
+		}
+
+		if (mode.bindPerDraw)
+		{
+			VkDeviceSize offset = VkDeviceSize(submesh.vertexOffset) * sizeof(Vertex);
+			vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vb.buffer, &offset);
+
+			vkCmdDrawIndexed(commandBuffer, submesh.indexCount, 1, submesh.indexOffset, 0, 0);
+		}
+		else
+			vkCmdDrawIndexed(commandBuffer, submesh.indexCount, 1, submesh.indexOffset, int32_t(submesh.vertexOffset), 0);
+	}
+
+	endOffscreen(commandBuffer, target);
+
+	VkImageMemoryBarrier copyBarrier = beginBarrier;
+	copyBarrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	copyBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	copyBarrier.oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	copyBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, 0, 0, 0, 1, &copyBarrier);
+
+	VkBufferImageCopy region = {};
+	region.bufferOffset = readbackOffset;
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.layerCount = 1;
+	region.imageExtent = { image.width, image.height, 1 };
+
+	vkCmdCopyImageToBuffer(commandBuffer, image.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readback.buffer, 1, &region);
+
+	VkMemoryBarrier hostBarrier = { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+	hostBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &hostBarrier, 0, 0, 0, 0);
+}
+
+bool benchmarkDraws(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties, VkQueue queue, uint32_t familyIndex, const RenderTargetInfo& target, VkShaderModule attributeVS, VkShaderModule pulledVS, VkShaderModule fs, VkPipelineLayout layout, uint32_t drawCount)
+{
+	// small instances keep the GPU side cheap, so recording dominates
+	SceneSettings settings = { uint64_t(drawCount) * 256, 0.5f, 16, drawCount, SceneLayoutGrid, 1 };
+
+	Mesh mesh;
+	generateScene(mesh, settings);
+
+	// 16-bit batches give every instance its own vertexOffset, like separate meshes in one buffer
+	selectIndexSize(mesh);
+
+	printf("Drawing %d meshes, %d triangles, %d-bit indices, %dx%d\n", int(mesh.submeshes.size()), int(mesh.indices.size() / 3), mesh.indexSize * 8, kDrawImageSize, kDrawImageSize);
+
+	VkBufferUsageFlags vertexUsage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | (pulledVS ? VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT_KHR : 0);
+	VkMemoryPropertyFlags hostVisible = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+	Buffer vb = {};
+	createBuffer(vb, device, memoryProperties, mesh.vertices.size() * sizeof(Vertex), vertexUsage, hostVisible);
+	memcpy(vb.data, mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex));
+
+	Buffer ib = {};
+	createBuffer(ib, device, memoryProperties, mesh.indices.size() * mesh.indexSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, hostVisible);
+
+	if (mesh.indexSize == sizeof(uint16_t))
+	{
+		std::vector<uint16_t> indices16(mesh.indices.begin(), mesh.indices.end());
+		memcpy(ib.data, indices16.data(), indices16.size() * sizeof(uint16_t));
+	}
+	else
+		memcpy(ib.data, mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t));
+
+	uint64_t vertexAddress = pulledVS ? getBufferAddress(device, vb) : 0;
+
+	Image image = {};
+	createImage(image, device, memoryProperties, kDrawImageSize, kDrawImageSize, target.colorFormat, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+
+	VkFramebuffer framebuffer = target.renderPass ? createFramebuffer(device, target.renderPass, &image.imageView, 1, image.width, image.height) : 0;
+
+	const DrawMode modes[] =
+	{
+		{ "attributes, bind per mesh", VertexInputAttributes, true },
+		{ "attributes, shared buffer", VertexInputAttributes, false },
+		{ "pulled", VertexInputPulled, false },
+	};
+
+	size_t modeCount = pulledVS ? ARRAYSIZE(modes) : ARRAYSIZE(modes) - 1;
+	size_t imageSize = size_t(image.width) * image.height * 4;
+
+	Buffer readback = {};
+	createBuffer(readback, device, memoryProperties, imageSize * modeCount, VK_BUFFER_USAGE_TRANSFER_DST_BIT, hostVisible);
+
+	VkCommandPoolCreateInfo poolInfo = { VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+	poolInfo.queueFamilyIndex = familyIndex;
+
+	VkCommandPool commandPool = 0;
+	VK_CHECK(vkCreateCommandPool(device, &poolInfo, 0, &commandPool));
+
+	VkCommandBufferAllocateInfo allocateInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
+	allocateInfo.commandPool = commandPool;
+	allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocateInfo.commandBufferCount = 1;
+
+	VkCommandBuffer commandBuffer = 0;
+	VK_CHECK(vkAllocateCommandBuffers(device, &allocateInfo, &commandBuffer));
+
+	uint32_t vertexFormat = mesh.hasNormals ? VertexFormatFull : VertexFormatNoNormals;
+
+	double baseline = 0;
+
+	for (size_t m = 0; m < modeCount; m++)
+	{
+		const DrawMode& mode = modes[m];
+
+		PipelineVariant variant = { vertexFormat, LightingModeLambert, mode.vertexInput };
+		VkPipeline pipeline = createGraphicsPipeline(device, 0, target, mode.vertexInput == VertexInputPulled ? pulledVS : attributeVS, fs, layout, variant);
+		assert(pipeline);
+
+		// the last recording is submitted, so the image comes from the same commands that were timed
+		double bestTime = 1e9;
+
+		for (uint32_t frame = 0; frame < kDrawFrames; frame++)
+		{
+			VK_CHECK(vkResetCommandPool(device, commandPool, 0));
+
+			double start = getTimeMs();
+
+			VkCommandBufferBeginInfo beginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+			beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+			VK_CHECK(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+
+			recordDraws(commandBuffer, target, framebuffer, image, readback, m * imageSize, pipeline, layout, mesh, vb, ib, vertexAddress, mode);
+
+			VK_CHECK(vkEndCommandBuffer(commandBuffer));
+
+			double end = getTimeMs();
+			bestTime = bestTime < end - start ? bestTime : end - start;
+		}
+
+		VkSubmitInfo submitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &commandBuffer;
+
+		VK_CHECK(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		VK_CHECK(vkQueueWaitIdle(queue));
+
+		vkDestroyPipeline(device, pipeline, VK_NULL_HANDLE);
+
+		baseline = (m == 0) ? bestTime : baseline;
+
+		printf("%-26s: record %7.3f ms, %6.1f ns/draw, %.2fx\n", mode.name, bestTime, bestTime * 1e6 / double(mesh.submeshes.size()), baseline / bestTime);
+	}
+
+	// every mode draws the same triangles in the same order without depth testing, so the images have to match exactly
+	bool matches = true;
+
+	for (size_t m = 1; m < modeCount; m++)
+	{
+		const unsigned char* reference = static_cast<const unsigned char*>(readback.data);
+		const unsigned char* pixels = reference + m * imageSize;
+
+		size_t covered = 0, mismatches = 0;
+
+		for (size_t i = 0; i < imageSize; i += 4)
+		{
+			covered += (reference[i + 0] | reference[i + 1] | reference[i + 2]) != 0;
+			mismatches += memcmp(reference + i, pixels + i, 4) != 0;
+		}
+
+		printf("%-26s: %d/%d pixels differ from %s (%d covered)\n", modes[m].name, int(mismatches), int(imageSize / 4), modes[0].name, int(covered));
+
+		matches &= mismatches == 0;
+	}
+
+	if (!pulledVS)
+		printf("Vertex pulling is not supported by this device\n");
+
+	vkDestroyCommandPool(device, commandPool, VK_NULL_HANDLE);
+
+	if (framebuffer)
+		vkDestroyFramebuffer(device, framebuffer, VK_NULL_HANDLE);
+
+	destroyImage(image, device);
+	destroyBuffer(readback, device);
+	destroyBuffer(vb, device);
+	destroyBuffer(ib, device);
+
+	return matches;
+}
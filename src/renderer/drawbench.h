@@ -0,0 +1,7 @@
+#pragma once
+
+// Draws a generated scene with one draw per mesh, using vertex attributes (with a vertex buffer binding per mesh, and
+// with one shared binding) and pulled vertices (pulledVS may be 0 if unsupported). Measures the CPU cost of recording
+// the draws and compares the rendered images, which have to be identical. Runs offscreen, so it works on lavapipe
+// and other drivers without a display; returns false if the images differ
+bool benchmarkDraws(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties, VkQueue queue, uint32_t familyIndex, const RenderTargetInfo& target, VkShaderModule attributeVS, VkShaderModule pulledVS, VkShaderModule fs, VkPipelineLayout layout, uint32_t drawCount);
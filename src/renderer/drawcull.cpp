@@ -0,0 +1,268 @@
+#include "common.h"
+#include "shaders.h"
+#include "drawcull.h"
+#include "scenegen.h"
+#include "timer.h"
+
+#include <string.h>
+
+// must match CullConstants in drawcull.comp.glsl
+struct CullConstants
+{
+	float cameraPosition[4];
+
+	uint64_t records;
+	uint64_t batches;
+	uint64_t commands;
+	uint64_t counts;
+};
+
+void createDrawCuller(DrawCuller& result, VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties, VkPipelineCache pipelineCache, VkShaderModule cs, Uploader& uploader, const DrawList& list)
+{
+	assert(!list.records.empty());
+
+	result.device = device;
+
+	VkPushConstantRange pushConstantRange = { VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullConstants) };
+
+	VkPipelineLayoutCreateInfo layoutInfo = { VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO };
+	layoutInfo.pushConstantRangeCount = 1;
+	layoutInfo.pPushConstantRanges = &pushConstantRange;
+
+	VK_CHECK(vkCreatePipelineLayout(device, &layoutInfo, 0, &result.layout));
+
+	result.pipeline = createComputePipeline(device, pipelineCache, cs, result.layout);
+
+	VkBufferUsageFlags inputUsage = VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT_KHR | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	VkBufferUsageFlags outputUsage = VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT_KHR | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+	createBuffer(result.records, device, memoryProperties, list.records.size() * sizeof(DrawRecord), inputUsage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	createBuffer(result.batches, device, memoryProperties, list.batches.size() * sizeof(DrawBatch), inputUsage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	createBuffer(result.commands, device, memoryProperties, list.records.size() * sizeof(DrawCommand), outputUsage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	createBuffer(result.counts, device, memoryProperties, list.batches.size() * sizeof(uint32_t), outputUsage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	uploadBuffer(uploader, result.records, list.records.data(), list.records.size() * sizeof(DrawRecord));
+	uploadBuffer(uploader, result.batches, list.batches.data(), list.batches.size() * sizeof(DrawBatch));
+
+	result.batchCount = uint32_t(list.batches.size());
+}
+
+void destroyDrawCuller(DrawCuller& culler)
+{
+	destroyBuffer(culler.records, culler.device);
+	destroyBuffer(culler.batches, culler.device);
+	destroyBuffer(culler.commands, culler.device);
+	destroyBuffer(culler.counts, culler.device);
+
+	vkDestroyPipeline(culler.device, culler.pipeline, VK_NULL_HANDLE);
+	vkDestroyPipelineLayout(culler.device, culler.layout, VK_NULL_HANDLE);
+}
+
+void dispatchCulling(DrawCuller& culler, VkCommandBuffer commandBuffer, const float camera[3])
+{
+	// indirect draws and readback copies of earlier frames may still be reading the previous commands
+	VkMemoryBarrier readBarrier = { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+	readBarrier.srcAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+	readBarrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &readBarrier, 0, 0, 0, 0);
+
+	CullConstants constants = { { camera[0], camera[1], camera[2], 0.f } };
+	constants.records = getBufferAddress(culler.device, culler.records);
+	constants.batches = getBufferAddress(culler.device, culler.batches);
+	constants.commands = getBufferAddress(culler.device, culler.commands);
+	constants.counts = getBufferAddress(culler.device, culler.counts);
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, culler.pipeline);
+	vkCmdPushConstants(commandBuffer, culler.layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+
+	vkCmdDispatch(commandBuffer, culler.batchCount, 1, 1);
+
+	VkMemoryBarrier writeBarrier = { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+	writeBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	writeBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &writeBarrier, 0, 0, 0, 0);
+}
+
+void copyCulledDraws(const DrawCuller& culler, VkCommandBuffer commandBuffer, const Buffer& readback)
+{
+	assert(readback.data && readback.size >= culler.commands.size + culler.counts.size);
+
+	// dispatchCulling already made the shader writes visible to transfers
+	VkBufferCopy regions[] =
+	{
+		{ 0, 0, culler.commands.size },
+		{ 0, culler.commands.size, culler.counts.size },
+	};
+
+	vkCmdCopyBuffer(commandBuffer, culler.commands.buffer, readback.buffer, 1, &regions[0]);
+	vkCmdCopyBuffer(commandBuffer, culler.counts.buffer, readback.buffer, 1, &regions[1]);
+
+	VkMemoryBarrier hostBarrier = { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+	hostBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &hostBarrier, 0, 0, 0, 0);
+}
+
+void drawCulled(const DrawCuller& culler, VkCommandBuffer commandBuffer, const DrawList& list, const Mesh& mesh, VkPipelineLayout layout, const VkDescriptorSet* materialSets)
+{
+#ifdef VK_KHR_draw_indirect_count
+	uint32_t currentMaterial = ~0u;
+
+	for (size_t i = 0; i < list.batches.size(); i++)
+	{
+		const DrawBatch& batch = list.batches[i];
+
+		if (batch.material != currentMaterial)
+		{
+			const Material& material = mesh.materials[batch.material];
+			vkCmdPushConstants(commandBuffer, layout, VK_SHADER_STAGE_VERTEX_BIT, offsetof(Globals, diffuseColor), sizeof(material.diffuse), material.diffuse);
+
+			if (materialSets)
+				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 0, 1, &materialSets[batch.material], 0, 0);
+
+			currentMaterial = batch.material;
+		}
+
+		vkCmdDrawIndexedIndirectCountKHR(commandBuffer, culler.commands.buffer, batch.firstRecord * sizeof(DrawCommand), culler.counts.buffer, i * sizeof(uint32_t), batch.recordCount, sizeof(DrawCommand));
+	}
+#else
+	assert(!"Draw indirect count is not available in this build");
+#endif
+}
+
+bool benchmarkCulling(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties, VkQueue queue, uint32_t familyIndex, float timestampPeriod, VkShaderModule cs, uint32_t objectCount)
+{
+	// the object count matters, not the triangle count; keep the scene cheap to generate
+	SceneSettings settings = { uint64_t(objectCount) * 16, 0.5f, 16, objectCount, SceneLayoutRandom, 1 };
+
+	Mesh mesh;
+	generateScene(mesh, settings);
+
+	DrawList list;
+	buildDrawList(list, mesh);
+
+	printf("Culling %d objects in %d batches\n", int(list.records.size()), int(list.batches.size()));
+
+	Uploader uploader;
+	createUploader(uploader, device, memoryProperties, queue, familyIndex, familyIndex, false, 8 * 1024 * 1024);
+
+	DrawCuller culler;
+	createDrawCuller(culler, device, memoryProperties, 0, cs, uploader, list);
+
+	Buffer readback = {};
+	createBuffer(readback, device, memoryProperties, culler.commands.size + culler.counts.size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+	VkCommandPoolCreateInfo poolInfo = { VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+	poolInfo.queueFamilyIndex = familyIndex;
+
+	VkCommandPool commandPool = 0;
+	VK_CHECK(vkCreateCommandPool(device, &poolInfo, 0, &commandPool));
+
+	VkCommandBufferAllocateInfo allocateInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
+	allocateInfo.commandPool = commandPool;
+	allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocateInfo.commandBufferCount = 1;
+
+	VkCommandBuffer commandBuffer = 0;
+	VK_CHECK(vkAllocateCommandBuffers(device, &allocateInfo, &commandBuffer));
+
+	VkQueryPoolCreateInfo queryInfo = { VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO };
+	queryInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	queryInfo.queryCount = 2;
+
+	VkQueryPool queryPool = 0;
+	VK_CHECK(vkCreateQueryPool(device, &queryInfo, 0, &queryPool));
+
+	// uploads ran on the same queue and were waited for on the host
+	waitTimeline(uploader.timeline, uploader.timeline.submitted);
+
+	std::vector<DrawCommand> commands(list.records.size());
+	std::vector<uint32_t> counts(list.batches.size());
+
+	bool matches = true;
+
+	// sweeps the camera through the scene, from everything visible to only a slice of it
+	const uint32_t kPositions = 8;
+
+	for (uint32_t p = 0; p < kPositions; p++)
+	{
+		float camera[3] = { -1.5f + 3.f * float(p) / float(kPositions - 1), 0.f, -0.5f + 0.75f * float(p % 2) };
+
+		VK_CHECK(vkResetCommandPool(device, commandPool, 0));
+
+		VkCommandBufferBeginInfo beginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+		VK_CHECK(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+
+		VkMemoryBarrier uploadBarrier = { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+		uploadBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		uploadBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &uploadBarrier, 0, 0, 0, 0);
+
+		// entries past the count of each batch are undefined; clearing them keeps the comparison below simple
+		vkCmdFillBuffer(commandBuffer, culler.commands.buffer, 0, VK_WHOLE_SIZE, 0);
+
+		VkMemoryBarrier fillBarrier = { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+		fillBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		fillBarrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &fillBarrier, 0, 0, 0, 0);
+
+		vkCmdResetQueryPool(commandBuffer, queryPool, 0, 2);
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, 0);
+
+		dispatchCulling(culler, commandBuffer, camera);
+
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, 1);
+
+		copyCulledDraws(culler, commandBuffer, readback);
+
+		VK_CHECK(vkEndCommandBuffer(commandBuffer));
+
+		VkSubmitInfo submitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &commandBuffer;
+
+		VK_CHECK(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		VK_CHECK(vkQueueWaitIdle(queue));
+
+		uint64_t timestamps[2] = {};
+		VK_CHECK(vkGetQueryPoolResults(device, queryPool, 0, 2, sizeof(timestamps), timestamps, sizeof(timestamps[0]), VK_QUERY_RESULT_64_BIT));
+
+		double gpuTime = double(timestamps[1] - timestamps[0]) * timestampPeriod * 1e-6;
+
+		memset(commands.data(), 0, commands.size() * sizeof(DrawCommand));
+
+		double cpuStart = getTimeMs();
+		uint32_t visible = cullDraws(commands.data(), counts.data(), list, camera);
+		double cpuTime = getTimeMs() - cpuStart;
+
+		const DrawCommand* gpuCommands = static_cast<const DrawCommand*>(readback.data);
+		const uint32_t* gpuCounts = reinterpret_cast<const uint32_t*>(static_cast<const char*>(readback.data) + culler.commands.size);
+
+		bool same = memcmp(gpuCounts, counts.data(), counts.size() * sizeof(uint32_t)) == 0 &&
+			memcmp(gpuCommands, commands.data(), commands.size() * sizeof(DrawCommand)) == 0;
+
+		printf("camera %5.2f %5.2f: %7d visible, gpu %7.3f ms, cpu %7.3f ms, %s\n", camera[0], camera[2], visible, gpuTime, cpuTime, same ? "match" : "MISMATCH");
+
+		matches &= same;
+	}
+
+	// with per-object draws recording grows with the visible objects; compacted draws are recorded per batch
+	printf("Recording: %d indirect draws instead of up to %d draws\n", int(list.batches.size()), int(list.records.size()));
+
+	vkDestroyQueryPool(device, queryPool, VK_NULL_HANDLE);
+	vkDestroyCommandPool(device, commandPool, VK_NULL_HANDLE);
+
+	destroyBuffer(readback, device);
+	destroyDrawCuller(culler);
+	destroyUploader(uploader);
+
+	return matches;
+}
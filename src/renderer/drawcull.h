@@ -0,0 +1,45 @@
+#pragma once
+
+#include "drawlist.h"
+#include "resources.h"
+
+// GPU side of draw compaction: drawcull.comp.glsl culls the records of every batch and writes the compacted commands
+// and per-batch counts, which are drawn with one vkCmdDrawIndexedIndirectCount per batch. Recording cost depends on the
+// number of batches, not on the number of objects. Buffers are accessed through device addresses
+struct DrawCuller
+{
+	VkDevice device;
+
+	VkPipelineLayout layout;
+	VkPipeline pipeline;
+
+	Buffer records;
+	Buffer batches;
+
+	// rewritten by every dispatch; barriers order the dispatch after indirect reads and readback copies of earlier
+	// frames on the queue, so frames in flight share them
+	Buffer commands;
+	Buffer counts;
+
+	uint32_t batchCount;
+};
+
+// records and batches are uploaded through the uploader; its acquires have to cover the compute shader stage
+void createDrawCuller(DrawCuller& result, VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties, VkPipelineCache pipelineCache, VkShaderModule cs, Uploader& uploader, const DrawList& list);
+void destroyDrawCuller(DrawCuller& culler);
+
+// Records the culling dispatch and the barrier to indirect reads; must be recorded outside of rendering
+void dispatchCulling(DrawCuller& culler, VkCommandBuffer commandBuffer, const float camera[3]);
+
+// Copies the compacted commands, followed by the per-batch counts, to a host visible buffer of at least commands.size +
+// counts.size bytes, so that what was drawn can be counted once the frame is done; must be recorded after
+// dispatchCulling and outside of rendering
+void copyCulledDraws(const DrawCuller& culler, VkCommandBuffer commandBuffer, const Buffer& readback);
+
+// Draws the compacted commands; material colors are pushed to Globals::diffuseColor and materialSets (one per material,
+// may be 0) are bound to set 0 when the batch material changes
+void drawCulled(const DrawCuller& culler, VkCommandBuffer commandBuffer, const DrawList& list, const Mesh& mesh, VkPipelineLayout layout, const VkDescriptorSet* materialSets);
+
+// Culls a generated scene with objectCount objects from several camera positions on the GPU and with cullDraws, and
+// compares the commands and counts; returns false if they differ. Needs buffer device addresses, but no draw count support
+bool benchmarkCulling(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties, VkQueue queue, uint32_t familyIndex, float timestampPeriod, VkShaderModule cs, uint32_t objectCount);
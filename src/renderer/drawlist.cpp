@@ -0,0 +1,104 @@
+#include "drawlist.h"
+
+#include <math.h>
+
+void buildDrawList(DrawList& result, const Mesh& mesh)
+{
+	result.records.resize(mesh.submeshes.size());
+	result.batches.clear();
+
+	for (size_t i = 0; i < mesh.submeshes.size(); i++)
+	{
+		const Submesh& submesh = mesh.submeshes[i];
+
+		DrawRecord& record = result.records[i];
+		record.center[0] = submesh.center[0];
+		record.center[1] = submesh.center[1];
+		record.center[2] = submesh.center[2];
+		record.radius = submesh.radius;
+		record.indexOffset = submesh.indexOffset;
+		record.indexCount = submesh.indexCount;
+		record.vertexOffset = int32_t(submesh.vertexOffset);
+		record.material = submesh.material;
+
+		DrawBatch* batch = result.batches.empty() ? 0 : &result.batches.back();
+
+		if (!batch || batch->material != submesh.material || batch->recordCount == kDrawBatchSize)
+		{
+			DrawBatch next = { uint32_t(i), 0, submesh.material, 0 };
+			result.batches.push_back(next);
+
+			batch = &result.batches.back();
+		}
+
+		batch->recordCount++;
+	}
+}
+
+bool isDrawVisible(const DrawRecord& record, const float camera[3])
+{
+	float x = record.center[0] - camera[0];
+	float y = record.center[1] - camera[1];
+	float z = record.center[2] - camera[2];
+	float r = record.radius;
+
+	return fabsf(x) <= 1 + r && fabsf(y) <= 1 + r && z >= -r && z <= 1 + r;
+}
+
+uint32_t cullDraws(DrawCommand* commands, uint32_t* counts, const DrawList& list, const float camera[3])
+{
+	uint32_t total = 0;
+
+	for (size_t i = 0; i < list.batches.size(); i++)
+	{
+		const DrawBatch& batch = list.batches[i];
+
+		uint32_t count = 0;
+
+		for (uint32_t j = 0; j < batch.recordCount; j++)
+		{
+			const DrawRecord& record = list.records[batch.firstRecord + j];
+
+			if (!isDrawVisible(record, camera))
+				continue;
+
+			DrawCommand& command = commands[batch.firstRecord + count];
+			command.indexCount = record.indexCount;
+			command.instanceCount = 1;
+			command.firstIndex = record.indexOffset;
+			command.vertexOffset = record.vertexOffset;
+			command.firstInstance = batch.firstRecord + j;
+
+			count++;
+		}
+
+		counts[i] = count;
+		total += count;
+	}
+
+	return total;
+}
+
+uint32_t countDraws(uint64_t& triangles, const DrawCommand* commands, const uint32_t* counts, const DrawList& list)
+{
+	uint32_t total = 0;
+	triangles = 0;
+
+	for (size_t i = 0; i < list.batches.size(); i++)
+	{
+		const DrawBatch& batch = list.batches[i];
+
+		uint32_t count = counts[i] < batch.recordCount ? counts[i] : batch.recordCount;
+
+		for (uint32_t j = 0; j < count; j++)
+		{
+			const DrawCommand& command = commands[batch.firstRecord + j];
+
+			triangles += uint64_t(command.indexCount / 3) * command.instanceCount;
+		}
+
+		total += count;
+	}
+
+	return total;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "mesh.h"
+
+// Per-object draw records for culling and draw compaction. Records are grouped into batches of one material; culling
+// writes the visible records of a batch as a compacted, order-preserving run of indexed draw commands starting at the
+// first record of the batch, plus a per-batch draw count. drawcull.comp.glsl runs this on the GPU; cullDraws is the
+// CPU version, and both have to produce identical commands.
+const uint32_t kDrawBatchSize = 4096;
+
+// must match DrawRecord in drawcull.comp.glsl
+// There is no per-object transform: loaders and scenegen bake instance transforms into the vertices, so bounds are in
+// world space and every record draws with the same vertex shader inputs
+struct DrawRecord
+{
+	// bounding sphere in world space; radius is FLT_MAX if the bounds are unknown
+	float center[3];
+	float radius;
+
+	uint32_t indexOffset, indexCount;
+	int32_t vertexOffset;
+	uint32_t material;
+};
+
+// must match DrawBatch in drawcull.comp.glsl
+struct DrawBatch
+{
+	uint32_t firstRecord, recordCount;
+	uint32_t material;
+	uint32_t reserved;
+};
+
+// same layout as VkDrawIndexedIndirectCommand; firstInstance is the record index, which shaders see as gl_InstanceIndex
+struct DrawCommand
+{
+	uint32_t indexCount;
+	uint32_t instanceCount;
+	uint32_t firstIndex;
+	int32_t vertexOffset;
+	uint32_t firstInstance;
+};
+
+struct DrawList
+{
+	std::vector<DrawRecord> records;
+	std::vector<DrawBatch> batches;
+};
+
+// One record per submesh; submeshes are sorted by material, so batches split at material changes and every kDrawBatchSize records
+void buildDrawList(DrawList& result, const Mesh& mesh);
+
+// vertices are transformed by subtracting the camera position, so the view volume is the clip space box
+bool isDrawVisible(const DrawRecord& record, const float camera[3]);
+
+// commands has one entry per record, counts one per batch; entries past the count of a batch are left untouched.
+// Returns the total number of visible records
+uint32_t cullDraws(DrawCommand* commands, uint32_t* counts, const DrawList& list, const float camera[3]);
+
+// Adds up the triangles of the commands cullDraws or drawcull.comp.glsl wrote, e.g. after reading them back from the
+// GPU; counts are clamped to the batch sizes. Returns the number of commands
+uint32_t countDraws(uint64_t& triangles, const DrawCommand* commands, const uint32_t* counts, const DrawList& list);
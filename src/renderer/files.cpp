@@ -0,0 +1,130 @@
+#ifndef _CRT_SECURE_NO_WARNINGS
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include "files.h"
+
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <direct.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+bool mapFile(MappedFile& result, const char* path)
+{
+	result = MappedFile();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!mapping)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!data)
+	{
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	result.data = data;
+	result.size = size_t(size.QuadPart);
+	result.file = file;
+	result.mapping = mapping;
+#else
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0)
+	{
+		close(fd);
+		return false;
+	}
+
+	void* data = mmap(NULL, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+
+	// the mapping keeps the file referenced, so the descriptor isn't needed anymore
+	close(fd);
+
+	if (data == MAP_FAILED)
+		return false;
+
+	result.data = data;
+	result.size = size_t(st.st_size);
+#endif
+
+	return true;
+}
+
+void unmapFile(MappedFile& file)
+{
+	if (!file.data)
+		return;
+
+#ifdef _WIN32
+	UnmapViewOfFile(file.data);
+	CloseHandle(file.mapping);
+	CloseHandle(file.file);
+#else
+	munmap(const_cast<void*>(file.data), file.size);
+#endif
+
+	file = MappedFile();
+}
+
+uint64_t getFileTime(const char* path)
+{
+	struct stat st;
+	if (stat(path, &st) != 0)
+		return 0;
+
+	return uint64_t(st.st_mtime);
+}
+
+bool createDirectory(const char* path)
+{
+#ifdef _WIN32
+	return _mkdir(path) == 0 || errno == EEXIST;
+#else
+	return mkdir(path, 0755) == 0 || errno == EEXIST;
+#endif
+}
+
+uint64_t hashBytes(const void* data, size_t size, uint64_t seed)
+{
+	// FNV-1a
+	uint64_t hash = 14695981039346656037ull ^ seed;
+
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+
+	return hash;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct MappedFile
+{
+	const void* data;
+	size_t size;
+
+	void* file; // platform handles
+	void* mapping;
+};
+
+bool mapFile(MappedFile& result, const char* path);
+void unmapFile(MappedFile& file);
+
+// Returns last modification time, or 0 if the file doesn't exist
+uint64_t getFileTime(const char* path);
+
+bool createDirectory(const char* path);
+
+uint64_t hashBytes(const void* data, size_t size, uint64_t seed = 0);
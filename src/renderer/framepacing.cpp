@@ -0,0 +1,71 @@
+#include "framepacing.h"
+
+#include <chrono>
+#include <thread>
+
+// sleeps are only accurate to a scheduler quantum, so the last part of every wait is spent spinning
+const double kSpinThreshold = 2.0;
+
+void initFramePacer(FramePacer& pacer, double targetFrameRate, uint32_t maxQueuedFrames)
+{
+	pacer.targetFrameTime = targetFrameRate > 0 ? 1000.0 / targetFrameRate : 0.0;
+	pacer.maxQueuedFrames = maxQueuedFrames < 1 ? 1 : maxQueuedFrames > kMaxFramesInFlight ? kMaxFramesInFlight : maxQueuedFrames;
+
+	pacer.cpuTime = 0;
+	pacer.gpuTime = 0;
+
+	pacer.frameStart = getTimeMs();
+	pacer.nextFrameStart = pacer.frameStart;
+
+	pacer.latency = 0;
+}
+
+void waitFrame(FramePacer& pacer)
+{
+	double now = getTimeMs();
+
+	for (;;)
+	{
+		double remaining = pacer.nextFrameStart - now;
+
+		if (remaining <= 0)
+			break;
+
+		if (remaining > kSpinThreshold)
+			std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(remaining - kSpinThreshold));
+		else
+			std::this_thread::yield();
+
+		now = getTimeMs();
+	}
+
+	pacer.frameStart = now;
+}
+
+void submitFrame(FramePacer& pacer, uint32_t framesAhead)
+{
+	double now = getTimeMs();
+
+	pacer.cpuTime = pacer.cpuTime * 0.95 + (now - pacer.frameStart) * 0.05;
+
+	// the frame has to wait for everything queued ahead of it before it can execute
+	pacer.latency = (now - pacer.frameStart) + (framesAhead + 1) * pacer.gpuTime;
+
+	// when the GPU is slower than the target, pacing to the GPU keeps the queue from filling up
+	double period = pacer.targetFrameTime > pacer.gpuTime ? pacer.targetFrameTime : pacer.gpuTime;
+
+	// start the next frame as late as possible: when the GPU will be free by the time the CPU finishes recording it
+	double gpuFree = now + framesAhead * pacer.gpuTime - pacer.cpuTime;
+	double scheduled = pacer.frameStart + period;
+
+	pacer.nextFrameStart = scheduled > gpuFree ? scheduled : gpuFree;
+
+	// don't try to catch up after a hitch, that would just produce a burst of frames
+	if (pacer.nextFrameStart < now - period)
+		pacer.nextFrameStart = now;
+}
+
+void updateGpuTime(FramePacer& pacer, double gpuTime)
+{
+	pacer.gpuTime = pacer.gpuTime * 0.95 + gpuTime * 0.05;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "timer.h"
+
+#include <stdint.h>
+
+const uint32_t kMaxFramesInFlight = 3;
+
+// Paces frame starts so that the CPU doesn't run ahead of the GPU or the target rate; every frame queued ahead of
+// the GPU adds a full frame of input latency, so it is better to start later and sample input closer to display
+struct FramePacer
+{
+	double targetFrameTime; // ms; 0 when uncapped
+	uint32_t maxQueuedFrames;
+
+	double cpuTime; // smoothed time from frame start to submit, ms
+	double gpuTime; // smoothed GPU execution time, ms
+
+	double frameStart; // time the current frame started sampling input, ms
+	double nextFrameStart; // scheduled start of the next frame, ms
+
+	double latency; // estimated input to GPU completion time of the last submitted frame, ms
+};
+
+void initFramePacer(FramePacer& pacer, double targetFrameRate, uint32_t maxQueuedFrames);
+
+// Sleeps, then spins, until the next frame is due; input should be sampled right after this returns
+void waitFrame(FramePacer& pacer);
+
+// Call after submitting a frame; framesAhead is the number of previously submitted frames that haven't completed yet
+void submitFrame(FramePacer& pacer, uint32_t framesAhead);
+
+void updateGpuTime(FramePacer& pacer, double gpuTime);
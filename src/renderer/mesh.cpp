@@ -0,0 +1,591 @@
+#include "mesh.h"
+#include "meshfile.h"
+#include "normals.h"
+#include "objparser.h"
+#include "parallel.h"
+#include "vertexremap.h"
+#include "timer.h"
+
+#include <assert.h>
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+
+#include <meshoptimizer.h>
+
+static void fillVertex(Vertex& v, const ObjFile& file, size_t element)
+{
+	int vi = file.f[element * 3 + 0];
+	int vti = file.f[element * 3 + 1];
+	int vni = file.f[element * 3 + 2];
+
+	v.vx = file.v[vi * 3 + 0];
+	v.vy = file.v[vi * 3 + 1];
+	v.vz = file.v[vi * 3 + 2];
+
+	v.nx = vni < 0 ? 0.f : file.vn[vni * 3 + 0];
+	v.ny = vni < 0 ? 0.f : file.vn[vni * 3 + 1];
+	v.nz = vni < 0 ? 1.f : file.vn[vni * 3 + 2];
+
+	v.tu = vti < 0 ? 0.f : file.vt[vti * file.vt_stride + 0];
+	v.tv = vti < 0 ? 0.f : file.vt[vti * file.vt_stride + 1];
+}
+
+static void computeBounds(Submesh& submesh, const Mesh& mesh)
+{
+	float minv[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+	float maxv[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+	for (uint32_t i = 0; i < submesh.indexCount; i++)
+	{
+		const Vertex& v = mesh.vertices[submesh.vertexOffset + mesh.indices[submesh.indexOffset + i]];
+
+		minv[0] = std::min(minv[0], v.vx), maxv[0] = std::max(maxv[0], v.vx);
+		minv[1] = std::min(minv[1], v.vy), maxv[1] = std::max(maxv[1], v.vy);
+		minv[2] = std::min(minv[2], v.vz), maxv[2] = std::max(maxv[2], v.vz);
+	}
+
+	float radius2 = 0;
+
+	for (int k = 0; k < 3; k++)
+		submesh.center[k] = (minv[k] + maxv[k]) * 0.5f;
+
+	for (uint32_t i = 0; i < submesh.indexCount; i++)
+	{
+		const Vertex& v = mesh.vertices[submesh.vertexOffset + mesh.indices[submesh.indexOffset + i]];
+
+		float dx = v.vx - submesh.center[0], dy = v.vy - submesh.center[1], dz = v.vz - submesh.center[2];
+		radius2 = std::max(radius2, dx * dx + dy * dy + dz * dz);
+	}
+
+	submesh.radius = sqrtf(radius2);
+}
+
+static bool loadObj(Mesh& result, const char* path)
+{
+	// every attribute is used, but texture coordinates are stored without w
+	ObjFile file;
+	if (!objParseFile(file, path, ObjAttributeAll) || !objValidate(file))
+		return false;
+
+	// faces without usemtl use a default material that goes after the materials from the file
+	uint32_t defaultMaterial = uint32_t(file.m_size);
+
+	result.materials.resize(file.m_size + 1);
+
+	for (size_t i = 0; i < file.m_size; i++)
+	{
+		const ObjMaterial& om = file.m[i];
+		Material& material = result.materials[i];
+
+		material.diffuse[0] = om.kd[0];
+		material.diffuse[1] = om.kd[1];
+		material.diffuse[2] = om.kd[2];
+		material.diffuse[3] = om.d;
+		material.diffuseTexture = objName(file, om.map_kd);
+	}
+
+	Material& fallback = result.materials[defaultMaterial];
+	fallback.diffuse[0] = fallback.diffuse[1] = fallback.diffuse[2] = fallback.diffuse[3] = 1.f;
+
+	std::vector<uint32_t> ranges;
+	ranges.reserve(file.r_size);
+
+	for (size_t i = 0; i < file.r_size; i++)
+		if (file.r[i].f_offset < (i + 1 < file.r_size ? file.r[i + 1].f_offset : file.f_size))
+			ranges.push_back(uint32_t(i));
+
+	// faces are written out grouped by material so that the draw loop changes material state once per material
+	std::stable_sort(ranges.begin(), ranges.end(), [&](uint32_t l, uint32_t r) {
+		uint32_t lm = file.r[l].material < 0 ? defaultMaterial : uint32_t(file.r[l].material);
+		uint32_t rm = file.r[r].material < 0 ? defaultMaterial : uint32_t(file.r[r].material);
+		return lm < rm;
+	});
+
+	size_t index_count = file.f_size / 3;
+
+	std::vector<Vertex> vertices(index_count);
+	size_t offset = 0;
+
+	result.submeshes.clear();
+
+	for (size_t i = 0; i < ranges.size(); i++)
+	{
+		const ObjRange& range = file.r[ranges[i]];
+
+		size_t begin = range.f_offset / 3;
+		size_t end = (ranges[i] + 1 < file.r_size ? file.r[ranges[i] + 1].f_offset : file.f_size) / 3;
+
+		uint32_t material = range.material < 0 ? defaultMaterial : uint32_t(range.material);
+
+		for (size_t j = begin; j < end; j++)
+			fillVertex(vertices[offset + j - begin], file, j);
+
+		// ranges split by repeated o/g lines with the same names are merged back
+		const ObjRange* last = i > 0 ? &file.r[ranges[i - 1]] : 0;
+
+		if (last && last->material == range.material && strcmp(objName(file, last->object), objName(file, range.object)) == 0 && strcmp(objName(file, last->group), objName(file, range.group)) == 0)
+			result.submeshes.back().indexCount += uint32_t(end - begin);
+		else
+		{
+			Submesh submesh = { uint32_t(offset), uint32_t(end - begin), 0, material, { 0, 0, 0 }, 0 };
+			result.submeshes.push_back(submesh);
+		}
+
+		offset += end - begin;
+	}
+
+	assert(offset == index_count);
+
+	std::vector<uint32_t> remap(index_count);
+
+	// same numbering as meshopt_generateVertexRemap, so the output doesn't depend on the thread count
+	size_t vertex_count = generateVertexRemap(remap.data(), vertices.data(), index_count, sizeof(Vertex), getThreadCount());
+
+	result.vertices.resize(vertex_count);
+	result.indices.resize(index_count);
+
+	meshopt_remapVertexBuffer(result.vertices.data(), vertices.data(), index_count, sizeof(Vertex), remap.data());
+	meshopt_remapIndexBuffer(result.indices.data(), 0, index_count, remap.data());
+
+	for (size_t i = 0; i < result.submeshes.size(); i++)
+		computeBounds(result.submeshes[i], result);
+
+	result.indexSize = sizeof(uint32_t);
+	result.hasNormals = file.vn_size > 0;
+
+	// hard edges between faces that meet at a sharp angle stay hard, like most exporters do
+	if (!result.hasNormals)
+	{
+		NormalSettings normalSettings = { 60.f, NormalWeightAngle };
+		generateNormals(result, normalSettings, getThreadCount());
+	}
+
+	return true;
+}
+
+static bool loadMeshFile(Mesh& result, const char* path)
+{
+	MeshFile file;
+	if (!openMeshFile(file, path))
+		return false;
+
+	if (file.header->vertexSize != sizeof(Vertex))
+	{
+		closeMeshFile(file);
+		return false;
+	}
+
+	result.vertices.resize(file.header->vertexCount);
+	result.indices.resize(file.header->indexCount);
+	result.indexSize = sizeof(uint32_t);
+	result.hasNormals = (file.header->flags & MeshFileHasNormals) != 0;
+
+	setSingleSubmesh(result, file.header->indexCount);
+
+	bool ok = decodeMeshFile(file, result.vertices.data(), result.indices.data(), sizeof(uint32_t), getThreadCount());
+
+	closeMeshFile(file);
+
+	return ok;
+}
+
+bool isMeshFile(const char* path)
+{
+	size_t length = strlen(path);
+
+	return length >= 5 && strcmp(path + length - 5, ".mesh") == 0;
+}
+
+void setSingleSubmesh(Mesh& mesh, uint32_t indexCount)
+{
+	Material material = { { 1, 1, 1, 1 } };
+	Submesh submesh = { 0, indexCount, 0, 0, { 0, 0, 0 }, FLT_MAX };
+
+	mesh.materials.assign(1, material);
+	mesh.submeshes.assign(1, submesh);
+}
+
+bool selectIndexSize(Mesh& mesh)
+{
+	if (mesh.indexSize == sizeof(uint16_t))
+		return true;
+
+	std::vector<Submesh> batches;
+
+	for (size_t i = 0; i < mesh.submeshes.size(); i++)
+	{
+		const Submesh& submesh = mesh.submeshes[i];
+		assert(submesh.vertexOffset == 0);
+
+		Submesh batch = submesh;
+		uint32_t minIndex = ~0u, maxIndex = 0;
+
+		for (uint32_t j = 0; j < submesh.indexCount; j += 3)
+		{
+			const uint32_t* triangle = &mesh.indices[submesh.indexOffset + j];
+
+			uint32_t triangleMin = std::min(triangle[0], std::min(triangle[1], triangle[2]));
+			uint32_t triangleMax = std::max(triangle[0], std::max(triangle[1], triangle[2]));
+
+			if (triangleMax - triangleMin > 0xffff)
+				return false;
+
+			// vertices are ordered by first use, so consecutive triangles mostly stay within a narrow window
+			if (std::max(maxIndex, triangleMax) - std::min(minIndex, triangleMin) > 0xffff)
+			{
+				batch.indexCount = submesh.indexOffset + j - batch.indexOffset;
+				batch.vertexOffset = minIndex;
+				batches.push_back(batch);
+
+				batch.indexOffset = submesh.indexOffset + j;
+				minIndex = ~0u, maxIndex = 0;
+			}
+
+			minIndex = std::min(minIndex, triangleMin);
+			maxIndex = std::max(maxIndex, triangleMax);
+		}
+
+		batch.indexCount = submesh.indexOffset + submesh.indexCount - batch.indexOffset;
+		batch.vertexOffset = submesh.indexCount ? minIndex : 0;
+		batches.push_back(batch);
+	}
+
+	for (size_t i = 0; i < batches.size(); i++)
+	{
+		Submesh& batch = batches[i];
+
+		for (uint32_t j = 0; j < batch.indexCount; j++)
+			mesh.indices[batch.indexOffset + j] -= batch.vertexOffset;
+
+		// batches split from a submesh get tighter bounds; unbounded submeshes stay unbounded
+		if (batch.radius != FLT_MAX)
+			computeBounds(batch, mesh);
+	}
+
+	mesh.submeshes.swap(batches);
+	mesh.indexSize = sizeof(uint16_t);
+
+	return true;
+}
+
+bool loadMesh(Mesh& result, const char* path)
+{
+	return isMeshFile(path) ? loadMeshFile(result, path) : loadObj(result, path);
+}
+
+bool convertMesh(const char* objPath, const char* meshPath, int quantizeBits)
+{
+	Mesh mesh;
+	if (!loadObj(mesh, objPath))
+		return false;
+
+	// the index codec relies on vertex cache locality and the vertex codec on neighboring vertices being similar;
+	// triangles are only reordered within submeshes so that faces stay grouped by material
+	for (size_t i = 0; i < mesh.submeshes.size(); i++)
+	{
+		uint32_t* indices = mesh.indices.data() + mesh.submeshes[i].indexOffset;
+
+		meshopt_optimizeVertexCache(indices, indices, mesh.submeshes[i].indexCount, mesh.vertices.size());
+	}
+
+	meshopt_optimizeVertexFetch(mesh.vertices.data(), mesh.indices.data(), mesh.indices.size(), mesh.vertices.data(), mesh.vertices.size(), sizeof(Vertex));
+
+	uint32_t flags = mesh.hasNormals ? MeshFileHasNormals : 0;
+
+	return writeMeshFile(meshPath, mesh.vertices.data(), mesh.vertices.size(), sizeof(Vertex), mesh.indices.data(), mesh.indices.size(), flags, quantizeBits);
+}
+
+static const char* getFileName(const char* path)
+{
+	const char* slash = strrchr(path, '/');
+	const char* backslash = strrchr(path, '\\');
+	const char* separator = slash > backslash ? slash : backslash;
+
+	return separator ? separator + 1 : path;
+}
+
+bool writeObjFile(const Mesh& mesh, const char* objPath, const char* mtlPath)
+{
+	FILE* mtl = fopen(mtlPath, "w");
+	if (!mtl)
+		return false;
+
+	for (size_t i = 0; i < mesh.materials.size(); i++)
+	{
+		const Material& material = mesh.materials[i];
+
+		fprintf(mtl, "newmtl material_%d\nKd %g %g %g\nd %g\n", int(i), material.diffuse[0], material.diffuse[1], material.diffuse[2], material.diffuse[3]);
+
+		if (!material.diffuseTexture.empty())
+			fprintf(mtl, "map_Kd %s\n", material.diffuseTexture.c_str());
+	}
+
+	fclose(mtl);
+
+	FILE* obj = fopen(objPath, "w");
+	if (!obj)
+		return false;
+
+	fprintf(obj, "mtllib %s\n", getFileName(mtlPath));
+
+	for (size_t i = 0; i < mesh.vertices.size(); i++)
+	{
+		const Vertex& v = mesh.vertices[i];
+
+		fprintf(obj, "v %g %g %g\nvt %g %g\nvn %g %g %g\n", v.vx, v.vy, v.vz, v.tu, v.tv, v.nx, v.ny, v.nz);
+	}
+
+	for (size_t i = 0; i < mesh.submeshes.size(); i++)
+	{
+		const Submesh& submesh = mesh.submeshes[i];
+
+		fprintf(obj, "o submesh_%d\nusemtl material_%d\n", int(i), int(submesh.material));
+
+		for (uint32_t j = 0; j < submesh.indexCount; j += 3)
+		{
+			const uint32_t* tri = &mesh.indices[submesh.indexOffset + j];
+
+			// obj indices are 1-based; vertex, texture and normal indices are the same
+			uint32_t a = tri[0] + submesh.vertexOffset + 1;
+			uint32_t b = tri[1] + submesh.vertexOffset + 1;
+			uint32_t c = tri[2] + submesh.vertexOffset + 1;
+
+			fprintf(obj, "f %u/%u/%u %u/%u/%u %u/%u/%u\n", a, a, a, b, b, b, c, c, c);
+		}
+	}
+
+	bool ok = ferror(obj) == 0;
+
+	return fclose(obj) == 0 && ok;
+}
+
+static size_t getFileSize(const char* path)
+{
+	MappedFile file;
+	if (!mapFile(file, path))
+		return 0;
+
+	size_t size = file.size;
+	unmapFile(file);
+
+	return size;
+}
+
+static const unsigned int kObjAttributeConfigs[] = {
+	ObjAttributePositions,
+	ObjAttributePositions | ObjAttributeTexcoords,
+	ObjAttributePositions | ObjAttributeNormals,
+	ObjAttributeAll,
+};
+
+static const char* kObjAttributeConfigNames[] = { "v", "v+vt", "v+vn", "v+vt+vn" };
+
+static const size_t kObjAttributeConfigCount = sizeof(kObjAttributeConfigs) / sizeof(kObjAttributeConfigs[0]);
+
+// Checks that a parse with the given attributes has the positions, face elements and ranges of the generic parse
+static bool parseObjAttributes(const ObjFile& generic, const char* path, unsigned int attributes)
+{
+	ObjFile file;
+	if (!objParseFile(file, path, attributes))
+		return false;
+
+	if (file.v_size != generic.v_size || file.f_size / file.f_stride != generic.f_size / generic.f_stride || file.r_size != generic.r_size)
+		return false;
+
+	size_t stride = file.f_stride / 3;
+
+	for (size_t i = 0; i < generic.f_size / 3; i++)
+	{
+		const int* element = &file.f[i * stride];
+		const int* expected = &generic.f[i * 3];
+
+		if (element[0] != expected[0])
+			return false;
+
+		if ((attributes & ObjAttributeTexcoords) && element[1] != expected[1])
+			return false;
+
+		if ((attributes & ObjAttributeNormals) && element[stride - 1] != expected[2])
+			return false;
+	}
+
+	return true;
+}
+
+void benchmarkObj(const char* const* objPaths, size_t objCount)
+{
+	double parseTime = 0, loadTime = 0;
+	double attributeTime[kObjAttributeConfigCount] = {};
+	size_t totalSize = 0, validCount = 0;
+	size_t attributeMismatches[kObjAttributeConfigCount] = {};
+
+	size_t vertexCount = 0, faceCount = 0, rangeCount = 0, materialCount = 0, submeshCount = 0;
+
+	for (size_t i = 0; i < objCount; i++)
+	{
+		double parseBest = 0, loadBest = 0;
+		bool valid = false;
+
+		for (int iteration = 0; iteration < 5; iteration++)
+		{
+			double start = getTimeMs();
+
+			ObjFile file;
+			bool ok = objParseFile(file, objPaths[i]);
+			valid = ok && objValidate(file);
+
+			double end = getTimeMs();
+
+			parseBest = (iteration == 0 || end - start < parseBest) ? end - start : parseBest;
+
+			if (iteration == 0)
+			{
+				vertexCount += file.v_size / 3;
+				faceCount += file.f_size / 9;
+				rangeCount += file.r_size;
+				materialCount += file.m_size;
+			}
+		}
+
+		ObjFile generic;
+		objParseFile(generic, objPaths[i]);
+
+		for (size_t config = 0; config < kObjAttributeConfigCount; config++)
+		{
+			double best = 0;
+
+			for (int iteration = 0; iteration < 5; iteration++)
+			{
+				double start = getTimeMs();
+
+				ObjFile file;
+				objParseFile(file, objPaths[i], kObjAttributeConfigs[config]);
+				objValidate(file);
+
+				double end = getTimeMs();
+
+				best = (iteration == 0 || end - start < best) ? end - start : best;
+			}
+
+			attributeTime[config] += best;
+			attributeMismatches[config] += !parseObjAttributes(generic, objPaths[i], kObjAttributeConfigs[config]);
+		}
+
+		// inputs that fail validation (e.g. from a fuzzing corpus) are still parsed, but there is nothing to load
+		for (int iteration = 0; valid && iteration < 5; iteration++)
+		{
+			double start = getTimeMs();
+
+			Mesh mesh;
+			bool ok = loadObj(mesh, objPaths[i]);
+
+			double end = getTimeMs();
+
+			assert(ok);
+			(void)ok;
+
+			loadBest = (iteration == 0 || end - start < loadBest) ? end - start : loadBest;
+
+			if (iteration == 0)
+				submeshCount += mesh.submeshes.size();
+		}
+
+		parseTime += parseBest;
+		loadTime += loadBest;
+		totalSize += getFileSize(objPaths[i]);
+		validCount += valid;
+	}
+
+	printf("%d files (%d valid), %.2f MB\n", int(objCount), int(validCount), double(totalSize) / 1e6);
+	printf("%d positions, %d triangles, %d ranges, %d materials\n", int(vertexCount), int(faceCount), int(rangeCount), int(materialCount));
+	printf("Parse: %.2f ms, %.2f MB/s\n", parseTime, double(totalSize) / 1e6 / (parseTime / 1000));
+
+	for (size_t config = 0; config < kObjAttributeConfigCount; config++)
+		printf("Parse %s: %.2f ms, %.2f MB/s, %.2fx%s\n", kObjAttributeConfigNames[config], attributeTime[config],
+			double(totalSize) / 1e6 / (attributeTime[config] / 1000), parseTime / attributeTime[config], attributeMismatches[config] ? " MISMATCH" : "");
+
+	printf("Load: %.2f ms, %d submeshes\n", loadTime, int(submeshCount));
+}
+
+void benchmarkMesh(const char* objPath, int quantizeBits)
+{
+	std::string meshPath = std::string(objPath) + ".mesh";
+
+	double objStart = getTimeMs();
+
+	Mesh objMesh;
+	if (!loadObj(objMesh, objPath))
+	{
+		printf("Failed to load %s\n", objPath);
+		return;
+	}
+
+	double objEnd = getTimeMs();
+
+	if (!convertMesh(objPath, meshPath.c_str(), quantizeBits))
+	{
+		printf("Failed to write %s\n", meshPath.c_str());
+		return;
+	}
+
+	double convertEnd = getTimeMs();
+
+	size_t objSize = getFileSize(objPath);
+	size_t meshSize = getFileSize(meshPath.c_str());
+	size_t rawSize = objMesh.vertices.size() * sizeof(Vertex) + objMesh.indices.size() * sizeof(uint32_t);
+
+	printf("%d vertices, %d indices, quantization %d bits\n", int(objMesh.vertices.size()), int(objMesh.indices.size()), quantizeBits);
+	printf("Size: obj %.2f MB, raw %.2f MB, mesh %.2f MB (%.1f%% of raw)\n",
+		double(objSize) / 1e6, double(rawSize) / 1e6, double(meshSize) / 1e6, rawSize ? double(meshSize) / double(rawSize) * 100 : 0.0);
+	printf("Convert: %.2f ms\n", convertEnd - objEnd);
+
+	MeshFile file;
+	if (!openMeshFile(file, meshPath.c_str()))
+	{
+		printf("Failed to open %s\n", meshPath.c_str());
+		return;
+	}
+
+	std::vector<Vertex> vertices(file.header->vertexCount);
+	std::vector<uint32_t> indices(file.header->indexCount);
+
+	uint32_t threadCounts[] = { 1, getThreadCount() };
+
+	for (size_t run = 0; run < (threadCounts[1] > 1 ? 2 : 1); run++)
+	{
+		double best = 0;
+
+		// the first iteration also faults in the file mapping and the destination pages; report the best of several
+		for (int iteration = 0; iteration < 5; iteration++)
+		{
+			double start = getTimeMs();
+			bool ok = decodeMeshFile(file, vertices.data(), indices.data(), sizeof(uint32_t), threadCounts[run]);
+			double end = getTimeMs();
+
+			assert(ok);
+			(void)ok;
+
+			best = (iteration == 0 || end - start < best) ? end - start : best;
+		}
+
+		printf("Decode: %2d threads %8.2f ms, %6.2f GB/s\n", threadCounts[run], best, double(rawSize) / 1e9 / (best / 1000));
+	}
+
+	closeMeshFile(file);
+
+	double meshStart = getTimeMs();
+
+	Mesh mesh;
+	bool ok = loadMesh(mesh, meshPath.c_str());
+
+	double meshEnd = getTimeMs();
+
+	printf("Load: obj %.2f ms, mesh %.2f ms (%.1fx)%s\n", objEnd - objStart, meshEnd - meshStart, (objEnd - objStart) / (meshEnd - meshStart), ok ? "" : " FAILED");
+
+	remove(meshPath.c_str());
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+struct Vertex {
+	float vx, vy, vz;
+	float nx, ny, nz;
+	float tu, tv;
+};
+
+struct Material
+{
+	float diffuse[4]; // rgb and opacity
+
+	std::string diffuseTexture; // relative to the mesh file, empty if none
+};
+
+// Index range drawn with a single material; submeshes are sorted by material
+struct Submesh
+{
+	uint32_t indexOffset, indexCount;
+	uint32_t vertexOffset; // added to the submesh indices when drawing
+	uint32_t material;
+
+	// bounding sphere; radius is FLT_MAX if the bounds are unknown
+	float center[3];
+	float radius;
+};
+
+struct Mesh
+{
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+
+	std::vector<Submesh> submeshes;
+	std::vector<Material> materials;
+
+	uint32_t indexSize; // bytes per index on the GPU; if 2, every index fits in 16 bits
+	bool hasNormals;
+};
+
+// Loads .obj files, or .mesh files produced by convertMesh
+bool loadMesh(Mesh& result, const char* path);
+
+bool isMeshFile(const char* path);
+
+// Switches to 16-bit indices if possible: submeshes are split into batches that reference fewer than 65536 consecutive
+// vertices and their indices are rebased to the first one. Leaves the mesh unchanged if a triangle spans too many vertices
+bool selectIndexSize(Mesh& mesh);
+
+// Replaces submeshes and materials with a single unbounded submesh of indexCount indices using a default material
+void setSingleSubmesh(Mesh& mesh, uint32_t indexCount);
+
+// Converts an .obj file to the binary .mesh container; quantizeBits is the number of float mantissa bits kept, 0 for lossless
+bool convertMesh(const char* objPath, const char* meshPath, int quantizeBits);
+
+// Writes the mesh as .obj with one object per submesh, and its materials as .mtl; the .mtl must be next to the .obj
+bool writeObjFile(const Mesh& mesh, const char* objPath, const char* mtlPath);
+
+// Measures .obj parsing throughput and the cost of building submeshes on top of it, summed over all files; any set of
+// files works, e.g. a fuzzing corpus, so that robustness changes to the parser are measured against the same inputs.
+// Parses restricted to each attribute subset are compared with the generic parse, for speed and for matching faces
+void benchmarkObj(const char* const* objPaths, size_t objCount);
+
+// Compares file size and load time of the .obj with its .mesh conversion, and measures .mesh decode throughput
+void benchmarkMesh(const char* objPath, int quantizeBits);
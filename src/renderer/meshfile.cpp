@@ -0,0 +1,268 @@
+#ifndef _CRT_SECURE_NO_WARNINGS
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include "meshfile.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <meshoptimizer.h>
+
+// 2 MB of 32-byte vertices; small enough to spread a mesh over several threads, large enough to amortize codec setup
+const uint32_t kChunkVertices = 65536;
+const uint32_t kChunkIndices = 65536 * 3;
+
+static float quantizeFloat(float v, int bits)
+{
+	uint32_t ui;
+	memcpy(&ui, &v, sizeof(ui));
+
+	uint32_t mask = (1u << (23 - bits)) - 1;
+	uint32_t round = (1u << (23 - bits)) >> 1;
+
+	uint32_t e = ui & 0x7f800000;
+	uint32_t rui = (ui + round) & ~mask;
+
+	// inf/nan keep their bits so that nan can't round into -0; denormals are flushed to zero
+	ui = e == 0x7f800000 ? ui : rui;
+	ui = e == 0 ? 0 : ui;
+
+	memcpy(&v, &ui, sizeof(ui));
+	return v;
+}
+
+bool writeMeshFile(const char* path, const void* vertices, size_t vertexCount, size_t vertexSize, const uint32_t* indices, size_t indexCount, uint32_t flags, int quantizeBits)
+{
+	assert(vertexSize % 4 == 0 && vertexSize <= 256);
+	assert(indexCount % 3 == 0);
+	assert(quantizeBits >= 0 && quantizeBits < 23);
+
+	std::vector<float> quantized;
+
+	if (quantizeBits > 0)
+	{
+		quantized.resize(vertexCount * vertexSize / 4);
+		memcpy(quantized.data(), vertices, quantized.size() * 4);
+
+		for (size_t i = 0; i < quantized.size(); i++)
+			quantized[i] = quantizeFloat(quantized[i], quantizeBits);
+
+		vertices = quantized.data();
+		flags |= MeshFileQuantized;
+	}
+
+	MeshFileHeader header = {};
+	header.magic = kMeshFileMagic;
+	header.version = kMeshFileVersion;
+	header.flags = flags;
+	header.vertexCount = uint32_t(vertexCount);
+	header.vertexSize = uint32_t(vertexSize);
+	header.indexCount = uint32_t(indexCount);
+	header.chunkVertices = kChunkVertices;
+	header.chunkIndices = kChunkIndices;
+	header.vertexChunkCount = uint32_t((vertexCount + kChunkVertices - 1) / kChunkVertices);
+	header.indexChunkCount = uint32_t((indexCount + kChunkIndices - 1) / kChunkIndices);
+
+	uint32_t chunkCount = header.vertexChunkCount + header.indexChunkCount;
+
+	std::vector<MeshFileChunk> chunks(chunkCount);
+	std::vector<std::vector<unsigned char> > data(chunkCount);
+
+	uint64_t offset = sizeof(MeshFileHeader) + chunkCount * sizeof(MeshFileChunk);
+
+	for (uint32_t i = 0; i < chunkCount; i++)
+	{
+		std::vector<unsigned char>& buffer = data[i];
+
+		if (i < header.vertexChunkCount)
+		{
+			size_t first = size_t(i) * kChunkVertices;
+			size_t count = vertexCount - first < kChunkVertices ? vertexCount - first : kChunkVertices;
+
+			buffer.resize(meshopt_encodeVertexBufferBound(count, vertexSize));
+			buffer.resize(meshopt_encodeVertexBuffer(buffer.data(), buffer.size(), static_cast<const char*>(vertices) + first * vertexSize, count, vertexSize));
+		}
+		else
+		{
+			size_t first = size_t(i - header.vertexChunkCount) * kChunkIndices;
+			size_t count = indexCount - first < kChunkIndices ? indexCount - first : kChunkIndices;
+
+			buffer.resize(meshopt_encodeIndexBufferBound(count, vertexCount));
+			buffer.resize(meshopt_encodeIndexBuffer(buffer.data(), buffer.size(), indices + first, count));
+		}
+
+		if (buffer.empty())
+			return false;
+
+		chunks[i].offset = offset;
+		chunks[i].size = buffer.size();
+
+		offset += buffer.size();
+	}
+
+	FILE* file = fopen(path, "wb");
+	if (!file)
+		return false;
+
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+	ok = ok && (chunkCount == 0 || fwrite(chunks.data(), sizeof(MeshFileChunk), chunkCount, file) == chunkCount);
+
+	for (uint32_t i = 0; i < chunkCount && ok; i++)
+		ok = fwrite(data[i].data(), 1, data[i].size(), file) == data[i].size();
+
+	ok = (fclose(file) == 0) && ok;
+
+	if (!ok)
+		remove(path);
+
+	return ok;
+}
+
+static bool validateChunks(const MeshFileChunk* chunks, uint32_t count, uint64_t begin, uint64_t end)
+{
+	for (uint32_t i = 0; i < count; i++)
+	{
+		if (chunks[i].offset < begin || chunks[i].offset > end || chunks[i].size > end - chunks[i].offset)
+			return false;
+	}
+
+	return true;
+}
+
+bool openMeshFile(MeshFile& result, const char* path)
+{
+	result = MeshFile();
+
+	if (!mapFile(result.file, path))
+		return false;
+
+	const MeshFileHeader* header = static_cast<const MeshFileHeader*>(result.file.data);
+
+	bool valid = result.file.size >= sizeof(MeshFileHeader) &&
+		header->magic == kMeshFileMagic &&
+		header->version == kMeshFileVersion &&
+		header->vertexSize > 0 && header->vertexSize <= 256 && header->vertexSize % 4 == 0 &&
+		header->indexCount % 3 == 0 &&
+		header->chunkVertices > 0 && header->chunkIndices > 0 && header->chunkIndices % 3 == 0 &&
+		header->vertexChunkCount == (uint64_t(header->vertexCount) + header->chunkVertices - 1) / header->chunkVertices &&
+		header->indexChunkCount == (uint64_t(header->indexCount) + header->chunkIndices - 1) / header->chunkIndices;
+
+	uint64_t tableEnd = sizeof(MeshFileHeader) + (uint64_t(valid ? header->vertexChunkCount : 0) + (valid ? header->indexChunkCount : 0)) * sizeof(MeshFileChunk);
+
+	valid = valid && tableEnd <= result.file.size;
+
+	if (!valid)
+	{
+		unmapFile(result.file);
+		return false;
+	}
+
+	result.header = header;
+	result.vertexChunks = reinterpret_cast<const MeshFileChunk*>(header + 1);
+	result.indexChunks = result.vertexChunks + header->vertexChunkCount;
+
+	if (!validateChunks(result.vertexChunks, header->vertexChunkCount, tableEnd, result.file.size) ||
+		!validateChunks(result.indexChunks, header->indexChunkCount, tableEnd, result.file.size))
+	{
+		closeMeshFile(result);
+		return false;
+	}
+
+	return true;
+}
+
+void closeMeshFile(MeshFile& file)
+{
+	unmapFile(file.file);
+
+	file.header = 0;
+	file.vertexChunks = 0;
+	file.indexChunks = 0;
+}
+
+template <typename T>
+static bool validateIndices(const T* indices, size_t count, uint32_t vertexCount)
+{
+	for (size_t i = 0; i < count; i++)
+		if (indices[i] >= vertexCount)
+			return false;
+
+	return true;
+}
+
+static bool decodeChunk(const MeshFile& file, uint32_t chunk, void* vertices, void* indices, size_t indexSize)
+{
+	const MeshFileHeader& header = *file.header;
+	const unsigned char* data = static_cast<const unsigned char*>(file.file.data);
+
+	if (chunk < header.vertexChunkCount)
+	{
+		const MeshFileChunk& entry = file.vertexChunks[chunk];
+
+		size_t first = size_t(chunk) * header.chunkVertices;
+		size_t count = header.vertexCount - first < header.chunkVertices ? header.vertexCount - first : header.chunkVertices;
+
+		return meshopt_decodeVertexBuffer(static_cast<char*>(vertices) + first * header.vertexSize, count, header.vertexSize, data + entry.offset, size_t(entry.size)) == 0;
+	}
+	else
+	{
+		const MeshFileChunk& entry = file.indexChunks[chunk - header.vertexChunkCount];
+
+		size_t first = size_t(chunk - header.vertexChunkCount) * header.chunkIndices;
+		size_t count = header.indexCount - first < header.chunkIndices ? header.indexCount - first : header.chunkIndices;
+
+		void* destination = static_cast<char*>(indices) + first * indexSize;
+
+		if (meshopt_decodeIndexBuffer(destination, count, indexSize, data + entry.offset, size_t(entry.size)) != 0)
+			return false;
+
+		// the index codec accepts any values, so a corrupted file could otherwise produce out of range indices
+		return indexSize == 2
+			? validateIndices(static_cast<const uint16_t*>(destination), count, header.vertexCount)
+			: validateIndices(static_cast<const uint32_t*>(destination), count, header.vertexCount);
+	}
+}
+
+static void decodeWorker(const MeshFile* file, void* vertices, void* indices, size_t indexSize, std::atomic<uint32_t>* next, std::atomic<bool>* failed)
+{
+	uint32_t chunkCount = file->header->vertexChunkCount + file->header->indexChunkCount;
+
+	for (;;)
+	{
+		uint32_t chunk = next->fetch_add(1);
+
+		if (chunk >= chunkCount)
+			break;
+
+		if (!decodeChunk(*file, chunk, vertices, indices, indexSize))
+			failed->store(true);
+	}
+}
+
+bool decodeMeshFile(const MeshFile& file, void* vertices, void* indices, size_t indexSize, uint32_t threadCount)
+{
+	assert(indexSize == 4 || (indexSize == 2 && file.header->vertexCount <= 65536));
+
+	std::atomic<uint32_t> next(0);
+	std::atomic<bool> failed(false);
+
+	uint32_t chunkCount = file.header->vertexChunkCount + file.header->indexChunkCount;
+
+	// the calling thread decodes as well
+	std::vector<std::thread> workers;
+	for (uint32_t i = 1; i < threadCount && i < chunkCount; i++)
+		workers.push_back(std::thread(decodeWorker, &file, vertices, indices, indexSize, &next, &failed));
+
+	decodeWorker(&file, vertices, indices, indexSize, &next, &failed);
+
+	for (size_t i = 0; i < workers.size(); i++)
+		workers[i].join();
+
+	return !failed.load();
+}
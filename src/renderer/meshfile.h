@@ -0,0 +1,60 @@
+#pragma once
+
+#include "files.h"
+
+// Binary mesh container: vertex and index streams are split into chunks that are encoded independently with the
+// meshoptimizer vertex/index codecs, so that chunks can be decoded in parallel straight into their final location.
+//
+// Layout: MeshFileHeader, vertexChunkCount + indexChunkCount MeshFileChunk entries, encoded chunk data
+const uint32_t kMeshFileMagic = 0x4853454d; // 'MESH'
+const uint32_t kMeshFileVersion = 1;
+
+enum MeshFileFlags
+{
+	MeshFileHasNormals = 1 << 0,
+	MeshFileQuantized = 1 << 1, // float mantissas were rounded before encoding; decoded data is still float
+};
+
+struct MeshFileHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t flags;
+
+	uint32_t vertexCount;
+	uint32_t vertexSize;
+	uint32_t indexCount;
+
+	uint32_t chunkVertices; // vertices per vertex chunk, the last one may be smaller
+	uint32_t chunkIndices; // indices per index chunk, a multiple of 3
+
+	uint32_t vertexChunkCount;
+	uint32_t indexChunkCount;
+};
+
+struct MeshFileChunk
+{
+	uint64_t offset; // from the start of the file
+	uint64_t size;
+};
+
+struct MeshFile
+{
+	MappedFile file;
+
+	const MeshFileHeader* header;
+	const MeshFileChunk* vertexChunks;
+	const MeshFileChunk* indexChunks;
+};
+
+// vertexSize has to be a multiple of 4; quantizeBits > 0 rounds every vertex float to that many mantissa bits, which makes
+// the vertex codec much more effective at the cost of precision (10-12 bits is plenty for positions of most assets)
+bool writeMeshFile(const char* path, const void* vertices, size_t vertexCount, size_t vertexSize, const uint32_t* indices, size_t indexCount, uint32_t flags, int quantizeBits);
+
+// Validates the header and chunk table against the file size; chunk contents are validated while decoding
+bool openMeshFile(MeshFile& result, const char* path);
+void closeMeshFile(MeshFile& file);
+
+// Decodes into caller provided memory (vertexCount * vertexSize and indexCount * indexSize bytes), e.g. a mapped staging
+// buffer; indexSize is 4, or 2 if vertexCount is at most 65536
+bool decodeMeshFile(const MeshFile& file, void* vertices, void* indices, size_t indexSize, uint32_t threadCount);
@@ -0,0 +1,456 @@
+#include "normals.h"
+#include "parallel.h"
+#include "scenegen.h"
+#include "vertexremap.h"
+#include "timer.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+
+#include <algorithm>
+
+#include <meshoptimizer.h>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define NORMALS_SSE
+#include <xmmintrin.h>
+#endif
+
+// below this, threads cost more than they save
+const size_t kMinTrianglesPerThread = 16384;
+
+static uint32_t getTriangleThreads(size_t triangleCount, uint32_t threadCount)
+{
+	return uint32_t(std::min(std::max(triangleCount / kMinTrianglesPerThread, size_t(1)), size_t(std::max(threadCount, 1u))));
+}
+
+// cross(b - a, c - a)
+static void computeCross(float result[3], const Vertex& a, const Vertex& b, const Vertex& c)
+{
+#ifdef NORMALS_SSE
+	// loads cover position and nx; the fourth lane cancels out and is never stored
+	__m128 pa = _mm_loadu_ps(&a.vx);
+	__m128 e1 = _mm_sub_ps(_mm_loadu_ps(&b.vx), pa);
+	__m128 e2 = _mm_sub_ps(_mm_loadu_ps(&c.vx), pa);
+
+	__m128 e1yzx = _mm_shuffle_ps(e1, e1, _MM_SHUFFLE(3, 0, 2, 1));
+	__m128 e2yzx = _mm_shuffle_ps(e2, e2, _MM_SHUFFLE(3, 0, 2, 1));
+
+	__m128 rzxy = _mm_sub_ps(_mm_mul_ps(e1, e2yzx), _mm_mul_ps(e1yzx, e2));
+	__m128 r = _mm_shuffle_ps(rzxy, rzxy, _MM_SHUFFLE(3, 0, 2, 1));
+
+	float lanes[4];
+	_mm_storeu_ps(lanes, r);
+
+	result[0] = lanes[0];
+	result[1] = lanes[1];
+	result[2] = lanes[2];
+#else
+	float e1[3] = { b.vx - a.vx, b.vy - a.vy, b.vz - a.vz };
+	float e2[3] = { c.vx - a.vx, c.vy - a.vy, c.vz - a.vz };
+
+	result[0] = e1[1] * e2[2] - e1[2] * e2[1];
+	result[1] = e1[2] * e2[0] - e1[0] * e2[2];
+	result[2] = e1[0] * e2[1] - e1[1] * e2[0];
+#endif
+}
+
+static float normalize(float v[3])
+{
+	float length = sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+
+	if (length > 0)
+	{
+		v[0] /= length;
+		v[1] /= length;
+		v[2] /= length;
+	}
+
+	return length;
+}
+
+static float getCornerAngle(const Vertex& a, const Vertex& b, const Vertex& c)
+{
+	float e1[3] = { b.vx - a.vx, b.vy - a.vy, b.vz - a.vz };
+	float e2[3] = { c.vx - a.vx, c.vy - a.vy, c.vz - a.vz };
+
+	if (normalize(e1) == 0 || normalize(e2) == 0)
+		return 0;
+
+	float d = e1[0] * e2[0] + e1[1] * e2[1] + e1[2] * e2[2];
+
+	return acosf(std::min(std::max(d, -1.f), 1.f));
+}
+
+// Sums per-corner contributions of every triangle into per-element totals (Stride floats each) without atomics:
+// triangles are split into chunks of kMinTrianglesPerThread, every chunk accumulates into a private buffer that covers
+// the element range its triangles reference, and the buffers are added up in chunk order afterwards. Chunks don't
+// depend on the thread count, so neither does the rounding of the sums. Triangles of loaded meshes reference mostly
+// ascending elements, so the ranges barely overlap; meshes where they don't are accumulated in one chunk instead of
+// multiplying memory
+template <size_t Stride, typename Contribution>
+static void accumulateTriangles(std::vector<float>& result, const uint32_t* elements, size_t elementCount, size_t triangleCount, uint32_t maxThreads, Contribution contribution)
+{
+	uint32_t chunkCount = uint32_t(std::max(triangleCount / kMinTrianglesPerThread, size_t(1)));
+	uint32_t threadCount = getTriangleThreads(triangleCount, maxThreads);
+
+	std::vector<uint32_t> windows(chunkCount * 2);
+
+	parallelFor(threadCount, [&](uint32_t thread) {
+		for (uint32_t chunk = uint32_t(getRangeBegin(chunkCount, thread, threadCount)); chunk < getRangeBegin(chunkCount, thread + 1, threadCount); chunk++)
+		{
+			uint32_t minElement = ~0u, maxElement = 0;
+
+			for (size_t i = getRangeBegin(triangleCount, chunk, chunkCount) * 3; i < getRangeBegin(triangleCount, chunk + 1, chunkCount) * 3; i++)
+			{
+				minElement = std::min(minElement, elements[i]);
+				maxElement = std::max(maxElement, elements[i]);
+			}
+
+			windows[chunk * 2 + 0] = minElement;
+			windows[chunk * 2 + 1] = minElement <= maxElement ? maxElement + 1 : minElement;
+		}
+	});
+
+	size_t windowTotal = 0;
+	for (uint32_t i = 0; i < chunkCount; i++)
+		windowTotal += windows[i * 2 + 1] - std::min(windows[i * 2 + 0], windows[i * 2 + 1]);
+
+	if (windowTotal > elementCount * 2)
+	{
+		chunkCount = 1;
+		threadCount = 1;
+		windows[0] = 0;
+		windows[1] = uint32_t(elementCount);
+	}
+
+	std::vector<std::vector<float> > buffers(chunkCount);
+
+	parallelFor(threadCount, [&](uint32_t thread) {
+		for (uint32_t chunk = uint32_t(getRangeBegin(chunkCount, thread, threadCount)); chunk < getRangeBegin(chunkCount, thread + 1, threadCount); chunk++)
+		{
+			uint32_t base = windows[chunk * 2 + 0];
+
+			std::vector<float>& buffer = buffers[chunk];
+			buffer.resize(size_t(windows[chunk * 2 + 1] - std::min(base, windows[chunk * 2 + 1])) * Stride);
+
+			for (size_t i = getRangeBegin(triangleCount, chunk, chunkCount); i < getRangeBegin(triangleCount, chunk + 1, chunkCount); i++)
+			{
+				float corners[3][Stride];
+				if (!contribution(i, corners))
+					continue;
+
+				for (int k = 0; k < 3; k++)
+				{
+					float* sum = &buffer[size_t(elements[i * 3 + k] - base) * Stride];
+
+					for (size_t s = 0; s < Stride; s++)
+						sum[s] += corners[k][s];
+				}
+			}
+		}
+	});
+
+	result.assign(elementCount * Stride, 0.f);
+
+	uint32_t reduceThreads = getTriangleThreads(elementCount, maxThreads);
+
+	parallelFor(reduceThreads, [&](uint32_t thread) {
+		size_t begin = getRangeBegin(elementCount, thread, reduceThreads);
+		size_t end = getRangeBegin(elementCount, thread + 1, reduceThreads);
+
+		for (uint32_t i = 0; i < chunkCount; i++)
+		{
+			size_t first = std::max(begin, size_t(windows[i * 2 + 0]));
+			size_t last = std::min(end, size_t(windows[i * 2 + 1]));
+
+			for (size_t e = first; e < last; e++)
+				for (size_t s = 0; s < Stride; s++)
+					result[e * Stride + s] += buffers[i][(e - windows[i * 2 + 0]) * Stride + s];
+		}
+	});
+}
+
+void generateNormals(Mesh& mesh, const NormalSettings& settings, uint32_t threadCount)
+{
+	for (size_t i = 0; i < mesh.submeshes.size(); i++)
+		assert(mesh.submeshes[i].vertexOffset == 0);
+
+	size_t vertexCount = mesh.vertices.size();
+	size_t triangleCount = mesh.indices.size() / 3;
+
+	if (triangleCount == 0)
+		return;
+
+	// texture seams duplicate vertices; normals are shared by position so that seams don't show in the lighting
+	std::vector<float> positions(vertexCount * 3);
+
+	for (size_t i = 0; i < vertexCount; i++)
+	{
+		positions[i * 3 + 0] = mesh.vertices[i].vx;
+		positions[i * 3 + 1] = mesh.vertices[i].vy;
+		positions[i * 3 + 2] = mesh.vertices[i].vz;
+	}
+
+	std::vector<uint32_t> positionRemap(vertexCount);
+	size_t positionCount = generateVertexRemap(positionRemap.data(), positions.data(), vertexCount, sizeof(float) * 3, threadCount);
+
+	std::vector<uint32_t> corners(triangleCount * 3);
+
+	for (size_t i = 0; i < triangleCount * 3; i++)
+		corners[i] = positionRemap[mesh.indices[i]];
+
+	// unit face normals and the weight of every corner
+	std::vector<float> faceNormals(triangleCount * 3);
+	std::vector<float> cornerWeights(triangleCount * 3);
+
+	uint32_t triangleThreads = getTriangleThreads(triangleCount, threadCount);
+
+	parallelFor(triangleThreads, [&](uint32_t thread) {
+		for (size_t i = getRangeBegin(triangleCount, thread, triangleThreads); i < getRangeBegin(triangleCount, thread + 1, triangleThreads); i++)
+		{
+			const Vertex& a = mesh.vertices[mesh.indices[i * 3 + 0]];
+			const Vertex& b = mesh.vertices[mesh.indices[i * 3 + 1]];
+			const Vertex& c = mesh.vertices[mesh.indices[i * 3 + 2]];
+
+			float* normal = &faceNormals[i * 3];
+			computeCross(normal, a, b, c);
+
+			float area = normalize(normal);
+
+			if (settings.weighting == NormalWeightAngle)
+			{
+				cornerWeights[i * 3 + 0] = area > 0 ? getCornerAngle(a, b, c) : 0.f;
+				cornerWeights[i * 3 + 1] = area > 0 ? getCornerAngle(b, c, a) : 0.f;
+				cornerWeights[i * 3 + 2] = area > 0 ? getCornerAngle(c, a, b) : 0.f;
+			}
+			else
+				cornerWeights[i * 3 + 0] = cornerWeights[i * 3 + 1] = cornerWeights[i * 3 + 2] = area;
+		}
+	});
+
+	if (settings.smoothingAngle >= 180)
+	{
+		// every corner at a position contributes to the same normal, so vertices keep their identity
+		std::vector<float> normals;
+
+		accumulateTriangles<3>(normals, corners.data(), positionCount, triangleCount, threadCount, [&](size_t i, float (&result)[3][3]) {
+			for (int k = 0; k < 3; k++)
+				for (int s = 0; s < 3; s++)
+					result[k][s] = faceNormals[i * 3 + s] * cornerWeights[i * 3 + k];
+
+			return true;
+		});
+
+		for (size_t i = 0; i < vertexCount; i++)
+		{
+			float* normal = &normals[positionRemap[i] * 3];
+			Vertex& v = mesh.vertices[i];
+
+			// vertices that no triangle references keep a placeholder
+			bool valid = normalize(normal) > 0;
+
+			v.nx = valid ? normal[0] : 0.f;
+			v.ny = valid ? normal[1] : 0.f;
+			v.nz = valid ? normal[2] : 1.f;
+		}
+
+		mesh.hasNormals = true;
+		return;
+	}
+
+	// corners sharing a position, grouped by position
+	std::vector<uint32_t> adjacencyOffsets(positionCount + 1);
+	std::vector<uint32_t> adjacency(triangleCount * 3);
+
+	for (size_t i = 0; i < triangleCount * 3; i++)
+		adjacencyOffsets[corners[i] + 1]++;
+
+	for (size_t i = 0; i < positionCount; i++)
+		adjacencyOffsets[i + 1] += adjacencyOffsets[i];
+
+	{
+		std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+
+		for (size_t i = 0; i < triangleCount * 3; i++)
+			adjacency[fill[corners[i]]++] = uint32_t(i);
+	}
+
+	float threshold = cosf(settings.smoothingAngle * (3.14159265f / 180.f));
+
+	// every corner averages the faces around its position that are within the smoothing angle of its own face; the
+	// result is written out unindexed and welded again since a vertex can end up with several normals
+	std::vector<Vertex> unindexed(triangleCount * 3);
+
+	parallelFor(triangleThreads, [&](uint32_t thread) {
+		for (size_t i = getRangeBegin(triangleCount, thread, triangleThreads) * 3; i < getRangeBegin(triangleCount, thread + 1, triangleThreads) * 3; i++)
+		{
+			const float* face = &faceNormals[(i / 3) * 3];
+			float normal[3] = {};
+
+			for (uint32_t j = adjacencyOffsets[corners[i]]; j < adjacencyOffsets[corners[i] + 1]; j++)
+			{
+				uint32_t corner = adjacency[j];
+				const float* other = &faceNormals[(corner / 3) * 3];
+
+				if (face[0] * other[0] + face[1] * other[1] + face[2] * other[2] < threshold)
+					continue;
+
+				normal[0] += other[0] * cornerWeights[corner];
+				normal[1] += other[1] * cornerWeights[corner];
+				normal[2] += other[2] * cornerWeights[corner];
+			}
+
+			bool valid = normalize(normal) > 0;
+
+			Vertex& v = unindexed[i];
+			v = mesh.vertices[mesh.indices[i]];
+			v.nx = valid ? normal[0] : 0.f;
+			v.ny = valid ? normal[1] : 0.f;
+			v.nz = valid ? normal[2] : 1.f;
+		}
+	});
+
+	std::vector<uint32_t> remap(triangleCount * 3);
+	size_t weldedCount = generateVertexRemap(remap.data(), unindexed.data(), triangleCount * 3, sizeof(Vertex), threadCount);
+
+	mesh.vertices.resize(weldedCount);
+
+	meshopt_remapVertexBuffer(mesh.vertices.data(), unindexed.data(), triangleCount * 3, sizeof(Vertex), remap.data());
+	meshopt_remapIndexBuffer(mesh.indices.data(), 0, triangleCount * 3, remap.data());
+
+	mesh.hasNormals = true;
+}
+
+void generateTangents(std::vector<Tangent>& result, const Mesh& mesh, uint32_t threadCount)
+{
+	for (size_t i = 0; i < mesh.submeshes.size(); i++)
+		assert(mesh.submeshes[i].vertexOffset == 0);
+
+	size_t vertexCount = mesh.vertices.size();
+	size_t triangleCount = mesh.indices.size() / 3;
+
+	// texture space directions of u and v, summed over the faces around every vertex
+	std::vector<float> directions;
+
+	accumulateTriangles<6>(directions, mesh.indices.data(), vertexCount, triangleCount, threadCount, [&](size_t i, float (&corners)[3][6]) {
+		const Vertex& a = mesh.vertices[mesh.indices[i * 3 + 0]];
+		const Vertex& b = mesh.vertices[mesh.indices[i * 3 + 1]];
+		const Vertex& c = mesh.vertices[mesh.indices[i * 3 + 2]];
+
+		float e1[3] = { b.vx - a.vx, b.vy - a.vy, b.vz - a.vz };
+		float e2[3] = { c.vx - a.vx, c.vy - a.vy, c.vz - a.vz };
+
+		float du1 = b.tu - a.tu, dv1 = b.tv - a.tv;
+		float du2 = c.tu - a.tu, dv2 = c.tv - a.tv;
+
+		float det = du1 * dv2 - du2 * dv1;
+
+		// faces with degenerate texture mapping have no texture space
+		if (fabsf(det) < 1e-12f)
+			return false;
+
+		float r = 1.f / det;
+
+		for (int s = 0; s < 3; s++)
+		{
+			corners[0][s] = (e1[s] * dv2 - e2[s] * dv1) * r;
+			corners[0][s + 3] = (e2[s] * du1 - e1[s] * du2) * r;
+		}
+
+		for (int s = 0; s < 6; s++)
+			corners[1][s] = corners[2][s] = corners[0][s];
+
+		return true;
+	});
+
+	result.resize(vertexCount);
+
+	uint32_t vertexThreads = getTriangleThreads(vertexCount, threadCount);
+
+	parallelFor(vertexThreads, [&](uint32_t thread) {
+		for (size_t i = getRangeBegin(vertexCount, thread, vertexThreads); i < getRangeBegin(vertexCount, thread + 1, vertexThreads); i++)
+		{
+			const Vertex& v = mesh.vertices[i];
+			const float* sdir = &directions[i * 6 + 0];
+			const float* tdir = &directions[i * 6 + 3];
+
+			float n[3] = { v.nx, v.ny, v.nz };
+
+			// Gram-Schmidt; vertices without texture space get an arbitrary tangent perpendicular to the normal
+			float d = n[0] * sdir[0] + n[1] * sdir[1] + n[2] * sdir[2];
+			float t[3] = { sdir[0] - n[0] * d, sdir[1] - n[1] * d, sdir[2] - n[2] * d };
+
+			if (normalize(t) == 0)
+			{
+				float axis[3] = { fabsf(n[0]) < 0.9f ? 1.f : 0.f, fabsf(n[0]) < 0.9f ? 0.f : 1.f, 0.f };
+				float ad = n[0] * axis[0] + n[1] * axis[1] + n[2] * axis[2];
+
+				t[0] = axis[0] - n[0] * ad;
+				t[1] = axis[1] - n[1] * ad;
+				t[2] = axis[2] - n[2] * ad;
+				normalize(t);
+			}
+
+			float bitangent[3] = { n[1] * t[2] - n[2] * t[1], n[2] * t[0] - n[0] * t[2], n[0] * t[1] - n[1] * t[0] };
+
+			Tangent& tangent = result[i];
+			tangent.tx = t[0];
+			tangent.ty = t[1];
+			tangent.tz = t[2];
+			tangent.tw = bitangent[0] * tdir[0] + bitangent[1] * tdir[1] + bitangent[2] * tdir[2] < 0 ? -1.f : 1.f;
+		}
+	});
+}
+
+void benchmarkNormals(const char* path)
+{
+	Mesh mesh;
+
+	SceneSettings sceneSettings;
+	if (isSceneSpec(path) ? !parseSceneSettings(sceneSettings, path) : !loadMesh(mesh, path))
+	{
+		printf("Failed to load %s\n", path);
+		return;
+	}
+
+	if (isSceneSpec(path))
+		generateScene(mesh, sceneSettings);
+
+	size_t triangleCount = mesh.indices.size() / 3;
+
+	printf("%d triangles, %d vertices\n", int(triangleCount), int(mesh.vertices.size()));
+
+	uint32_t threadCounts[] = { 1, getThreadCount() };
+
+	NormalSettings settings[] = {
+		{ 180.f, NormalWeightArea },
+		{ 180.f, NormalWeightAngle },
+		{ 60.f, NormalWeightAngle },
+	};
+
+	for (size_t i = 0; i < sizeof(threadCounts) / sizeof(threadCounts[0]); i++)
+	{
+		for (size_t j = 0; j < sizeof(settings) / sizeof(settings[0]); j++)
+		{
+			Mesh copy = mesh;
+
+			double start = getTimeMs();
+			generateNormals(copy, settings[j], threadCounts[i]);
+			double end = getTimeMs();
+
+			printf("Normals (%.0f degrees, %s weights, %d threads): %.2f ms, %.2f M triangles/s, %d vertices\n", settings[j].smoothingAngle,
+				settings[j].weighting == NormalWeightAngle ? "angle" : "area", threadCounts[i], end - start, double(triangleCount) / 1e3 / (end - start),
+				int(copy.vertices.size()));
+		}
+
+		std::vector<Tangent> tangents;
+
+		double start = getTimeMs();
+		generateTangents(tangents, mesh, threadCounts[i]);
+		double end = getTimeMs();
+
+		printf("Tangents (%d threads): %.2f ms, %.2f M triangles/s\n", threadCounts[i], end - start, double(triangleCount) / 1e3 / (end - start));
+	}
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "mesh.h"
+
+// Normal and tangent generation for meshes that don't come with them. Both run in parallel over triangles; indices
+// have to be absolute (every submesh vertexOffset is 0), i.e. this runs before selectIndexSize
+enum NormalWeighting
+{
+	NormalWeightArea, // large faces dominate; cheapest
+	NormalWeightAngle, // weighted by the corner angle, independent of how the surface is tessellated
+};
+
+struct NormalSettings
+{
+	float smoothingAngle; // degrees; faces meeting at a sharper angle keep separate normals, 180 smooths everything
+	uint32_t weighting;
+};
+
+struct Tangent
+{
+	float tx, ty, tz;
+	float tw; // bitangent sign: bitangent = cross(normal, tangent) * tw
+};
+
+// Vertices at the same position share a normal unless the angle between their faces exceeds the smoothing angle, in
+// which case vertices are split; texture seams don't split normals. Sets mesh.hasNormals
+void generateNormals(Mesh& mesh, const NormalSettings& settings, uint32_t threadCount);
+
+// Per-vertex tangents from texture coordinates, orthogonal to the vertex normal
+void generateTangents(std::vector<Tangent>& result, const Mesh& mesh, uint32_t threadCount);
+
+// Measures normal and tangent throughput for the mesh (.obj, .mesh or a scene spec) with one thread and with all threads
+void benchmarkNormals(const char* path);
@@ -0,0 +1,123 @@
+// Fuzz target for the OBJ/MTL parsers; not part of the renderer build.
+//
+// libFuzzer: clang++ -g -O1 -fsanitize=fuzzer,address,undefined objfuzz.cpp objparser.cpp -o objfuzz
+//            ./objfuzz corpus/ tests/corpus/
+// Without libFuzzer, build with -DOBJFUZZ_STANDALONE to replay files (e.g. a corpus or a crash) through the same checks.
+// tests/corpus holds the seed inputs; ctest replays them when the target is built (RENDERER_BUILD_FUZZ).
+//
+// The corpus directory is also the input set for parser throughput: renderer -objbench corpus/*
+#include "objparser.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static float touch(const ObjFile& file)
+{
+	// reading every referenced element makes out of bounds accesses visible to the sanitizers if validation misses them
+	float sum = 0;
+
+	size_t stride = file.f_stride / 3;
+	bool texcoords = (file.attributes & ObjAttributeTexcoords) != 0;
+	bool normals = (file.attributes & ObjAttributeNormals) != 0;
+
+	for (size_t i = 0; i < file.f_size; i += stride)
+	{
+		int vi = file.f[i];
+		int vti = texcoords ? file.f[i + 1] : -1;
+		int vni = normals ? file.f[i + stride - 1] : -1;
+
+		sum += file.v[vi * 3 + 0] + file.v[vi * 3 + 1] + file.v[vi * 3 + 2];
+		sum += vti < 0 ? 0.f : file.vt[vti * file.vt_stride + 0] + file.vt[vti * file.vt_stride + 1];
+		sum += vni < 0 ? 0.f : file.vn[vni * 3 + 0] + file.vn[vni * 3 + 1] + file.vn[vni * 3 + 2];
+	}
+
+	for (size_t i = 0; i < file.r_size; i++)
+	{
+		const ObjRange& range = file.r[i];
+
+		sum += float(strlen(objName(file, range.object)) + strlen(objName(file, range.group)));
+		sum += range.material < 0 ? 0.f : file.m[range.material].kd[0];
+	}
+
+	for (size_t i = 0; i < file.m_size; i++)
+		sum += float(strlen(objName(file, file.m[i].name)) + strlen(objName(file, file.m[i].map_kd)));
+
+	return sum;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+	// the parsers terminate lines in place and need one spare byte
+	char* buffer = static_cast<char*>(malloc(size + 1));
+	assert(buffer);
+
+	memcpy(buffer, data, size);
+
+	ObjFile file;
+	objParseBuffer(file, buffer, size);
+
+	// the same input goes through the material parser, on top of whatever materials usemtl declared
+	memcpy(buffer, data, size);
+	objParseMaterialBuffer(file, buffer, size);
+
+	// the specialized parsers get one attribute subset per input, picked by its size
+	static const unsigned int attributes[] = {
+		ObjAttributePositions,
+		ObjAttributePositions | ObjAttributeTexcoords,
+		ObjAttributePositions | ObjAttributeNormals,
+		ObjAttributeAll,
+	};
+
+	ObjFile subset;
+
+	memcpy(buffer, data, size);
+	objParseBuffer(subset, buffer, size, attributes[size % 4]);
+
+	free(buffer);
+
+	if (objValidate(file))
+	{
+		volatile float sink = touch(file);
+		(void)sink;
+	}
+
+	if (objValidate(subset))
+	{
+		volatile float sink = touch(subset);
+		(void)sink;
+	}
+
+	return 0;
+}
+
+#ifdef OBJFUZZ_STANDALONE
+int main(int argc, const char** argv)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		FILE* file = fopen(argv[i], "rb");
+		if (!file)
+		{
+			printf("Failed to open %s\n", argv[i]);
+			return 1;
+		}
+
+		fseek(file, 0, SEEK_END);
+		long length = ftell(file);
+		fseek(file, 0, SEEK_SET);
+
+		uint8_t* data = static_cast<uint8_t*>(malloc(length > 0 ? length : 1));
+		size_t read = fread(data, 1, length > 0 ? length : 0, file);
+		fclose(file);
+
+		LLVMFuzzerTestOneInput(data, read);
+		free(data);
+	}
+
+	printf("Ran %d inputs\n", argc - 1);
+	return 0;
+}
+#endif
@@ -10,6 +10,9 @@
 #include <cstdlib>
 #include <cstring>
 
+// longer lines are treated as corrupted input
+static const size_t kMaxLineLength = 64 * 1024 * 1024;
+
 template <typename T>
 static void growArray(T*& data, size_t& capacity)
 {
@@ -45,8 +48,9 @@ static int parseInt(const char* s, const char** end)
 
 	for (;;)
 	{
+		// saturates instead of wrapping around, so that huge indices stay out of range
 		if (unsigned(*s - '0') < 10)
-			result = result * 10 + (*s - '0');
+			result = result < 214748364 ? result * 10 + (*s - '0') : 0x7fffffff;
 		else
 			break;
 
@@ -109,7 +113,8 @@ static float parseFloat(const char* s, const char** end)
 
 		while (unsigned(*s - '0') < 10)
 		{
-			exppower = exppower * 10 + (*s - '0');
+			// anything past this is out of float range anyway
+			exppower = exppower < 10000 ? exppower * 10 + (*s - '0') : exppower;
 			s++;
 		}
 
@@ -130,6 +135,88 @@ static float parseFloat(const char* s, const char** end)
 		return float(sign * result * pow(10.0, power));
 }
 
+// Appends the rest of the line, without surrounding whitespace, to the name pool and returns its offset
+static size_t parseName(ObjFile& result, const char* s)
+{
+	while (*s == ' ' || *s == '\t')
+		s++;
+
+	size_t length = strlen(s);
+
+	while (length && (s[length - 1] == ' ' || s[length - 1] == '\t' || s[length - 1] == '\r'))
+		length--;
+
+	if (length == 0)
+		return 0;
+
+	// offset 0 is reserved for the empty string
+	size_t offset = result.names_size ? result.names_size : 1;
+
+	while (offset + length + 1 > result.names_cap)
+		growArray(result.names, result.names_cap);
+
+	result.names[0] = 0;
+
+	memcpy(result.names + offset, s, length);
+	result.names[offset + length] = 0;
+
+	result.names_size = offset + length + 1;
+
+	return offset;
+}
+
+static int findMaterial(const ObjFile& result, size_t name)
+{
+	for (size_t i = 0; i < result.m_size; i++)
+		if (strcmp(result.names + result.m[i].name, result.names + name) == 0)
+			return int(i);
+
+	return -1;
+}
+
+// Returns the material with the given name, adding one with default properties if it wasn't seen before
+static int getMaterial(ObjFile& result, size_t name)
+{
+	int index = findMaterial(result, name);
+
+	if (index >= 0)
+	{
+		// the name is already in the pool, so the copy that was just appended can go
+		result.names_size = name;
+		return index;
+	}
+
+	if (result.m_size + 1 > result.m_cap)
+		growArray(result.m, result.m_cap);
+
+	ObjMaterial material = { name, { 1, 1, 1 }, { 0, 0, 0 }, 0, 1, 0 };
+	result.m[result.m_size] = material;
+
+	return int(result.m_size++);
+}
+
+// Returns the range subsequent faces go to; state changes without faces in between update the last range in place
+static ObjRange& beginRange(ObjFile& result)
+{
+	if (result.r_size && result.r[result.r_size - 1].f_offset == result.f_size)
+		return result.r[result.r_size - 1];
+
+	ObjRange range = { result.f_size, 0, 0, -1 };
+
+	if (result.r_size)
+	{
+		range = result.r[result.r_size - 1];
+		range.f_offset = result.f_size;
+	}
+
+	if (result.r_size + 1 > result.r_cap)
+		growArray(result.r, result.r_cap);
+
+	result.r[result.r_size] = range;
+
+	return result.r[result.r_size++];
+}
+
 static const char* parseFace(const char* s, int& vi, int& vti, int& vni)
 {
 	while (*s == ' ' || *s == '\t')
@@ -154,6 +241,43 @@ static const char* parseFace(const char* s, int& vi, int& vti, int& vni)
 	return s;
 }
 
+// Handles the lines that change the state of subsequent faces, and mtllib
+static void parseStateLine(ObjFile& result, const char* line)
+{
+	if (line[0] == 'o' && line[1] == ' ')
+	{
+		size_t name = parseName(result, line + 2);
+
+		beginRange(result).object = name;
+	}
+	else if (line[0] == 'g' && line[1] == ' ')
+	{
+		size_t name = parseName(result, line + 2);
+
+		beginRange(result).group = name;
+	}
+	else if (strncmp(line, "usemtl ", 7) == 0)
+	{
+		size_t name = parseName(result, line + 7);
+
+		int material = name ? getMaterial(result, name) : -1;
+
+		beginRange(result).material = material;
+	}
+	else if (strncmp(line, "mtllib ", 7) == 0)
+	{
+		size_t name = parseName(result, line + 7);
+
+		if (name)
+		{
+			if (result.mtllib_size + 1 > result.mtllib_cap)
+				growArray(result.mtllib, result.mtllib_cap);
+
+			result.mtllib[result.mtllib_size++] = name;
+		}
+	}
+}
+
 ObjFile::ObjFile()
     : v(0)
     , v_size(0)
@@ -161,13 +285,32 @@ ObjFile::ObjFile()
     , vt(0)
     , vt_size(0)
     , vt_cap(0)
+    , vt_stride(3)
     , vn(0)
     , vn_size(0)
     , vn_cap(0)
     , f(0)
     , f_size(0)
     , f_cap(0)
+    , f_stride(9)
+    , r(0)
+    , r_size(0)
+    , r_cap(0)
+    , m(0)
+    , m_size(0)
+    , m_cap(0)
+    , mtllib(0)
+    , mtllib_size(0)
+    , mtllib_cap(0)
+    , names(0)
+    , names_size(0)
+    , names_cap(0)
+    , m_current(-1)
+    , attributes(ObjAttributeAll)
+    , f_form(-1)
+    , f_invalid(false)
 {
+	f_max[0] = f_max[1] = f_max[2] = -1;
 }
 
 ObjFile::~ObjFile()
@@ -176,6 +319,10 @@ ObjFile::~ObjFile()
 	delete[] vt;
 	delete[] vn;
 	delete[] f;
+	delete[] r;
+	delete[] m;
+	delete[] mtllib;
+	delete[] names;
 }
 
 void objParseLine(ObjFile& result, const char* line)
@@ -233,6 +380,10 @@ void objParseLine(ObjFile& result, const char* line)
 		size_t vt = result.vt_size / 3;
 		size_t vn = result.vn_size / 3;
 
+		// faces before the first o/g/usemtl go to an unnamed range
+		if (result.r_size == 0)
+			beginRange(result);
+
 		int fv = 0;
 		int f[3][3] = {};
 
@@ -248,6 +399,14 @@ void objParseLine(ObjFile& result, const char* line)
 			f[fv][1] = fixupIndex(vti, vt);
 			f[fv][2] = fixupIndex(vni, vn);
 
+			// texture coordinate and normal indices may be omitted, which fixes them up to -1; anything else that ends
+			// up negative is a relative index that points before the first element
+			result.f_invalid |= (f[fv][0] < 0) | (vti != 0 && f[fv][1] < 0) | (vni != 0 && f[fv][2] < 0);
+
+			result.f_max[0] = f[fv][0] > result.f_max[0] ? f[fv][0] : result.f_max[0];
+			result.f_max[1] = f[fv][1] > result.f_max[1] ? f[fv][1] : result.f_max[1];
+			result.f_max[2] = f[fv][2] > result.f_max[2] ? f[fv][2] : result.f_max[2];
+
 			if (fv == 2)
 			{
 				if (result.f_size + 9 > result.f_cap)
@@ -266,85 +425,533 @@ void objParseLine(ObjFile& result, const char* line)
 			}
 		}
 	}
+	else
+	{
+		parseStateLine(result, line);
+	}
 }
 
-bool objParseFile(ObjFile& result, const char* path)
+// Index forms of face elements; FaceFormAny accepts all of them, element by element
+enum FaceForm
+{
+	FaceFormAny,
+	FaceFormV, // v
+	FaceFormVT, // v/vt
+	FaceFormVN, // v//vn
+	FaceFormVTN, // v/vt/vn
+};
+
+// Returns the form of the first element on the line
+static int detectFaceForm(const char* s)
+{
+	while (*s == ' ' || *s == '\t')
+		s++;
+
+	while (*s && *s != '/' && *s != ' ' && *s != '\t')
+		s++;
+
+	if (*s != '/')
+		return FaceFormV;
+	s++;
+
+	if (*s == '/')
+		return FaceFormVN;
+
+	while (*s && *s != '/' && *s != ' ' && *s != '\t')
+		s++;
+
+	return *s == '/' ? FaceFormVTN : FaceFormVT;
+}
+
+// Skips an index that isn't stored, with the same whitespace and sign rules as parseInt
+static const char* skipInt(const char* s)
+{
+	while (*s == ' ' || *s == '\t')
+		s++;
+
+	s += (*s == '-' || *s == '+');
+
+	while (unsigned(*s - '0') < 10)
+		s++;
+
+	return s;
+}
+
+// Parses one face element of the given form, skipping indices of attributes that aren't parsed; returns 0 if the
+// element has a different form
+template <unsigned int Attributes, int Form>
+static const char* parseFaceForm(const char* s, int& vi, int& vti, int& vni)
+{
+	if (Form == FaceFormAny)
+		return parseFace(s, vi, vti, vni);
+
+	vi = parseInt(s, &s);
+
+	// end of line, or an invalid index that ends the face in every form
+	if (vi == 0)
+		return s;
+
+	if (Form == FaceFormVT || Form == FaceFormVTN)
+	{
+		if (*s != '/' || s[1] == '/')
+			return 0;
+		s++;
+
+		if (Attributes & ObjAttributeTexcoords)
+			vti = parseInt(s, &s);
+		else
+			s = skipInt(s);
+	}
+
+	if (Form == FaceFormVN || Form == FaceFormVTN)
+	{
+		if (*s != '/')
+			return 0;
+		s++;
+
+		if (Form == FaceFormVN)
+		{
+			if (*s != '/')
+				return 0;
+			s++;
+		}
+
+		if (Attributes & ObjAttributeNormals)
+			vni = parseInt(s, &s);
+		else
+			s = skipInt(s);
+	}
+
+	// an element with more indices than the form
+	return *s == '/' ? 0 : s;
+}
+
+// Returns false, with no faces added, if an element doesn't have the given form
+template <unsigned int Attributes, int Form>
+static bool parseFaceLine(ObjFile& result, const char* s)
+{
+	enum
+	{
+		HasTexcoords = (Attributes & ObjAttributeTexcoords) != 0,
+		HasNormals = (Attributes & ObjAttributeNormals) != 0,
+		Stride = 1 + HasTexcoords + HasNormals,
+	};
+
+	size_t v = result.v_size / 3;
+	size_t vt = result.vt_size / 2;
+	size_t vn = result.vn_size / 3;
+
+	size_t f_begin = result.f_size;
+
+	int fv = 0;
+	int f[3][Stride] = {};
+
+	while (*s)
+	{
+		int vi = 0, vti = 0, vni = 0;
+		s = parseFaceForm<Attributes, Form>(s, vi, vti, vni);
+
+		// f_max and f_invalid only see elements that the fallback parses again
+		if (!s)
+		{
+			result.f_size = f_begin;
+			return false;
+		}
+
+		if (vi == 0)
+			break;
+
+		f[fv][0] = fixupIndex(vi, v);
+		result.f_invalid |= f[fv][0] < 0;
+		result.f_max[0] = f[fv][0] > result.f_max[0] ? f[fv][0] : result.f_max[0];
+
+		if (HasTexcoords)
+		{
+			int& fvt = f[fv][1];
+			fvt = fixupIndex(vti, vt);
+			result.f_invalid |= vti != 0 && fvt < 0;
+			result.f_max[1] = fvt > result.f_max[1] ? fvt : result.f_max[1];
+		}
+
+		if (HasNormals)
+		{
+			int& fvn = f[fv][Stride - 1];
+			fvn = fixupIndex(vni, vn);
+			result.f_invalid |= vni != 0 && fvn < 0;
+			result.f_max[2] = fvn > result.f_max[2] ? fvn : result.f_max[2];
+		}
+
+		if (fv == 2)
+		{
+			if (result.f_size + 3 * Stride > result.f_cap)
+				growArray(result.f, result.f_cap);
+
+			memcpy(&result.f[result.f_size], f, 3 * Stride * sizeof(int));
+			result.f_size += 3 * Stride;
+
+			memcpy(f[1], f[2], Stride * sizeof(int));
+		}
+		else
+		{
+			fv++;
+		}
+	}
+
+	return true;
+}
+
+template <unsigned int Attributes>
+static void parseLineAttributes(ObjFile& result, const char* line)
+{
+	// lines of attributes that aren't parsed cost a few compares
+	if (line[0] == 'v')
+	{
+		if (line[1] == ' ')
+		{
+			const char* s = line + 2;
+
+			float x = parseFloat(s, &s);
+			float y = parseFloat(s, &s);
+			float z = parseFloat(s, &s);
+
+			if (result.v_size + 3 > result.v_cap)
+				growArray(result.v, result.v_cap);
+
+			result.v[result.v_size++] = x;
+			result.v[result.v_size++] = y;
+			result.v[result.v_size++] = z;
+		}
+		else if ((Attributes & ObjAttributeTexcoords) && line[1] == 't' && line[2] == ' ')
+		{
+			const char* s = line + 3;
+
+			float u = parseFloat(s, &s);
+			float v = parseFloat(s, &s);
+
+			if (result.vt_size + 2 > result.vt_cap)
+				growArray(result.vt, result.vt_cap);
+
+			result.vt[result.vt_size++] = u;
+			result.vt[result.vt_size++] = v;
+		}
+		else if ((Attributes & ObjAttributeNormals) && line[1] == 'n' && line[2] == ' ')
+		{
+			const char* s = line + 3;
+
+			float x = parseFloat(s, &s);
+			float y = parseFloat(s, &s);
+			float z = parseFloat(s, &s);
+
+			if (result.vn_size + 3 > result.vn_cap)
+				growArray(result.vn, result.vn_cap);
+
+			result.vn[result.vn_size++] = x;
+			result.vn[result.vn_size++] = y;
+			result.vn[result.vn_size++] = z;
+		}
+	}
+	else if (line[0] == 'f' && line[1] == ' ')
+	{
+		const char* s = line + 2;
+
+		// faces before the first o/g/usemtl go to an unnamed range
+		if (result.r_size == 0)
+			beginRange(result);
+
+		if (result.f_form < 0)
+			result.f_form = detectFaceForm(s);
+
+		bool parsed = false;
+
+		switch (result.f_form)
+		{
+		case FaceFormV:
+			parsed = parseFaceLine<Attributes, FaceFormV>(result, s);
+			break;
+		case FaceFormVT:
+			parsed = parseFaceLine<Attributes, FaceFormVT>(result, s);
+			break;
+		case FaceFormVN:
+			parsed = parseFaceLine<Attributes, FaceFormVN>(result, s);
+			break;
+		case FaceFormVTN:
+			parsed = parseFaceLine<Attributes, FaceFormVTN>(result, s);
+			break;
+		}
+
+		// files that mix forms pay for the specialized attempt on every face with a different form
+		if (!parsed)
+			parseFaceLine<Attributes, FaceFormAny>(result, s);
+	}
+	else
+	{
+		parseStateLine(result, line);
+	}
+}
+
+typedef void (*ParseLineFunction)(ObjFile&, const char*);
+
+static ParseLineFunction beginParseAttributes(ObjFile& result, unsigned int attributes)
+{
+	assert(attributes & ObjAttributePositions);
+	attributes |= ObjAttributePositions;
+
+	size_t f_stride = 3 * (1 + ((attributes & ObjAttributeTexcoords) != 0) + ((attributes & ObjAttributeNormals) != 0));
+
+	// strides can't change once there is data
+	assert(result.vt_size == 0 || result.vt_stride == 2);
+	assert(result.f_size == 0 || result.f_stride == f_stride);
+
+	result.attributes = attributes;
+	result.vt_stride = 2;
+	result.f_stride = f_stride;
+
+	switch (attributes & ObjAttributeAll)
+	{
+	case ObjAttributePositions:
+		return parseLineAttributes<ObjAttributePositions>;
+	case ObjAttributePositions | ObjAttributeTexcoords:
+		return parseLineAttributes<ObjAttributePositions | ObjAttributeTexcoords>;
+	case ObjAttributePositions | ObjAttributeNormals:
+		return parseLineAttributes<ObjAttributePositions | ObjAttributeNormals>;
+	default:
+		return parseLineAttributes<ObjAttributeAll>;
+	}
+}
+
+void objParseMaterialLine(ObjFile& result, const char* line)
+{
+	while (*line == ' ' || *line == '\t')
+		line++;
+
+	if (strncmp(line, "newmtl ", 7) == 0)
+	{
+		size_t name = parseName(result, line + 7);
+
+		result.m_current = name ? getMaterial(result, name) : -1;
+		return;
+	}
+
+	if (result.m_current < 0)
+		return;
+
+	ObjMaterial& material = result.m[result.m_current];
+
+	if (line[0] == 'K' && line[1] == 'd' && line[2] == ' ')
+	{
+		const char* s = line + 3;
+
+		material.kd[0] = parseFloat(s, &s);
+		material.kd[1] = parseFloat(s, &s);
+		material.kd[2] = parseFloat(s, &s);
+	}
+	else if (line[0] == 'K' && line[1] == 's' && line[2] == ' ')
+	{
+		const char* s = line + 3;
+
+		material.ks[0] = parseFloat(s, &s);
+		material.ks[1] = parseFloat(s, &s);
+		material.ks[2] = parseFloat(s, &s);
+	}
+	else if (line[0] == 'N' && line[1] == 's' && line[2] == ' ')
+	{
+		const char* s = line + 3;
+
+		material.ns = parseFloat(s, &s);
+	}
+	else if (line[0] == 'd' && line[1] == ' ')
+	{
+		const char* s = line + 2;
+
+		material.d = parseFloat(s, &s);
+	}
+	else if (line[0] == 'T' && line[1] == 'r' && line[2] == ' ')
+	{
+		const char* s = line + 3;
+
+		material.d = 1 - parseFloat(s, &s);
+	}
+	else if (strncmp(line, "map_Kd ", 7) == 0)
+	{
+		material.map_kd = parseName(result, line + 7);
+	}
+}
+
+// Calls parseLine for every line in data, zero-terminating lines in place; data[size] has to be writable, and is only
+// written to when the last line has no trailing newline
+static void parseBuffer(ObjFile& result, char* data, size_t size, void (*parseLine)(ObjFile&, const char*))
+{
+	size_t line = 0;
+
+	while (line < size)
+	{
+		// find the end of current line
+		void* eol = memchr(data + line, '\n', size - line);
+		size_t next = eol ? static_cast<char*>(eol) - data : size;
+
+		data[next] = 0;
+
+		// process next line
+		parseLine(result, data + line);
+
+		line = next + 1;
+	}
+}
+
+static bool parseLines(ObjFile& result, const char* path, void (*parseLine)(ObjFile&, const char*))
 {
 	FILE* file = fopen(path, "rb");
 	if (!file)
 		return false;
 
-	char buffer[65536];
+	// one byte past capacity is reserved for the terminator of the last line
+	size_t capacity = 65536;
+	char* buffer = new char[capacity + 1];
 	size_t size = 0;
 
-	while (!feof(file))
-	{
-		size += fread(buffer + size, 1, sizeof(buffer) - size, file);
+	bool ok = true;
 
-		size_t line = 0;
-
-		while (line < size)
+	for (;;)
+	{
+		// lines longer than the buffer grow it rather than being split; a line that never ends fails the parse
+		if (size == capacity)
 		{
-			// find the end of current line
-			void* eol = memchr(buffer + line, '\n', size - line);
-			if (!eol)
+			if (capacity >= kMaxLineLength)
+			{
+				ok = false;
 				break;
+			}
 
-			// zero-terminate for objParseLine
-			size_t next = static_cast<char*>(eol) - buffer;
+			char* newbuffer = new char[capacity * 2 + 1];
+			memcpy(newbuffer, buffer, size);
+			delete[] buffer;
 
-			buffer[next] = 0;
+			buffer = newbuffer;
+			capacity *= 2;
+		}
 
-			// process next line
-			objParseLine(result, buffer + line);
+		size_t read = fread(buffer + size, 1, capacity - size, file);
+		if (read == 0)
+			break;
 
-			line = next + 1;
-		}
+		size += read;
+
+		// only complete lines are processed; the partial last line is moved to the beginning of the buffer
+		size_t end = size;
+		while (end > 0 && buffer[end - 1] != '\n')
+			end--;
 
-		// move prefix of the last line in the buffer to the beginning of the buffer for next iteration
-		assert(line <= size);
+		parseBuffer(result, buffer, end, parseLine);
 
-		memmove(buffer, buffer + line, size - line);
-		size -= line;
+		memmove(buffer, buffer + end, size - end);
+		size -= end;
 	}
 
-	if (size)
+	// process last line
+	if (ok)
+		parseBuffer(result, buffer, size, parseLine);
+
+	ok = ok && !ferror(file);
+
+	delete[] buffer;
+	fclose(file);
+
+	return ok;
+}
+
+void objParseBuffer(ObjFile& result, char* data, size_t size)
+{
+	parseBuffer(result, data, size, objParseLine);
+}
+
+void objParseBuffer(ObjFile& result, char* data, size_t size, unsigned int attributes)
+{
+	parseBuffer(result, data, size, beginParseAttributes(result, attributes));
+}
+
+void objParseMaterialBuffer(ObjFile& result, char* data, size_t size)
+{
+	result.m_current = -1;
+
+	parseBuffer(result, data, size, objParseMaterialLine);
+}
+
+// Parses the .mtl files referenced by mtllib; their paths are relative to the .obj file
+static void parseMaterialLibraries(ObjFile& result, const char* path)
+{
+	const char* slash = strrchr(path, '/');
+	const char* backslash = strrchr(path, '\\');
+	const char* separator = slash > backslash ? slash : backslash;
+
+	size_t prefix = separator ? separator - path + 1 : 0;
+
+	for (size_t i = 0; i < result.mtllib_size; i++)
 	{
-		// process last line
-		assert(size < sizeof(buffer));
-		buffer[size] = 0;
+		const char* name = objName(result, result.mtllib[i]);
 
-		objParseLine(result, buffer);
+		char mtlPath[1024];
+		if (prefix + strlen(name) >= sizeof(mtlPath))
+			continue;
+
+		memcpy(mtlPath, path, prefix);
+		strcpy(mtlPath + prefix, name);
+
+		objParseMaterialFile(result, mtlPath);
 	}
+}
+
+bool objParseFile(ObjFile& result, const char* path)
+{
+	if (!parseLines(result, path, objParseLine))
+		return false;
+
+	parseMaterialLibraries(result, path);
 
-	fclose(file);
 	return true;
 }
 
+bool objParseFile(ObjFile& result, const char* path, unsigned int attributes)
+{
+	if (!parseLines(result, path, beginParseAttributes(result, attributes)))
+		return false;
+
+	parseMaterialLibraries(result, path);
+
+	return true;
+}
+
+bool objParseMaterialFile(ObjFile& result, const char* path)
+{
+	result.m_current = -1;
+
+	return parseLines(result, path, objParseMaterialLine);
+}
+
 bool objValidate(const ObjFile& result)
 {
-	size_t v = result.v_size / 3;
-	size_t vt = result.vt_size / 3;
-	size_t vn = result.vn_size / 3;
+	// face elements were checked while parsing; only the largest references have to be compared with the final counts
+	if (result.f_invalid)
+		return false;
 
-	for (size_t i = 0; i < result.f_size; i += 3)
-	{
-		int vi = result.f[i + 0];
-		int vti = result.f[i + 1];
-		int vni = result.f[i + 2];
+	if (result.f_max[0] >= 0 && size_t(result.f_max[0]) >= result.v_size / 3)
+		return false;
 
-		if (vi < 0)
-			return false;
+	if (result.f_max[1] >= 0 && size_t(result.f_max[1]) >= result.vt_size / result.vt_stride)
+		return false;
 
-		if (vi >= 0 && size_t(vi) >= v)
-			return false;
+	if (result.f_max[2] >= 0 && size_t(result.f_max[2]) >= result.vn_size / 3)
+		return false;
+
+	for (size_t i = 0; i < result.r_size; i++)
+	{
+		const ObjRange& range = result.r[i];
 
-		if (vti >= 0 && size_t(vti) >= vt)
+		if (range.f_offset > result.f_size || (i > 0 && range.f_offset < result.r[i - 1].f_offset))
 			return false;
 
-		if (vni >= 0 && size_t(vni) >= vn)
+		if (range.material >= 0 && size_t(range.material) >= result.m_size)
 			return false;
 	}
 
 	return true;
-}
\ No newline at end of file
+}
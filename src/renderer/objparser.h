@@ -2,20 +2,72 @@
 
 #include <stddef.h>
 
+// Faces from f_offset up to the next range's f_offset (or f_size) share an object, group and material
+struct ObjRange
+{
+	size_t f_offset; // into f
+
+	size_t object; // names offset, 0 if unnamed
+	size_t group; // names offset, 0 if unnamed
+	int material; // index into m, -1 if none
+};
+
+struct ObjMaterial
+{
+	size_t name; // names offset
+
+	float kd[3]; // diffuse color
+	float ks[3]; // specular color
+	float ns; // specular exponent
+	float d; // dissolve; 1 is opaque
+
+	size_t map_kd; // names offset of the diffuse texture path as written in the .mtl file, 0 if none
+};
+
+enum ObjAttributes
+{
+	ObjAttributePositions = 1 << 0,
+	ObjAttributeTexcoords = 1 << 1,
+	ObjAttributeNormals = 1 << 2,
+
+	ObjAttributeAll = ObjAttributePositions | ObjAttributeTexcoords | ObjAttributeNormals,
+};
+
 class ObjFile
 {
 public:
 	float* v; // positions; stride 3 (xyz)
 	size_t v_size, v_cap;
 
-	float* vt; // texture coordinates; stride 3 (uvw)
-	size_t vt_size, vt_cap;
+	float* vt; // texture coordinates; stride vt_stride (uvw, or uv for objParseFile with attributes)
+	size_t vt_size, vt_cap, vt_stride;
 
 	float* vn; // vertex normals; stride 3 (xyz)
 	size_t vn_size, vn_cap;
 
-	int* f; // face elements; stride 9 (3 groups of indices into v/vt/vn)
-	size_t f_size, f_cap;
+	int* f; // face elements; stride f_stride (3 groups of indices into v/vt/vn, or into the parsed attributes only)
+	size_t f_size, f_cap, f_stride;
+
+	ObjRange* r; // submesh ranges in face order; a new range starts whenever o/g/usemtl change between faces
+	size_t r_size, r_cap;
+
+	ObjMaterial* m; // materials referenced by usemtl or defined by newmtl, in order of first appearance
+	size_t m_size, m_cap;
+
+	size_t* mtllib; // names offsets of .mtl files referenced by mtllib
+	size_t mtllib_size, mtllib_cap;
+
+	char* names; // zero-terminated strings; offset 0 is the empty string
+	size_t names_size, names_cap;
+
+	int m_current; // material objParseMaterialLine updates; set by newmtl
+
+	unsigned int attributes; // ObjAttributes that are parsed and referenced by f
+	int f_form; // index form of the first face for parses with attributes, -1 before it
+
+	// face references are validated while parsing; objValidate compares the largest ones with the final counts
+	int f_max[3]; // largest v/vt/vn index in f, -1 if none
+	bool f_invalid; // a face element had a relative index that resolved before the first element
 
 	ObjFile();
 	~ObjFile();
@@ -26,6 +78,28 @@ private:
 };
 
 void objParseLine(ObjFile& result, const char* line);
+void objParseMaterialLine(ObjFile& result, const char* line);
+
+// Parses text in memory without following mtllib; data[size] has to be writable, lines are zero-terminated in place
+void objParseBuffer(ObjFile& result, char* data, size_t size);
+void objParseMaterialBuffer(ObjFile& result, char* data, size_t size);
+
+// Also parses the .mtl files referenced by mtllib, relative to the .obj file; missing .mtl files are ignored
 bool objParseFile(ObjFile& result, const char* path);
+bool objParseMaterialFile(ObjFile& result, const char* path);
+
+// Parse only the given ObjAttributes, which have to include positions, with line parsers specialized at compile time
+// for each combination: lines of other attributes are skipped, texture coordinates are stored without w (vt_stride 2)
+// and faces store indices of the parsed attributes only, in v/vt/vn order (f_stride 3 to 9). Faces with the index form
+// of the first face (v, v/vt, v//vn or v/vt/vn) are parsed by a face parser specialized for it; other faces fall back
+// to a parser that accepts every form. Texture coordinate and normal indices are -1 where the face omits them
+void objParseBuffer(ObjFile& result, char* data, size_t size, unsigned int attributes);
+bool objParseFile(ObjFile& result, const char* path, unsigned int attributes);
+
+inline const char* objName(const ObjFile& result, size_t offset)
+{
+	return offset ? result.names + offset : "";
+}
 
+// Checks that every face element references existing vertex data and that ranges are consistent; O(1) in the face count
 bool objValidate(const ObjFile& result);
\ No newline at end of file
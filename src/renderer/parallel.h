@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <thread>
+#include <vector>
+
+inline uint32_t getThreadCount()
+{
+	uint32_t threadCount = std::thread::hardware_concurrency();
+	return threadCount ? threadCount : 1;
+}
+
+// Runs task(thread) for every thread index; the calling thread is thread 0
+template <typename Task>
+void parallelFor(uint32_t threadCount, Task task)
+{
+	std::vector<std::thread> workers;
+	for (uint32_t i = 1; i < threadCount; i++)
+		workers.push_back(std::thread(task, i));
+
+	task(0);
+
+	for (size_t i = 0; i < workers.size(); i++)
+		workers[i].join();
+}
+
+// First element of the thread's share when count elements are split evenly between threadCount threads
+inline size_t getRangeBegin(size_t count, uint32_t thread, uint32_t threadCount)
+{
+	return count * thread / threadCount;
+}
@@ -0,0 +1,312 @@
+#include "common.h"
+#include "shaders.h"
+#include "pipelines.h"
+#include "sync.h"
+#include "timer.h"
+
+VkPipelineCache createPipelineCache(VkDevice device)
+{
+	// pipeline caches are internally synchronized unless created with VK_PIPELINE_CACHE_CREATE_EXTERNALLY_SYNCHRONIZED_BIT,
+	// so all worker threads can share this one
+	VkPipelineCacheCreateInfo createInfo = { VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO };
+
+	VkPipelineCache cache = 0;
+	VK_CHECK(vkCreatePipelineCache(device, &createInfo, 0, &cache));
+
+	return cache;
+}
+
+// requests in one batch go through a single vkCreateGraphicsPipelines call, so everything but the variant has to match
+static bool isSameBatch(const PipelineRequest& lhs, const PipelineRequest& rhs)
+{
+	return lhs.target.renderPass == rhs.target.renderPass && lhs.target.colorFormat == rhs.target.colorFormat && lhs.target.depthFormat == rhs.target.depthFormat &&
+		lhs.target.samples == rhs.target.samples && lhs.vs == rhs.vs && lhs.fs == rhs.fs && lhs.layout == rhs.layout;
+}
+
+static void pipelineWorker(PipelineManager* manager)
+{
+	uint32_t handles[kPipelineBatchSize];
+	uint32_t generations[kPipelineBatchSize];
+	PipelineVariant variants[kPipelineBatchSize];
+	VkPipeline pipelines[kPipelineBatchSize];
+
+	for (;;)
+	{
+		uint32_t batchSize = 0;
+		PipelineRequest request;
+
+		{
+			std::unique_lock<std::mutex> lock(manager->mutex);
+			manager->pending.wait(lock, [&]() { return manager->quit || !manager->queue.empty(); });
+
+			if (manager->queue.empty())
+				return;
+
+			// split the queue evenly between workers so that small queues still compile in parallel
+			size_t share = (manager->queue.size() + manager->workerCount - 1) / manager->workerCount;
+			size_t maxBatchSize = share < kPipelineBatchSize ? share : kPipelineBatchSize;
+
+			// requests can be rewritten by replaceShaderModule while we compile, so work on a copy
+			request = manager->requests[manager->queue.front()];
+
+			while (batchSize < maxBatchSize && !manager->queue.empty() && isSameBatch(manager->requests[manager->queue.front()], request))
+			{
+				uint32_t handle = manager->queue.front();
+				manager->queue.pop_front();
+
+				handles[batchSize] = handle;
+				generations[batchSize] = manager->generations[handle];
+				variants[batchSize] = manager->requests[handle].variant;
+				batchSize++;
+			}
+		}
+
+		double start = getTimeMs();
+
+		createGraphicsPipelines(pipelines, manager->device, manager->cache, request.target, request.vs, request.fs, request.layout, variants, batchSize);
+
+		double end = getTimeMs();
+
+		{
+			std::unique_lock<std::mutex> lock(manager->mutex);
+
+			for (uint32_t i = 0; i < batchSize; i++)
+			{
+				uint32_t handle = handles[i];
+				assert(pipelines[i]);
+
+				// with several rebuilds of one handle in flight, a stale compile may finish last; never publish it over a newer one
+				if (generations[i] > manager->installed[handle])
+				{
+					VkPipeline oldPipeline = manager->pipelines[handle].exchange(pipelines[i], std::memory_order_acq_rel);
+					manager->installed[handle] = generations[i];
+
+					if (oldPipeline)
+						manager->retired.push_back(oldPipeline);
+				}
+				else
+					manager->retired.push_back(pipelines[i]);
+			}
+
+			// the driver doesn't report per-pipeline times within a batch, so the batch time is split evenly
+			double compileTime = (end - start) / batchSize;
+
+			PipelineStats& stats = manager->stats;
+			stats.compiled += batchSize;
+			stats.totalCompileTime += end - start;
+			stats.maxCompileTime = stats.maxCompileTime < compileTime ? compileTime : stats.maxCompileTime;
+			stats.wallTime = end - manager->startTime;
+		}
+
+		manager->completed.notify_all();
+	}
+}
+
+void createPipelineManager(PipelineManager& result, VkDevice device, VkPipelineCache cache, uint32_t threadCount, uint32_t maxPipelines)
+{
+	assert(threadCount > 0);
+
+	result.device = device;
+	result.cache = cache;
+
+	result.requests.resize(maxPipelines);
+	result.generations.resize(maxPipelines);
+	result.installed.resize(maxPipelines);
+	result.pipelines = new std::atomic<VkPipeline>[maxPipelines];
+	result.pipelineCount = 0;
+	result.maxPipelines = maxPipelines;
+
+	for (uint32_t i = 0; i < maxPipelines; i++)
+		result.pipelines[i].store(VK_NULL_HANDLE, std::memory_order_relaxed);
+
+	result.stats = PipelineStats();
+	result.startTime = 0;
+
+	result.quit = false;
+
+	result.workerCount = threadCount;
+
+	for (uint32_t i = 0; i < threadCount; i++)
+		result.workers.push_back(std::thread(pipelineWorker, &result));
+}
+
+void destroyPipelineManager(PipelineManager& manager)
+{
+	{
+		std::unique_lock<std::mutex> lock(manager.mutex);
+		manager.quit = true;
+	}
+
+	manager.pending.notify_all();
+
+	// workers drain the queue before exiting so that every handed out handle refers to a valid pipeline or 0
+	for (size_t i = 0; i < manager.workers.size(); i++)
+		manager.workers[i].join();
+
+	manager.workers.clear();
+
+	for (uint32_t i = 0; i < manager.pipelineCount; i++)
+		vkDestroyPipeline(manager.device, manager.pipelines[i].load(), VK_NULL_HANDLE);
+
+	for (size_t i = 0; i < manager.retired.size(); i++)
+		vkDestroyPipeline(manager.device, manager.retired[i], VK_NULL_HANDLE);
+
+	manager.retired.clear();
+
+	delete[] manager.pipelines;
+	manager.pipelines = 0;
+	manager.pipelineCount = 0;
+}
+
+uint32_t requestPipeline(PipelineManager& manager, const PipelineRequest& request)
+{
+	uint32_t handle = 0;
+
+	{
+		std::unique_lock<std::mutex> lock(manager.mutex);
+		assert(manager.pipelineCount < manager.maxPipelines);
+
+		if (manager.stats.requested == manager.stats.compiled)
+			manager.startTime = getTimeMs();
+
+		handle = manager.pipelineCount++;
+
+		manager.requests[handle] = request;
+		manager.generations[handle] = 1;
+		manager.installed[handle] = 0;
+		manager.queue.push_back(handle);
+
+		manager.stats.requested++;
+	}
+
+	manager.pending.notify_one();
+
+	return handle;
+}
+
+VkPipeline getPipeline(const PipelineManager& manager, uint32_t handle)
+{
+	assert(handle < manager.pipelineCount);
+
+	return manager.pipelines[handle].load(std::memory_order_acquire);
+}
+
+uint32_t replaceShaderModule(PipelineManager& manager, VkShaderModule oldModule, VkShaderModule newModule)
+{
+	uint32_t affected = 0;
+
+	{
+		std::unique_lock<std::mutex> lock(manager.mutex);
+
+		for (uint32_t i = 0; i < manager.pipelineCount; i++)
+		{
+			PipelineRequest& request = manager.requests[i];
+
+			if (request.vs != oldModule && request.fs != oldModule)
+				continue;
+
+			request.vs = (request.vs == oldModule) ? newModule : request.vs;
+			request.fs = (request.fs == oldModule) ? newModule : request.fs;
+
+			if (manager.stats.requested == manager.stats.compiled)
+				manager.startTime = getTimeMs();
+
+			manager.generations[i]++;
+			manager.queue.push_back(i);
+			manager.stats.requested++;
+
+			affected++;
+		}
+	}
+
+	manager.pending.notify_all();
+
+	return affected;
+}
+
+void retirePipelines(PipelineManager& manager, DeletionQueue& deletionQueue, uint64_t value)
+{
+	std::unique_lock<std::mutex> lock(manager.mutex);
+
+	for (size_t i = 0; i < manager.retired.size(); i++)
+		deferDestroy(deletionQueue, value, VK_OBJECT_TYPE_PIPELINE, (uint64_t)manager.retired[i]);
+
+	manager.retired.clear();
+}
+
+void waitPipelines(PipelineManager& manager)
+{
+	std::unique_lock<std::mutex> lock(manager.mutex);
+	manager.completed.wait(lock, [&]() { return manager.stats.compiled == manager.stats.requested; });
+}
+
+PipelineStats getPipelineStats(PipelineManager& manager)
+{
+	std::unique_lock<std::mutex> lock(manager.mutex);
+	return manager.stats;
+}
+
+bool benchmarkPipelineManager(VkDevice device, const RenderTargetInfo& target, VkShaderModule vs, VkShaderModule fs, VkPipelineLayout layout, uint32_t variantCount)
+{
+	uint32_t maxThreads = std::thread::hardware_concurrency();
+	maxThreads = maxThreads ? maxThreads : 1;
+
+	printf("Compiling %d pipeline variants, %d hardware threads\n", variantCount, maxThreads);
+
+	std::vector<uint32_t> threadCounts;
+	for (uint32_t threadCount = 1; threadCount < maxThreads; threadCount *= 2)
+		threadCounts.push_back(threadCount);
+	threadCounts.push_back(maxThreads);
+
+	double baseline = 0;
+	bool result = true;
+
+	std::vector<uint32_t> handles(variantCount);
+
+	for (size_t run = 0; run < threadCounts.size(); run++)
+	{
+		uint32_t threadCount = threadCounts[run];
+
+		// every run starts from an empty cache so that results measure compilation, not cache lookups
+		VkPipelineCache cache = createPipelineCache(device);
+
+		PipelineManager manager;
+		createPipelineManager(manager, device, cache, threadCount, variantCount);
+
+		for (uint32_t i = 0; i < variantCount; i++)
+		{
+			// cycles through the valid formats and modes; the seed keeps specialization data unique, so the driver can't dedup variants
+			PipelineVariant variant = { i % VertexFormatCount, (i / VertexFormatCount) % LightingModeCount, VertexInputAttributes, i / (VertexFormatCount * LightingModeCount) };
+
+			PipelineRequest request = { target, vs, fs, layout, variant };
+			handles[i] = requestPipeline(manager, request);
+		}
+
+		waitPipelines(manager);
+
+		// once the queue is drained every handle has to resolve to a pipeline, regardless of which worker compiled it
+		uint32_t missing = 0;
+
+		for (uint32_t i = 0; i < variantCount; i++)
+			missing += getPipeline(manager, handles[i]) == VK_NULL_HANDLE;
+
+		PipelineStats stats = getPipelineStats(manager);
+
+		baseline = (threadCount == 1) ? stats.wallTime : baseline;
+
+		printf("%2d threads: wall %8.2f ms, avg %6.2f ms, max %6.2f ms, speedup %.2fx\n",
+			threadCount, stats.wallTime, stats.totalCompileTime / stats.compiled, stats.maxCompileTime, baseline / stats.wallTime);
+
+		if (missing || stats.compiled != variantCount)
+		{
+			printf("%2d threads: %d of %d handles have no pipeline, %d compiled, MISMATCH\n", threadCount, missing, variantCount, stats.compiled);
+			result = false;
+		}
+
+		destroyPipelineManager(manager);
+
+		vkDestroyPipelineCache(device, cache, VK_NULL_HANDLE);
+	}
+
+	return result;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+struct DeletionQueue;
+
+// Queued requests that only differ by variant are compiled together, up to this many per vkCreateGraphicsPipelines call
+const uint32_t kPipelineBatchSize = 8;
+
+struct PipelineRequest
+{
+	RenderTargetInfo target;
+	VkShaderModule vs, fs;
+	VkPipelineLayout layout;
+	PipelineVariant variant;
+};
+
+struct PipelineStats
+{
+	uint32_t requested;
+	uint32_t compiled;
+
+	double totalCompileTime; // sum of per-pipeline compile times, ms
+	double maxCompileTime; // slowest pipeline, ms
+	double wallTime; // first request to last completion, ms
+};
+
+// Compiles graphics pipelines on worker threads against a shared VkPipelineCache, in batches of up to kPipelineBatchSize.
+// Pipelines are identified by the handle returned from requestPipeline; getPipeline returns 0 until the pipeline is ready,
+// in which case the caller is expected to draw with a fallback pipeline or skip the draw.
+struct PipelineManager
+{
+	VkDevice device;
+	VkPipelineCache cache;
+
+	std::vector<std::thread> workers;
+	uint32_t workerCount; // workers may start before the vector is filled, so they read this instead
+
+	std::mutex mutex;
+	std::condition_variable pending; // signaled when a request is queued or on shutdown
+	std::condition_variable completed; // signaled when a pipeline finishes compiling
+
+	std::deque<uint32_t> queue;
+	std::vector<PipelineRequest> requests; // preallocated to maxPipelines; protected by mutex
+	std::atomic<VkPipeline>* pipelines;
+	std::vector<uint32_t> generations; // bumped every time a request is queued; protected by mutex
+	std::vector<uint32_t> installed; // generation of the pipeline currently published for each handle; protected by mutex
+	std::vector<VkPipeline> retired; // pipelines replaced by a rebuild; protected by mutex
+	uint32_t pipelineCount;
+	uint32_t maxPipelines;
+
+	PipelineStats stats;
+	double startTime;
+
+	bool quit;
+};
+
+VkPipelineCache createPipelineCache(VkDevice device);
+
+void createPipelineManager(PipelineManager& result, VkDevice device, VkPipelineCache cache, uint32_t threadCount, uint32_t maxPipelines);
+void destroyPipelineManager(PipelineManager& manager);
+
+uint32_t requestPipeline(PipelineManager& manager, const PipelineRequest& request);
+VkPipeline getPipeline(const PipelineManager& manager, uint32_t handle);
+
+// Requeues every pipeline created from oldModule with newModule substituted; the previous pipeline stays in use until its replacement is ready
+uint32_t replaceShaderModule(PipelineManager& manager, VkShaderModule oldModule, VkShaderModule newModule);
+
+// Pipelines replaced by a rebuild may still be referenced by command buffers in flight; moves them to the deletion queue
+// to be destroyed once the timeline reaches value
+void retirePipelines(PipelineManager& manager, DeletionQueue& deletionQueue, uint64_t value);
+
+void waitPipelines(PipelineManager& manager);
+PipelineStats getPipelineStats(PipelineManager& manager);
+
+// Compiles variantCount variants with 1 to hardware_concurrency threads; returns false if any handle has no pipeline
+bool benchmarkPipelineManager(VkDevice device, const RenderTargetInfo& target, VkShaderModule vs, VkShaderModule fs, VkPipelineLayout layout, uint32_t variantCount);
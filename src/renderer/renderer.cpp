@@ -1,27 +1,35 @@
-#include <stdio.h>
-#include <assert.h>
-
-#include <vector>
+#include "common.h"
+#include "shaders.h"
+#include "pipelines.h"
+#include "swapchain.h"
+#include "framepacing.h"
+#include "device.h"
+#include "resources.h"
+#include "sync.h"
+#include "mesh.h"
+#include "meshfile.h"
+#include "streaming.h"
+#include "scenegen.h"
+#include "normals.h"
+#include "vertexremap.h"
+#include "drawbench.h"
+#include "drawcull.h"
+#include "visibility.h"
+#include "rendergraph.h"
+#include "stats.h"
+#include "capture.h"
+#include "replay.h"
+#include "texturefile.h"
+#include "textures.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include <GLFW/glfw3.h>
-#include <GLFW/glfw3native.h>
-#include <volk.h>
-
-#include<meshoptimizer.h>
-#include"objparser.h"
-
-
-#define VK_CHECK(call) \
-	do{ \
-		VkResult result_ = call;\
-		assert(result_ == VK_SUCCESS);\
-	}while (0)
 
-#ifndef ARRAYSIZE
-#define ARRAYSIZE(array) (sizeof(array) / sizeof((array)[0]))
-#endif
 
-VkInstance createInstance()
+VkInstance createInstance(bool surfaces)
 {
 	VkApplicationInfo appInfo = { VK_STRUCTURE_TYPE_APPLICATION_INFO };
 	appInfo.apiVersion = VK_API_VERSION_1_1;
@@ -36,53 +44,37 @@ VkInstance createInstance()
 	createInfo.ppEnabledLayerNames = debugLayers;
 #endif
 
-	const char* extensions[] = {
-		VK_KHR_SURFACE_EXTENSION_NAME,
-#ifdef VK_USE_PLATFORM_WIN32_KHR
-		VK_KHR_WIN32_SURFACE_EXTENSION_NAME,
-#endif // DEBUG
-#ifdef _DEBUG 
-		VK_EXT_DEBUG_REPORT_EXTENSION_NAME,
-#endif 
-	};
-
-	createInfo.enabledExtensionCount = sizeof(extensions) / sizeof(extensions[0]);
-	createInfo.ppEnabledExtensionNames = extensions;
+	std::vector<const char*> extensions;
 
-	VkInstance instance = 0;
-	VK_CHECK(vkCreateInstance(&createInfo, NULL, &instance));
+	// GLFW knows which surface extensions the platform needs (Win32, Xlib, XCB or Wayland)
+	if (surfaces)
+	{
+		uint32_t glfwExtensionCount = 0;
+		const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+		assert(glfwExtensions);
 
-	return instance;
-}
+		extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+	}
 
-uint32_t getGraphicsQueueFamily(VkPhysicalDevice physicalDevice)
-{
-	uint32_t queueCount = 0;
-	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueCount, VK_NULL_HANDLE);
+#ifdef _DEBUG
+	extensions.push_back(VK_EXT_DEBUG_REPORT_EXTENSION_NAME);
+#endif
 
-	std::vector<VkQueueFamilyProperties> queues(queueCount);
-	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueCount, queues.data());
+	createInfo.enabledExtensionCount = uint32_t(extensions.size());
+	createInfo.ppEnabledExtensionNames = extensions.data();
 
-	for (int i = 0; i < queueCount; i++)
-	{
-		if (queues[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
-			return i;
-		}
-	}
+	VkInstance instance = 0;
+	VK_CHECK(vkCreateInstance(&createInfo, NULL, &instance));
 
-	return VK_QUEUE_FAMILY_IGNORED;
+	return instance;
 }
 
-bool supportsPresentation(VkPhysicalDevice physicalDevice, uint32_t familyIndex)
+bool supportsPresentation(VkInstance instance, VkPhysicalDevice physicalDevice, uint32_t familyIndex)
 {
-#ifdef VK_USE_PLATFORM_WIN32_KHR
-	return vkGetPhysicalDeviceWin32PresentationSupportKHR(physicalDevice, familyIndex);
-#else
-	return true;
-#endif
+	return glfwGetPhysicalDevicePresentationSupport(instance, physicalDevice, familyIndex) == GLFW_TRUE;
 }
 
-VkPhysicalDevice pickPhysicalDevice(VkPhysicalDevice* physicalDevices, uint32_t physicalDeviceCount)
+VkPhysicalDevice pickPhysicalDevice(VkInstance instance, VkPhysicalDevice* physicalDevices, uint32_t physicalDeviceCount, bool presentation)
 {
 	VkPhysicalDevice discrete = 0;
 	VkPhysicalDevice fallback = 0;
@@ -99,7 +91,7 @@ VkPhysicalDevice pickPhysicalDevice(VkPhysicalDevice* physicalDevices, uint32_t
 		if (familyIndex == VK_QUEUE_FAMILY_IGNORED)
 			continue;
 
-		if (!supportsPresentation(physicalDevices[i], familyIndex))
+		if (presentation && !supportsPresentation(instance, physicalDevices[i], familyIndex))
 			continue;
 
 		if (!discrete && props.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU)
@@ -123,105 +115,12 @@ VkPhysicalDevice pickPhysicalDevice(VkPhysicalDevice* physicalDevices, uint32_t
 	return discrete ? discrete : fallback;
 }
 
-VkDevice createDevice(float queueProperties[], const VkPhysicalDevice& physicalDevice, uint32_t familyIndex)
-{
-	VkDeviceQueueCreateInfo queueInfo = { VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO };
-	queueInfo.queueFamilyIndex = familyIndex;
-	queueInfo.queueCount = 1;
-	queueInfo.pQueuePriorities = queueProperties;
-
-	const char* extensions[] = {
-		VK_KHR_SWAPCHAIN_EXTENSION_NAME
-	};
-
-	VkDeviceCreateInfo deviceInfo = { VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO };
-	deviceInfo.queueCreateInfoCount = 1;
-	deviceInfo.pQueueCreateInfos = &queueInfo;
-
-	deviceInfo.enabledExtensionCount = sizeof(extensions) / sizeof(extensions[0]);;
-	deviceInfo.ppEnabledExtensionNames = extensions;
-
-	VkDevice device = 0;
-	VK_CHECK(vkCreateDevice(physicalDevice, &deviceInfo, VK_NULL_HANDLE, &device));
-
-	return device;
-}
-
 VkSurfaceKHR createSurface(VkInstance instance, GLFWwindow* window)
 {
-#ifdef VK_USE_PLATFORM_WIN32_KHR
-	VkWin32SurfaceCreateInfoKHR createInfo = { VK_STRUCTURE_TYPE_WIN32_SURFACE_CREATE_INFO_KHR };
-	createInfo.hinstance = GetModuleHandle(0);
-	createInfo.hwnd = glfwGetWin32Window(window);
-
 	VkSurfaceKHR surface = 0;
-
-	vkCreateWin32SurfaceKHR(instance, &createInfo, VK_NULL_HANDLE, &surface);
+	VK_CHECK(glfwCreateWindowSurface(instance, window, VK_NULL_HANDLE, &surface));
 
 	return surface;
-#endif // VK_USE_PLATFORM_WIN32_KHR
-}
-
-VkSurfaceFormatKHR chooseSwapSurfaceFormat(VkSurfaceFormatKHR* formats, uint32_t formatCount) {
-	for (int i = 0; i < formatCount; i++) {
-		if (formats[i].format == VK_FORMAT_B8G8R8A8_SRGB && formats[i].colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR) {
-			return formats[i];
-		}
-	}
-
-	return formats[0];
-}
-
-VkSurfaceFormatKHR getSwapchainFormat(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface, uint32_t familyIndex) {
-	uint32_t surfaceForamatsCount;
-	VK_CHECK(vkGetPhysicalDeviceSurfaceFormatsKHR(physicalDevice, surface, &surfaceForamatsCount, NULL));
-
-	std::vector<VkSurfaceFormatKHR> formats(surfaceForamatsCount);
-	VK_CHECK(vkGetPhysicalDeviceSurfaceFormatsKHR(physicalDevice, surface, &surfaceForamatsCount, formats.data()));
-
-	auto format = chooseSwapSurfaceFormat(formats.data(), surfaceForamatsCount);
-
-	return format;
-}
-
-VkSwapchainKHR createSwapchain(VkDevice device, VkPhysicalDevice physicalDevice, VkSurfaceKHR surface, uint32_t familyIndex, VkSurfaceFormatKHR format, VkSwapchainKHR oldSwapchain)
-{
-	VkSurfaceCapabilitiesKHR surfaceCaps;
-	vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physicalDevice, surface, &surfaceCaps);
-
-	VkCompositeAlphaFlagBitsKHR surfaceComposite =
-		(surfaceCaps.supportedCompositeAlpha & VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR)
-		? VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR
-		: (surfaceCaps.supportedCompositeAlpha & VK_COMPOSITE_ALPHA_PRE_MULTIPLIED_BIT_KHR)
-		? VK_COMPOSITE_ALPHA_PRE_MULTIPLIED_BIT_KHR
-		: (surfaceCaps.supportedCompositeAlpha & VK_COMPOSITE_ALPHA_POST_MULTIPLIED_BIT_KHR)
-		? VK_COMPOSITE_ALPHA_POST_MULTIPLIED_BIT_KHR
-		: VK_COMPOSITE_ALPHA_INHERIT_BIT_KHR;
-
-	VkSwapchainCreateInfoKHR createInfo = { VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR };
-	createInfo.surface = surface;
-	createInfo.minImageCount = surfaceCaps.minImageCount + 1;
-
-	createInfo.imageFormat = format.format;
-	createInfo.imageColorSpace = format.colorSpace;
-	createInfo.imageExtent.width = surfaceCaps.currentExtent.width;
-	createInfo.imageExtent.height = surfaceCaps.currentExtent.height;
-	createInfo.imageArrayLayers = 1;
-	createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
-
-	createInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
-	createInfo.queueFamilyIndexCount = 1;
-	createInfo.pQueueFamilyIndices = &familyIndex;
-	createInfo.preTransform = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR;
-	createInfo.compositeAlpha = surfaceComposite;
-	createInfo.presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
-	createInfo.clipped = VK_TRUE;
-	createInfo.oldSwapchain = oldSwapchain;
-
-	VkSwapchainKHR swapchain = 0;
-	VK_CHECK(vkCreateSwapchainKHR(device, &createInfo, NULL, &swapchain));
-
-	return swapchain;
 }
 
 VkSemaphore createSemaphore(VkDevice device) {
@@ -233,6 +132,16 @@ VkSemaphore createSemaphore(VkDevice device) {
 	return semaphore;
 }
 
+VkFence createFence(VkDevice device, bool signaled) {
+	VkFenceCreateInfo createInfo = { VK_STRUCTURE_TYPE_FENCE_CREATE_INFO };
+	createInfo.flags = signaled ? VK_FENCE_CREATE_SIGNALED_BIT : 0;
+
+	VkFence fence;
+	VK_CHECK(vkCreateFence(device, &createInfo, NULL, &fence));
+
+	return fence;
+}
+
 VkCommandPool createCommandPool(VkDevice device, uint32_t familyIndex) {
 	VkCommandPoolCreateInfo createInfo = { VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
 	createInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
@@ -244,190 +153,91 @@ VkCommandPool createCommandPool(VkDevice device, uint32_t familyIndex) {
 	return commandPool;
 }
 
-VkRenderPass createRenderPass(VkDevice device, VkFormat format)
-{
-	VkAttachmentDescription attachments[1] = {};
-	attachments[0].format = format;
-	attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
-	attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-	attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-	attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-	attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-	attachments[0].initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-	attachments[0].finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-	VkAttachmentReference colorAttachments = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
-
-	VkSubpassDescription subpass = {};
-	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-	subpass.colorAttachmentCount = 1;
-	subpass.pColorAttachments = &colorAttachments;
-
-	VkRenderPassCreateInfo createInfo = { VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO };
-	createInfo.subpassCount = 1;
-	createInfo.pSubpasses = &subpass;
-	createInfo.attachmentCount = sizeof(attachments) / sizeof(attachments[0]);
-	createInfo.pAttachments = attachments;
-
-	VkRenderPass renderPass = 0;
-	VK_CHECK(vkCreateRenderPass(device, &createInfo, VK_NULL_HANDLE, &renderPass));
-
-	return renderPass;
-}
-
-VkFramebuffer createFramebuffer(VkDevice device, VkRenderPass renderPass, VkImageView imageView, uint32_t width, uint32_t height)
-{
-	VkFramebufferCreateInfo createInfo = { VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO };
-	createInfo.renderPass = renderPass;
-	createInfo.attachmentCount = 1;
-	createInfo.pAttachments = &imageView;
-	createInfo.width = width;
-	createInfo.height = height;
-	createInfo.layers = 1;
-
-	VkFramebuffer framebuffer = 0;
-	VK_CHECK(vkCreateFramebuffer(device, &createInfo, 0, &framebuffer));
-
-	return framebuffer;
-}
-
-VkImageView createImageView(VkDevice device, VkImage image, VkFormat format)
-{
-	VkImageViewCreateInfo createInfo = { VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO };
-	createInfo.image = image;
-	createInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-	createInfo.format = format;
-	createInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	createInfo.subresourceRange.layerCount = 1;
-	createInfo.subresourceRange.levelCount = 1;
-
-	VkImageView view = 0;
-	VK_CHECK(vkCreateImageView(device, &createInfo, VK_NULL_HANDLE, &view));
-
-	return view;
-}
-
-VkShaderModule loadShader(VkDevice device, const char* path)
-{
-	FILE* file = fopen(path, "rb");
-	assert(file);
-
-	fseek(file, 0, SEEK_END);
-	long length = ftell(file);
-	fseek(file, 0, SEEK_SET);
-
-	char* buffer = new char[length];
-	size_t rc = fread(buffer, 1, length, file);
-	assert(rc == size_t(length));
-
-	fclose(file);
-
-	VkShaderModuleCreateInfo createInfo = { VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO };
-	createInfo.codeSize = length;
-	createInfo.pCode = reinterpret_cast<const uint32_t*>(buffer);
-
-	VkShaderModule shaderModule = 0;
-	VK_CHECK(vkCreateShaderModule(device, &createInfo, VK_NULL_HANDLE, &shaderModule));
-
-	return shaderModule;
-}
-
-VkPipelineLayout createPipelineLayout(VkDevice device)
+VkQueryPool createQueryPool(VkDevice device, uint32_t queryCount)
 {
-	VkPipelineLayoutCreateInfo createInfo = { VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO };
+	VkQueryPoolCreateInfo createInfo = { VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO };
+	createInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	createInfo.queryCount = queryCount;
 
-	VkPipelineLayout layout = 0;
-	VK_CHECK(vkCreatePipelineLayout(device, &createInfo, 0, &layout));
+	VkQueryPool queryPool = 0;
+	VK_CHECK(vkCreateQueryPool(device, &createInfo, 0, &queryPool));
 
-	return layout;
+	return queryPool;
 }
 
-VkPipeline createGraphicsPipeline(VkDevice device, VkPipelineCache pipelineCache, VkRenderPass renderPass, VkShaderModule vs, VkShaderModule fs, VkPipelineLayout layout)
+// Attachments match the swapchain framebuffers: color, depth if depthFormat is set, and with more than one sample the
+// swapchain image that color is resolved into at the end of the subpass. Multisampled color and depth are never stored,
+// so on tiled GPUs they stay in tile memory
+VkRenderPass createRenderPass(VkDevice device, VkFormat format, VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT, VkFormat depthFormat = VK_FORMAT_UNDEFINED)
 {
+	bool multisampled = samples != VK_SAMPLE_COUNT_1_BIT;
 
-	VkGraphicsPipelineCreateInfo createInfo = { VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO };
-
-	VkPipelineShaderStageCreateInfo stages[2] = {};
-	stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
-	stages[0].module = vs;
-	stages[0].pName = "main";
-	stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-	stages[1].module = fs;
-	stages[1].pName = "main";
-
-	createInfo.stageCount = sizeof(stages) / sizeof(stages[0]);
-	createInfo.pStages = stages;
-
-	VkPipelineVertexInputStateCreateInfo vertexInput = { VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO };
-	createInfo.pVertexInputState = &vertexInput;
-
-	VkVertexInputBindingDescription stream = { 0,32,VK_VERTEX_INPUT_RATE_VERTEX };
-	VkVertexInputAttributeDescription attrs[3] = {};
-
-	attrs[0].location = 0;
-	attrs[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-	attrs[0].offset = 0;
-
-	attrs[1].location = 1;
-	attrs[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-	attrs[1].offset = 12;
+	VkAttachmentDescription attachments[3] = {};
+	uint32_t attachmentCount = 0;
 
-	attrs[2].location = 2;
-	attrs[2].format = VK_FORMAT_R32G32B32_SFLOAT;
-	attrs[2].offset = 24;
+	VkAttachmentReference colorAttachment = { attachmentCount, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
 
-	vertexInput.vertexAttributeDescriptionCount = 3;
-	vertexInput.pVertexAttributeDescriptions = attrs;
-	vertexInput.vertexBindingDescriptionCount = 1;
-	vertexInput.pVertexBindingDescriptions = &stream;
+	attachments[attachmentCount].format = format;
+	attachments[attachmentCount].samples = samples;
+	attachments[attachmentCount].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	attachments[attachmentCount].storeOp = multisampled ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE;
+	attachments[attachmentCount].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	attachments[attachmentCount].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	attachments[attachmentCount].initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	attachments[attachmentCount].finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	attachmentCount++;
 
-	VkPipelineInputAssemblyStateCreateInfo inputAssembly = { VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO };
-	inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-	createInfo.pInputAssemblyState = &inputAssembly;
+	VkAttachmentReference depthAttachment = { attachmentCount, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
 
-	VkPipelineViewportStateCreateInfo viewportState = { VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO };
-	viewportState.viewportCount = 1;
-	viewportState.scissorCount = 1;
-	createInfo.pViewportState = &viewportState;
-
-	VkPipelineRasterizationStateCreateInfo rasterizationState = { VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO };
-	rasterizationState.lineWidth = 1.f;
-	createInfo.pRasterizationState = &rasterizationState;
-
-	VkPipelineMultisampleStateCreateInfo multisampleState = { VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO };
-	multisampleState.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-	createInfo.pMultisampleState = &multisampleState;
-
-	VkPipelineDepthStencilStateCreateInfo depthStencilState = { VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO };
-	createInfo.pDepthStencilState = &depthStencilState;
-
-	VkPipelineColorBlendAttachmentState colorAttachmentState = {};
-	colorAttachmentState.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+	if (depthFormat != VK_FORMAT_UNDEFINED)
+	{
+		attachments[attachmentCount].format = depthFormat;
+		attachments[attachmentCount].samples = samples;
+		attachments[attachmentCount].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		attachments[attachmentCount].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachments[attachmentCount].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachments[attachmentCount].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachments[attachmentCount].initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		attachments[attachmentCount].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		attachmentCount++;
+	}
 
-	VkPipelineColorBlendStateCreateInfo colorBlendState = { VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO };
-	colorBlendState.attachmentCount = 1;
-	colorBlendState.pAttachments = &colorAttachmentState;
-	createInfo.pColorBlendState = &colorBlendState;
+	VkAttachmentReference resolveAttachment = { attachmentCount, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
 
-	VkDynamicState dynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+	if (multisampled)
+	{
+		// every pixel is written by the resolve, so the previous contents are never loaded
+		attachments[attachmentCount].format = format;
+		attachments[attachmentCount].samples = VK_SAMPLE_COUNT_1_BIT;
+		attachments[attachmentCount].loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachments[attachmentCount].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		attachments[attachmentCount].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachments[attachmentCount].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachments[attachmentCount].initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		attachments[attachmentCount].finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		attachmentCount++;
+	}
 
-	VkPipelineDynamicStateCreateInfo dynamicState = { VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO };
-	dynamicState.dynamicStateCount = sizeof(dynamicStates) / sizeof(dynamicStates[0]);
-	dynamicState.pDynamicStates = dynamicStates;
-	createInfo.pDynamicState = &dynamicState;
+	VkSubpassDescription subpass = {};
+	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpass.colorAttachmentCount = 1;
+	subpass.pColorAttachments = &colorAttachment;
+	subpass.pResolveAttachments = multisampled ? &resolveAttachment : NULL;
+	subpass.pDepthStencilAttachment = depthFormat != VK_FORMAT_UNDEFINED ? &depthAttachment : NULL;
 
-	createInfo.layout = layout;
-	createInfo.renderPass = renderPass;
+	VkRenderPassCreateInfo createInfo = { VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO };
+	createInfo.subpassCount = 1;
+	createInfo.pSubpasses = &subpass;
+	createInfo.attachmentCount = attachmentCount;
+	createInfo.pAttachments = attachments;
 
-	VkPipeline pipeline = 0;
-	VK_CHECK(vkCreateGraphicsPipelines(device, pipelineCache, 1, &createInfo, 0, &pipeline));
+	VkRenderPass renderPass = 0;
+	VK_CHECK(vkCreateRenderPass(device, &createInfo, VK_NULL_HANDLE, &renderPass));
 
-	return pipeline;
+	return renderPass;
 }
 
-VkBool32 debugReportCallback(VkDebugReportFlagsEXT flags, VkDebugReportObjectTypeEXT objectType, uint64_t object, size_t location, int32_t messageCode, const char* pLayerPrefix, const char* pMessage, void* pUserData)
+VkBool32 debugReportCallback(VkDebugReportFlagsEXT flags, VkDebugReportObjectTypeEXT, uint64_t, size_t, int32_t, const char*, const char* pMessage, void*)
 {
 	const char* type = (flags & VK_DEBUG_REPORT_ERROR_BIT_EXT) ? "ERROR " : "WARNING ";
 
@@ -455,242 +265,310 @@ VkDebugReportCallbackEXT registerDebugCallback(VkInstance instance)
 
 	PFN_vkCreateDebugReportCallbackEXT vkCreateDebugReportCallbackEXT = (PFN_vkCreateDebugReportCallbackEXT)vkGetInstanceProcAddr(instance, "vkCreateDebugReportCallbackEXT");
 
+	// the extension is only enabled in debug builds
+	if (!vkCreateDebugReportCallbackEXT)
+		return 0;
+
 	VkDebugReportCallbackEXT callback = 0;
 	VK_CHECK(vkCreateDebugReportCallbackEXT(instance, &createInfo, VK_NULL_HANDLE, &callback));
 
 	return callback;
 }
 
-VkImageMemoryBarrier imageBarrier(VkImage image, VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask, VkImageLayout oldLayout, VkImageLayout newLayout)
-{
-	VkImageMemoryBarrier barrier = { VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
-
-	barrier.srcAccessMask = srcAccessMask;
-	barrier.oldLayout = oldLayout;
-	barrier.dstAccessMask = dstAccessMask;
-	barrier.newLayout = newLayout;
-	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-	barrier.image = image;
-	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
-	barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
-
-	return barrier;
-}
-
-struct Swapchain {
-	VkSwapchainKHR swapchain;
-	std::vector<VkImage> images;
-	std::vector<VkImageView> imageViews;
-	std::vector<VkFramebuffer> framebuffers;
-	uint32_t width, height;
-	uint32_t imageCount;
-};
-
-void destroySwapchain(Swapchain& swapchain, VkDevice device)
+void beginRendering(VkCommandBuffer commandBuffer, VkRenderPass renderPass, const Swapchain& swapchain, uint32_t imageIndex, const VkClearValue& clearColor)
 {
-	for (int i = 0; i < swapchain.imageCount; i++)
+	if (renderPass)
 	{
-		vkDestroyFramebuffer(device, swapchain.framebuffers[i], VK_NULL_HANDLE);
-	}
-
-	for (int i = 0; i < swapchain.imageCount; i++)
-	{
-		vkDestroyImageView(device, swapchain.imageViews[i], VK_NULL_HANDLE);
-	}
-
-	vkDestroySwapchainKHR(device, swapchain.swapchain, VK_NULL_HANDLE);
-}
+		VkRenderPassBeginInfo passBeginInfo = { VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO };
+		passBeginInfo.renderPass = renderPass;
+		passBeginInfo.framebuffer = swapchain.framebuffers[imageIndex];
+		passBeginInfo.renderArea.extent.width = swapchain.width;
+		passBeginInfo.renderArea.extent.height = swapchain.height;
 
-void createSwapchain(Swapchain& result, VkDevice device, VkPhysicalDevice physicalDevice, VkSurfaceKHR surface, uint32_t familyIndex, VkSurfaceFormatKHR format, VkRenderPass renderPass, VkSwapchainKHR oldSwapchain = 0) {
-	VkSurfaceCapabilitiesKHR surfaceCaps;
-	vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physicalDevice, surface, &surfaceCaps);
+		// the resolve attachment is never cleared and doesn't need a value
+		VkClearValue clearValues[2] = { clearColor };
+		clearValues[1].depthStencil.depth = 1.f;
 
-	VkSwapchainKHR swapchain = createSwapchain(device, physicalDevice, surface, familyIndex, format, oldSwapchain);
+		passBeginInfo.clearValueCount = swapchain.depth.image ? 2 : 1;
+		passBeginInfo.pClearValues = clearValues;
 
-	uint32_t imageCount = 0;
-	VK_CHECK(vkGetSwapchainImagesKHR(device, swapchain, &imageCount, VK_NULL_HANDLE));
+		vkCmdBeginRenderPass(commandBuffer, &passBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		return;
+	}
 
-	std::vector<VkImage> swapchainImages(imageCount);
-	VK_CHECK(vkGetSwapchainImagesKHR(device, swapchain, &imageCount, swapchainImages.data()));
+#ifdef VK_KHR_dynamic_rendering
+	VkRenderingAttachmentInfoKHR colorAttachment = { VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR };
+	colorAttachment.imageView = swapchain.imageViews[imageIndex];
+	colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	colorAttachment.clearValue = clearColor;
 
-	std::vector<VkImageView> swapchainImageViews(imageCount);
-	for (int i = 0; i < imageCount; i++)
+	// multisampled color is resolved into the swapchain image when rendering ends and never stored
+	if (swapchain.color.image)
 	{
-		swapchainImageViews[i] = createImageView(device, swapchainImages[i], format.format);
-		assert(swapchainImageViews[i]);
+		colorAttachment.imageView = swapchain.color.imageView;
+		colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		colorAttachment.resolveMode = VK_RESOLVE_MODE_AVERAGE_BIT_KHR;
+		colorAttachment.resolveImageView = swapchain.imageViews[imageIndex];
+		colorAttachment.resolveImageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 	}
 
-	std::vector<VkFramebuffer> swapchainFramebuffers(imageCount);
-	for (int i = 0; i < imageCount; i++)
+	VkRenderingAttachmentInfoKHR depthAttachment = { VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR };
+	depthAttachment.imageView = swapchain.depth.imageView;
+	depthAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+	depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	depthAttachment.clearValue.depthStencil.depth = 1.f;
+
+	VkRenderingInfoKHR renderingInfo = { VK_STRUCTURE_TYPE_RENDERING_INFO_KHR };
+	renderingInfo.renderArea.extent.width = swapchain.width;
+	renderingInfo.renderArea.extent.height = swapchain.height;
+	renderingInfo.layerCount = 1;
+	renderingInfo.colorAttachmentCount = 1;
+	renderingInfo.pColorAttachments = &colorAttachment;
+	renderingInfo.pDepthAttachment = swapchain.depth.image ? &depthAttachment : NULL;
+
+	vkCmdBeginRenderingKHR(commandBuffer, &renderingInfo);
+#else
+	assert(!"Dynamic rendering is not available in this build");
+#endif
+}
+
+void endRendering(VkCommandBuffer commandBuffer, VkRenderPass renderPass)
+{
+	if (renderPass)
 	{
-		swapchainFramebuffers[i] = createFramebuffer(device, renderPass, swapchainImageViews[i], surfaceCaps.currentExtent.width, surfaceCaps.currentExtent.height);
-		assert(swapchainFramebuffers[i]);
+		vkCmdEndRenderPass(commandBuffer);
+		return;
 	}
 
-	result.swapchain = swapchain;
+#ifdef VK_KHR_dynamic_rendering
+	vkCmdEndRenderingKHR(commandBuffer);
+#endif
+}
 
-	result.imageCount = imageCount;
+struct Frame
+{
+	VkCommandPool commandPool;
+	VkCommandBuffer commandBuffer;
+	VkSemaphore acquireSemaphore;
+	VkFence fence;
 
-	result.images = swapchainImages;
-	result.imageViews = swapchainImageViews;
-	result.framebuffers = swapchainFramebuffers;
+	Buffer cullReadback; // commands and counts written by gpu culling, counted once the frame is done
 
-	result.width = surfaceCaps.currentExtent.width;
-	result.height = surfaceCaps.currentExtent.height;
-}
+	uint64_t index; // timeline value of the frame last submitted from this slot, 0 if none
+};
 
+static uint32_t lightingMode = LightingModeNormals;
+static bool visibilityShading = false;
+static bool visibilityAvailable = false;
 
-void resizeSwapchain(Swapchain& result, VkDevice device, VkPhysicalDevice physicalDevice, VkSurfaceKHR surface, uint32_t familyIndex, VkSurfaceFormatKHR format, VkRenderPass renderPass)
+void keyCallback(GLFWwindow*, int key, int, int action, int)
 {
-	VkSurfaceCapabilitiesKHR surfaceCaps;
-	VK_CHECK(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physicalDevice, surface, &surfaceCaps));
+	if (action == GLFW_PRESS && key == GLFW_KEY_L)
+		lightingMode = (lightingMode + 1) % LightingModeCount;
 
-	uint32_t newWidth = surfaceCaps.currentExtent.width;
-	uint32_t newHeight = surfaceCaps.currentExtent.height;
-
-	if (result.width == newWidth && result.height == newHeight) return;
+	if (action == GLFW_PRESS && key == GLFW_KEY_V)
+		visibilityShading = !visibilityShading && visibilityAvailable;
+}
 
-	VkSwapchainKHR oldSwapchain = result.swapchain;
+static bool swapchainDirty = false;
 
-	Swapchain old = result;
+// bounded so that a stalled presentation engine can't hang the loop
+const uint64_t kAcquireTimeout = 100 * 1000 * 1000;
 
-	createSwapchain(result, device, physicalDevice, surface, familyIndex, format, renderPass, oldSwapchain);
+// meshes larger than this are streamed
+const size_t kMeshBufferSize = 128 * 1024 * 1024;
+const uint32_t kStreamChunkTriangles = 8192;
 
-	VK_CHECK(vkDeviceWaitIdle(device));
+// units per millisecond for WASD/QE camera movement
+const float kCameraSpeed = 0.001f;
 
-	destroySwapchain(old, device);
+void framebufferSizeCallback(GLFWwindow*, int, int)
+{
+	swapchainDirty = true;
 }
 
-struct Vertex {
-	float vx, vy, vz;
-	float nx, ny, nz;
-	float tu, tv;
-};
-
-struct Mesh
+VkPresentModeKHR parsePresentMode(const char* name)
 {
-	std::vector<Vertex> vertices;
-	std::vector<uint32_t> indices;
-};
+	if (strcmp(name, "immediate") == 0)
+		return VK_PRESENT_MODE_IMMEDIATE_KHR;
+	else if (strcmp(name, "mailbox") == 0)
+		return VK_PRESENT_MODE_MAILBOX_KHR;
+	else
+		return VK_PRESENT_MODE_FIFO_KHR;
+}
 
-bool loadMesh(Mesh& result, const char* path)
+const char* getPresentModeName(VkPresentModeKHR presentMode)
 {
-	ObjFile file;
-	if (!objParseFile(file, path))
-		return false;
-
-	size_t index_count = file.f_size / 3;
-
-	std::vector<Vertex> vertices(index_count);
-
-	for (size_t i = 0; i < index_count; i++) {
-		Vertex& v = vertices[i];
+	switch (presentMode)
+	{
+	case VK_PRESENT_MODE_IMMEDIATE_KHR: return "immediate";
+	case VK_PRESENT_MODE_MAILBOX_KHR: return "mailbox";
+	case VK_PRESENT_MODE_FIFO_KHR: return "fifo";
+	default: return "other";
+	}
+}
 
-		int vi = file.f[i * 3 + 0];
-		int vti = file.f[i * 3 + 1];
-		int vni = file.f[i * 3 + 2];
+void updateHeapStats(Stats& stats, VkPhysicalDevice physicalDevice)
+{
+	VkPhysicalDeviceMemoryProperties2 memoryProps = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2 };
 
-		v.vx = file.v[vi * 3 + 0];
-		v.vy = file.v[vi * 3 + 1];
-		v.vz = file.v[vi * 3 + 2];
+#ifdef VK_EXT_memory_budget
+	VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProps = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT };
 
-		v.nx = vni < 0 ? 0.f : file.vn[vni * 3 + 0];
-		v.ny = vni < 0 ? 0.f : file.vn[vni * 3 + 1];
-		v.nz = vni < 0 ? 1.f : file.vn[vni * 3 + 2];
+	if (stats.memoryBudget)
+		memoryProps.pNext = &budgetProps;
+#endif
 
-		v.tu = vti < 0 ? 0.f : file.vt[vti * 3 + 0];
-		v.tv = vti < 0 ? 0.f : file.vt[vti * 3 + 1];
-	}
+	vkGetPhysicalDeviceMemoryProperties2(physicalDevice, &memoryProps);
 
-	std::vector<uint32_t> remap(index_count);
+	const VkPhysicalDeviceMemoryProperties& props = memoryProps.memoryProperties;
 
-	size_t vertex_count = meshopt_generateVertexRemap(remap.data(), 0, index_count, vertices.data(), index_count, sizeof(Vertex));
+	stats.heaps.resize(props.memoryHeapCount);
 
-	result.vertices.resize(vertex_count);
-	result.indices.resize(index_count);
+	for (uint32_t i = 0; i < props.memoryHeapCount; i++)
+	{
+		HeapStats& heap = stats.heaps[i];
 
-	meshopt_remapVertexBuffer(result.vertices.data(), vertices.data(), index_count, sizeof(Vertex), remap.data());
-	meshopt_remapIndexBuffer(result.indices.data(), 0, index_count, remap.data());
+		heap.size = props.memoryHeaps[i].size;
+		heap.budget = heap.size;
+		heap.usage = 0;
+		heap.deviceLocal = (props.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
 
-	return true;
+#ifdef VK_EXT_memory_budget
+		if (stats.memoryBudget)
+		{
+			heap.budget = budgetProps.heapBudget[i];
+			heap.usage = budgetProps.heapUsage[i];
+		}
+#endif
+	}
 }
 
-struct Buffer
+int main(int argc, const char** argv)
 {
-	VkBuffer buffer;
-	VkDeviceMemory memory;
-	void* data;
-	size_t size;
-};
+	if (argc < 2)
+	{
+		printf("Usage: %s <mesh.obj|mesh.mesh|scene:...> [-present fifo|mailbox|immediate] [-images N] [-fps N] [-queued N] [-stream budgetMB] [-normals degrees] [-vertices attributes|pulled] [-culling cpu|gpu] [-shading forward|visibility] [-msaa samples]\n"
+			"       [-stats out.csv|out.json] [-statsinterval seconds] [-metricsport port] [-capture out.rcap]\n", argv[0]);
+		printf("       %s -convert <mesh.obj> <mesh.mesh> [quantization bits]\n", argv[0]);
+		printf("       %s -meshbench <mesh.obj> [quantization bits]\n", argv[0]);
+		printf("       %s -objbench <mesh.obj|corpus files...>\n", argv[0]);
+		printf("       %s -scenebench <scene:...> [out.obj]\n", argv[0]);
+		printf("       %s -normalbench <mesh.obj|mesh.mesh|scene:...>\n", argv[0]);
+		printf("       %s -remapbench <mesh.obj|mesh.mesh|scene:...>\n", argv[0]);
+		printf("       %s -texbench [image.tga|image.ppm]\n", argv[0]);
+		printf("       %s -pipelinebench [variants]\n", argv[0]);
+		printf("       %s -drawbench [draws]\n", argv[0]);
+		printf("       %s -cullbench [objects]\n", argv[0]);
+		printf("       %s -visbench [objects]\n", argv[0]);
+		printf("       %s -graphbench [images]\n", argv[0]);
+		printf("       %s -replay <capture.rcap> [repeats]\n", argv[0]);
+		return 1;
+	}
 
-uint32_t selectMemoryType(VkPhysicalDeviceMemoryProperties memoryProperties, uint32_t memoryTypeBits, VkMemoryPropertyFlags flags)
-{
-	for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+	if (strcmp(argv[1], "-convert") == 0 && argc > 3)
 	{
-		if ((memoryTypeBits & (1 << i)) != 0 && (memoryProperties.memoryTypes[i].propertyFlags & flags) == flags)
+		if (!convertMesh(argv[2], argv[3], argc > 4 ? atoi(argv[4]) : 0))
 		{
-			return i;
+			printf("Failed to convert %s\n", argv[2]);
+			return 1;
 		}
-	}
 
-	assert(!"No compatible memory type found");
-	return ~0u;
-}
+		return 0;
+	}
 
-void createBuffer(Buffer& result, VkDevice device, VkPhysicalDeviceMemoryProperties memoryProperties, size_t size, VkBufferUsageFlags usage)
-{
-VkBufferCreateInfo createInfo = { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
-	createInfo.size = size;
-	createInfo.usage = usage;
+	if (strcmp(argv[1], "-meshbench") == 0 && argc > 2)
+	{
+		benchmarkMesh(argv[2], argc > 3 ? atoi(argv[3]) : 0);
+		return 0;
+	}
 
-	VkBuffer buffer = 0;
-	VK_CHECK(vkCreateBuffer(device, &createInfo, 0, &buffer));
+	if (strcmp(argv[1], "-objbench") == 0 && argc > 2)
+	{
+		benchmarkObj(argv + 2, argc - 2);
+		return 0;
+	}
 
-	VkMemoryRequirements memoryRequirements;
-	vkGetBufferMemoryRequirements(device, buffer, &memoryRequirements);
+	if (strcmp(argv[1], "-scenebench") == 0 && argc > 2)
+	{
+		benchmarkScene(argv[2], argc > 3 ? argv[3] : "scenebench.obj");
+		return 0;
+	}
 
-	uint32_t memoryTypeIndex = selectMemoryType(memoryProperties, memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-	assert(memoryTypeIndex != ~0u);
+	if (strcmp(argv[1], "-normalbench") == 0 && argc > 2)
+	{
+		benchmarkNormals(argv[2]);
+		return 0;
+	}
 
-	VkMemoryAllocateInfo allocateInfo = { VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO };
-	allocateInfo.allocationSize = memoryRequirements.size;
-	allocateInfo.memoryTypeIndex = memoryTypeIndex;
+	if (strcmp(argv[1], "-remapbench") == 0 && argc > 2)
+		return benchmarkVertexRemap(argv[2]) ? 0 : 1;
 
-	VkDeviceMemory memory = 0;
-	VK_CHECK(vkAllocateMemory(device, &allocateInfo, 0, &memory));
+	if (strcmp(argv[1], "-texbench") == 0)
+		return benchmarkTextures(argc > 2 ? argv[2] : 0) ? 0 : 1;
 
-	VK_CHECK(vkBindBufferMemory(device, buffer, memory, 0));
+	SwapchainSettings swapchainSettings = { VK_PRESENT_MODE_MAILBOX_KHR, 0, VK_SAMPLE_COUNT_1_BIT, VK_FORMAT_UNDEFINED };
 
-	void* data = 0;
-	VK_CHECK(vkMapMemory(device, memory, 0, size, 0, &data));
+	double targetFrameRate = 0;
+	uint32_t maxQueuedFrames = 2;
+	size_t streamBudget = 0;
+	float smoothingAngle = -1;
+	bool vertexPulling = false;
+	bool gpuCulling = true;
+	uint32_t msaaSamples = 1;
+	const char* statsPath = 0;
+	double statsInterval = 10;
+	int metricsPort = 0;
+	const char* capturePath = 0;
 
-	result.buffer = buffer;
-	result.memory = memory;
-	result.data = data;
-	result.size = size;
-}
+	for (int i = 2; i + 1 < argc; i += 2)
+	{
+		if (strcmp(argv[i], "-present") == 0)
+			swapchainSettings.presentMode = parsePresentMode(argv[i + 1]);
+		else if (strcmp(argv[i], "-images") == 0)
+			swapchainSettings.imageCount = atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "-fps") == 0)
+			targetFrameRate = atof(argv[i + 1]);
+		else if (strcmp(argv[i], "-queued") == 0)
+			maxQueuedFrames = atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "-stream") == 0)
+			streamBudget = size_t(atoi(argv[i + 1])) * 1024 * 1024;
+		else if (strcmp(argv[i], "-normals") == 0)
+			smoothingAngle = float(atof(argv[i + 1]));
+		else if (strcmp(argv[i], "-vertices") == 0)
+			vertexPulling = strcmp(argv[i + 1], "pulled") == 0;
+		else if (strcmp(argv[i], "-culling") == 0)
+			gpuCulling = strcmp(argv[i + 1], "gpu") == 0;
+		else if (strcmp(argv[i], "-shading") == 0)
+			visibilityShading = strcmp(argv[i + 1], "visibility") == 0;
+		else if (strcmp(argv[i], "-msaa") == 0)
+			msaaSamples = atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "-stats") == 0)
+			statsPath = argv[i + 1];
+		else if (strcmp(argv[i], "-statsinterval") == 0)
+			statsInterval = atof(argv[i + 1]);
+		else if (strcmp(argv[i], "-metricsport") == 0)
+			metricsPort = atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "-capture") == 0)
+			capturePath = argv[i + 1];
+	}
 
-void destroyBuffer(Buffer& buffer, VkDevice device)
-{
-	vkFreeMemory(device, buffer.memory, VK_NULL_HANDLE);
-	vkDestroyBuffer(device, buffer.buffer, VK_NULL_HANDLE);
-}
+	// benchmarks and replay render offscreen; they don't initialize GLFW, so they run without a display (e.g. on lavapipe under ctest)
+	bool headless = strcmp(argv[1], "-pipelinebench") == 0 || strcmp(argv[1], "-drawbench") == 0 || strcmp(argv[1], "-cullbench") == 0 ||
+		strcmp(argv[1], "-visbench") == 0 || strcmp(argv[1], "-graphbench") == 0 || strcmp(argv[1], "-replay") == 0;
 
-int main(int argc, const char** argv)
-{
-	if (argc < 2)
+	if (!headless && !glfwInit())
 	{
+		printf("Failed to initialize GLFW\n");
 		return 1;
 	}
 
-	int rc = glfwInit();
-	assert(rc);
-
 	VK_CHECK(volkInitialize());
 
-	VkInstance instance = createInstance();
+	VkInstance instance = createInstance(!headless);
 	assert(instance);
 
 	volkLoadInstance(instance);
@@ -701,190 +579,1284 @@ int main(int argc, const char** argv)
 	uint32_t physicalDeviceCount = sizeof(physicalDevices) / sizeof(physicalDevices[0]);
 	VK_CHECK(vkEnumeratePhysicalDevices(instance, &physicalDeviceCount, physicalDevices));
 
-	VkPhysicalDevice physicalDevice = pickPhysicalDevice(physicalDevices, physicalDeviceCount);
+	VkPhysicalDevice physicalDevice = pickPhysicalDevice(instance, physicalDevices, physicalDeviceCount, !headless);
 	assert(physicalDevice);
 
-	float queueProperties[] = { 1.0f };
+	QueueFamilies queueFamilies = getQueueFamilies(physicalDevice);
 
-	uint32_t familyIndex = getGraphicsQueueFamily(physicalDevice);
+	uint32_t familyIndex = queueFamilies.graphics;
 
 	assert(familyIndex != VK_QUEUE_FAMILY_IGNORED);
 
-	VkDevice device = createDevice(queueProperties, physicalDevice, familyIndex);
+	printf("Queue families: graphics %d, compute %d%s, transfer %d%s\n", queueFamilies.graphics,
+		queueFamilies.compute, queueFamilies.compute != familyIndex ? " (async)" : "",
+		queueFamilies.transfer, queueFamilies.transfer != familyIndex ? " (dedicated)" : "");
 
-	volkLoadDevice(device);
+	bool dynamicRendering = supportsDynamicRendering(physicalDevice);
+	bool timelineSemaphores = supportsTimelineSemaphores(physicalDevice);
+	bool memoryBudget = supportsMemoryBudget(physicalDevice);
+	bool textureCompressionBC = supportsTextureCompressionBC(physicalDevice);
 
-	glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-	GLFWwindow* window = glfwCreateWindow(1024, 768, "renderer", NULL, NULL);
-	assert(window);
+	printf("Dynamic rendering: %s\n", dynamicRendering ? "yes" : "no (using render pass)");
+	printf("Timeline semaphores: %s\n", timelineSemaphores ? "yes" : "no (uploads wait on the host)");
+	printf("Memory budget: %s\n", memoryBudget ? "yes" : "no (reporting heap sizes only)");
+	printf("BC textures: %s\n", textureCompressionBC ? "yes" : "no (decoding to RGBA8)");
 
-	VkSurfaceKHR surface = createSurface(instance, window);
-	assert(surface);
+	// the benchmarks compare against paths that need device addresses, so they always ask for them
+	bool drawBench = strcmp(argv[1], "-drawbench") == 0;
+	bool cullBench = strcmp(argv[1], "-cullbench") == 0;
+	bool visBench = strcmp(argv[1], "-visbench") == 0;
+	bool replay = strcmp(argv[1], "-replay") == 0 && argc > 2;
+	bool bufferDeviceAddress = (vertexPulling || gpuCulling || visibilityShading || drawBench || cullBench || visBench || replay) && supportsBufferDeviceAddress(physicalDevice);
+	bool drawIndirectCount = gpuCulling && bufferDeviceAddress && supportsDrawIndirectCount(physicalDevice);
 
-	VkBool32 supported;
-	VK_CHECK(vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, familyIndex, surface, &supported));
-	assert(supported);
+	// the resolve pass reads the mesh through device addresses; once the device supports it, shading can be switched at runtime
+	bool visibilityBuffer = bufferDeviceAddress && supportsVisibilityBuffer(physicalDevice);
 
-	auto swapchainFormat = getSwapchainFormat(physicalDevice, surface, familyIndex);
+	printf("Buffer device address: %s\n", bufferDeviceAddress ? "yes" : "no (using vertex attributes and cpu culling)");
+	printf("Draw indirect count: %s\n", drawIndirectCount ? "yes" : "no (using cpu culling)");
+	printf("Visibility buffer: %s\n", visibilityBuffer ? "yes" : "no (using forward shading)");
 
-	VkSemaphore aquireSemaphore = createSemaphore(device);
-	assert(aquireSemaphore);
+	vertexPulling = vertexPulling && bufferDeviceAddress;
+	gpuCulling = drawIndirectCount;
 
-	VkSemaphore releaseSemaphore = createSemaphore(device);
-	assert(releaseSemaphore);
+	VkDevice device = createDevice(physicalDevice, queueFamilies, !headless, dynamicRendering, timelineSemaphores, bufferDeviceAddress, drawIndirectCount, visibilityBuffer, memoryBudget, textureCompressionBC);
 
-	VkQueue queue = 0;
-	vkGetDeviceQueue(device, familyIndex, 0, &queue);
+	volkLoadDevice(device);
 
-	VkRenderPass renderPass = createRenderPass(device, swapchainFormat.format);
-	assert(renderPass);
+	if (strcmp(argv[1], "-pipelinebench") == 0)
+	{
+		VkShaderModule vs = loadShader(device, "shaders/triangle.vert.spv");
+		VkShaderModule fs = loadShader(device, "shaders/triangle.frag.spv");
+		VkPipelineLayout layout = createPipelineLayout(device);
 
-	VkShaderModule triangleVS = loadShader(device, "shaders/triangle.vert.spv");
-	assert(triangleVS);
+		VkRenderPass benchRenderPass = dynamicRendering ? 0 : createRenderPass(device, VK_FORMAT_B8G8R8A8_UNORM);
+		RenderTargetInfo benchTarget = { benchRenderPass, VK_FORMAT_B8G8R8A8_UNORM, VK_FORMAT_UNDEFINED, VK_SAMPLE_COUNT_1_BIT };
 
-	VkShaderModule triangleFS = loadShader(device, "shaders/triangle.frag.spv");
-	assert(triangleFS);
+		bool matches = benchmarkPipelineManager(device, benchTarget, vs, fs, layout, argc > 2 ? atoi(argv[2]) : 256);
 
-	VkPipelineLayout triangleLayout = createPipelineLayout(device);
-	assert(triangleLayout);
+		if (benchRenderPass)
+			vkDestroyRenderPass(device, benchRenderPass, VK_NULL_HANDLE);
 
-	Swapchain swapchain;
-	createSwapchain(swapchain, device, physicalDevice, surface, familyIndex, swapchainFormat, renderPass);
+		vkDestroyPipelineLayout(device, layout, VK_NULL_HANDLE);
+		vkDestroyShaderModule(device, vs, VK_NULL_HANDLE);
+		vkDestroyShaderModule(device, fs, VK_NULL_HANDLE);
 
-	VkPipelineCache pipelineCache = 0;
-	VkPipeline trianglePipeline = createGraphicsPipeline(device, pipelineCache, renderPass, triangleVS, triangleFS, triangleLayout);
-	assert(trianglePipeline);
+		vkDestroyDevice(device, NULL);
+		vkDestroyInstance(instance, NULL);
+		return matches ? 0 : 1;
+	}
 
-	VkCommandPool commandPool = createCommandPool(device, familyIndex);
-	assert(commandPool);
+	if (replay)
+	{
+		VkShaderModule vs = loadShader(device, "shaders/triangle.vert.spv");
+		VkShaderModule pullVS = bufferDeviceAddress ? loadShader(device, "shaders/triangle.pull.vert.spv") : 0;
+		VkShaderModule fs = loadShader(device, "shaders/triangle.frag.spv");
+		VkPipelineLayout layout = createPipelineLayout(device);
 
-	VkCommandBufferAllocateInfo commandBufferInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
-	commandBufferInfo.commandPool = commandPool;
-	commandBufferInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-	commandBufferInfo.commandBufferCount = 1;
+		VkQueue replayQueue = 0;
+		vkGetDeviceQueue(device, familyIndex, 0, &replayQueue);
 
-	VkCommandBuffer commandBuffer = 0;
-	VK_CHECK(vkAllocateCommandBuffers(device, &commandBufferInfo, &commandBuffer));
+		VkPhysicalDeviceMemoryProperties replayMemoryProps;
+		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &replayMemoryProps);
 
-	VkPhysicalDeviceMemoryProperties memoryProps;
-	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProps);
+		VkPhysicalDeviceProperties replayProps;
+		vkGetPhysicalDeviceProperties(physicalDevice, &replayProps);
 
-	Mesh mesh;
-	bool rcm = loadMesh(mesh, argv[1]);
+		VkRenderPass replayRenderPass = dynamicRendering ? 0 : createRenderPass(device, VK_FORMAT_B8G8R8A8_UNORM);
+		RenderTargetInfo replayTarget = { replayRenderPass, VK_FORMAT_B8G8R8A8_UNORM, VK_FORMAT_UNDEFINED, VK_SAMPLE_COUNT_1_BIT };
 
-	Buffer vb = {};
-	createBuffer(vb, device, memoryProps, 128 * 1024 * 1024, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
-	Buffer ib = {};
-	createBuffer(ib, device, memoryProps, 128 * 1024 * 1024, VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+		bool replayed = replayCapture(device, replayMemoryProps, replayQueue, familyIndex, replayProps.limits.timestampPeriod, replayTarget,
+			vs, pullVS, fs, layout, argv[2], argc > 3 ? atoi(argv[3]) : 1);
 
-	assert(vb.size >= mesh.vertices.size() * sizeof(Vertex));
-	memcpy(vb.data, mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex));
+		if (replayRenderPass)
+			vkDestroyRenderPass(device, replayRenderPass, VK_NULL_HANDLE);
 
-	assert(ib.size >= mesh.indices.size() * sizeof(uint32_t));
-	memcpy(ib.data, mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t));
+		vkDestroyPipelineLayout(device, layout, VK_NULL_HANDLE);
+		vkDestroyShaderModule(device, vs, VK_NULL_HANDLE);
+		if (pullVS)
+			vkDestroyShaderModule(device, pullVS, VK_NULL_HANDLE);
+		vkDestroyShaderModule(device, fs, VK_NULL_HANDLE);
 
-	while (!glfwWindowShouldClose(window)) {
-		glfwPollEvents();
+		vkDestroyDevice(device, NULL);
+		vkDestroyInstance(instance, NULL);
+		return replayed ? 0 : 1;
+	}
 
-		resizeSwapchain(swapchain, device, physicalDevice, surface, familyIndex, swapchainFormat, renderPass);
+	if (drawBench)
+	{
+		VkShaderModule vs = loadShader(device, "shaders/triangle.vert.spv");
+		VkShaderModule pullVS = bufferDeviceAddress ? loadShader(device, "shaders/triangle.pull.vert.spv") : 0;
+		VkShaderModule fs = loadShader(device, "shaders/triangle.frag.spv");
+		VkPipelineLayout layout = createPipelineLayout(device);
 
+		VkQueue benchQueue = 0;
+		vkGetDeviceQueue(device, familyIndex, 0, &benchQueue);
 
-		uint32_t imageIndex = 0;
-		VK_CHECK(vkAcquireNextImageKHR(device, swapchain.swapchain, ~0ull, aquireSemaphore, VK_NULL_HANDLE, &imageIndex));
+		VkPhysicalDeviceMemoryProperties benchMemoryProps;
+		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &benchMemoryProps);
 
-		VK_CHECK(vkResetCommandPool(device, commandPool, 0));
+		VkRenderPass benchRenderPass = dynamicRendering ? 0 : createRenderPass(device, VK_FORMAT_R8G8B8A8_UNORM);
+		RenderTargetInfo benchTarget = { benchRenderPass, VK_FORMAT_R8G8B8A8_UNORM, VK_FORMAT_UNDEFINED, VK_SAMPLE_COUNT_1_BIT };
 
-		VkCommandBufferBeginInfo beginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
-		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		bool matches = benchmarkDraws(device, benchMemoryProps, benchQueue, familyIndex, benchTarget, vs, pullVS, fs, layout, argc > 2 ? atoi(argv[2]) : 4096);
 
-		VK_CHECK(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+		if (benchRenderPass)
+			vkDestroyRenderPass(device, benchRenderPass, VK_NULL_HANDLE);
 
-		VkImageMemoryBarrier renderBeginBarrier = imageBarrier(swapchain.images[imageIndex], 0, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
-		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_DEPENDENCY_BY_REGION_BIT, 0, 0, 0, 0, 1, &renderBeginBarrier);
+		vkDestroyPipelineLayout(device, layout, VK_NULL_HANDLE);
+		vkDestroyShaderModule(device, vs, VK_NULL_HANDLE);
+		if (pullVS)
+			vkDestroyShaderModule(device, pullVS, VK_NULL_HANDLE);
+		vkDestroyShaderModule(device, fs, VK_NULL_HANDLE);
 
-		VkClearColorValue color = { 48.f / 255.f, 10.f / 255.f, 36.f / 255.f, 1 };
-		VkClearValue clearColor = { color };
+		vkDestroyDevice(device, NULL);
+		vkDestroyInstance(instance, NULL);
+		return matches ? 0 : 1;
+	}
 
-		VkRenderPassBeginInfo passBeginInfo = { VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO };
-		passBeginInfo.renderPass = renderPass;
-		passBeginInfo.framebuffer = swapchain.framebuffers[imageIndex];
-		passBeginInfo.renderArea.extent.width = swapchain.width;
-		passBeginInfo.renderArea.extent.height = swapchain.height;
-		passBeginInfo.clearValueCount = 1;
-		passBeginInfo.pClearValues = &clearColor;
+	if (cullBench)
+	{
+		if (!bufferDeviceAddress)
+		{
+			printf("Culling benchmark needs buffer device addresses\n");
+			return 1;
+		}
 
-		vkCmdBeginRenderPass(commandBuffer, &passBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		VkShaderModule cs = loadShader(device, "shaders/drawcull.comp.spv");
 
-		VkViewport viewport = { 0, float(swapchain.height), float(swapchain.width), -float(swapchain.height), 0, 1 };
-		VkRect2D scissor = { {0, 0}, {uint32_t(swapchain.width), uint32_t(swapchain.height)} };
+		VkQueue benchQueue = 0;
+		vkGetDeviceQueue(device, familyIndex, 0, &benchQueue);
 
-		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
-		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+		VkPhysicalDeviceMemoryProperties benchMemoryProps;
+		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &benchMemoryProps);
 
-		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, trianglePipeline);
+		VkPhysicalDeviceProperties benchProps;
+		vkGetPhysicalDeviceProperties(physicalDevice, &benchProps);
 
-		VkDeviceSize offset = 0;
-		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vb.buffer, &offset);
-		vkCmdBindIndexBuffer(commandBuffer, ib.buffer, 0, VK_INDEX_TYPE_UINT32);
-		vkCmdDrawIndexed(commandBuffer, mesh.indices.size(), 1, 0, 0, 0);
+		bool matches = benchmarkCulling(device, benchMemoryProps, benchQueue, familyIndex, benchProps.limits.timestampPeriod, cs, argc > 2 ? atoi(argv[2]) : 100000);
 
-		//vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+		vkDestroyShaderModule(device, cs, VK_NULL_HANDLE);
 
-		vkCmdEndRenderPass(commandBuffer);
+		vkDestroyDevice(device, NULL);
+		vkDestroyInstance(instance, NULL);
+		return matches ? 0 : 1;
+	}
 
-		VkImageMemoryBarrier renderEndBarrier = imageBarrier(swapchain.images[imageIndex], VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
-		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_DEPENDENCY_BY_REGION_BIT, 0, 0, 0, 0, 1, &renderEndBarrier);
+	if (visBench)
+	{
+		if (!visibilityBuffer)
+		{
+			printf("Visibility benchmark needs buffer device addresses, geometryShader and shaderStorageImageExtendedFormats\n");
+			return 1;
+		}
 
-		VK_CHECK(vkEndCommandBuffer(commandBuffer));
+		VkShaderModule vs = loadShader(device, "shaders/triangle.vert.spv");
+		VkShaderModule fs = loadShader(device, "shaders/triangle.frag.spv");
+		VkShaderModule visibilityFS = loadShader(device, "shaders/visibility.frag.spv");
+		VkShaderModule resolveVS = loadShader(device, "shaders/resolve.vert.spv");
+		VkShaderModule resolveFS = loadShader(device, "shaders/resolve.frag.spv");
+		VkPipelineLayout layout = createPipelineLayout(device);
 
-		VkPipelineStageFlags submitStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		VkQueue benchQueue = 0;
+		vkGetDeviceQueue(device, familyIndex, 0, &benchQueue);
 
-		VkSubmitInfo submitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
-		submitInfo.waitSemaphoreCount = 1;
-		submitInfo.pWaitSemaphores = &aquireSemaphore;
-		submitInfo.pWaitDstStageMask = &submitStageMask;
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &commandBuffer;
-		submitInfo.signalSemaphoreCount = 1;
-		submitInfo.pSignalSemaphores = &releaseSemaphore;
+		VkPhysicalDeviceMemoryProperties benchMemoryProps;
+		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &benchMemoryProps);
 
-		VK_CHECK(vkQueueSubmit(queue, 1, &submitInfo, NULL));
+		VkPhysicalDeviceProperties benchProps;
+		vkGetPhysicalDeviceProperties(physicalDevice, &benchProps);
 
-		VkPresentInfoKHR presentInfo = { VK_STRUCTURE_TYPE_PRESENT_INFO_KHR };
-		presentInfo.waitSemaphoreCount = 1;
-		presentInfo.pWaitSemaphores = &releaseSemaphore;
-		presentInfo.swapchainCount = 1;
-		presentInfo.pSwapchains = &swapchain.swapchain;
-		presentInfo.pImageIndices = &imageIndex;
+		bool matches = benchmarkVisibility(device, benchMemoryProps, benchQueue, familyIndex, benchProps.limits.timestampPeriod, dynamicRendering,
+			vs, fs, visibilityFS, resolveVS, resolveFS, layout, argc > 2 ? atoi(argv[2]) : 512);
 
-		VK_CHECK(vkQueuePresentKHR(queue, &presentInfo));
+		vkDestroyPipelineLayout(device, layout, VK_NULL_HANDLE);
+		vkDestroyShaderModule(device, vs, VK_NULL_HANDLE);
+		vkDestroyShaderModule(device, fs, VK_NULL_HANDLE);
+		vkDestroyShaderModule(device, visibilityFS, VK_NULL_HANDLE);
+		vkDestroyShaderModule(device, resolveVS, VK_NULL_HANDLE);
+		vkDestroyShaderModule(device, resolveFS, VK_NULL_HANDLE);
 
-		VK_CHECK(vkDeviceWaitIdle(device));
+		vkDestroyDevice(device, NULL);
+		vkDestroyInstance(instance, NULL);
+		return matches ? 0 : 1;
 	}
 
-	VK_CHECK(vkDeviceWaitIdle(device));
-
-	destroyBuffer(vb, device);
-	destroyBuffer(ib, device);
+	if (strcmp(argv[1], "-graphbench") == 0)
+	{
+		VkQueue benchQueue = 0;
+		vkGetDeviceQueue(device, familyIndex, 0, &benchQueue);
 
-	glfwDestroyWindow(window);
-	vkDestroyCommandPool(device, commandPool, NULL);
+		VkPhysicalDeviceMemoryProperties benchMemoryProps;
+		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &benchMemoryProps);
 
-	destroySwapchain(swapchain, device);
+		bool matches = benchmarkRenderGraph(device, benchMemoryProps, benchQueue, familyIndex, argc > 2 ? atoi(argv[2]) : 8);
 
-	PFN_vkDestroyDebugReportCallbackEXT vkDestroyDebugReportCallbackEXT = (PFN_vkDestroyDebugReportCallbackEXT)vkGetInstanceProcAddr(instance, "vkDestroyDebugReportCallbackEXT");
-	vkDestroyDebugReportCallbackEXT(instance, debugCallback, VK_NULL_HANDLE);
+		vkDestroyDevice(device, NULL);
+		vkDestroyInstance(instance, NULL);
+		return matches ? 0 : 1;
+	}
 
-	vkDestroySemaphore(device, releaseSemaphore, NULL);
-	vkDestroySemaphore(device, aquireSemaphore, NULL);
+	glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+	GLFWwindow* window = glfwCreateWindow(1024, 768, "renderer", NULL, NULL);
+	assert(window);
+
+	glfwSetKeyCallback(window, keyCallback);
+	glfwSetFramebufferSizeCallback(window, framebufferSizeCallback);
+
+	VkSurfaceKHR surface = createSurface(instance, window);
+	assert(surface);
+
+	VkBool32 supported;
+	VK_CHECK(vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, familyIndex, surface, &supported));
+	assert(supported);
+
+	auto swapchainFormat = getSwapchainFormat(physicalDevice, surface, familyIndex);
+
+	VkPhysicalDeviceProperties props;
+	vkGetPhysicalDeviceProperties(physicalDevice, &props);
+
+	VkQueue queue = 0;
+	vkGetDeviceQueue(device, familyIndex, 0, &queue);
+
+	VkQueue transferQueue = 0;
+	vkGetDeviceQueue(device, queueFamilies.transfer, 0, &transferQueue);
+
+	// the requested count is rounded down to one that both color and depth framebuffers support; depth is a transient
+	// attachment at the same sample count, so it costs no memory traffic on tiled GPUs with or without MSAA
+	swapchainSettings.samples = getSampleCount(physicalDevice, msaaSamples);
+	swapchainSettings.depthFormat = VK_FORMAT_D32_SFLOAT;
+
+	VkRenderPass renderPass = dynamicRendering ? 0 : createRenderPass(device, swapchainFormat.format, swapchainSettings.samples, swapchainSettings.depthFormat);
+	assert(renderPass || dynamicRendering);
+
+	RenderTargetInfo renderTarget = { renderPass, swapchainFormat.format, swapchainSettings.depthFormat, swapchainSettings.samples };
+
+	Shader triangleVS;
+	bool rcs = loadShader(triangleVS, device, "triangle.vert");
+	assert(rcs);
+	(void)rcs; // shaders are only checked in debug builds, like VK_CHECK results
+
+	// the renderer samples material textures; benchmarks and replay keep the untextured triangle.frag
+	Shader triangleFS;
+	rcs = loadShader(triangleFS, device, "triangle.tex.frag");
+	assert(rcs);
+
+	// pulled vertices only change the vertex shader; the fragment shader is shared
+	Shader trianglePullVS = {};
+
+	if (vertexPulling)
+	{
+		rcs = loadShader(trianglePullVS, device, "triangle.pull.vert");
+		assert(rcs);
+	}
+
+	uint32_t vertexInput = vertexPulling ? VertexInputPulled : VertexInputAttributes;
+	VkShaderModule vertexShader = vertexPulling ? trianglePullVS.module : triangleVS.module;
+
+	VkDescriptorSetLayout materialSetLayout = createMaterialSetLayout(device);
+	assert(materialSetLayout);
+
+	VkPipelineLayout triangleLayout = createPipelineLayout(device, materialSetLayout);
+	assert(triangleLayout);
+
+	int windowWidth = 0, windowHeight = 0;
+	glfwGetFramebufferSize(window, &windowWidth, &windowHeight);
+
+	Swapchain swapchain;
+	createSwapchain(swapchain, device, physicalDevice, surface, uint32_t(windowWidth), uint32_t(windowHeight), familyIndex, swapchainFormat, renderPass, swapchainSettings);
+
+	printf("Swapchain: %d images, present mode %s\n", swapchain.imageCount, getPresentModeName(swapchain.presentMode));
+
+	if (msaaSamples > 1)
+	{
+		VkSampleCountFlags sampleCounts = props.limits.framebufferColorSampleCounts & props.limits.framebufferDepthSampleCounts;
+
+		// transient color and depth for every supported count at the current size; lazily allocated memory may never be committed
+		for (uint32_t samples = 2; samples <= VK_SAMPLE_COUNT_64_BIT; samples *= 2)
+		{
+			if ((sampleCounts & samples) == 0)
+				continue;
+
+			VkImageUsageFlags transient = VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+
+			VkDeviceSize colorSize = getImageMemorySize(device, swapchain.width, swapchain.height, swapchainFormat.format, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | transient, VkSampleCountFlagBits(samples));
+			VkDeviceSize depthSize = getImageMemorySize(device, swapchain.width, swapchain.height, VK_FORMAT_D32_SFLOAT, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | transient, VkSampleCountFlagBits(samples));
+
+			printf("MSAA %2dx: %.2f MB color + %.2f MB depth at %dx%d%s\n", samples, double(colorSize) / 1e6, double(depthSize) / 1e6, swapchain.width, swapchain.height,
+				samples == uint32_t(swapchain.samples) ? " (selected)" : "");
+		}
+
+		printf("MSAA attachments: %s\n", swapchain.color.lazilyAllocated ? "transient, lazily allocated" : "transient, device local (no lazily allocated memory type)");
+	}
+
+	// every graphics submission signals the next value; objects that submitted work may reference are destroyed once it passes them
+	Timeline frameTimeline;
+	createTimeline(frameTimeline, device, timelineSemaphores);
+
+	DeletionQueue deletionQueue;
+	createDeletionQueue(deletionQueue, destroyDeviceObject, device);
+
+	// .mesh files are only opened here; they are decoded straight into upload memory once the buffers exist
+	Mesh mesh;
+	MeshFile meshFile = {};
+
+	bool scene = isSceneSpec(argv[1]);
+	bool rcm = true;
+
+	if (scene)
+	{
+		SceneSettings sceneSettings;
+		if (!parseSceneSettings(sceneSettings, argv[1]))
+		{
+			printf("Invalid scene spec %s\n", argv[1]);
+			return 1;
+		}
+
+		double generateStart = getTimeMs();
+		generateScene(mesh, sceneSettings);
+
+		printf("Generated %d triangles, %d vertices, %d instances in %.2f ms\n", int(mesh.indices.size() / 3), int(mesh.vertices.size()), int(mesh.submeshes.size()),
+			getTimeMs() - generateStart);
+	}
+	else
+		rcm = isMeshFile(argv[1]) ? openMeshFile(meshFile, argv[1]) && meshFile.header->vertexSize == sizeof(Vertex) : loadMesh(mesh, argv[1]);
+
+	if (!rcm)
+	{
+		printf("Failed to load %s\n", argv[1]);
+		return 1;
+	}
+
+	// replaces normals from the file (or the ones generated on load) with normals smoothed up to the given angle
+	if (smoothingAngle >= 0 && !meshFile.header)
+	{
+		NormalSettings normalSettings = { smoothingAngle, NormalWeightAngle };
+
+		double normalsStart = getTimeMs();
+		generateNormals(mesh, normalSettings, std::thread::hardware_concurrency());
+
+		printf("Generated normals (%.0f degrees) in %.2f ms, %d vertices\n", smoothingAngle, getTimeMs() - normalsStart, int(mesh.vertices.size()));
+	}
+
+	bool hasNormals = meshFile.header ? (meshFile.header->flags & MeshFileHasNormals) != 0 : mesh.hasNormals;
+	uint32_t vertexCount = meshFile.header ? meshFile.header->vertexCount : uint32_t(mesh.vertices.size());
+	uint32_t indexCount = meshFile.header ? meshFile.header->indexCount : uint32_t(mesh.indices.size());
+
+	// .mesh files don't store submeshes
+	if (meshFile.header)
+		setSingleSubmesh(mesh, indexCount);
+
+	// meshes that don't fit the static buffers are split into chunks that are paged in around the camera
+	bool streaming = streamBudget > 0 || vertexCount * sizeof(Vertex) > kMeshBufferSize || indexCount * sizeof(uint32_t) > kMeshBufferSize;
+
+	StreamingMesh streamingMesh = {};
+
+	if (streaming)
+	{
+		if (meshFile.header)
+		{
+			mesh.vertices.resize(vertexCount);
+			mesh.indices.resize(indexCount);
+			mesh.hasNormals = hasNormals;
+
+			rcm = decodeMeshFile(meshFile, mesh.vertices.data(), mesh.indices.data(), sizeof(uint32_t), std::thread::hardware_concurrency());
+
+			closeMeshFile(meshFile);
+
+			// the header was validated on open, so this is a truncated or corrupted stream
+			if (!rcm)
+			{
+				printf("Failed to decode %s\n", argv[1]);
+				return 1;
+			}
+		}
+
+		buildStreamingMesh(streamingMesh, mesh, kStreamChunkTriangles);
+
+		// chunks keep their own copy of the source data in system memory
+		mesh = Mesh();
+
+		streamBudget = streamBudget ? streamBudget : kMeshBufferSize;
+
+		printf("Streaming: %d chunks, %.2f KB per slot, %.2f MB budget\n", int(streamingMesh.chunks.size()), double(streamingMesh.slotSize) / 1024, double(streamBudget) / (1024 * 1024));
+	}
+	else
+	{
+		size_t submeshCount = mesh.submeshes.size();
+
+		// .mesh files are decoded straight to 16-bit indices when all of them fit; other meshes are split into 16-bit batches
+		if (meshFile.header)
+			mesh.indexSize = vertexCount <= 65536 ? sizeof(uint16_t) : sizeof(uint32_t);
+		else
+			selectIndexSize(mesh);
+
+		printf("Indices: %d-bit, %d batches from %d submeshes, %.2f MB (%.2f MB with 32-bit indices)\n", mesh.indexSize * 8, int(mesh.submeshes.size()), int(submeshCount),
+			double(indexCount) * mesh.indexSize / 1e6, double(indexCount) * sizeof(uint32_t) / 1e6);
+	}
+
+	// streamed chunks are culled by residency instead
+	gpuCulling = gpuCulling && !streaming;
+
+	DrawList drawList;
+
+	if (!streaming)
+	{
+		buildDrawList(drawList, mesh);
+
+		printf("Culling: %s, %d draw batches\n", gpuCulling ? "gpu" : "cpu", int(drawList.batches.size()));
+	}
+
+	Shader cullCS = {};
+
+	if (gpuCulling)
+	{
+		rcs = loadShader(cullCS, device, "drawcull.comp");
+		assert(rcs);
+	}
+
+	// the resolve pass fetches triangles through draw records, which streamed chunks don't have
+	visibilityAvailable = visibilityBuffer && !streaming;
+	visibilityShading = visibilityShading && visibilityAvailable;
+
+	printf("Shading: %s%s\n", visibilityShading ? "visibility" : "forward", visibilityAvailable ? " (V toggles)" : "");
+
+	Shader visibilityFS = {};
+	Shader resolveVS = {};
+	Shader resolveFS = {};
+
+	if (visibilityAvailable)
+	{
+		rcs = loadShader(visibilityFS, device, "visibility.frag");
+		assert(rcs);
+		rcs = loadShader(resolveVS, device, "resolve.vert");
+		assert(rcs);
+		rcs = loadShader(resolveFS, device, "resolve.frag");
+		assert(rcs);
+	}
+
+	// every vertex format/lighting mode combination is compiled in the background; draws use the fallback until then
+	PipelineVariant triangleVariants[VertexFormatCount * LightingModeCount] = {};
+	for (uint32_t i = 0; i < VertexFormatCount; i++)
+	{
+		for (uint32_t j = 0; j < LightingModeCount; j++)
+		{
+			triangleVariants[i * LightingModeCount + j].vertexFormat = i;
+			triangleVariants[i * LightingModeCount + j].lightingMode = j;
+			triangleVariants[i * LightingModeCount + j].vertexInput = vertexInput;
+		}
+	}
+
+	VkPipelineCache pipelineCache = createPipelineCache(device);
+	assert(pipelineCache);
+
+	// the unlit variant is cheap to compile and stands in for any variant that isn't ready yet
+	PipelineVariant fallbackVariant = { hasNormals ? VertexFormatFull : VertexFormatNoNormals, LightingModeUnlit, vertexInput };
+	VkPipeline fallbackPipeline = createGraphicsPipeline(device, pipelineCache, renderTarget, vertexShader, triangleFS.module, triangleLayout, fallbackVariant);
+	assert(fallbackPipeline);
+
+	uint32_t pipelineThreads = std::thread::hardware_concurrency();
+	pipelineThreads = pipelineThreads > 1 ? pipelineThreads - 1 : 1;
+
+	PipelineManager pipelineManager;
+	// visibility shading adds one geometry pass pipeline and a resolve pipeline per variant
+	createPipelineManager(pipelineManager, device, pipelineCache, pipelineThreads, ARRAYSIZE(triangleVariants) * 2 + 1);
+
+	uint32_t trianglePipelines[ARRAYSIZE(triangleVariants)] = {};
+	for (size_t i = 0; i < ARRAYSIZE(triangleVariants); i++)
+	{
+		PipelineRequest request = { renderTarget, vertexShader, triangleFS.module, triangleLayout, triangleVariants[i] };
+		trianglePipelines[i] = requestPipeline(pipelineManager, request);
+	}
+
+	FramePacer pacer;
+	initFramePacer(pacer, targetFrameRate, maxQueuedFrames);
+
+	printf("Frame pacing: %s, up to %d queued frames\n", targetFrameRate > 0 ? "capped" : "uncapped", pacer.maxQueuedFrames);
+
+	Frame frames[kMaxFramesInFlight] = {};
+
+	// declared again every frame, as the passes depend on the shading mode and the images on the acquired image
+	RenderGraph frameGraph = {};
+
+	for (uint32_t i = 0; i < pacer.maxQueuedFrames; i++)
+	{
+		frames[i].commandPool = createCommandPool(device, familyIndex);
+		assert(frames[i].commandPool);
+
+		VkCommandBufferAllocateInfo commandBufferInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
+		commandBufferInfo.commandPool = frames[i].commandPool;
+		commandBufferInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		commandBufferInfo.commandBufferCount = 1;
+
+		VK_CHECK(vkAllocateCommandBuffers(device, &commandBufferInfo, &frames[i].commandBuffer));
+
+		frames[i].acquireSemaphore = createSemaphore(device);
+		assert(frames[i].acquireSemaphore);
+
+		frames[i].fence = createFence(device, true);
+		assert(frames[i].fence);
+	}
+
+	// two timestamps per frame slot bracket the GPU work of the frame
+	VkQueryPool queryPool = createQueryPool(device, kMaxFramesInFlight * 2);
+	assert(queryPool);
+
+	VkPhysicalDeviceMemoryProperties memoryProps;
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProps);
+
+	Uploader uploader;
+	createUploader(uploader, device, memoryProps, transferQueue, queueFamilies.transfer, familyIndex, timelineSemaphores, 32 * 1024 * 1024);
+
+	Buffer vb = {};
+	Buffer ib = {};
+
+	Streamer streamer = {};
+
+	if (streaming)
+		createStreamer(streamer, device, memoryProps, transferQueue, queueFamilies.transfer, familyIndex, timelineSemaphores, streamingMesh, streamBudget, vertexPulling);
+	else
+	{
+		// the resolve pass reads vertices and indices through device addresses as well
+		VkBufferUsageFlags vertexUsage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | (vertexPulling || visibilityAvailable ? VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT_KHR : 0);
+		VkBufferUsageFlags indexUsage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | (visibilityAvailable ? VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT_KHR : 0);
+
+		createBuffer(vb, device, memoryProps, kMeshBufferSize, vertexUsage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		createBuffer(ib, device, memoryProps, kMeshBufferSize, indexUsage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	}
+
+	// copies run on the transfer queue; the first frame acquires the buffers and waits for the copies on the GPU
+	// a streamed .mesh file was already decoded and closed, and streamed chunks are uploaded by the streamer
+	if (meshFile.header)
+	{
+		Buffer vertexStaging = {};
+		createBuffer(vertexStaging, device, memoryProps, vertexCount * sizeof(Vertex), VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		Buffer indexStaging = {};
+		createBuffer(indexStaging, device, memoryProps, indexCount * mesh.indexSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+		// the decoders write sequentially, which is fine for write combined memory; no intermediate copy is made
+		double decodeStart = getTimeMs();
+
+		rcm = decodeMeshFile(meshFile, vertexStaging.data, indexStaging.data, mesh.indexSize, std::thread::hardware_concurrency());
+
+		closeMeshFile(meshFile);
+
+		if (!rcm)
+		{
+			printf("Failed to decode %s\n", argv[1]);
+
+			destroyBuffer(indexStaging, device);
+			destroyBuffer(vertexStaging, device);
+			return 1;
+		}
+
+		printf("Decoded %s in %.2f ms\n", argv[1], getTimeMs() - decodeStart);
+
+		uploadBuffer(uploader, vb, vertexStaging, vertexStaging.size);
+		uploadBuffer(uploader, ib, indexStaging, indexStaging.size);
+
+		// the first frame waits for the uploads, so staging memory is free once it completes
+		deferDestroyBuffer(deletionQueue, frameTimeline.submitted + 1, vertexStaging);
+		deferDestroyBuffer(deletionQueue, frameTimeline.submitted + 1, indexStaging);
+	}
+	else if (!streaming)
+	{
+		uploadBuffer(uploader, vb, mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex));
+
+		if (mesh.indexSize == sizeof(uint16_t))
+		{
+			std::vector<uint16_t> indices16(mesh.indices.begin(), mesh.indices.end());
+			uploadBuffer(uploader, ib, indices16.data(), indices16.size() * sizeof(uint16_t));
+		}
+		else
+			uploadBuffer(uploader, ib, mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t));
+	}
+
+	// streamed chunks don't keep materials, so they only get the default set
+	MaterialTextures materialTextures = {};
+	createMaterialTextures(materialTextures, device, memoryProps, uploader, materialSetLayout, mesh, argv[1], textureCompressionBC);
+
+	DrawCuller culler = {};
+
+	if (gpuCulling)
+	{
+		createDrawCuller(culler, device, memoryProps, pipelineCache, cullCS.module, uploader, drawList);
+
+		for (uint32_t i = 0; i < pacer.maxQueuedFrames; i++)
+			createBuffer(frames[i].cullReadback, device, memoryProps, culler.commands.size + culler.counts.size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	}
+
+	VisibilityBuffer visibility = {};
+
+	VkPipeline visibilityFallbackPipeline = 0;
+	VkPipeline resolveFallbackPipeline = 0;
+
+	uint32_t visibilityPipeline = 0;
+	uint32_t resolvePipelines[ARRAYSIZE(triangleVariants)] = {};
+
+	if (visibilityAvailable)
+	{
+		createVisibilityBuffer(visibility, device, memoryProps, dynamicRendering, uploader, drawList, mesh, swapchain.width, swapchain.height);
+
+		// the geometry pass only writes ids, so lighting doesn't matter for it
+		PipelineVariant geometryVariant = fallbackVariant;
+		PipelineRequest geometryRequest = { visibility.target, vertexShader, visibilityFS.module, triangleLayout, geometryVariant };
+
+		visibilityFallbackPipeline = createGraphicsPipeline(device, pipelineCache, visibility.target, vertexShader, visibilityFS.module, triangleLayout, geometryVariant);
+		assert(visibilityFallbackPipeline);
+
+		visibilityPipeline = requestPipeline(pipelineManager, geometryRequest);
+
+		// the resolve has no vertex input; its specialization matches the forward variants
+		PipelineVariant resolveFallbackVariant = fallbackVariant;
+		resolveFallbackVariant.vertexInput = VertexInputPulled;
+
+		resolveFallbackPipeline = createGraphicsPipeline(device, pipelineCache, renderTarget, resolveVS.module, resolveFS.module, visibility.resolveLayout, resolveFallbackVariant);
+		assert(resolveFallbackPipeline);
+
+		for (size_t i = 0; i < ARRAYSIZE(triangleVariants); i++)
+		{
+			PipelineRequest request = { renderTarget, resolveVS.module, resolveFS.module, visibility.resolveLayout, triangleVariants[i] };
+			request.variant.vertexInput = VertexInputPulled;
+
+			resolvePipelines[i] = requestPipeline(pipelineManager, request);
+		}
+	}
+
+	// commands and per-batch counts written by cullDraws when culling on the cpu
+	std::vector<DrawCommand> drawCommands(drawList.records.size());
+	std::vector<uint32_t> drawCounts(drawList.batches.size());
+
+	// gpu culling results come back once a frame slot is reused, so they are a few frames old
+	uint32_t culledSubmeshes = 0;
+	uint64_t culledTriangles = 0;
+
+	// pulled vertices are read from this address instead of a vertex buffer binding; the streamer keeps all chunks in its pool
+	uint64_t vertexAddress = vertexPulling ? getBufferAddress(device, streaming ? streamer.pool : vb) : 0;
+
+	std::vector<VkShaderModule> retiredShaders;
+
+	// matches the fixed offset the vertex shader used to apply before there was a camera; generated scenes are centered
+	float camera[3] = { 0.f, scene ? 0.f : 0.95f, -0.5f };
+
+	// streamed chunks live at pool slots that depend on load timing, so only static buffers can be captured
+	CaptureWriter captureWriter = {};
+	std::vector<CaptureDraw> captureDraws;
+
+	if (capturePath && streaming)
+		printf("Capture is not supported when streaming\n");
+	else if (capturePath)
+	{
+		CaptureHeader captureHeader = {};
+		strncpy(captureHeader.source, argv[1], sizeof(captureHeader.source) - 1);
+		captureHeader.smoothingAngle = meshFile.header ? -1.f : smoothingAngle;
+		captureHeader.vertexCount = vertexCount;
+		captureHeader.indexCount = indexCount;
+		captureHeader.indexSize = mesh.indexSize;
+		captureHeader.submeshCount = uint32_t(mesh.submeshes.size());
+
+		if (!openCapture(captureWriter, capturePath, captureHeader))
+			printf("Failed to create %s\n", capturePath);
+	}
+
+	Stats stats;
+	initStats(stats);
+
+	stats.memoryBudget = memoryBudget;
+	updateHeapStats(stats, physicalDevice);
+
+	StatsExporter statsExporter;
+	initStatsExporter(statsExporter);
+
+	if (statsPath && !openStatsFile(statsExporter, statsPath, statsInterval))
+		printf("Failed to create %s\n", statsPath);
+
+	// loopback only; the endpoint is meant for a local scraper during soak runs
+	if (metricsPort && !listenStats(statsExporter, uint16_t(metricsPort)))
+		printf("Failed to listen on port %d\n", metricsPort);
+
+	double lastFrameTime = getTimeMs();
+	double statsStart = lastFrameTime;
+
+	// budgets change as other processes allocate, but querying them every frame is wasteful
+	double nextHeapUpdate = 0;
+
+	while (!glfwWindowShouldClose(window)) {
+		// input is sampled after the pacer wait, as close to the GPU picking the frame up as possible
+		waitFrame(pacer);
+
+		glfwPollEvents();
+
+		double frameTime = getTimeMs();
+		float cameraStep = float(frameTime - lastFrameTime) * kCameraSpeed;
+
+		if (stats.frames)
+			addSample(stats.frameTime, frameTime - lastFrameTime);
+
+		lastFrameTime = frameTime;
+
+		camera[0] += cameraStep * float((glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) - (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS));
+		camera[1] += cameraStep * float((glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS) - (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS));
+		camera[2] += cameraStep * float((glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) - (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS));
+
+		uint32_t frameSlot = frameTimeline.submitted % pacer.maxQueuedFrames;
+		Frame& frame = frames[frameSlot];
+
+		// the slot's command pool and acquire semaphore are reused, so its last frame has to be done
+		if (frameTimeline.semaphore)
+			waitTimeline(frameTimeline, frame.index);
+		else
+		{
+			VK_CHECK(vkWaitForFences(device, 1, &frame.fence, VK_TRUE, ~0ull));
+
+			// frames complete in submission order, so this slot's fence covers every frame up to its last one
+			markTimelineCompleted(frameTimeline, frame.index);
+		}
+
+		if (frame.index)
+		{
+			uint64_t timestamps[2] = {};
+			VK_CHECK(vkGetQueryPoolResults(device, queryPool, frameSlot * 2, 2, sizeof(timestamps), timestamps, sizeof(timestamps[0]), VK_QUERY_RESULT_64_BIT));
+
+			double gpuTime = double(timestamps[1] - timestamps[0]) * props.limits.timestampPeriod * 1e-6;
+
+			updateGpuTime(pacer, gpuTime);
+			addSample(stats.gpuTime, gpuTime);
+		}
+
+		if (frame.index && gpuCulling)
+		{
+			const DrawCommand* commands = static_cast<const DrawCommand*>(frame.cullReadback.data);
+			const uint32_t* counts = reinterpret_cast<const uint32_t*>(static_cast<const char*>(frame.cullReadback.data) + culler.commands.size);
+
+			culledSubmeshes = countDraws(culledTriangles, commands, counts, drawList);
+		}
+
+		flushDeletionQueue(deletionQueue, getTimelineCompleted(frameTimeline));
+
+		// the frame about to be recorded won't use pipelines retired so far, but earlier frames may
+		retirePipelines(pipelineManager, deletionQueue, frameTimeline.submitted + 1);
+
+		if (streaming)
+			updateStreamer(streamer, streamingMesh, camera, frameTimeline.submitted + 1, getTimelineCompleted(frameTimeline));
+
+		Shader* triangleShaders[] = { &triangleVS, &triangleFS, &trianglePullVS, &visibilityFS, &resolveVS, &resolveFS };
 
-	vkDestroyShaderModule(device, triangleVS, VK_NULL_HANDLE);
-	vkDestroyShaderModule(device, triangleFS, VK_NULL_HANDLE);
+		for (size_t i = 0; i < ARRAYSIZE(triangleShaders); i++)
+		{
+			if (!triangleShaders[i]->module)
+				continue;
+
+			VkShaderModule oldModule = 0;
+
+			if (reloadShader(*triangleShaders[i], device, oldModule))
+			{
+				uint32_t affected = replaceShaderModule(pipelineManager, oldModule, triangleShaders[i]->module);
+				printf("Rebuilding %d pipelines\n", affected);
+
+				retiredShaders.push_back(oldModule);
+			}
+		}
+
+		// old modules can go once no compile that references them is pending
+		PipelineStats reloadStats = getPipelineStats(pipelineManager);
+
+		if (!retiredShaders.empty() && reloadStats.compiled == reloadStats.requested)
+		{
+			for (size_t i = 0; i < retiredShaders.size(); i++)
+				vkDestroyShaderModule(device, retiredShaders[i], VK_NULL_HANDLE);
+
+			retiredShaders.clear();
+		}
+
+		if (swapchainDirty)
+		{
+			glfwGetFramebufferSize(window, &windowWidth, &windowHeight);
+
+			// frames in flight may still present to the old swapchain, so it is kept until the next frame completes
+			if (!resizeSwapchain(swapchain, deletionQueue, frameTimeline.submitted + 1, device, physicalDevice, surface, uint32_t(windowWidth), uint32_t(windowHeight), familyIndex, swapchainFormat, renderPass, swapchainSettings))
+			{
+				// the window is minimized; there is nothing to render to until it is restored
+				glfwWaitEvents();
+				continue;
+			}
+
+			swapchainDirty = false;
+		}
+
+		// ids and depth follow the swapchain size; frames in flight may still read the old ones
+		if (visibilityAvailable)
+			resizeVisibilityBuffer(visibility, memoryProps, deletionQueue, frameTimeline.submitted + 1, swapchain.width, swapchain.height);
+
+		uint32_t imageIndex = 0;
+		VkResult acquireResult = vkAcquireNextImageKHR(device, swapchain.swapchain, kAcquireTimeout, frame.acquireSemaphore, VK_NULL_HANDLE, &imageIndex);
+
+		if (acquireResult == VK_ERROR_OUT_OF_DATE_KHR)
+		{
+			swapchainDirty = true;
+			continue;
+		}
+
+		// the presentation engine is holding on to every image; drop this frame rather than blocking the loop
+		if (acquireResult == VK_TIMEOUT || acquireResult == VK_NOT_READY)
+			continue;
+
+		// a suboptimal swapchain can still be presented to; it is recreated on the next frame
+		assert(acquireResult == VK_SUCCESS || acquireResult == VK_SUBOPTIMAL_KHR);
+		swapchainDirty |= acquireResult == VK_SUBOPTIMAL_KHR;
+
+		VK_CHECK(vkResetCommandPool(device, frame.commandPool, 0));
+
+		VkCommandBuffer commandBuffer = frame.commandBuffer;
+
+		VkCommandBufferBeginInfo beginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+		VK_CHECK(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+
+		vkCmdResetQueryPool(commandBuffer, queryPool, frameSlot * 2, 2);
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, frameSlot * 2 + 0);
+
+		uint64_t uploadValue = acquireUploads(uploader, commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+			VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_SHADER_READ_BIT);
+
+		if (streaming)
+			acquireStreamedChunks(streamer, commandBuffer);
+
+		if (gpuCulling)
+		{
+			dispatchCulling(culler, commandBuffer, camera);
+			copyCulledDraws(culler, commandBuffer, frame.cullReadback);
+		}
+
+		VkClearColorValue color = { 48.f / 255.f, 10.f / 255.f, 36.f / 255.f, 1 };
+		VkClearValue clearColor = { color };
+
+		// with visibility shading, the draws below write ids and the swapchain image is only rendered to by the resolve
+		bool visibilityFrame = visibilityShading;
+
+		// attachments are rendered from scratch every frame, so their previous contents are discarded; the previous usage
+		// orders this frame after the last one, and the swapchain image after the acquire semaphore wait
+		resetRenderGraph(frameGraph);
+
+		uint32_t targetImage = importGraphImage(frameGraph, "swapchain", swapchain.images[imageIndex], VK_IMAGE_ASPECT_COLOR_BIT, UsageColorAttachment, true, UsagePresent);
+		uint32_t colorImage = swapchain.color.image ? importGraphImage(frameGraph, "msaa color", swapchain.color.image, VK_IMAGE_ASPECT_COLOR_BIT, UsageColorAttachment, true) : ~0u;
+		uint32_t depthImage = swapchain.depth.image ? importGraphImage(frameGraph, "depth", swapchain.depth.image, VK_IMAGE_ASPECT_DEPTH_BIT, UsageDepthAttachment, true) : ~0u;
+
+		uint32_t idsImage = ~0u;
+		uint32_t geometryPass = ~0u;
+
+		if (visibilityFrame)
+		{
+			idsImage = importGraphImage(frameGraph, "ids", visibility.ids.image, VK_IMAGE_ASPECT_COLOR_BIT, UsageFragmentStorageRead, true);
+			uint32_t visibilityDepthImage = importGraphImage(frameGraph, "visibility depth", visibility.depth.image, VK_IMAGE_ASPECT_DEPTH_BIT, UsageDepthAttachment, true);
+
+			geometryPass = addGraphPass(frameGraph, "visibility");
+			addGraphAccess(frameGraph, geometryPass, idsImage, UsageColorAttachment);
+			addGraphAccess(frameGraph, geometryPass, visibilityDepthImage, UsageDepthAttachment);
+		}
+
+		uint32_t mainPass = addGraphPass(frameGraph, visibilityFrame ? "resolve" : "forward");
+
+		if (idsImage != ~0u)
+			addGraphAccess(frameGraph, mainPass, idsImage, UsageFragmentStorageRead);
+
+		addGraphAccess(frameGraph, mainPass, targetImage, UsageColorAttachment);
+
+		if (colorImage != ~0u)
+			addGraphAccess(frameGraph, mainPass, colorImage, UsageColorAttachment);
+
+		if (depthImage != ~0u)
+			addGraphAccess(frameGraph, mainPass, depthImage, UsageDepthAttachment);
+
+		compileRenderGraph(frameGraph);
+
+		if (visibilityFrame)
+		{
+			recordGraphBarriers(frameGraph, commandBuffer, geometryPass);
+
+			beginVisibilityPass(visibility, commandBuffer);
+		}
+		else
+		{
+			recordGraphBarriers(frameGraph, commandBuffer, mainPass);
+
+			beginRendering(commandBuffer, renderPass, swapchain, imageIndex, clearColor);
+		}
+
+		VkViewport viewport = { 0, float(swapchain.height), float(swapchain.width), -float(swapchain.height), 0, 1 };
+		VkRect2D scissor = { {0, 0}, {uint32_t(swapchain.width), uint32_t(swapchain.height)} };
+
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+		uint32_t vertexFormat = hasNormals ? VertexFormatFull : VertexFormatNoNormals;
+
+		VkPipeline trianglePipeline = getPipeline(pipelineManager, trianglePipelines[vertexFormat * LightingModeCount + lightingMode]);
+
+		if (visibilityFrame)
+		{
+			VkPipeline geometryPipeline = getPipeline(pipelineManager, visibilityPipeline);
+
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, geometryPipeline ? geometryPipeline : visibilityFallbackPipeline);
+		}
+		else
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, trianglePipeline ? trianglePipeline : fallbackPipeline);
+
+		Globals globals = { { camera[0], camera[1], camera[2], 0.f }, { 1.f, 1.f, 1.f, 1.f }, vertexAddress };
+		vkCmdPushConstants(commandBuffer, triangleLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(globals), &globals);
+
+		uint32_t drawnSubmeshes = 0;
+
+		stats.draws = 0;
+		stats.triangles = 0;
+
+		if (streaming)
+		{
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, triangleLayout, 0, 1, &materialTextures.defaultSet, 0, 0);
+
+			stats.draws = drawStreamedChunks(streamer, streamingMesh, commandBuffer, stats.triangles);
+		}
+		else
+		{
+			if (!vertexPulling)
+			{
+				VkDeviceSize offset = 0;
+				vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vb.buffer, &offset);
+			}
+
+			vkCmdBindIndexBuffer(commandBuffer, ib.buffer, 0, mesh.indexSize == sizeof(uint16_t) ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32);
+
+			if (gpuCulling)
+			{
+				drawCulled(culler, commandBuffer, drawList, mesh, triangleLayout, materialTextures.sets.data());
+
+				// each batch is one indirect draw; what was drawn is only known once an earlier frame is read back
+				drawnSubmeshes = culledSubmeshes;
+
+				stats.draws = uint32_t(drawList.batches.size());
+				stats.triangles = culledTriangles;
+			}
+			else
+			{
+				drawnSubmeshes = cullDraws(drawCommands.data(), drawCounts.data(), drawList, camera);
+
+				// batches are sorted by material, so material constants and textures change at most once per material
+				uint32_t currentMaterial = ~0u;
+
+				for (size_t i = 0; i < drawList.batches.size(); i++)
+				{
+					const DrawBatch& batch = drawList.batches[i];
+
+					if (drawCounts[i] == 0)
+						continue;
+
+					if (batch.material != currentMaterial)
+					{
+						const Material& material = mesh.materials[batch.material];
+						vkCmdPushConstants(commandBuffer, triangleLayout, VK_SHADER_STAGE_VERTEX_BIT, offsetof(Globals, diffuseColor), sizeof(material.diffuse), material.diffuse);
+						vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, triangleLayout, 0, 1, &materialTextures.sets[batch.material], 0, 0);
+
+						currentMaterial = batch.material;
+					}
+
+					for (uint32_t j = 0; j < drawCounts[i]; j++)
+					{
+						const DrawCommand& command = drawCommands[batch.firstRecord + j];
+
+						vkCmdDrawIndexed(commandBuffer, command.indexCount, command.instanceCount, command.firstIndex, command.vertexOffset, command.firstInstance);
+
+						stats.triangles += uint64_t(command.indexCount / 3) * command.instanceCount;
+					}
+
+					stats.draws += drawCounts[i];
+				}
+			}
+		}
+
+		//vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+
+		if (captureWriter.file)
+		{
+			// gpu culled draws are captured as cullDraws produces them, which matches what the culling shader writes
+			if (gpuCulling)
+				cullDraws(drawCommands.data(), drawCounts.data(), drawList, camera);
+
+			captureDraws.clear();
+
+			for (size_t i = 0; i < drawList.batches.size(); i++)
+			{
+				const DrawBatch& batch = drawList.batches[i];
+
+				for (uint32_t j = 0; j < drawCounts[i]; j++)
+				{
+					const DrawCommand& command = drawCommands[batch.firstRecord + j];
+					CaptureDraw draw = { batch.material, command.indexCount, command.instanceCount, command.firstIndex, command.vertexOffset, command.firstInstance };
+
+					captureDraws.push_back(draw);
+				}
+			}
+
+			CaptureFrame captureFrame = { { camera[0], camera[1], camera[2] }, swapchain.width, swapchain.height,
+				vertexFormat, lightingMode, vertexInput, visibilityFrame ? uint32_t(CaptureShadingVisibility) : uint32_t(CaptureShadingForward) };
+
+			writeCaptureFrame(captureWriter, captureFrame, captureDraws.data(), captureDraws.size());
+		}
+
+		if (visibilityFrame)
+		{
+			endVisibilityPass(visibility, commandBuffer);
+
+			recordGraphBarriers(frameGraph, commandBuffer, mainPass);
+
+			beginRendering(commandBuffer, renderPass, swapchain, imageIndex, clearColor);
+
+			// viewport and scissor are still set from the geometry pass
+			VkPipeline resolvePipeline = getPipeline(pipelineManager, resolvePipelines[vertexFormat * LightingModeCount + lightingMode]);
+
+			resolveVisibility(visibility, commandBuffer, resolvePipeline ? resolvePipeline : resolveFallbackPipeline, camera,
+				getBufferAddress(device, vb), getBufferAddress(device, ib), mesh.indexSize);
+		}
+
+		endRendering(commandBuffer, renderPass);
+
+		// transitions the swapchain image for presentation
+		recordGraphBarriers(frameGraph, commandBuffer, uint32_t(frameGraph.passes.size()));
+
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, frameSlot * 2 + 1);
+
+		VK_CHECK(vkEndCommandBuffer(commandBuffer));
+
+		VkSemaphore waitSemaphores[] = { frame.acquireSemaphore, uploader.timeline.semaphore };
+		VkPipelineStageFlags waitStageMasks[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT };
+		uint64_t waitValues[] = { 0, uploadValue };
+
+		VkSubmitInfo submitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+		submitInfo.waitSemaphoreCount = uploadValue ? 2 : 1;
+		submitInfo.pWaitSemaphores = waitSemaphores;
+		submitInfo.pWaitDstStageMask = waitStageMasks;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &commandBuffer;
+		uint64_t frameValue = nextTimelineValue(frameTimeline);
+
+		VkSemaphore signalSemaphores[] = { swapchain.releaseSemaphores[imageIndex], frameTimeline.semaphore };
+		uint64_t signalValues[] = { 0, frameValue };
+
+		submitInfo.signalSemaphoreCount = frameTimeline.semaphore ? 2 : 1;
+		submitInfo.pSignalSemaphores = signalSemaphores;
+
+#ifdef VK_KHR_timeline_semaphore
+		// values for binary semaphores are ignored
+		VkTimelineSemaphoreSubmitInfoKHR timelineInfo = { VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR };
+		timelineInfo.waitSemaphoreValueCount = submitInfo.waitSemaphoreCount;
+		timelineInfo.pWaitSemaphoreValues = waitValues;
+		timelineInfo.signalSemaphoreValueCount = submitInfo.signalSemaphoreCount;
+		timelineInfo.pSignalSemaphoreValues = signalValues;
+
+		if (uploadValue || frameTimeline.semaphore)
+			submitInfo.pNext = &timelineInfo;
+#endif
+
+		// fences are only needed to track frames when there is no timeline semaphore to signal
+		VkFence submitFence = frameTimeline.semaphore ? VK_NULL_HANDLE : frame.fence;
+
+		if (submitFence)
+			VK_CHECK(vkResetFences(device, 1, &submitFence));
+
+		VK_CHECK(vkQueueSubmit(queue, 1, &submitInfo, submitFence));
+
+		frame.index = frameValue;
+
+		addSample(stats.cpuTime, getTimeMs() - frameTime);
+
+		uint32_t framesAhead = 0;
+
+		if (frameTimeline.semaphore)
+			framesAhead = uint32_t(frameValue - 1 - getTimelineCompleted(frameTimeline));
+		else
+		{
+			for (uint32_t i = 0; i < pacer.maxQueuedFrames; i++)
+			{
+				if (i != frameSlot && frames[i].index && vkGetFenceStatus(device, frames[i].fence) == VK_NOT_READY)
+					framesAhead++;
+			}
+		}
+
+		submitFrame(pacer, framesAhead);
+
+		VkPresentInfoKHR presentInfo = { VK_STRUCTURE_TYPE_PRESENT_INFO_KHR };
+		presentInfo.waitSemaphoreCount = 1;
+		presentInfo.pWaitSemaphores = &swapchain.releaseSemaphores[imageIndex];
+		presentInfo.swapchainCount = 1;
+		presentInfo.pSwapchains = &swapchain.swapchain;
+		presentInfo.pImageIndices = &imageIndex;
+
+		VkResult presentResult = vkQueuePresentKHR(queue, &presentInfo);
+
+		if (presentResult == VK_ERROR_OUT_OF_DATE_KHR || presentResult == VK_SUBOPTIMAL_KHR)
+			swapchainDirty = true;
+		else
+			VK_CHECK(presentResult);
+
+		char title[256];
+		snprintf(title, sizeof(title), "cpu: %.2f ms; gpu: %.2f ms; latency: %.2f ms; queued: %d", pacer.cpuTime, pacer.gpuTime, pacer.latency, framesAhead + 1);
+
+		if (!streaming)
+		{
+			size_t length = strlen(title);
+
+			snprintf(title + length, sizeof(title) - length, "; submeshes: %d/%d", drawnSubmeshes, int(mesh.submeshes.size()));
+
+			length = strlen(title);
+
+			if (gpuCulling)
+				snprintf(title + length, sizeof(title) - length, ", %d indirect draws", int(drawList.batches.size()));
+
+			length = strlen(title);
+			snprintf(title + length, sizeof(title) - length, "; shading: %s", visibilityFrame ? "visibility" : "forward");
+		}
+		else
+		{
+			const ResidencyStats& residency = streamer.residency.stats;
+			size_t length = strlen(title);
+
+			snprintf(title + length, sizeof(title) - length, "; chunks: %d/%d resident, %d loading, %d wanted",
+				residency.residentChunks, residency.chunkCount, residency.loadingChunks, residency.wantedChunks);
+		}
+
+		stats.frames++;
+		stats.uploadBytes = uploader.uploadedBytes + streamer.uploadedBytes;
+
+		double statsTime = (getTimeMs() - statsStart) * 1e-3;
+
+		if (statsTime >= nextHeapUpdate)
+		{
+			updateHeapStats(stats, physicalDevice);
+			nextHeapUpdate = statsTime + 1;
+		}
+
+		updateStatsExport(statsExporter, stats, statsTime);
+
+		size_t titleLength = strlen(title);
+		snprintf(title + titleLength, sizeof(title) - titleLength, "; p99: %.2f ms", getPercentile(stats.frameTime, 0.99));
+
+		glfwSetWindowTitle(window, title);
+	}
+
+	VK_CHECK(vkDeviceWaitIdle(device));
+
+	flushDeletionQueue(deletionQueue, ~0ull);
+
+	printf("Frames: %lld, frame time p50 %.2f ms, p99 %.2f ms; uploaded %.2f MB\n", (long long)stats.frames,
+		getPercentile(stats.frameTime, 0.5), getPercentile(stats.frameTime, 0.99), double(stats.uploadBytes) / 1e6);
+
+	if (captureWriter.file)
+	{
+		printf("Capture: %d frames, %.2f MB written to %s\n", captureWriter.frames, double(captureWriter.size) / 1e6, capturePath);
+
+		closeCapture(captureWriter);
+	}
+
+	dumpStats(statsExporter, stats, (getTimeMs() - statsStart) * 1e-3);
+
+	closeStatsExporter(statsExporter);
+
+	if (streaming)
+	{
+		const ResidencyStats& residency = streamer.residency.stats;
+		printf("Streaming: %d slots, %lld chunk loads, %lld evictions\n", residency.slotCount, (long long)residency.loads, (long long)residency.evictions);
+
+		destroyStreamer(streamer);
+	}
+
+	if (gpuCulling)
+		destroyDrawCuller(culler);
+
+	if (visibilityAvailable)
+		destroyVisibilityBuffer(visibility);
+
+	destroyMaterialTextures(materialTextures);
+
+	destroyBuffer(vb, device);
+	destroyBuffer(ib, device);
+
+	destroyUploader(uploader);
+
+	glfwDestroyWindow(window);
+	for (uint32_t i = 0; i < pacer.maxQueuedFrames; i++)
+	{
+		vkDestroyCommandPool(device, frames[i].commandPool, NULL);
+		vkDestroySemaphore(device, frames[i].acquireSemaphore, NULL);
+		vkDestroyFence(device, frames[i].fence, NULL);
+
+		if (gpuCulling)
+			destroyBuffer(frames[i].cullReadback, device);
+	}
+
+	vkDestroyQueryPool(device, queryPool, NULL);
+
+	destroyTimeline(frameTimeline);
+
+	if (swapchain.color.lazilyAllocated || swapchain.depth.lazilyAllocated)
+	{
+		VkDeviceSize colorCommitted = 0, depthCommitted = 0;
+
+		if (swapchain.color.lazilyAllocated)
+			vkGetDeviceMemoryCommitment(device, swapchain.color.memory, &colorCommitted);
+
+		if (swapchain.depth.lazilyAllocated)
+			vkGetDeviceMemoryCommitment(device, swapchain.depth.memory, &depthCommitted);
+
+		printf("Transient attachments: %.2f MB committed out of %.2f MB\n", double(colorCommitted + depthCommitted) / 1e6, double(swapchain.color.memorySize + swapchain.depth.memorySize) / 1e6);
+	}
+
+	destroySwapchain(swapchain, device);
+
+	if (debugCallback)
+	{
+		PFN_vkDestroyDebugReportCallbackEXT vkDestroyDebugReportCallbackEXT = (PFN_vkDestroyDebugReportCallbackEXT)vkGetInstanceProcAddr(instance, "vkDestroyDebugReportCallbackEXT");
+		vkDestroyDebugReportCallbackEXT(instance, debugCallback, VK_NULL_HANDLE);
+	}
+
+
+	destroyShader(triangleVS, device);
+	destroyShader(triangleFS, device);
+
+	if (trianglePullVS.module)
+		destroyShader(trianglePullVS, device);
+
+	if (cullCS.module)
+		destroyShader(cullCS, device);
+
+	if (visibilityAvailable)
+	{
+		destroyShader(visibilityFS, device);
+		destroyShader(resolveVS, device);
+		destroyShader(resolveFS, device);
+	}
+
+	for (size_t i = 0; i < retiredShaders.size(); i++)
+		vkDestroyShaderModule(device, retiredShaders[i], VK_NULL_HANDLE);
 
 	vkDestroyPipelineLayout(device, triangleLayout, VK_NULL_HANDLE);
-	vkDestroyPipeline(device, trianglePipeline, VK_NULL_HANDLE);
+	vkDestroyDescriptorSetLayout(device, materialSetLayout, VK_NULL_HANDLE);
+	PipelineStats pipelineStats = getPipelineStats(pipelineManager);
+	printf("Pipelines: %d/%d compiled in %.2f ms (avg %.2f ms, max %.2f ms)\n", pipelineStats.compiled, pipelineStats.requested,
+		pipelineStats.wallTime, pipelineStats.compiled ? pipelineStats.totalCompileTime / pipelineStats.compiled : 0.0, pipelineStats.maxCompileTime);
+
+	destroyPipelineManager(pipelineManager);
+
+	vkDestroyPipeline(device, fallbackPipeline, VK_NULL_HANDLE);
+
+	if (visibilityAvailable)
+	{
+		vkDestroyPipeline(device, visibilityFallbackPipeline, VK_NULL_HANDLE);
+		vkDestroyPipeline(device, resolveFallbackPipeline, VK_NULL_HANDLE);
+	}
+	vkDestroyPipelineCache(device, pipelineCache, VK_NULL_HANDLE);
 
-	vkDestroyRenderPass(device, renderPass, VK_NULL_HANDLE);
+	if (renderPass)
+		vkDestroyRenderPass(device, renderPass, VK_NULL_HANDLE);
 
 	vkDestroySurfaceKHR(instance, surface, NULL);
 
@@ -0,0 +1,368 @@
+#include "common.h"
+#include "rendergraph.h"
+
+#include <algorithm>
+
+struct UsageInfo
+{
+	VkPipelineStageFlags stages;
+	VkAccessFlags access;
+	VkAccessFlags writeAccess; // 0 for read only usages
+	VkImageLayout layout; // images only
+};
+
+// indexed by ResourceUsage
+static const UsageInfo kUsageInfo[UsageCount] =
+{
+	{ 0, 0, 0, VK_IMAGE_LAYOUT_UNDEFINED },
+	{ VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL },
+	{ VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL },
+	{ VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, 0, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL },
+	{ VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, 0, VK_IMAGE_LAYOUT_GENERAL },
+	{ VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, 0, VK_IMAGE_LAYOUT_GENERAL },
+	{ VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL },
+	{ VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT, 0, VK_IMAGE_LAYOUT_UNDEFINED },
+	{ VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, 0, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL },
+	{ VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL },
+	// presentation is ordered by the semaphore the present waits on; the barrier only has to change the layout
+	{ VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR },
+};
+
+// Synchronization state of one resource while the graph is compiled
+struct ResourceState
+{
+	VkImageLayout layout;
+
+	// last write, or the layout transition of the last read that changed the layout
+	VkPipelineStageFlags writeStages;
+	VkAccessFlags writeAccess;
+
+	// reads since then; a write has to wait for them, but they don't have to be made visible
+	VkPipelineStageFlags readStages;
+
+	// stages and accesses the last write is already visible to
+	VkPipelineStageFlags visibleStages;
+	VkAccessFlags visibleAccess;
+};
+
+static ResourceState getInitialState(const GraphResource& resource)
+{
+	const UsageInfo& info = kUsageInfo[resource.previousUsage];
+
+	ResourceState state = {};
+	state.layout = resource.discard ? VK_IMAGE_LAYOUT_UNDEFINED : info.layout;
+
+	if (info.writeAccess)
+	{
+		state.writeStages = info.stages;
+		state.writeAccess = info.writeAccess;
+	}
+	else
+		state.readStages = info.stages;
+
+	return state;
+}
+
+static void addBarrier(GraphBarriers& batch, const GraphResource& resource, ResourceState& state, ResourceUsage usage, VkPipelineStageFlags aliasStages, VkAccessFlags aliasAccess)
+{
+	const UsageInfo& info = kUsageInfo[usage];
+
+	bool image = resource.buffer == 0;
+	bool layoutChange = image && info.layout != state.layout;
+	bool write = info.writeAccess != 0;
+
+	VkPipelineStageFlags srcStages = aliasStages;
+	VkAccessFlags srcAccess = aliasAccess;
+
+	// writes and layout transitions wait for all earlier accesses; reads only for a write that isn't visible to them yet
+	bool needed = layoutChange || aliasStages;
+
+	if (write || layoutChange)
+	{
+		srcStages |= state.writeStages | state.readStages;
+		srcAccess |= state.writeAccess;
+		needed |= srcStages != 0;
+	}
+	else if (state.writeStages && ((info.stages & ~state.visibleStages) || (info.access & ~state.visibleAccess)))
+	{
+		srcStages |= state.writeStages;
+		srcAccess |= state.writeAccess;
+		needed = true;
+	}
+
+	if (needed)
+	{
+		// nothing to wait for: the barrier only orders the layout transition before this use
+		batch.srcStageMask |= srcStages ? srcStages : VkPipelineStageFlags(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+		batch.dstStageMask |= info.stages;
+
+		if (image)
+		{
+			VkImageMemoryBarrier barrier = { VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+			barrier.srcAccessMask = srcAccess;
+			barrier.dstAccessMask = info.access;
+			barrier.oldLayout = state.layout;
+			barrier.newLayout = layoutChange ? info.layout : state.layout;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.image = resource.image;
+			barrier.subresourceRange.aspectMask = resource.aspectMask;
+			barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+			barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+
+			batch.imageBarriers.push_back(barrier);
+		}
+		else
+		{
+			VkBufferMemoryBarrier barrier = { VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER };
+			barrier.srcAccessMask = srcAccess;
+			barrier.dstAccessMask = info.access;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.buffer = resource.buffer;
+			barrier.size = VK_WHOLE_SIZE;
+
+			batch.bufferBarriers.push_back(barrier);
+		}
+	}
+
+	if (write || layoutChange)
+	{
+		// a layout transition is a write at the barrier, so later uses in other stages still have to wait for it
+		state.writeStages = info.stages;
+		state.writeAccess = info.writeAccess;
+		state.readStages = write ? 0 : info.stages;
+		state.visibleStages = info.stages;
+		state.visibleAccess = info.access;
+	}
+	else
+	{
+		state.readStages |= info.stages;
+
+		if (needed)
+		{
+			state.visibleStages |= info.stages;
+			state.visibleAccess |= info.access;
+		}
+	}
+
+	if (layoutChange)
+		state.layout = info.layout;
+}
+
+static bool overlaps(uint32_t firstA, uint32_t lastA, uint32_t firstB, uint32_t lastB)
+{
+	return firstA <= lastB && firstB <= lastA;
+}
+
+static bool sharesMemory(const GraphResource& a, const GraphResource& b)
+{
+	return a.offset < b.offset + b.size && b.offset < a.offset + a.size;
+}
+
+static bool compareSize(const GraphResource* a, const GraphResource* b)
+{
+	return a->size > b->size;
+}
+
+// Largest images first, each at the lowest offset that doesn't overlap an image that is alive at the same time
+static void placeTransientImages(RenderGraph& graph)
+{
+	std::vector<GraphResource*> images;
+
+	for (size_t i = 0; i < graph.resources.size(); i++)
+		if (graph.resources[i].transient && graph.resources[i].firstPass != ~0u)
+			images.push_back(&graph.resources[i]);
+
+	std::stable_sort(images.begin(), images.end(), compareSize);
+
+	graph.memorySize = 0;
+	graph.unaliasedSize = 0;
+	graph.memoryTypeBits = ~0u;
+
+	for (size_t i = 0; i < images.size(); i++)
+	{
+		GraphResource& image = *images[i];
+		assert(image.alignment);
+
+		image.offset = 0;
+
+		for (size_t j = 0; j < i; j++)
+		{
+			const GraphResource& placed = *images[j];
+
+			if (overlaps(image.firstPass, image.lastPass, placed.firstPass, placed.lastPass) && sharesMemory(image, placed))
+			{
+				image.offset = (placed.offset + placed.size + image.alignment - 1) / image.alignment * image.alignment;
+
+				// images placed earlier may overlap the new offset
+				j = ~size_t(0);
+			}
+		}
+
+		graph.memorySize = std::max(graph.memorySize, image.offset + image.size);
+		graph.unaliasedSize += image.size;
+		graph.memoryTypeBits &= image.memoryTypeBits;
+	}
+
+	// all transient images share one allocation
+	assert(images.empty() || graph.memoryTypeBits);
+}
+
+void resetRenderGraph(RenderGraph& graph)
+{
+	assert(!graph.memory);
+
+	// batches are kept, so that a graph declared every frame reuses their barrier arrays
+	graph.resources.clear();
+	graph.passes.clear();
+	graph.accesses.clear();
+
+	graph.memorySize = 0;
+	graph.unaliasedSize = 0;
+	graph.memoryTypeBits = 0;
+}
+
+uint32_t addGraphImage(RenderGraph& graph, const char* name, uint32_t width, uint32_t height, VkFormat format, VkImageUsageFlags usage, VkSampleCountFlagBits samples)
+{
+	GraphResource resource = {};
+	resource.name = name;
+	resource.aspectMask = format == VK_FORMAT_D32_SFLOAT ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+	resource.transient = true;
+	resource.discard = true;
+	resource.width = width;
+	resource.height = height;
+	resource.format = format;
+	resource.usage = usage;
+	resource.samples = samples;
+
+	graph.resources.push_back(resource);
+
+	return uint32_t(graph.resources.size() - 1);
+}
+
+uint32_t importGraphImage(RenderGraph& graph, const char* name, VkImage image, VkImageAspectFlags aspectMask, ResourceUsage previousUsage, bool discard, ResourceUsage finalUsage)
+{
+	GraphResource resource = {};
+	resource.name = name;
+	resource.image = image;
+	resource.aspectMask = aspectMask;
+	resource.discard = discard;
+	resource.previousUsage = previousUsage;
+	resource.finalUsage = finalUsage;
+
+	graph.resources.push_back(resource);
+
+	return uint32_t(graph.resources.size() - 1);
+}
+
+uint32_t importGraphBuffer(RenderGraph& graph, const char* name, VkBuffer buffer, ResourceUsage previousUsage)
+{
+	assert(buffer);
+
+	GraphResource resource = {};
+	resource.name = name;
+	resource.buffer = buffer;
+	resource.previousUsage = previousUsage;
+
+	graph.resources.push_back(resource);
+
+	return uint32_t(graph.resources.size() - 1);
+}
+
+uint32_t addGraphPass(RenderGraph& graph, const char* name)
+{
+	GraphPass pass = { name, uint32_t(graph.accesses.size()), 0 };
+
+	graph.passes.push_back(pass);
+
+	return uint32_t(graph.passes.size() - 1);
+}
+
+void addGraphAccess(RenderGraph& graph, uint32_t pass, uint32_t resource, ResourceUsage usage)
+{
+	assert(pass + 1 == graph.passes.size());
+	assert(resource < graph.resources.size());
+	assert(usage != UsageNone && usage != UsagePresent);
+
+	for (uint32_t i = 0; i < graph.passes[pass].accessCount; i++)
+		assert(graph.accesses[graph.passes[pass].firstAccess + i].resource != resource);
+
+	GraphAccess access = { pass, resource, usage };
+
+	graph.accesses.push_back(access);
+	graph.passes[pass].accessCount++;
+}
+
+void compileRenderGraph(RenderGraph& graph)
+{
+	for (size_t i = 0; i < graph.resources.size(); i++)
+	{
+		graph.resources[i].firstPass = ~0u;
+		graph.resources[i].lastPass = ~0u;
+	}
+
+	for (size_t i = 0; i < graph.accesses.size(); i++)
+	{
+		GraphResource& resource = graph.resources[graph.accesses[i].resource];
+
+		if (resource.firstPass == ~0u)
+			resource.firstPass = graph.accesses[i].pass;
+
+		resource.lastPass = graph.accesses[i].pass;
+	}
+
+	// placement needs memory requirements, which are only known once the images exist
+	bool place = false;
+
+	for (size_t i = 0; i < graph.resources.size(); i++)
+		place |= graph.resources[i].transient && graph.resources[i].size;
+
+	if (place)
+		placeTransientImages(graph);
+
+	std::vector<ResourceState> states(graph.resources.size());
+
+	for (size_t i = 0; i < graph.resources.size(); i++)
+		states[i] = getInitialState(graph.resources[i]);
+
+	graph.batches.resize(graph.passes.size() + 1);
+
+	for (size_t i = 0; i < graph.batches.size(); i++)
+	{
+		graph.batches[i].srcStageMask = 0;
+		graph.batches[i].dstStageMask = 0;
+		graph.batches[i].imageBarriers.clear();
+		graph.batches[i].bufferBarriers.clear();
+	}
+
+	for (size_t i = 0; i < graph.accesses.size(); i++)
+	{
+		const GraphAccess& access = graph.accesses[i];
+		const GraphResource& resource = graph.resources[access.resource];
+
+		VkPipelineStageFlags aliasStages = 0;
+		VkAccessFlags aliasAccess = 0;
+
+		// the first use of an aliased image has to wait until the images that used its memory before are done with it
+		if (place && resource.transient && access.pass == resource.firstPass)
+		{
+			for (size_t j = 0; j < graph.resources.size(); j++)
+			{
+				const GraphResource& previous = graph.resources[j];
+
+				if (previous.transient && previous.lastPass < resource.firstPass && sharesMemory(previous, resource))
+				{
+					aliasStages |= states[j].writeStages | states[j].readStages;
+					aliasAccess |= states[j].writeAccess;
+				}
+			}
+		}
+
+		addBarrier(graph.batches[access.pass], resource, states[access.resource], access.usage, aliasStages, aliasAccess);
+	}
+
+	for (size_t i = 0; i < graph.resources.size(); i++)
+		if (graph.resources[i].finalUsage != UsageNone)
+			addBarrier(graph.batches.back(), graph.resources[i], states[i], graph.resources[i].finalUsage, 0, 0);
+}
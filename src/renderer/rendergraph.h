@@ -0,0 +1,119 @@
+#pragma once
+
+// Frame graph: passes declare which resources they read and write and how, and compiling the graph derives the layout
+// transitions and barriers between them, batched into one vkCmdPipelineBarrier per pass. Transient images created by
+// the graph share one allocation, with images whose pass ranges don't overlap placed at the same offsets.
+// Declaring and compiling a graph doesn't touch the device, so barriers and aliasing can be checked on the CPU; the
+// functions that do (images, recording and the benchmark) are in rendergraphdevice.cpp
+enum ResourceUsage
+{
+	UsageNone, // not used before the graph, contents are undefined
+
+	UsageColorAttachment,
+	UsageDepthAttachment,
+	UsageFragmentSampled,
+	UsageFragmentStorageRead,
+	UsageComputeStorageRead,
+	UsageComputeStorageWrite,
+	UsageIndirectRead,
+	UsageTransferRead,
+	UsageTransferWrite,
+	UsagePresent,
+
+	UsageCount
+};
+
+struct GraphResource
+{
+	const char* name;
+
+	VkImage image;
+	VkBuffer buffer;
+	VkImageView imageView; // transient images only
+	VkImageAspectFlags aspectMask;
+
+	bool transient; // created by the graph in createRenderGraphImages
+	bool discard; // previous contents don't have to be preserved; always set for transient images
+
+	// how the resource was used before the graph ran and how it has to be left; UsageNone leaves the last layout
+	ResourceUsage previousUsage;
+	ResourceUsage finalUsage;
+
+	// transient images; memory requirements are filled in by createRenderGraphImages
+	uint32_t width, height;
+	VkFormat format;
+	VkImageUsageFlags usage;
+	VkSampleCountFlagBits samples;
+
+	VkDeviceSize size, alignment;
+	uint32_t memoryTypeBits;
+
+	// set by compileRenderGraph
+	uint32_t firstPass, lastPass; // ~0u if no pass uses the resource
+	VkDeviceSize offset; // in the graph allocation
+};
+
+struct GraphAccess
+{
+	uint32_t pass;
+	uint32_t resource;
+	ResourceUsage usage;
+};
+
+struct GraphPass
+{
+	const char* name;
+
+	uint32_t firstAccess, accessCount;
+};
+
+// Barriers recorded together before a pass
+struct GraphBarriers
+{
+	VkPipelineStageFlags srcStageMask, dstStageMask;
+
+	std::vector<VkImageMemoryBarrier> imageBarriers;
+	std::vector<VkBufferMemoryBarrier> bufferBarriers;
+};
+
+struct RenderGraph
+{
+	std::vector<GraphResource> resources;
+	std::vector<GraphPass> passes;
+	std::vector<GraphAccess> accesses; // grouped by pass, in declaration order
+
+	// batches[i] is recorded before pass i; the last batch follows all passes and leaves resources in their final usage
+	std::vector<GraphBarriers> batches;
+
+	VkDeviceMemory memory; // transient images
+	VkDeviceSize memorySize;
+	VkDeviceSize unaliasedSize; // memory the transient images would take without aliasing
+	uint32_t memoryTypeBits;
+};
+
+// Removes all resources and passes; transient images have to be destroyed first
+void resetRenderGraph(RenderGraph& graph);
+
+// Transient image owned by the graph; it is created by createRenderGraphImages once all passes are declared
+uint32_t addGraphImage(RenderGraph& graph, const char* name, uint32_t width, uint32_t height, VkFormat format, VkImageUsageFlags usage, VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT);
+
+uint32_t importGraphImage(RenderGraph& graph, const char* name, VkImage image, VkImageAspectFlags aspectMask, ResourceUsage previousUsage, bool discard, ResourceUsage finalUsage = UsageNone);
+uint32_t importGraphBuffer(RenderGraph& graph, const char* name, VkBuffer buffer, ResourceUsage previousUsage);
+
+// Passes run in the order they are added; accesses can only be added to the last pass, once per resource
+uint32_t addGraphPass(RenderGraph& graph, const char* name);
+void addGraphAccess(RenderGraph& graph, uint32_t pass, uint32_t resource, ResourceUsage usage);
+
+// Computes resource lifetimes, places transient images with known memory requirements and derives the barriers
+void compileRenderGraph(RenderGraph& graph);
+
+// Creates the transient images, compiles the graph and binds the images to one shared allocation
+void createRenderGraphImages(RenderGraph& graph, VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties);
+void destroyRenderGraphImages(RenderGraph& graph, VkDevice device);
+
+// Records the barriers that precede pass; graph.passes.size() records the final transitions
+void recordGraphBarriers(const RenderGraph& graph, VkCommandBuffer commandBuffer, uint32_t pass);
+
+// Runs a chain of copy passes through transient images on the device and verifies that the data survives aliasing;
+// returns false on mismatch
+bool benchmarkRenderGraph(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties, VkQueue queue, uint32_t familyIndex, uint32_t imageCount);
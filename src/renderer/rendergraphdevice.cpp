@@ -0,0 +1,237 @@
+#include "common.h"
+#include "resources.h"
+#include "rendergraph.h"
+#include "swapchain.h"
+#include "timer.h"
+
+void createRenderGraphImages(RenderGraph& graph, VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties)
+{
+	assert(!graph.memory);
+
+	for (size_t i = 0; i < graph.resources.size(); i++)
+	{
+		GraphResource& resource = graph.resources[i];
+
+		if (!resource.transient)
+			continue;
+
+		VkImageCreateInfo createInfo = getImageInfo(resource.width, resource.height, resource.format, resource.usage, resource.samples);
+
+		VK_CHECK(vkCreateImage(device, &createInfo, 0, &resource.image));
+
+		VkMemoryRequirements memoryRequirements;
+		vkGetImageMemoryRequirements(device, resource.image, &memoryRequirements);
+
+		resource.size = memoryRequirements.size;
+		resource.alignment = memoryRequirements.alignment;
+		resource.memoryTypeBits = memoryRequirements.memoryTypeBits;
+	}
+
+	compileRenderGraph(graph);
+
+	if (graph.memorySize == 0)
+		return;
+
+	uint32_t memoryTypeIndex = selectMemoryType(memoryProperties, graph.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	assert(memoryTypeIndex != ~0u);
+
+	VkMemoryAllocateInfo allocateInfo = { VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO };
+	allocateInfo.allocationSize = graph.memorySize;
+	allocateInfo.memoryTypeIndex = memoryTypeIndex;
+
+	VK_CHECK(vkAllocateMemory(device, &allocateInfo, 0, &graph.memory));
+
+	for (size_t i = 0; i < graph.resources.size(); i++)
+	{
+		GraphResource& resource = graph.resources[i];
+
+		// images no pass uses are never placed; they are only destroyed
+		if (!resource.transient || resource.firstPass == ~0u)
+			continue;
+
+		VK_CHECK(vkBindImageMemory(device, resource.image, graph.memory, resource.offset));
+
+		resource.imageView = createImageView(device, resource.image, resource.format, resource.aspectMask);
+	}
+}
+
+void destroyRenderGraphImages(RenderGraph& graph, VkDevice device)
+{
+	for (size_t i = 0; i < graph.resources.size(); i++)
+	{
+		GraphResource& resource = graph.resources[i];
+
+		if (!resource.transient)
+			continue;
+
+		vkDestroyImageView(device, resource.imageView, VK_NULL_HANDLE);
+		vkDestroyImage(device, resource.image, VK_NULL_HANDLE);
+
+		resource.imageView = 0;
+		resource.image = 0;
+	}
+
+	vkFreeMemory(device, graph.memory, VK_NULL_HANDLE);
+	graph.memory = 0;
+}
+
+void recordGraphBarriers(const RenderGraph& graph, VkCommandBuffer commandBuffer, uint32_t pass)
+{
+	const GraphBarriers& batch = graph.batches[pass];
+
+	if (batch.imageBarriers.empty() && batch.bufferBarriers.empty())
+		return;
+
+	vkCmdPipelineBarrier(commandBuffer, batch.srcStageMask, batch.dstStageMask, 0, 0, 0,
+		uint32_t(batch.bufferBarriers.size()), batch.bufferBarriers.data(), uint32_t(batch.imageBarriers.size()), batch.imageBarriers.data());
+}
+
+bool benchmarkRenderGraph(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties, VkQueue queue, uint32_t familyIndex, uint32_t imageCount)
+{
+	const uint32_t kImageSize = 1024;
+	const VkFormat kFormat = VK_FORMAT_R8G8B8A8_UINT;
+
+	assert(imageCount >= 2);
+
+	size_t imageSize = size_t(kImageSize) * kImageSize * 4;
+
+	Buffer readback = {};
+	createBuffer(readback, device, memoryProperties, imageSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+	// the first pass clears image 0 and every following pass copies the previous image into the next one, so only two
+	// images are alive at a time; whatever the aliasing overwrote would end up in the readback
+	RenderGraph graph = {};
+
+	std::vector<uint32_t> images(imageCount);
+
+	for (uint32_t i = 0; i < imageCount; i++)
+		images[i] = addGraphImage(graph, "chain", kImageSize, kImageSize, kFormat, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+
+	uint32_t output = importGraphBuffer(graph, "readback", readback.buffer, UsageNone);
+
+	std::vector<uint32_t> passes(imageCount + 1);
+
+	for (uint32_t i = 0; i < imageCount; i++)
+	{
+		passes[i] = addGraphPass(graph, i == 0 ? "clear" : "copy");
+
+		if (i > 0)
+			addGraphAccess(graph, passes[i], images[i - 1], UsageTransferRead);
+
+		addGraphAccess(graph, passes[i], images[i], UsageTransferWrite);
+	}
+
+	passes[imageCount] = addGraphPass(graph, "readback");
+	addGraphAccess(graph, passes[imageCount], images[imageCount - 1], UsageTransferRead);
+	addGraphAccess(graph, passes[imageCount], output, UsageTransferWrite);
+
+	createRenderGraphImages(graph, device, memoryProperties);
+
+	printf("Transient images: %d x %dx%d, %.2f MB aliased, %.2f MB without aliasing\n", imageCount, kImageSize, kImageSize, double(graph.memorySize) / 1e6, double(graph.unaliasedSize) / 1e6);
+
+	// barriers only depend on declarations, so per frame compilation cost is what a rebuilt graph adds
+	const int kCompiles = 1000;
+
+	double compileStart = getTimeMs();
+
+	for (int i = 0; i < kCompiles; i++)
+		compileRenderGraph(graph);
+
+	double compileTime = (getTimeMs() - compileStart) / kCompiles;
+
+	size_t barrierCount = 0;
+
+	for (size_t i = 0; i < graph.batches.size(); i++)
+		barrierCount += graph.batches[i].imageBarriers.size() + graph.batches[i].bufferBarriers.size();
+
+	printf("Compile: %d passes, %d barriers in %d batches, %.3f ms\n", int(graph.passes.size()), int(barrierCount), int(graph.batches.size()), compileTime);
+
+	VkCommandPoolCreateInfo poolInfo = { VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+	poolInfo.queueFamilyIndex = familyIndex;
+
+	VkCommandPool commandPool = 0;
+	VK_CHECK(vkCreateCommandPool(device, &poolInfo, 0, &commandPool));
+
+	VkCommandBufferAllocateInfo allocateInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
+	allocateInfo.commandPool = commandPool;
+	allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocateInfo.commandBufferCount = 1;
+
+	VkCommandBuffer commandBuffer = 0;
+	VK_CHECK(vkAllocateCommandBuffers(device, &allocateInfo, &commandBuffer));
+
+	VkCommandBufferBeginInfo beginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	VK_CHECK(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+
+	VkClearColorValue clearValue = {};
+	clearValue.uint32[0] = 1;
+	clearValue.uint32[1] = 2;
+	clearValue.uint32[2] = 3;
+	clearValue.uint32[3] = 4;
+
+	VkImageSubresourceRange range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+	VkImageSubresourceLayers layers = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+
+	for (uint32_t i = 0; i < imageCount; i++)
+	{
+		recordGraphBarriers(graph, commandBuffer, passes[i]);
+
+		VkImage image = graph.resources[images[i]].image;
+
+		if (i == 0)
+			vkCmdClearColorImage(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clearValue, 1, &range);
+		else
+		{
+			VkImageCopy region = {};
+			region.srcSubresource = layers;
+			region.dstSubresource = layers;
+			region.extent = { kImageSize, kImageSize, 1 };
+
+			vkCmdCopyImage(commandBuffer, graph.resources[images[i - 1]].image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+		}
+	}
+
+	recordGraphBarriers(graph, commandBuffer, passes[imageCount]);
+
+	VkBufferImageCopy region = {};
+	region.imageSubresource = layers;
+	region.imageExtent = { kImageSize, kImageSize, 1 };
+
+	vkCmdCopyImageToBuffer(commandBuffer, graph.resources[images[imageCount - 1]].image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readback.buffer, 1, &region);
+
+	recordGraphBarriers(graph, commandBuffer, uint32_t(graph.passes.size()));
+
+	VkMemoryBarrier hostBarrier = { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+	hostBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &hostBarrier, 0, 0, 0, 0);
+
+	VK_CHECK(vkEndCommandBuffer(commandBuffer));
+
+	VkSubmitInfo submitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &commandBuffer;
+
+	VK_CHECK(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+	VK_CHECK(vkQueueWaitIdle(queue));
+
+	const unsigned char* pixels = static_cast<const unsigned char*>(readback.data);
+
+	size_t mismatches = 0;
+
+	for (size_t i = 0; i < imageSize; i += 4)
+		mismatches += pixels[i + 0] != 1 || pixels[i + 1] != 2 || pixels[i + 2] != 3 || pixels[i + 3] != 4;
+
+	printf("Chain: %d pixels differ, %s\n", int(mismatches), mismatches == 0 ? "match" : "MISMATCH");
+
+	vkDestroyCommandPool(device, commandPool, VK_NULL_HANDLE);
+
+	destroyRenderGraphImages(graph, device);
+	destroyBuffer(readback, device);
+
+	return mismatches == 0;
+}
@@ -0,0 +1,513 @@
+#include "common.h"
+#include "shaders.h"
+#include "swapchain.h"
+#include "resources.h"
+#include "files.h"
+#include "mesh.h"
+#include "scenegen.h"
+#include "normals.h"
+#include "capture.h"
+#include "replay.h"
+#include "timer.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <thread>
+
+// enough to keep the GPU busy while the next frame is recorded
+static const uint32_t kReplayFramesInFlight = 2;
+
+struct ReplaySlot
+{
+	VkCommandPool commandPool;
+	VkCommandBuffer commandBuffer;
+	VkFence fence;
+
+	bool submitted;
+};
+
+// Same steps as the renderer: scene specs are generated, .mesh files keep a single submesh and pick 16-bit indices
+// when all vertices fit, everything else is split into 16-bit batches where possible
+static bool loadReplayMesh(Mesh& mesh, const CaptureHeader& header)
+{
+	if (isSceneSpec(header.source))
+	{
+		SceneSettings settings;
+		if (!parseSceneSettings(settings, header.source))
+			return false;
+
+		generateScene(mesh, settings);
+	}
+	else if (!loadMesh(mesh, header.source))
+		return false;
+
+	if (isMeshFile(header.source))
+	{
+		setSingleSubmesh(mesh, uint32_t(mesh.indices.size()));
+		mesh.indexSize = mesh.vertices.size() <= 65536 ? sizeof(uint16_t) : sizeof(uint32_t);
+		return true;
+	}
+
+	if (header.smoothingAngle >= 0)
+	{
+		NormalSettings normalSettings = { header.smoothingAngle, NormalWeightAngle };
+		generateNormals(mesh, normalSettings, std::thread::hardware_concurrency());
+	}
+
+	selectIndexSize(mesh);
+	return true;
+}
+
+static bool validateCapture(const Capture& capture, const Mesh& mesh, bool pulledVertices)
+{
+	const CaptureHeader& header = capture.header;
+
+	if (header.vertexCount != mesh.vertices.size() || header.indexCount != mesh.indices.size() || header.indexSize != mesh.indexSize || header.submeshCount != mesh.submeshes.size())
+	{
+		printf("Capture was made with %d vertices, %d indices (%d-bit), %d submeshes; %s has %d, %d (%d-bit), %d\n",
+			header.vertexCount, header.indexCount, header.indexSize * 8, header.submeshCount, header.source,
+			int(mesh.vertices.size()), int(mesh.indices.size()), mesh.indexSize * 8, int(mesh.submeshes.size()));
+		return false;
+	}
+
+	for (size_t i = 0; i < capture.frames.size(); i++)
+	{
+		const CaptureFrame& frame = capture.frames[i];
+
+		if (frame.vertexFormat >= VertexFormatCount || frame.lightingMode >= LightingModeCount || frame.vertexInput >= VertexInputCount || frame.width == 0 || frame.height == 0)
+		{
+			printf("Capture frame %d has an invalid pipeline selection or viewport\n", int(i));
+			return false;
+		}
+
+		if (frame.vertexInput == VertexInputPulled && !pulledVertices)
+		{
+			printf("Capture frame %d pulls vertices, which this device doesn't support\n", int(i));
+			return false;
+		}
+
+		for (uint32_t j = 0; j < frame.drawCount; j++)
+		{
+			const CaptureDraw& draw = capture.draws[capture.firstDraw[i] + j];
+
+			if (draw.material >= mesh.materials.size() || uint64_t(draw.firstIndex) + draw.indexCount > mesh.indices.size())
+			{
+				printf("Capture frame %d draw %d is out of range of the mesh\n", int(i), int(j));
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+static void beginReplayFrame(VkCommandBuffer commandBuffer, const RenderTargetInfo& target, VkFramebuffer framebuffer, const Image& image, const CaptureFrame& frame)
+{
+	// every frame is cleared, so previous contents are discarded; the previous frame's writes still have to finish first
+	VkImageMemoryBarrier beginBarrier = { VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+	beginBarrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	beginBarrier.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	beginBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	beginBarrier.newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	beginBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	beginBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	beginBarrier.image = image.image;
+	beginBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	beginBarrier.subresourceRange.levelCount = 1;
+	beginBarrier.subresourceRange.layerCount = 1;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_DEPENDENCY_BY_REGION_BIT, 0, 0, 0, 0, 1, &beginBarrier);
+
+	// matches the renderer's clear color, so replayed images look like captured frames
+	VkClearColorValue color = { 48.f / 255.f, 10.f / 255.f, 36.f / 255.f, 1 };
+	VkClearValue clearColor = { color };
+
+	if (target.renderPass)
+	{
+		VkRenderPassBeginInfo passBeginInfo = { VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO };
+		passBeginInfo.renderPass = target.renderPass;
+		passBeginInfo.framebuffer = framebuffer;
+		passBeginInfo.renderArea.extent.width = frame.width;
+		passBeginInfo.renderArea.extent.height = frame.height;
+		passBeginInfo.clearValueCount = 1;
+		passBeginInfo.pClearValues = &clearColor;
+
+		vkCmdBeginRenderPass(commandBuffer, &passBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		return;
+	}
+
+#ifdef VK_KHR_dynamic_rendering
+	VkRenderingAttachmentInfoKHR colorAttachment = { VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR };
+	colorAttachment.imageView = image.imageView;
+	colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	colorAttachment.clearValue = clearColor;
+
+	VkRenderingInfoKHR renderingInfo = { VK_STRUCTURE_TYPE_RENDERING_INFO_KHR };
+	renderingInfo.renderArea.extent.width = frame.width;
+	renderingInfo.renderArea.extent.height = frame.height;
+	renderingInfo.layerCount = 1;
+	renderingInfo.colorAttachmentCount = 1;
+	renderingInfo.pColorAttachments = &colorAttachment;
+
+	vkCmdBeginRenderingKHR(commandBuffer, &renderingInfo);
+#else
+	assert(!"Dynamic rendering is not available in this build");
+#endif
+}
+
+static void endReplayFrame(VkCommandBuffer commandBuffer, const RenderTargetInfo& target)
+{
+	if (target.renderPass)
+		vkCmdEndRenderPass(commandBuffer);
+#ifdef VK_KHR_dynamic_rendering
+	else
+		vkCmdEndRenderingKHR(commandBuffer);
+#endif
+}
+
+static double getFramePercentile(std::vector<double>& values, double p)
+{
+	if (values.empty())
+		return 0;
+
+	size_t index = std::min(size_t(p * double(values.size())), values.size() - 1);
+	std::nth_element(values.begin(), values.begin() + index, values.end());
+
+	return values[index];
+}
+
+bool replayCapture(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties, VkQueue queue, uint32_t familyIndex, float timestampPeriod, const RenderTargetInfo& target,
+	VkShaderModule attributeVS, VkShaderModule pulledVS, VkShaderModule fs, VkPipelineLayout layout, const char* path, uint32_t repeats)
+{
+	Capture capture;
+
+	if (!loadCapture(capture, path))
+	{
+		printf("Failed to load capture %s\n", path);
+		return false;
+	}
+
+	Mesh mesh;
+
+	if (!loadReplayMesh(mesh, capture.header))
+	{
+		printf("Failed to load %s\n", capture.header.source);
+		return false;
+	}
+
+	if (!validateCapture(capture, mesh, pulledVS != 0))
+		return false;
+
+	// the image covers the largest viewport; smaller frames render to its corner
+	uint32_t width = 1, height = 1;
+	uint32_t replayedFrames = 0;
+	uint64_t replayedDraws = 0;
+
+	for (size_t i = 0; i < capture.frames.size(); i++)
+	{
+		const CaptureFrame& frame = capture.frames[i];
+
+		if (frame.shading != CaptureShadingForward)
+			continue;
+
+		width = std::max(width, frame.width);
+		height = std::max(height, frame.height);
+
+		replayedFrames++;
+		replayedDraws += frame.drawCount;
+	}
+
+	printf("Replaying %s: %d/%d frames (%d skipped with visibility shading), %.1f draws per frame, up to %dx%d, %s\n", path, replayedFrames, int(capture.frames.size()),
+		int(capture.frames.size()) - replayedFrames, replayedFrames ? double(replayedDraws) / replayedFrames : 0.0, width, height, capture.header.source);
+
+	// the uploader shares the queue, so copies are done before it returns
+	Uploader uploader;
+	createUploader(uploader, device, memoryProperties, queue, familyIndex, familyIndex, false, 32 * 1024 * 1024);
+
+	VkBufferUsageFlags vertexUsage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | (pulledVS ? VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT_KHR : 0);
+
+	Buffer vb = {};
+	createBuffer(vb, device, memoryProperties, std::max(mesh.vertices.size() * sizeof(Vertex), size_t(16)), vertexUsage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	uploadBuffer(uploader, vb, mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex));
+
+	Buffer ib = {};
+	createBuffer(ib, device, memoryProperties, std::max(mesh.indices.size() * mesh.indexSize, size_t(16)), VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	if (mesh.indexSize == sizeof(uint16_t))
+	{
+		std::vector<uint16_t> indices16(mesh.indices.begin(), mesh.indices.end());
+		uploadBuffer(uploader, ib, indices16.data(), indices16.size() * sizeof(uint16_t));
+	}
+	else
+		uploadBuffer(uploader, ib, mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t));
+
+	destroyUploader(uploader);
+
+	uint64_t vertexAddress = pulledVS ? getBufferAddress(device, vb) : 0;
+	VkIndexType indexType = mesh.indexSize == sizeof(uint16_t) ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+
+	Image image = {};
+	createImage(image, device, memoryProperties, width, height, target.colorFormat, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+
+	VkFramebuffer framebuffer = target.renderPass ? createFramebuffer(device, target.renderPass, &image.imageView, 1, image.width, image.height) : 0;
+
+	// every variant is compiled up front, so compiles don't show up in frame times
+	VkPipeline pipelines[VertexInputCount][VertexFormatCount][LightingModeCount] = {};
+
+	for (size_t i = 0; i < capture.frames.size(); i++)
+	{
+		const CaptureFrame& frame = capture.frames[i];
+		VkPipeline& pipeline = pipelines[frame.vertexInput][frame.vertexFormat][frame.lightingMode];
+
+		if (frame.shading != CaptureShadingForward || pipeline)
+			continue;
+
+		PipelineVariant variant = { frame.vertexFormat, frame.lightingMode, frame.vertexInput };
+
+		pipeline = createGraphicsPipeline(device, 0, target, frame.vertexInput == VertexInputPulled ? pulledVS : attributeVS, fs, layout, variant);
+		assert(pipeline);
+	}
+
+	VkQueryPoolCreateInfo queryInfo = { VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO };
+	queryInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	queryInfo.queryCount = kReplayFramesInFlight * 2;
+
+	VkQueryPool queryPool = 0;
+	VK_CHECK(vkCreateQueryPool(device, &queryInfo, 0, &queryPool));
+
+	ReplaySlot slots[kReplayFramesInFlight] = {};
+
+	for (uint32_t i = 0; i < kReplayFramesInFlight; i++)
+	{
+		VkCommandPoolCreateInfo poolInfo = { VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+		poolInfo.queueFamilyIndex = familyIndex;
+
+		VK_CHECK(vkCreateCommandPool(device, &poolInfo, 0, &slots[i].commandPool));
+
+		VkCommandBufferAllocateInfo allocateInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
+		allocateInfo.commandPool = slots[i].commandPool;
+		allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocateInfo.commandBufferCount = 1;
+
+		VK_CHECK(vkAllocateCommandBuffers(device, &allocateInfo, &slots[i].commandBuffer));
+
+		VkFenceCreateInfo fenceInfo = { VK_STRUCTURE_TYPE_FENCE_CREATE_INFO };
+		VK_CHECK(vkCreateFence(device, &fenceInfo, 0, &slots[i].fence));
+	}
+
+	std::vector<double> cpuTimes, gpuTimes;
+	cpuTimes.reserve(size_t(replayedFrames) * repeats);
+	gpuTimes.reserve(size_t(replayedFrames) * repeats);
+
+	const CaptureFrame* lastFrame = 0;
+	uint32_t submitted = 0;
+
+	double replayStart = getTimeMs();
+
+	for (uint32_t r = 0; r < repeats; r++)
+	{
+		for (size_t i = 0; i < capture.frames.size(); i++)
+		{
+			const CaptureFrame& frame = capture.frames[i];
+
+			if (frame.shading != CaptureShadingForward)
+				continue;
+
+			uint32_t slotIndex = submitted % kReplayFramesInFlight;
+			ReplaySlot& slot = slots[slotIndex];
+
+			if (slot.submitted)
+			{
+				VK_CHECK(vkWaitForFences(device, 1, &slot.fence, VK_TRUE, ~0ull));
+				VK_CHECK(vkResetFences(device, 1, &slot.fence));
+
+				uint64_t timestamps[2] = {};
+				VK_CHECK(vkGetQueryPoolResults(device, queryPool, slotIndex * 2, 2, sizeof(timestamps), timestamps, sizeof(timestamps[0]), VK_QUERY_RESULT_64_BIT));
+
+				gpuTimes.push_back(double(timestamps[1] - timestamps[0]) * timestampPeriod * 1e-6);
+			}
+
+			double recordStart = getTimeMs();
+
+			VK_CHECK(vkResetCommandPool(device, slot.commandPool, 0));
+
+			VkCommandBuffer commandBuffer = slot.commandBuffer;
+
+			VkCommandBufferBeginInfo beginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+			beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+			VK_CHECK(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+
+			vkCmdResetQueryPool(commandBuffer, queryPool, slotIndex * 2, 2);
+			vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, slotIndex * 2 + 0);
+
+			beginReplayFrame(commandBuffer, target, framebuffer, image, frame);
+
+			VkViewport viewport = { 0, float(frame.height), float(frame.width), -float(frame.height), 0, 1 };
+			VkRect2D scissor = { {0, 0}, {frame.width, frame.height} };
+
+			vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+			vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines[frame.vertexInput][frame.vertexFormat][frame.lightingMode]);
+
+			Globals globals = { { frame.camera[0], frame.camera[1], frame.camera[2], 0.f }, { 1.f, 1.f, 1.f, 1.f }, vertexAddress };
+			vkCmdPushConstants(commandBuffer, layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(globals), &globals);
+
+			if (frame.vertexInput == VertexInputAttributes)
+			{
+				VkDeviceSize offset = 0;
+				vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vb.buffer, &offset);
+			}
+
+			vkCmdBindIndexBuffer(commandBuffer, ib.buffer, 0, indexType);
+
+			const CaptureDraw* draws = frame.drawCount ? &capture.draws[capture.firstDraw[i]] : 0;
+			uint32_t currentMaterial = ~0u;
+
+			for (uint32_t j = 0; j < frame.drawCount; j++)
+			{
+				const CaptureDraw& draw = draws[j];
+
+				if (draw.material != currentMaterial)
+				{
+					const Material& material = mesh.materials[draw.material];
+					vkCmdPushConstants(commandBuffer, layout, VK_SHADER_STAGE_VERTEX_BIT, offsetof(Globals, diffuseColor), sizeof(material.diffuse), material.diffuse);
+
+					currentMaterial = draw.material;
+				}
+
+				vkCmdDrawIndexed(commandBuffer, draw.indexCount, draw.instanceCount, draw.firstIndex, draw.vertexOffset, draw.firstInstance);
+			}
+
+			endReplayFrame(commandBuffer, target);
+
+			vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, slotIndex * 2 + 1);
+
+			VK_CHECK(vkEndCommandBuffer(commandBuffer));
+
+			cpuTimes.push_back(getTimeMs() - recordStart);
+
+			VkSubmitInfo submitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+			submitInfo.commandBufferCount = 1;
+			submitInfo.pCommandBuffers = &commandBuffer;
+
+			VK_CHECK(vkQueueSubmit(queue, 1, &submitInfo, slot.fence));
+
+			slot.submitted = true;
+			submitted++;
+
+			lastFrame = &frame;
+		}
+	}
+
+	for (uint32_t i = 0; i < kReplayFramesInFlight && submitted; i++)
+	{
+		uint32_t slotIndex = (submitted + i) % kReplayFramesInFlight;
+		ReplaySlot& slot = slots[slotIndex];
+
+		if (!slot.submitted)
+			continue;
+
+		VK_CHECK(vkWaitForFences(device, 1, &slot.fence, VK_TRUE, ~0ull));
+
+		uint64_t timestamps[2] = {};
+		VK_CHECK(vkGetQueryPoolResults(device, queryPool, slotIndex * 2, 2, sizeof(timestamps), timestamps, sizeof(timestamps[0]), VK_QUERY_RESULT_64_BIT));
+
+		gpuTimes.push_back(double(timestamps[1] - timestamps[0]) * timestampPeriod * 1e-6);
+	}
+
+	double replayTime = getTimeMs() - replayStart;
+
+	if (submitted)
+	{
+		printf("Replay: %d frames in %.2f ms, %.1f fps\n", submitted, replayTime, double(submitted) * 1e3 / replayTime);
+		printf("Record: p50 %.3f ms, p99 %.3f ms\n", getFramePercentile(cpuTimes, 0.5), getFramePercentile(cpuTimes, 0.99));
+		printf("GPU: p50 %.3f ms, p99 %.3f ms\n", getFramePercentile(gpuTimes, 0.5), getFramePercentile(gpuTimes, 0.99));
+	}
+
+	// the hash of the last frame identifies the rendered output; it changes when the captured frames render differently
+	if (lastFrame)
+	{
+		size_t imageSize = size_t(lastFrame->width) * lastFrame->height * 4;
+
+		Buffer readback = {};
+		createBuffer(readback, device, memoryProperties, imageSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+		VkCommandBuffer commandBuffer = slots[0].commandBuffer;
+
+		VK_CHECK(vkResetCommandPool(device, slots[0].commandPool, 0));
+
+		VkCommandBufferBeginInfo beginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+		VK_CHECK(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+
+		VkImageMemoryBarrier copyBarrier = { VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+		copyBarrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		copyBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		copyBarrier.oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		copyBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		copyBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		copyBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		copyBarrier.image = image.image;
+		copyBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		copyBarrier.subresourceRange.levelCount = 1;
+		copyBarrier.subresourceRange.layerCount = 1;
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, 0, 0, 0, 1, &copyBarrier);
+
+		VkBufferImageCopy region = {};
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.layerCount = 1;
+		region.imageExtent = { lastFrame->width, lastFrame->height, 1 };
+
+		vkCmdCopyImageToBuffer(commandBuffer, image.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readback.buffer, 1, &region);
+
+		VkMemoryBarrier hostBarrier = { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+		hostBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &hostBarrier, 0, 0, 0, 0);
+
+		VK_CHECK(vkEndCommandBuffer(commandBuffer));
+
+		VkSubmitInfo submitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &commandBuffer;
+
+		VK_CHECK(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		VK_CHECK(vkQueueWaitIdle(queue));
+
+		printf("Last frame: %dx%d, image hash %016llx\n", lastFrame->width, lastFrame->height, (unsigned long long)hashBytes(readback.data, imageSize));
+
+		destroyBuffer(readback, device);
+	}
+
+	for (uint32_t i = 0; i < kReplayFramesInFlight; i++)
+	{
+		vkDestroyCommandPool(device, slots[i].commandPool, 0);
+		vkDestroyFence(device, slots[i].fence, 0);
+	}
+
+	vkDestroyQueryPool(device, queryPool, 0);
+
+	for (uint32_t i = 0; i < VertexInputCount; i++)
+		for (uint32_t j = 0; j < VertexFormatCount; j++)
+			for (uint32_t k = 0; k < LightingModeCount; k++)
+				if (pipelines[i][j][k])
+					vkDestroyPipeline(device, pipelines[i][j][k], VK_NULL_HANDLE);
+
+	if (framebuffer)
+		vkDestroyFramebuffer(device, framebuffer, VK_NULL_HANDLE);
+
+	destroyImage(image, device);
+	destroyBuffer(vb, device);
+	destroyBuffer(ib, device);
+
+	return true;
+}
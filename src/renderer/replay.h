@@ -0,0 +1,8 @@
+#pragma once
+
+// Loads a capture written by the renderer and the mesh it names, then re-issues the captured forward frames offscreen
+// as fast as the device allows, repeats times over. Reports CPU recording and GPU times per frame and a hash of the
+// last image, which stays the same across builds as long as the rendered frames do. Frames captured with visibility
+// shading are skipped. Returns false if the capture can't be loaded or doesn't match the mesh
+bool replayCapture(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties, VkQueue queue, uint32_t familyIndex, float timestampPeriod, const RenderTargetInfo& target,
+	VkShaderModule attributeVS, VkShaderModule pulledVS, VkShaderModule fs, VkPipelineLayout layout, const char* path, uint32_t repeats);
@@ -0,0 +1,128 @@
+#include "residency.h"
+
+#include <assert.h>
+
+#include <algorithm>
+
+void createResidency(Residency& result, uint32_t chunkCount, uint32_t slotCount)
+{
+	ChunkResidency unloaded = { ChunkUnloaded, ~0u, 0 };
+
+	result.chunks.assign(chunkCount, unloaded);
+
+	result.freeSlots.resize(slotCount);
+	for (uint32_t i = 0; i < slotCount; i++)
+		result.freeSlots[i] = slotCount - 1 - i;
+
+	result.retiredSlots.clear();
+
+	result.stats = ResidencyStats();
+	result.stats.chunkCount = chunkCount;
+	result.stats.slotCount = slotCount;
+}
+
+static bool evictLeastRecentlyUsed(Residency& residency, uint64_t frame)
+{
+	uint32_t victim = ~0u;
+
+	for (uint32_t i = 0; i < residency.chunks.size(); i++)
+	{
+		const ChunkResidency& chunk = residency.chunks[i];
+
+		// chunks wanted this frame are never evicted, so a full budget of wanted chunks can't thrash
+		if (chunk.state == ChunkResident && chunk.lastUsed < frame && (victim == ~0u || chunk.lastUsed < residency.chunks[victim].lastUsed))
+			victim = i;
+	}
+
+	if (victim == ~0u)
+		return false;
+
+	ChunkResidency& chunk = residency.chunks[victim];
+
+	// the frame about to be recorded won't draw the chunk, but frames in flight may
+	RetiredSlot retired = { chunk.slot, frame };
+	residency.retiredSlots.push_back(retired);
+
+	chunk.state = ChunkUnloaded;
+	chunk.slot = ~0u;
+
+	residency.stats.residentChunks--;
+	residency.stats.evictions++;
+
+	return true;
+}
+
+void updateResidency(Residency& residency, const float* distances, uint64_t frame, uint64_t completedFrame, uint32_t maxLoads, std::vector<uint32_t>& loads)
+{
+	loads.clear();
+
+	size_t write = 0;
+
+	for (size_t i = 0; i < residency.retiredSlots.size(); i++)
+	{
+		if (residency.retiredSlots[i].frame <= completedFrame)
+			residency.freeSlots.push_back(residency.retiredSlots[i].slot);
+		else
+			residency.retiredSlots[write++] = residency.retiredSlots[i];
+	}
+
+	residency.retiredSlots.resize(write);
+
+	uint32_t chunkCount = uint32_t(residency.chunks.size());
+	uint32_t wantedCount = std::min(chunkCount, residency.stats.slotCount);
+
+	std::vector<uint32_t> order(chunkCount);
+	for (uint32_t i = 0; i < chunkCount; i++)
+		order[i] = i;
+
+	std::partial_sort(order.begin(), order.begin() + wantedCount, order.end(), [&](uint32_t l, uint32_t r) { return distances[l] < distances[r]; });
+
+	for (uint32_t i = 0; i < wantedCount; i++)
+		residency.chunks[order[i]].lastUsed = frame;
+
+	residency.stats.wantedChunks = 0;
+
+	uint32_t waiting = 0;
+
+	for (uint32_t i = 0; i < wantedCount; i++)
+	{
+		ChunkResidency& chunk = residency.chunks[order[i]];
+
+		if (chunk.state != ChunkUnloaded)
+			continue;
+
+		residency.stats.wantedChunks++;
+
+		if (loads.size() >= maxLoads)
+			continue;
+
+		// an evicted slot only becomes free once frames that may draw from it complete, so the load starts on a later frame;
+		// slots evicted on earlier frames are already on their way, so only evict for chunks they don't cover
+		if (residency.freeSlots.empty())
+		{
+			if (++waiting > residency.retiredSlots.size())
+				evictLeastRecentlyUsed(residency, frame);
+
+			continue;
+		}
+
+		chunk.state = ChunkLoading;
+		chunk.slot = residency.freeSlots.back();
+		residency.freeSlots.pop_back();
+
+		residency.stats.loadingChunks++;
+		residency.stats.loads++;
+
+		loads.push_back(order[i]);
+	}
+}
+
+void completeLoad(Residency& residency, uint32_t chunk)
+{
+	assert(residency.chunks[chunk].state == ChunkLoading);
+
+	residency.chunks[chunk].state = ChunkResident;
+
+	residency.stats.loadingChunks--;
+	residency.stats.residentChunks++;
+}
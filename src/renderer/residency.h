@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <vector>
+
+// Residency policy; independent of Vulkan so that it can be driven by a simulated frame/timeline sequence on the CPU
+enum ChunkState
+{
+	ChunkUnloaded,
+	ChunkLoading,
+	ChunkResident,
+};
+
+struct ChunkResidency
+{
+	uint32_t state;
+	uint32_t slot;
+	uint64_t lastUsed; // last frame the chunk was among the nearest chunks that fit the budget
+};
+
+struct ResidencyStats
+{
+	uint32_t chunkCount;
+	uint32_t slotCount;
+
+	uint32_t residentChunks;
+	uint32_t loadingChunks;
+	uint32_t wantedChunks; // nearest chunks that fit the budget but aren't resident yet
+
+	uint64_t loads; // totals since creation
+	uint64_t evictions;
+};
+
+struct RetiredSlot
+{
+	uint32_t slot;
+	uint64_t frame; // the slot can be written once this frame completes
+};
+
+struct Residency
+{
+	std::vector<ChunkResidency> chunks;
+
+	std::vector<uint32_t> freeSlots;
+	std::vector<RetiredSlot> retiredSlots; // evicted, but frames in flight may still read them
+
+	ResidencyStats stats;
+};
+
+void createResidency(Residency& result, uint32_t chunkCount, uint32_t slotCount);
+
+// Chunks closest to the camera (by distance, in order) are wanted as long as they fit into the slot budget; wanted
+// chunks that aren't resident get a slot, evicting the least recently wanted resident chunk if necessary. frame is the
+// frame about to be recorded and completedFrame the last frame the GPU finished. Returns chunks to load in loads.
+void updateResidency(Residency& residency, const float* distances, uint64_t frame, uint64_t completedFrame, uint32_t maxLoads, std::vector<uint32_t>& loads);
+
+void completeLoad(Residency& residency, uint32_t chunk);
@@ -0,0 +1,453 @@
+#include "common.h"
+#include "resources.h"
+#include "swapchain.h"
+
+#include <string.h>
+
+uint32_t selectMemoryType(const VkPhysicalDeviceMemoryProperties& memoryProperties, uint32_t memoryTypeBits, VkMemoryPropertyFlags flags)
+{
+	for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+	{
+		if ((memoryTypeBits & (1 << i)) != 0 && (memoryProperties.memoryTypes[i].propertyFlags & flags) == flags)
+		{
+			return i;
+		}
+	}
+
+	assert(!"No compatible memory type found");
+	return ~0u;
+}
+
+void createBuffer(Buffer& result, VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties, size_t size, VkBufferUsageFlags usage, VkMemoryPropertyFlags memoryFlags)
+{
+	VkBufferCreateInfo createInfo = { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+	createInfo.size = size;
+	createInfo.usage = usage;
+
+	VkBuffer buffer = 0;
+	VK_CHECK(vkCreateBuffer(device, &createInfo, 0, &buffer));
+
+	VkMemoryRequirements memoryRequirements;
+	vkGetBufferMemoryRequirements(device, buffer, &memoryRequirements);
+
+	uint32_t memoryTypeIndex = selectMemoryType(memoryProperties, memoryRequirements.memoryTypeBits, memoryFlags);
+	assert(memoryTypeIndex != ~0u);
+
+	VkMemoryAllocateInfo allocateInfo = { VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO };
+	allocateInfo.allocationSize = memoryRequirements.size;
+	allocateInfo.memoryTypeIndex = memoryTypeIndex;
+
+#ifdef VK_KHR_buffer_device_address
+	// memory has to be allocated for device addresses to be queried for buffers bound to it
+	VkMemoryAllocateFlagsInfo flagsInfo = { VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO };
+	flagsInfo.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT_KHR;
+
+	if (usage & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT_KHR)
+		allocateInfo.pNext = &flagsInfo;
+#endif
+
+	VkDeviceMemory memory = 0;
+	VK_CHECK(vkAllocateMemory(device, &allocateInfo, 0, &memory));
+
+	VK_CHECK(vkBindBufferMemory(device, buffer, memory, 0));
+
+	void* data = 0;
+	if (memoryFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+		VK_CHECK(vkMapMemory(device, memory, 0, size, 0, &data));
+
+	result.buffer = buffer;
+	result.memory = memory;
+	result.data = data;
+	result.size = size;
+}
+
+void destroyBuffer(Buffer& buffer, VkDevice device)
+{
+	vkFreeMemory(device, buffer.memory, VK_NULL_HANDLE);
+	vkDestroyBuffer(device, buffer.buffer, VK_NULL_HANDLE);
+}
+
+uint64_t getBufferAddress(VkDevice device, const Buffer& buffer)
+{
+#ifdef VK_KHR_buffer_device_address
+	VkBufferDeviceAddressInfoKHR addressInfo = { VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO_KHR };
+	addressInfo.buffer = buffer.buffer;
+
+	return vkGetBufferDeviceAddressKHR(device, &addressInfo);
+#else
+	assert(!"Buffer device addresses are not available in this build");
+	return 0;
+#endif
+}
+
+VkImageCreateInfo getImageInfo(uint32_t width, uint32_t height, VkFormat format, VkImageUsageFlags usage, VkSampleCountFlagBits samples, uint32_t mipLevels)
+{
+	VkImageCreateInfo createInfo = { VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO };
+	createInfo.imageType = VK_IMAGE_TYPE_2D;
+	createInfo.format = format;
+	createInfo.extent = { width, height, 1 };
+	createInfo.mipLevels = mipLevels;
+	createInfo.arrayLayers = 1;
+	createInfo.samples = samples;
+	createInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	createInfo.usage = usage;
+	createInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	return createInfo;
+}
+
+void createImage(Image& result, VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties, uint32_t width, uint32_t height, VkFormat format, VkImageUsageFlags usage, VkSampleCountFlagBits samples, uint32_t mipLevels)
+{
+	VkImageCreateInfo createInfo = getImageInfo(width, height, format, usage, samples, mipLevels);
+
+	VkImage image = 0;
+	VK_CHECK(vkCreateImage(device, &createInfo, 0, &image));
+
+	VkMemoryRequirements memoryRequirements;
+	vkGetImageMemoryRequirements(device, image, &memoryRequirements);
+
+	uint32_t memoryTypeIndex = ~0u;
+
+	// transient attachments never leave tile memory on tiled GPUs, so their memory doesn't have to be backed
+	if (usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT)
+	{
+		for (uint32_t i = 0; i < memoryProperties.memoryTypeCount && memoryTypeIndex == ~0u; i++)
+		{
+			if ((memoryRequirements.memoryTypeBits & (1 << i)) != 0 && (memoryProperties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) != 0)
+				memoryTypeIndex = i;
+		}
+	}
+
+	bool lazilyAllocated = memoryTypeIndex != ~0u;
+
+	if (!lazilyAllocated)
+		memoryTypeIndex = selectMemoryType(memoryProperties, memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	assert(memoryTypeIndex != ~0u);
+
+	VkMemoryAllocateInfo allocateInfo = { VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO };
+	allocateInfo.allocationSize = memoryRequirements.size;
+	allocateInfo.memoryTypeIndex = memoryTypeIndex;
+
+	VkDeviceMemory memory = 0;
+	VK_CHECK(vkAllocateMemory(device, &allocateInfo, 0, &memory));
+
+	VK_CHECK(vkBindImageMemory(device, image, memory, 0));
+
+	result.image = image;
+	result.imageView = createImageView(device, image, format, format == VK_FORMAT_D32_SFLOAT ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT, mipLevels);
+	result.memory = memory;
+	result.width = width;
+	result.height = height;
+	result.mipLevels = mipLevels;
+	result.memorySize = memoryRequirements.size;
+	result.lazilyAllocated = lazilyAllocated;
+}
+
+VkDeviceSize getImageMemorySize(VkDevice device, uint32_t width, uint32_t height, VkFormat format, VkImageUsageFlags usage, VkSampleCountFlagBits samples)
+{
+	VkImageCreateInfo createInfo = getImageInfo(width, height, format, usage, samples);
+
+	VkImage image = 0;
+	VK_CHECK(vkCreateImage(device, &createInfo, 0, &image));
+
+	VkMemoryRequirements memoryRequirements;
+	vkGetImageMemoryRequirements(device, image, &memoryRequirements);
+
+	vkDestroyImage(device, image, VK_NULL_HANDLE);
+
+	return memoryRequirements.size;
+}
+
+void destroyImage(Image& image, VkDevice device)
+{
+	vkDestroyImageView(device, image.imageView, VK_NULL_HANDLE);
+	vkDestroyImage(device, image.image, VK_NULL_HANDLE);
+	vkFreeMemory(device, image.memory, VK_NULL_HANDLE);
+}
+
+void deferDestroyBuffer(DeletionQueue& queue, uint64_t value, Buffer& buffer)
+{
+	deferDestroy(queue, value, VK_OBJECT_TYPE_BUFFER, (uint64_t)buffer.buffer);
+	deferDestroy(queue, value, VK_OBJECT_TYPE_DEVICE_MEMORY, (uint64_t)buffer.memory);
+
+	buffer = Buffer();
+}
+
+void deferDestroyImage(DeletionQueue& queue, uint64_t value, Image& image)
+{
+	deferDestroy(queue, value, VK_OBJECT_TYPE_IMAGE_VIEW, (uint64_t)image.imageView);
+	deferDestroy(queue, value, VK_OBJECT_TYPE_IMAGE, (uint64_t)image.image);
+	deferDestroy(queue, value, VK_OBJECT_TYPE_DEVICE_MEMORY, (uint64_t)image.memory);
+
+	image = Image();
+}
+
+void createUploader(Uploader& result, VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties, VkQueue queue, uint32_t familyIndex, uint32_t dstFamilyIndex, bool timelineSemaphores, size_t scratchSize)
+{
+	result.device = device;
+	result.queue = queue;
+	result.familyIndex = familyIndex;
+	result.dstFamilyIndex = dstFamilyIndex;
+
+	VkCommandPoolCreateInfo poolInfo = { VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+	poolInfo.queueFamilyIndex = familyIndex;
+
+	VK_CHECK(vkCreateCommandPool(device, &poolInfo, VK_NULL_HANDLE, &result.commandPool));
+
+	VkCommandBufferAllocateInfo commandBufferInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
+	commandBufferInfo.commandPool = result.commandPool;
+	commandBufferInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	commandBufferInfo.commandBufferCount = 1;
+
+	VK_CHECK(vkAllocateCommandBuffers(device, &commandBufferInfo, &result.commandBuffer));
+
+	createTimeline(result.timeline, device, timelineSemaphores);
+	result.pendingValue = 0;
+	result.uploadedBytes = 0;
+
+	createBuffer(result.scratch, device, memoryProperties, scratchSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+	result.pendingAcquires.clear();
+	result.pendingImageAcquires.clear();
+}
+
+void destroyUploader(Uploader& uploader)
+{
+	VK_CHECK(vkQueueWaitIdle(uploader.queue));
+
+	destroyBuffer(uploader.scratch, uploader.device);
+
+	destroyTimeline(uploader.timeline);
+
+	vkDestroyCommandPool(uploader.device, uploader.commandPool, VK_NULL_HANDLE);
+}
+
+static void submitCopy(Uploader& uploader, const Buffer& source, VkDeviceSize sourceOffset, const Buffer& buffer, VkDeviceSize offset, VkDeviceSize size, bool release)
+{
+	VK_CHECK(vkResetCommandPool(uploader.device, uploader.commandPool, 0));
+
+	VkCommandBufferBeginInfo beginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	VK_CHECK(vkBeginCommandBuffer(uploader.commandBuffer, &beginInfo));
+
+	VkBufferCopy region = { sourceOffset, offset, size };
+	vkCmdCopyBuffer(uploader.commandBuffer, source.buffer, buffer.buffer, 1, &region);
+
+	uploader.uploadedBytes += size;
+
+	// the release has to follow every copy into the buffer; barriers cover all earlier submissions to the queue
+	if (release && uploader.familyIndex != uploader.dstFamilyIndex)
+	{
+		VkBufferMemoryBarrier barrier = { VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER };
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = 0;
+		barrier.srcQueueFamilyIndex = uploader.familyIndex;
+		barrier.dstQueueFamilyIndex = uploader.dstFamilyIndex;
+		barrier.buffer = buffer.buffer;
+		barrier.offset = 0;
+		barrier.size = VK_WHOLE_SIZE;
+
+		vkCmdPipelineBarrier(uploader.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, 0, 1, &barrier, 0, 0);
+
+		uploader.pendingAcquires.push_back(barrier);
+	}
+
+	VK_CHECK(vkEndCommandBuffer(uploader.commandBuffer));
+
+	submitTimeline(uploader.timeline, uploader.queue, uploader.commandBuffer);
+}
+
+void uploadBuffer(Uploader& uploader, const Buffer& buffer, const void* data, size_t size)
+{
+	assert(size <= buffer.size);
+
+	for (size_t offset = 0; offset < size; offset += uploader.scratch.size)
+	{
+		size_t chunk = size - offset < uploader.scratch.size ? size - offset : uploader.scratch.size;
+
+		// scratch memory and the command buffer are reused, so the previous chunk has to be done with them
+		waitTimeline(uploader.timeline, uploader.timeline.submitted);
+
+		memcpy(uploader.scratch.data, static_cast<const char*>(data) + offset, chunk);
+
+		submitCopy(uploader, uploader.scratch, 0, buffer, offset, chunk, offset + chunk == size);
+	}
+
+	uploader.pendingValue = uploader.timeline.semaphore ? uploader.timeline.submitted : 0;
+}
+
+uint64_t uploadBuffer(Uploader& uploader, const Buffer& buffer, const Buffer& staging, size_t size)
+{
+	assert(size <= buffer.size && size <= staging.size);
+
+	// the command buffer is reused
+	waitTimeline(uploader.timeline, uploader.timeline.submitted);
+
+	submitCopy(uploader, staging, 0, buffer, 0, size, true);
+
+	uploader.pendingValue = uploader.timeline.semaphore ? uploader.timeline.submitted : 0;
+
+	return uploader.timeline.submitted;
+}
+
+static void submitImageCopy(Uploader& uploader, const Image& image, const VkBufferImageCopy* regions, uint32_t regionCount, VkDeviceSize size, bool first, bool last)
+{
+	VK_CHECK(vkResetCommandPool(uploader.device, uploader.commandPool, 0));
+
+	VkCommandBufferBeginInfo beginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	VK_CHECK(vkBeginCommandBuffer(uploader.commandBuffer, &beginInfo));
+
+	VkImageMemoryBarrier barrier = { VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = image.image;
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.levelCount = image.mipLevels;
+	barrier.subresourceRange.layerCount = 1;
+
+	// earlier contents don't matter; later submissions are ordered after this one by the host wait between them
+	if (first)
+	{
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+
+		vkCmdPipelineBarrier(uploader.commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, 0, 0, 0, 1, &barrier);
+	}
+
+	vkCmdCopyBufferToImage(uploader.commandBuffer, uploader.scratch.buffer, image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, regionCount, regions);
+
+	uploader.uploadedBytes += size;
+
+	// the layout transition is part of the release when ownership changes; the consumer repeats it in the acquire
+	if (last)
+	{
+		bool release = uploader.familyIndex != uploader.dstFamilyIndex;
+
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = 0;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		barrier.srcQueueFamilyIndex = release ? uploader.familyIndex : VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = release ? uploader.dstFamilyIndex : VK_QUEUE_FAMILY_IGNORED;
+
+		vkCmdPipelineBarrier(uploader.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, 0, 0, 0, 1, &barrier);
+
+		if (release)
+			uploader.pendingImageAcquires.push_back(barrier);
+	}
+
+	VK_CHECK(vkEndCommandBuffer(uploader.commandBuffer));
+
+	submitTimeline(uploader.timeline, uploader.queue, uploader.commandBuffer);
+}
+
+void uploadImage(Uploader& uploader, const Image& image, const void* data, size_t size, uint32_t blockSize, uint32_t blockBytes)
+{
+	std::vector<VkBufferImageCopy> regions;
+
+	size_t dataOffset = 0;
+	size_t scratchOffset = 0;
+	bool first = true;
+
+	// scratch memory and the command buffer are reused, so the previous upload has to be done with them
+	waitTimeline(uploader.timeline, uploader.timeline.submitted);
+
+	for (uint32_t mip = 0; mip < image.mipLevels; mip++)
+	{
+		uint32_t width = image.width >> mip ? image.width >> mip : 1;
+		uint32_t height = image.height >> mip ? image.height >> mip : 1;
+
+		uint32_t blockRows = (height + blockSize - 1) / blockSize;
+		size_t rowSize = size_t((width + blockSize - 1) / blockSize) * blockBytes;
+
+		assert(rowSize <= uploader.scratch.size);
+		assert(dataOffset + rowSize * blockRows <= size);
+
+		for (uint32_t row = 0; row < blockRows;)
+		{
+			size_t available = (uploader.scratch.size - scratchOffset) / rowSize;
+
+			if (available == 0)
+			{
+				submitImageCopy(uploader, image, regions.data(), uint32_t(regions.size()), scratchOffset, first, false);
+
+				regions.clear();
+				scratchOffset = 0;
+				first = false;
+
+				waitTimeline(uploader.timeline, uploader.timeline.submitted);
+				continue;
+			}
+
+			uint32_t count = available < blockRows - row ? uint32_t(available) : blockRows - row;
+
+			memcpy(static_cast<char*>(uploader.scratch.data) + scratchOffset, static_cast<const char*>(data) + dataOffset + row * rowSize, count * rowSize);
+
+			// partial blocks at the edges are copied with the extent of the mip
+			VkBufferImageCopy region = {};
+			region.bufferOffset = scratchOffset;
+			region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			region.imageSubresource.mipLevel = mip;
+			region.imageSubresource.layerCount = 1;
+			region.imageOffset.y = int32_t(row * blockSize);
+			region.imageExtent.width = width;
+			region.imageExtent.height = (row + count) * blockSize < height ? count * blockSize : height - row * blockSize;
+			region.imageExtent.depth = 1;
+
+			regions.push_back(region);
+
+			scratchOffset += count * rowSize;
+			row += count;
+		}
+
+		dataOffset += rowSize * blockRows;
+	}
+
+	assert(dataOffset == size);
+	(void)size;
+
+	submitImageCopy(uploader, image, regions.data(), uint32_t(regions.size()), scratchOffset, first, true);
+
+	uploader.pendingValue = uploader.timeline.semaphore ? uploader.timeline.submitted : 0;
+}
+
+uint64_t acquireUploads(Uploader& uploader, VkCommandBuffer commandBuffer, VkPipelineStageFlags dstStageMask, VkAccessFlags dstAccessMask)
+{
+	if (!uploader.pendingAcquires.empty())
+	{
+		for (size_t i = 0; i < uploader.pendingAcquires.size(); i++)
+		{
+			uploader.pendingAcquires[i].srcAccessMask = 0;
+			uploader.pendingAcquires[i].dstAccessMask = dstAccessMask;
+		}
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dstStageMask, 0, 0, 0, uint32_t(uploader.pendingAcquires.size()), uploader.pendingAcquires.data(), 0, 0);
+
+		uploader.pendingAcquires.clear();
+	}
+
+	if (!uploader.pendingImageAcquires.empty())
+	{
+		for (size_t i = 0; i < uploader.pendingImageAcquires.size(); i++)
+		{
+			uploader.pendingImageAcquires[i].srcAccessMask = 0;
+			uploader.pendingImageAcquires[i].dstAccessMask = dstAccessMask;
+		}
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dstStageMask, 0, 0, 0, 0, 0, uint32_t(uploader.pendingImageAcquires.size()), uploader.pendingImageAcquires.data());
+
+		uploader.pendingImageAcquires.clear();
+	}
+
+	uint64_t value = uploader.pendingValue;
+	uploader.pendingValue = 0;
+
+	return value;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "sync.h"
+
+struct Buffer
+{
+	VkBuffer buffer;
+	VkDeviceMemory memory;
+	void* data; // 0 unless the memory is host visible
+	size_t size;
+};
+
+struct Image
+{
+	VkImage image;
+	VkImageView imageView;
+	VkDeviceMemory memory;
+	uint32_t width, height;
+	uint32_t mipLevels;
+
+	VkDeviceSize memorySize;
+	bool lazilyAllocated; // memory may only be committed as the GPU needs it, or never on tiled GPUs
+};
+
+uint32_t selectMemoryType(const VkPhysicalDeviceMemoryProperties& memoryProperties, uint32_t memoryTypeBits, VkMemoryPropertyFlags flags);
+
+// Buffers with VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT_KHR get memory that device addresses can be taken of
+void createBuffer(Buffer& result, VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties, size_t size, VkBufferUsageFlags usage, VkMemoryPropertyFlags memoryFlags);
+void destroyBuffer(Buffer& buffer, VkDevice device);
+
+// Requires a device created with buffer device addresses enabled
+uint64_t getBufferAddress(VkDevice device, const Buffer& buffer);
+
+// Single layer, optimally tiled 2D image
+VkImageCreateInfo getImageInfo(uint32_t width, uint32_t height, VkFormat format, VkImageUsageFlags usage, VkSampleCountFlagBits samples, uint32_t mipLevels = 1);
+
+// 2D image in device local memory, with a view of the whole image; VK_FORMAT_D32_SFLOAT images get a depth view.
+// Images with VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT get lazily allocated memory when the device has it
+void createImage(Image& result, VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties, uint32_t width, uint32_t height, VkFormat format, VkImageUsageFlags usage, VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT, uint32_t mipLevels = 1);
+void destroyImage(Image& image, VkDevice device);
+
+// Memory an image with these parameters would need, without allocating it
+VkDeviceSize getImageMemorySize(VkDevice device, uint32_t width, uint32_t height, VkFormat format, VkImageUsageFlags usage, VkSampleCountFlagBits samples);
+
+// For buffers that may still be in use by submitted work, e.g. transient or resized buffers
+void deferDestroyBuffer(DeletionQueue& queue, uint64_t value, Buffer& buffer);
+void deferDestroyImage(DeletionQueue& queue, uint64_t value, Image& image);
+
+// Copies data into device local buffers and images on a (preferably dedicated) transfer queue through a host visible
+// scratch buffer. When the transfer family differs from the family that consumes them, the transfer queue releases
+// ownership and the consumer has to record the matching acquire barriers (see acquireUploads) after waiting on the timeline
+struct Uploader
+{
+	VkDevice device;
+
+	VkQueue queue;
+	uint32_t familyIndex;
+	uint32_t dstFamilyIndex;
+
+	VkCommandPool commandPool;
+	VkCommandBuffer commandBuffer;
+
+	Timeline timeline; // without a timeline semaphore uploads wait for the transfer queue on the host
+	uint64_t pendingValue; // value the consumer hasn't waited on yet, 0 if none
+
+	Buffer scratch;
+
+	uint64_t uploadedBytes; // copied to device buffers since creation
+
+	std::vector<VkBufferMemoryBarrier> pendingAcquires;
+	std::vector<VkImageMemoryBarrier> pendingImageAcquires;
+};
+
+void createUploader(Uploader& result, VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties, VkQueue queue, uint32_t familyIndex, uint32_t dstFamilyIndex, bool timelineSemaphores, size_t scratchSize);
+void destroyUploader(Uploader& uploader);
+
+// The buffer must be created with VK_BUFFER_USAGE_TRANSFER_DST_BIT and must not be in use by the consumer queue
+void uploadBuffer(Uploader& uploader, const Buffer& buffer, const void* data, size_t size);
+
+// Copies from a caller owned host visible buffer, e.g. one that data was decoded into directly; returns the uploader
+// timeline value after which staging can be destroyed
+uint64_t uploadBuffer(Uploader& uploader, const Buffer& buffer, const Buffer& staging, size_t size);
+
+// Copies a mip chain into an image with VK_IMAGE_USAGE_TRANSFER_DST_BIT that isn't in use. Mips are tightly packed from
+// mip 0 to image.mipLevels - 1, each in rows of blockSize x blockSize blocks of blockBytes (blockSize is 1 and blockBytes
+// the texel size for uncompressed formats). Small mips share a submission, mips larger than the scratch buffer are split
+// at block rows. The image ends up in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+void uploadImage(Uploader& uploader, const Image& image, const void* data, size_t size, uint32_t blockSize, uint32_t blockBytes);
+
+// Records ownership acquires for uploads submitted since the last call; returns the timeline value the submit containing
+// commandBuffer has to wait on at dstStageMask, or 0 if there is nothing to wait for
+uint64_t acquireUploads(Uploader& uploader, VkCommandBuffer commandBuffer, VkPipelineStageFlags dstStageMask, VkAccessFlags dstAccessMask);
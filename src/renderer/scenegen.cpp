@@ -0,0 +1,441 @@
+#include "scenegen.h"
+#include "normals.h"
+#include "objparser.h"
+#include "timer.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <thread>
+
+const float kPi = 3.14159265f;
+
+// every unique mesh is a unit sphere with bumps of this height
+const float kDisplacement = 0.15f;
+
+static uint32_t hash(uint32_t x)
+{
+	x ^= x >> 16;
+	x *= 0x7feb352d;
+	x ^= x >> 15;
+	x *= 0x846ca68b;
+	x ^= x >> 16;
+	return x;
+}
+
+// uniform in [0, 1); state is advanced so that consecutive calls give independent values
+static float random(uint32_t& state)
+{
+	state = hash(state + 0x9e3779b9);
+	return float(state >> 8) * (1.f / 16777216.f);
+}
+
+bool isSceneSpec(const char* path)
+{
+	return strncmp(path, "scene:", 6) == 0;
+}
+
+static uint64_t parseCount(const char* s)
+{
+	char* end = 0;
+	double value = strtod(s, &end);
+
+	if (*end == 'K' || *end == 'k')
+		value *= 1e3;
+	else if (*end == 'M' || *end == 'm')
+		value *= 1e6;
+
+	return value > 0 ? uint64_t(value) : 0;
+}
+
+bool parseSceneSettings(SceneSettings& result, const char* spec)
+{
+	if (!isSceneSpec(spec))
+		return false;
+
+	result.triangleCount = 1000000;
+	result.verticesPerTriangle = 0.5f;
+	result.meshCount = 1;
+	result.instanceCount = 1;
+	result.layout = SceneLayoutGrid;
+	result.seed = 1;
+
+	std::string settings(spec + 6);
+
+	for (size_t begin = 0; begin < settings.size();)
+	{
+		size_t end = settings.find(',', begin);
+		end = end == std::string::npos ? settings.size() : end;
+
+		std::string item = settings.substr(begin, end - begin);
+		size_t equals = item.find('=');
+
+		if (equals == std::string::npos)
+			return false;
+
+		std::string key = item.substr(0, equals);
+		const char* value = item.c_str() + equals + 1;
+
+		if (key == "tris")
+			result.triangleCount = parseCount(value);
+		else if (key == "vpt")
+			result.verticesPerTriangle = float(atof(value));
+		else if (key == "meshes")
+			result.meshCount = uint32_t(parseCount(value));
+		else if (key == "instances")
+			result.instanceCount = uint32_t(parseCount(value));
+		else if (key == "seed")
+			result.seed = uint32_t(atoi(value));
+		else if (key == "layout" && strcmp(value, "grid") == 0)
+			result.layout = SceneLayoutGrid;
+		else if (key == "layout" && strcmp(value, "random") == 0)
+			result.layout = SceneLayoutRandom;
+		else if (key == "layout" && strcmp(value, "clusters") == 0)
+			result.layout = SceneLayoutClusters;
+		else
+			return false;
+
+		begin = end + 1;
+	}
+
+	// indices are 32-bit; every instance needs at least a couple of triangles
+	return result.triangleCount > 0 && result.triangleCount * 3 <= 0xffffffffull && result.meshCount > 0 && result.instanceCount > 0;
+}
+
+static void generateSphere(Mesh& result, uint32_t triangleCount, float verticesPerTriangle, uint32_t seed)
+{
+	// a (2h x h) grid of quads wrapped around a sphere
+	uint32_t quads = std::max(triangleCount / 2, 1u);
+	uint32_t rows = std::max(uint32_t(sqrtf(float(quads) / 2)), 1u);
+	uint32_t columns = std::max(quads / rows, 1u);
+
+	uint32_t state = hash(seed);
+
+	float frequency0 = float(2 + int(random(state) * 8));
+	float frequency1 = float(2 + int(random(state) * 8));
+	float phase = random(state) * 2 * kPi;
+
+	result.vertices.resize((rows + 1) * (columns + 1));
+
+	for (uint32_t y = 0; y <= rows; y++)
+	{
+		for (uint32_t x = 0; x <= columns; x++)
+		{
+			float u = float(x) / float(columns);
+			float v = float(y) / float(rows);
+
+			// the seam repeats the first column and the poles are single points; computing them exactly keeps the
+			// positions bitwise equal so that welding by position closes the surface
+			float theta = float(x % columns) / float(columns) * 2 * kPi;
+			float phi = v * kPi;
+
+			bool pole = y == 0 || y == rows;
+
+			float nx = pole ? 0.f : sinf(phi) * cosf(theta);
+			float ny = y == 0 ? 1.f : y == rows ? -1.f : cosf(phi);
+			float nz = pole ? 0.f : sinf(phi) * sinf(theta);
+
+			// the bumps vanish at the poles and match up at the seam
+			float radius = pole ? 1.f : 1 + kDisplacement * sinf(theta * frequency0 + phase) * sinf(phi * frequency1);
+
+			Vertex& vertex = result.vertices[y * (columns + 1) + x];
+
+			vertex.vx = nx * radius;
+			vertex.vy = ny * radius;
+			vertex.vz = nz * radius;
+			vertex.nx = nx;
+			vertex.ny = ny;
+			vertex.nz = nz;
+			vertex.tu = u;
+			vertex.tv = v;
+		}
+	}
+
+	result.indices.resize(rows * columns * 6);
+
+	for (uint32_t y = 0; y < rows; y++)
+	{
+		for (uint32_t x = 0; x < columns; x++)
+		{
+			uint32_t a = y * (columns + 1) + x;
+			uint32_t b = a + 1;
+			uint32_t c = a + columns + 1;
+			uint32_t d = c + 1;
+
+			uint32_t* quad = &result.indices[(y * columns + x) * 6];
+
+			// counter-clockwise seen from outside, matching the normals
+			quad[0] = a, quad[1] = b, quad[2] = c;
+			quad[3] = b, quad[4] = d, quad[5] = c;
+		}
+	}
+
+	// the grid shares vertices at ~0.5 per triangle; giving a fraction of triangles their own vertices raises the ratio
+	// up to 3. Split vertices get unique texture coordinates so that welding on load keeps them apart
+	float split = std::min(std::max((verticesPerTriangle - 0.5f) / 2.5f, 0.f), 1.f);
+
+	size_t gridVertices = result.vertices.size();
+
+	for (size_t i = 0; split > 0 && i < result.indices.size() / 3; i++)
+	{
+		if (float(hash(uint32_t(i) ^ seed) >> 8) * (1.f / 16777216.f) >= split)
+			continue;
+
+		for (int k = 0; k < 3; k++)
+		{
+			Vertex vertex = result.vertices[result.indices[i * 3 + k]];
+			vertex.tu = -1.f - float(i & 0xffff);
+			vertex.tv = -1.f - float(i >> 16);
+
+			result.indices[i * 3 + k] = uint32_t(result.vertices.size());
+			result.vertices.push_back(vertex);
+		}
+	}
+
+	if (result.vertices.size() == gridVertices)
+		return;
+
+	// drop grid vertices that no triangle references anymore
+	std::vector<uint32_t> remap(result.vertices.size(), ~0u);
+	size_t vertexCount = 0;
+
+	for (size_t i = 0; i < result.indices.size(); i++)
+		remap[result.indices[i]] = 0;
+
+	for (size_t i = 0; i < result.vertices.size(); i++)
+		if (remap[i] != ~0u)
+		{
+			remap[i] = uint32_t(vertexCount);
+			result.vertices[vertexCount++] = result.vertices[i];
+		}
+
+	for (size_t i = 0; i < result.indices.size(); i++)
+		result.indices[i] = remap[result.indices[i]];
+
+	result.vertices.resize(vertexCount);
+}
+
+void generateScene(Mesh& result, const SceneSettings& settings)
+{
+	uint32_t meshCount = std::min(settings.meshCount, settings.instanceCount);
+	uint32_t instanceTriangles = uint32_t(std::max(settings.triangleCount / settings.instanceCount, uint64_t(2)));
+
+	std::vector<Mesh> meshes(meshCount);
+
+	// sphere directions are only approximate normals once the surface is displaced
+	NormalSettings normalSettings = { 180.f, NormalWeightAngle };
+
+	for (uint32_t i = 0; i < meshCount; i++)
+	{
+		generateSphere(meshes[i], instanceTriangles, settings.verticesPerTriangle, hash(settings.seed * 977 + i));
+		generateNormals(meshes[i], normalSettings, std::thread::hardware_concurrency());
+	}
+
+	const float extent[3] = { 0.9f, 0.9f, 0.45f };
+
+	// instances are sized to the cells of a grid that holds all of them, whatever the layout
+	uint32_t cells = 1;
+	while (uint64_t(cells) * cells * cells < settings.instanceCount)
+		cells++;
+
+	float cellSize[3] = { 2 * extent[0] / cells, 2 * extent[1] / cells, 2 * extent[2] / cells };
+	float scale = std::min(cellSize[0], std::min(cellSize[1], cellSize[2])) * 0.5f / (1 + kDisplacement);
+
+	uint32_t state = hash(settings.seed);
+
+	uint32_t clusterCount = std::max(settings.instanceCount / 64, 1u);
+	std::vector<float> clusters(clusterCount * 3);
+
+	for (size_t i = 0; i < clusters.size(); i++)
+		clusters[i] = (random(state) * 2 - 1) * extent[i % 3] * 0.8f;
+
+	result.vertices.clear();
+	result.indices.clear();
+	result.submeshes.clear();
+	result.materials.resize(meshCount);
+
+	for (uint32_t i = 0; i < meshCount; i++)
+	{
+		uint32_t color = hash(settings.seed + i);
+
+		Material& material = result.materials[i];
+		material.diffuse[0] = 0.3f + float(color & 0xff) / 255.f * 0.7f;
+		material.diffuse[1] = 0.3f + float((color >> 8) & 0xff) / 255.f * 0.7f;
+		material.diffuse[2] = 0.3f + float((color >> 16) & 0xff) / 255.f * 0.7f;
+		material.diffuse[3] = 1.f;
+		material.diffuseTexture.clear();
+	}
+
+	size_t vertexTotal = 0, indexTotal = 0;
+
+	for (uint32_t i = 0; i < settings.instanceCount; i++)
+	{
+		vertexTotal += meshes[i % meshCount].vertices.size();
+		indexTotal += meshes[i % meshCount].indices.size();
+	}
+
+	result.vertices.reserve(vertexTotal);
+	result.indices.reserve(indexTotal);
+
+	// instances are emitted grouped by mesh, which keeps submeshes sorted by material
+	for (uint32_t m = 0; m < meshCount; m++)
+	{
+		const Mesh& mesh = meshes[m];
+
+		for (uint32_t i = m; i < settings.instanceCount; i += meshCount)
+		{
+			float position[3];
+
+			if (settings.layout == SceneLayoutGrid)
+			{
+				uint32_t cell[3] = { i % cells, (i / cells) % cells, i / (cells * cells) };
+
+				for (int k = 0; k < 3; k++)
+					position[k] = -extent[k] + (float(cell[k]) + 0.5f) * cellSize[k];
+			}
+			else if (settings.layout == SceneLayoutRandom)
+			{
+				for (int k = 0; k < 3; k++)
+					position[k] = (random(state) * 2 - 1) * (extent[k] - cellSize[k] * 0.5f);
+			}
+			else
+			{
+				const float* center = &clusters[(hash(i ^ settings.seed) % clusterCount) * 3];
+
+				// like random placement, the centers keep half a cell from the bounds so that the instances stay inside
+				float limit[3] = { extent[0] - cellSize[0] * 0.5f, extent[1] - cellSize[1] * 0.5f, extent[2] - cellSize[2] * 0.5f };
+
+				// sum of uniforms approximates a normal distribution around the cluster center
+				for (int k = 0; k < 3; k++)
+				{
+					float offset = (random(state) + random(state) + random(state) - 1.5f) * cellSize[k] * 2;
+					position[k] = std::min(std::max(center[k] + offset, -limit[k]), limit[k]);
+				}
+			}
+
+			float angle = random(state) * 2 * kPi;
+			float c = cosf(angle), s = sinf(angle);
+
+			Submesh submesh = {};
+			submesh.indexOffset = uint32_t(result.indices.size());
+			submesh.indexCount = uint32_t(mesh.indices.size());
+			submesh.material = m;
+			submesh.center[0] = position[0];
+			submesh.center[1] = position[1];
+			submesh.center[2] = position[2];
+			submesh.radius = scale * (1 + kDisplacement);
+
+			uint32_t vertexOffset = uint32_t(result.vertices.size());
+
+			for (size_t j = 0; j < mesh.vertices.size(); j++)
+			{
+				Vertex v = mesh.vertices[j];
+
+				// rotation around Y, then uniform scale and translation
+				float vx = v.vx * c - v.vz * s, vz = v.vx * s + v.vz * c;
+				float nx = v.nx * c - v.nz * s, nz = v.nx * s + v.nz * c;
+
+				v.vx = vx * scale + position[0];
+				v.vy = v.vy * scale + position[1];
+				v.vz = vz * scale + position[2];
+				v.nx = nx;
+				v.nz = nz;
+
+				result.vertices.push_back(v);
+			}
+
+			for (size_t j = 0; j < mesh.indices.size(); j++)
+				result.indices.push_back(mesh.indices[j] + vertexOffset);
+
+			result.submeshes.push_back(submesh);
+		}
+	}
+
+	result.indexSize = sizeof(uint32_t);
+	result.hasNormals = true;
+}
+
+static size_t getFileSize(const char* path)
+{
+	FILE* file = fopen(path, "rb");
+	if (!file)
+		return 0;
+
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fclose(file);
+
+	return size > 0 ? size_t(size) : 0;
+}
+
+void benchmarkScene(const char* spec, const char* objPath)
+{
+	SceneSettings settings;
+	if (!parseSceneSettings(settings, spec))
+	{
+		printf("Invalid scene %s\n", spec);
+		return;
+	}
+
+	double generateStart = getTimeMs();
+
+	Mesh scene;
+	generateScene(scene, settings);
+
+	double generateEnd = getTimeMs();
+
+	size_t triangleCount = scene.indices.size() / 3;
+
+	printf("%d triangles, %d vertices (%.2f per triangle), %d instances of %d meshes\n", int(triangleCount), int(scene.vertices.size()),
+		double(scene.vertices.size()) / double(triangleCount), int(scene.submeshes.size()), int(scene.materials.size()));
+	printf("Generate: %.2f ms, %.2f M triangles/s\n", generateEnd - generateStart, double(triangleCount) / 1e3 / (generateEnd - generateStart));
+
+	// the .mtl goes next to the .obj, e.g. scene.obj and scene.mtl
+	std::string mtlPath = objPath;
+	size_t extension = mtlPath.rfind(".obj");
+	mtlPath = (extension == std::string::npos ? mtlPath : mtlPath.substr(0, extension)) + ".mtl";
+
+	if (!writeObjFile(scene, objPath, mtlPath.c_str()))
+	{
+		printf("Failed to write %s\n", objPath);
+		return;
+	}
+
+	double writeEnd = getTimeMs();
+
+	size_t objSize = getFileSize(objPath);
+
+	printf("Write: %.2f ms, %.2f MB\n", writeEnd - generateEnd, double(objSize) / 1e6);
+
+	scene = Mesh();
+
+	double parseStart = getTimeMs();
+
+	{
+		ObjFile file;
+		bool ok = objParseFile(file, objPath) && objValidate(file);
+
+		double parseEnd = getTimeMs();
+
+		printf("Parse: %.2f ms, %.2f MB/s, %.2f M triangles/s%s\n", parseEnd - parseStart, double(objSize) / 1e3 / (parseEnd - parseStart),
+			double(file.f_size / 9) / 1e3 / (parseEnd - parseStart), ok ? "" : " FAILED");
+	}
+
+	double loadStart = getTimeMs();
+
+	Mesh mesh;
+	bool ok = loadMesh(mesh, objPath);
+
+	double loadEnd = getTimeMs();
+
+	printf("Load: %.2f ms, %.2f M triangles/s, %d vertices, %d submeshes%s\n", loadEnd - loadStart, double(mesh.indices.size() / 3) / 1e3 / (loadEnd - loadStart),
+		int(mesh.vertices.size()), int(mesh.submeshes.size()), ok ? "" : " FAILED");
+
+	remove(objPath);
+	remove(mtlPath.c_str());
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "mesh.h"
+
+// Procedural stress scenes: a few unique meshes (displaced spheres) placed as instances, with transforms baked into
+// a single Mesh. Every instance is a submesh and every unique mesh has its own material, so the submesh, culling and
+// index batching paths are exercised like with a real scene. Output only depends on the settings.
+enum SceneLayout
+{
+	SceneLayoutGrid,
+	SceneLayoutRandom,
+	SceneLayoutClusters,
+};
+
+struct SceneSettings
+{
+	uint64_t triangleCount; // total over all instances
+	float verticesPerTriangle; // 0.5 shares grid vertices between triangles, 3 gives every triangle its own vertices
+
+	uint32_t meshCount; // unique meshes; instances cycle through them
+	uint32_t instanceCount;
+	uint32_t layout;
+
+	uint32_t seed;
+};
+
+// Scene specs look like "scene:tris=10M,vpt=0.6,meshes=4,instances=256,layout=random,seed=1"; every key is optional,
+// and counts accept K and M suffixes
+bool isSceneSpec(const char* path);
+bool parseSceneSettings(SceneSettings& result, const char* spec);
+
+// The scene fits into [-0.9, 0.9] x [-0.9, 0.9] x [-0.45, 0.45]
+void generateScene(Mesh& result, const SceneSettings& settings);
+
+// Times in-memory generation against writing the same scene as .obj and loading it back through the OBJ parser
+void benchmarkScene(const char* spec, const char* objPath);
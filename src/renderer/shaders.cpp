@@ -0,0 +1,319 @@
+#include "common.h"
+#include "shaders.h"
+#include "files.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+
+VkShaderModule loadShader(VkDevice device, const char* path)
+{
+	MappedFile file;
+	if (!mapFile(file, path))
+		return 0;
+
+	// SPIR-V is a stream of 32-bit words; mapped memory is page aligned so pCode can point straight into the mapping
+	if (file.size % 4 != 0)
+	{
+		unmapFile(file);
+		return 0;
+	}
+
+	VkShaderModuleCreateInfo createInfo = { VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO };
+	createInfo.codeSize = file.size;
+	createInfo.pCode = static_cast<const uint32_t*>(file.data);
+
+	VkShaderModule shaderModule = 0;
+	VK_CHECK(vkCreateShaderModule(device, &createInfo, VK_NULL_HANDLE, &shaderModule));
+
+	unmapFile(file);
+
+	return shaderModule;
+}
+
+#ifdef _DEBUG
+static bool compileShader(const char* source, const char* output)
+{
+	const char* sdk = getenv("VULKAN_SDK");
+
+	char command[1024];
+
+#ifdef _WIN32
+	if (sdk)
+		snprintf(command, sizeof(command), "\"\"%s\\Bin\\glslangValidator\" -V \"%s\" -o \"%s\"\"", sdk, source, output);
+#else
+	if (sdk)
+		snprintf(command, sizeof(command), "\"%s/bin/glslangValidator\" -V \"%s\" -o \"%s\"", sdk, source, output);
+#endif
+	else
+		snprintf(command, sizeof(command), "glslangValidator -V \"%s\" -o \"%s\"", source, output);
+
+	return system(command) == 0;
+}
+
+static VkShaderModule loadShaderSource(VkDevice device, const char* name, uint64_t& hash)
+{
+	std::string sourcePath = std::string("shaders/") + name + ".glsl";
+
+	MappedFile source;
+	if (!mapFile(source, sourcePath.c_str()))
+		return 0;
+
+	hash = hashBytes(source.data, source.size);
+
+	unmapFile(source);
+
+	char cachePath[256];
+	snprintf(cachePath, sizeof(cachePath), "shaders/cache/%s.%016llx.spv", name, (unsigned long long)hash);
+
+	if (getFileTime(cachePath) == 0)
+	{
+		createDirectory("shaders/cache");
+
+		if (!compileShader(sourcePath.c_str(), cachePath))
+		{
+			printf("Failed to compile %s\n", sourcePath.c_str());
+
+			// glslangValidator may leave a partial file behind on failure
+			remove(cachePath);
+			return 0;
+		}
+	}
+
+	return loadShader(device, cachePath);
+}
+#endif
+
+bool loadShader(Shader& result, VkDevice device, const char* name)
+{
+	result.module = 0;
+	result.name = name;
+	result.sourceTime = 0;
+	result.sourceHash = 0;
+
+#ifdef _DEBUG
+	std::string sourcePath = std::string("shaders/") + name + ".glsl";
+
+	result.sourceTime = getFileTime(sourcePath.c_str());
+
+	if (result.sourceTime)
+		result.module = loadShaderSource(device, name, result.sourceHash);
+#endif
+
+	// fall back to the SPIR-V produced by the build
+	if (!result.module)
+		result.module = loadShader(device, (std::string("shaders/") + name + ".spv").c_str());
+
+	return result.module != 0;
+}
+
+void destroyShader(Shader& shader, VkDevice device)
+{
+	vkDestroyShaderModule(device, shader.module, VK_NULL_HANDLE);
+	shader.module = 0;
+}
+
+bool reloadShader(Shader& shader, VkDevice device, VkShaderModule& oldModule)
+{
+#ifdef _DEBUG
+	std::string sourcePath = std::string("shaders/") + shader.name + ".glsl";
+
+	uint64_t sourceTime = getFileTime(sourcePath.c_str());
+
+	if (sourceTime == 0 || sourceTime == shader.sourceTime)
+		return false;
+
+	shader.sourceTime = sourceTime;
+
+	uint64_t hash = 0;
+	VkShaderModule module = loadShaderSource(device, shader.name.c_str(), hash);
+
+	// saving a file without changing it produces the same hash; keep the existing module and pipelines
+	if (!module || hash == shader.sourceHash)
+	{
+		if (module)
+			vkDestroyShaderModule(device, module, VK_NULL_HANDLE);
+
+		return false;
+	}
+
+	printf("Reloaded shader %s\n", shader.name.c_str());
+
+	oldModule = shader.module;
+
+	shader.module = module;
+	shader.sourceHash = hash;
+
+	return true;
+#else
+	(void)shader;
+	(void)device;
+	(void)oldModule;
+
+	return false;
+#endif
+}
+
+VkPipelineLayout createPipelineLayout(VkDevice device, VkDescriptorSetLayout setLayout)
+{
+	VkPushConstantRange pushConstantRange = { VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(Globals) };
+
+	VkPipelineLayoutCreateInfo createInfo = { VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO };
+	createInfo.setLayoutCount = setLayout ? 1 : 0;
+	createInfo.pSetLayouts = &setLayout;
+	createInfo.pushConstantRangeCount = 1;
+	createInfo.pPushConstantRanges = &pushConstantRange;
+
+	VkPipelineLayout layout = 0;
+	VK_CHECK(vkCreatePipelineLayout(device, &createInfo, 0, &layout));
+
+	return layout;
+}
+
+void createGraphicsPipelines(VkPipeline* pipelines, VkDevice device, VkPipelineCache pipelineCache, const RenderTargetInfo& target, VkShaderModule vs, VkShaderModule fs, VkPipelineLayout layout, const PipelineVariant* variants, size_t variantCount)
+{
+	// all fixed function state other than vertex input is shared between variants; shader stages differ by specialization data
+	VkPipelineVertexInputStateCreateInfo vertexInput = { VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO };
+
+	VkVertexInputBindingDescription stream = { 0,32,VK_VERTEX_INPUT_RATE_VERTEX };
+	VkVertexInputAttributeDescription attrs[3] = {};
+
+	attrs[0].location = 0;
+	attrs[0].format = VK_FORMAT_R32G32B32_SFLOAT;
+	attrs[0].offset = 0;
+
+	attrs[1].location = 1;
+	attrs[1].format = VK_FORMAT_R32G32B32_SFLOAT;
+	attrs[1].offset = 12;
+
+	attrs[2].location = 2;
+	attrs[2].format = VK_FORMAT_R32G32_SFLOAT;
+	attrs[2].offset = 24;
+
+	vertexInput.vertexAttributeDescriptionCount = 3;
+	vertexInput.pVertexAttributeDescriptions = attrs;
+	vertexInput.vertexBindingDescriptionCount = 1;
+	vertexInput.pVertexBindingDescriptions = &stream;
+
+	// pulled vertices have no fixed function input at all
+	VkPipelineVertexInputStateCreateInfo pulledInput = { VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO };
+
+	VkPipelineInputAssemblyStateCreateInfo inputAssembly = { VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO };
+	inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+	VkPipelineViewportStateCreateInfo viewportState = { VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO };
+	viewportState.viewportCount = 1;
+	viewportState.scissorCount = 1;
+
+	VkPipelineRasterizationStateCreateInfo rasterizationState = { VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO };
+	rasterizationState.lineWidth = 1.f;
+
+	VkPipelineMultisampleStateCreateInfo multisampleState = { VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO };
+	multisampleState.rasterizationSamples = target.samples;
+
+	VkPipelineDepthStencilStateCreateInfo depthStencilState = { VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO };
+	depthStencilState.depthTestEnable = target.depthFormat != VK_FORMAT_UNDEFINED;
+	depthStencilState.depthWriteEnable = target.depthFormat != VK_FORMAT_UNDEFINED;
+	depthStencilState.depthCompareOp = VK_COMPARE_OP_LESS; // depth is view space z, cleared to 1
+
+	VkPipelineColorBlendAttachmentState colorAttachmentState = {};
+	colorAttachmentState.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+	VkPipelineColorBlendStateCreateInfo colorBlendState = { VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO };
+	colorBlendState.attachmentCount = 1;
+	colorBlendState.pAttachments = &colorAttachmentState;
+
+	VkDynamicState dynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+
+	VkPipelineDynamicStateCreateInfo dynamicState = { VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO };
+	dynamicState.dynamicStateCount = sizeof(dynamicStates) / sizeof(dynamicStates[0]);
+	dynamicState.pDynamicStates = dynamicStates;
+
+#ifdef VK_KHR_dynamic_rendering
+	VkPipelineRenderingCreateInfoKHR renderingInfo = { VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR };
+	renderingInfo.colorAttachmentCount = 1;
+	renderingInfo.pColorAttachmentFormats = &target.colorFormat;
+	renderingInfo.depthAttachmentFormat = target.depthFormat;
+#else
+	assert(target.renderPass);
+#endif
+
+	VkSpecializationMapEntry specializationEntries[] = {
+		{ 0, offsetof(PipelineVariant, vertexFormat), sizeof(uint32_t) },
+		{ 1, offsetof(PipelineVariant, lightingMode), sizeof(uint32_t) },
+		{ 2, offsetof(PipelineVariant, benchmarkSeed), sizeof(uint32_t) },
+	};
+
+	std::vector<VkSpecializationInfo> specializationInfos(variantCount);
+	std::vector<VkPipelineShaderStageCreateInfo> stages(variantCount * 2);
+	std::vector<VkGraphicsPipelineCreateInfo> createInfos(variantCount);
+
+	for (size_t i = 0; i < variantCount; ++i)
+	{
+		VkSpecializationInfo& specializationInfo = specializationInfos[i];
+		specializationInfo.mapEntryCount = ARRAYSIZE(specializationEntries);
+		specializationInfo.pMapEntries = specializationEntries;
+		specializationInfo.dataSize = sizeof(PipelineVariant);
+		specializationInfo.pData = &variants[i];
+
+		VkPipelineShaderStageCreateInfo* variantStages = &stages[i * 2];
+
+		variantStages[0] = { VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO };
+		variantStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+		variantStages[0].module = vs;
+		variantStages[0].pName = "main";
+		variantStages[0].pSpecializationInfo = &specializationInfo;
+		variantStages[1] = { VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO };
+		variantStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+		variantStages[1].module = fs;
+		variantStages[1].pName = "main";
+		variantStages[1].pSpecializationInfo = &specializationInfo;
+
+		VkGraphicsPipelineCreateInfo& createInfo = createInfos[i];
+		createInfo = { VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO };
+
+		createInfo.stageCount = 2;
+		createInfo.pStages = variantStages;
+		createInfo.pVertexInputState = variants[i].vertexInput == VertexInputPulled ? &pulledInput : &vertexInput;
+		createInfo.pInputAssemblyState = &inputAssembly;
+		createInfo.pViewportState = &viewportState;
+		createInfo.pRasterizationState = &rasterizationState;
+		createInfo.pMultisampleState = &multisampleState;
+		createInfo.pDepthStencilState = &depthStencilState;
+		createInfo.pColorBlendState = &colorBlendState;
+		createInfo.pDynamicState = &dynamicState;
+
+		createInfo.layout = layout;
+		createInfo.renderPass = target.renderPass;
+
+#ifdef VK_KHR_dynamic_rendering
+		if (!target.renderPass)
+			createInfo.pNext = &renderingInfo;
+#endif
+	}
+
+	// one call for all variants lets the driver compile them in parallel and share the pipeline cache lookups
+	VK_CHECK(vkCreateGraphicsPipelines(device, pipelineCache, uint32_t(variantCount), createInfos.data(), 0, pipelines));
+}
+
+VkPipeline createGraphicsPipeline(VkDevice device, VkPipelineCache pipelineCache, const RenderTargetInfo& target, VkShaderModule vs, VkShaderModule fs, VkPipelineLayout layout, const PipelineVariant& variant)
+{
+	VkPipeline pipeline = 0;
+	createGraphicsPipelines(&pipeline, device, pipelineCache, target, vs, fs, layout, &variant, 1);
+
+	return pipeline;
+}
+
+VkPipeline createComputePipeline(VkDevice device, VkPipelineCache pipelineCache, VkShaderModule cs, VkPipelineLayout layout)
+{
+	VkComputePipelineCreateInfo createInfo = { VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO };
+	createInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	createInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	createInfo.stage.module = cs;
+	createInfo.stage.pName = "main";
+	createInfo.layout = layout;
+
+	VkPipeline pipeline = 0;
+	VK_CHECK(vkCreateComputePipelines(device, pipelineCache, 1, &createInfo, 0, &pipeline));
+
+	return pipeline;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <string>
+
+// Specialization constants shared by triangle.vert.glsl/triangle.frag.glsl; constant_id matches the enum order in PipelineVariant
+enum VertexFormat
+{
+	VertexFormatFull, // position, normal, texcoord
+	VertexFormatNoNormals, // normal stream is not meaningful (OBJ without vn)
+
+	VertexFormatCount
+};
+
+enum LightingMode
+{
+	LightingModeNormals,
+	LightingModeLambert,
+	LightingModeUnlit,
+
+	LightingModeCount
+};
+
+// How the vertex shader gets vertices; pulled vertices are read through Globals::vertexAddress with gl_VertexIndex, so
+// every mesh in a buffer is drawn without vertex buffer bindings. Not a specialization constant: each uses its own shader
+enum VertexInput
+{
+	VertexInputAttributes, // fixed function vertex input from binding 0; triangle.vert
+	VertexInputPulled, // triangle.pull.vert; needs buffer device addresses
+
+	VertexInputCount
+};
+
+struct PipelineVariant
+{
+	uint32_t vertexFormat;
+	uint32_t lightingMode;
+	uint32_t vertexInput;
+	uint32_t benchmarkSeed; // only set by -pipelinebench, to make otherwise identical variants unique; 0 elsewhere
+};
+
+// Describes the attachments pipelines render to; renderPass is 0 when dynamic rendering is used
+struct RenderTargetInfo
+{
+	VkRenderPass renderPass;
+	VkFormat colorFormat;
+	VkFormat depthFormat; // VK_FORMAT_UNDEFINED without depth; with depth, pipelines test and write it
+	VkSampleCountFlagBits samples;
+};
+
+struct Shader
+{
+	VkShaderModule module;
+
+	std::string name; // e.g. triangle.vert, loaded from shaders/triangle.vert.spv or shaders/triangle.vert.glsl
+
+	uint64_t sourceTime;
+	uint64_t sourceHash;
+};
+
+VkShaderModule loadShader(VkDevice device, const char* path);
+
+// Release builds load SPIR-V compiled at build time; _DEBUG builds compile the GLSL source through a content-hashed
+// SPIR-V cache in shaders/cache so that hot reload and restarts only invoke the compiler for sources that changed
+bool loadShader(Shader& result, VkDevice device, const char* name);
+void destroyShader(Shader& shader, VkDevice device);
+
+// Returns true if the source changed and compiled successfully; the previous module is returned in oldModule
+// and must be kept alive until pipelines that are being created from it are done
+bool reloadShader(Shader& shader, VkDevice device, VkShaderModule& oldModule);
+
+// Push constants shared by all graphics pipelines; must match Globals in triangle.vert.glsl
+struct Globals
+{
+	float cameraPosition[4];
+	float diffuseColor[4]; // material color; updated separately at offsetof(Globals, diffuseColor)
+	uint64_t vertexAddress; // vertex buffer for VertexInputPulled, unused otherwise
+};
+
+// Globals push constants, and set 0 from setLayout if it isn't 0 (see createMaterialSetLayout)
+VkPipelineLayout createPipelineLayout(VkDevice device, VkDescriptorSetLayout setLayout = 0);
+
+void createGraphicsPipelines(VkPipeline* pipelines, VkDevice device, VkPipelineCache pipelineCache, const RenderTargetInfo& target, VkShaderModule vs, VkShaderModule fs, VkPipelineLayout layout, const PipelineVariant* variants, size_t variantCount);
+VkPipeline createGraphicsPipeline(VkDevice device, VkPipelineCache pipelineCache, const RenderTargetInfo& target, VkShaderModule vs, VkShaderModule fs, VkPipelineLayout layout, const PipelineVariant& variant);
+
+VkPipeline createComputePipeline(VkDevice device, VkPipelineCache pipelineCache, VkShaderModule cs, VkPipelineLayout layout);
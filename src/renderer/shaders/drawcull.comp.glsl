@@ -0,0 +1,131 @@
+#version 450
+
+#extension GL_EXT_buffer_reference : require
+
+// One workgroup per batch; visible records are compacted in order with a workgroup prefix sum, so the result doesn't
+// depend on scheduling and matches cullDraws in drawlist.cpp exactly
+layout(local_size_x = 256) in;
+
+// must match DrawRecord in drawlist.h
+struct DrawRecord
+{
+	vec3 center;
+	float radius;
+
+	uint indexOffset, indexCount;
+	int vertexOffset;
+	uint material;
+};
+
+// must match DrawBatch in drawlist.h
+struct DrawBatch
+{
+	uint firstRecord, recordCount;
+	uint material;
+	uint reserved;
+};
+
+// VkDrawIndexedIndirectCommand
+struct DrawCommand
+{
+	uint indexCount;
+	uint instanceCount;
+	uint firstIndex;
+	int vertexOffset;
+	uint firstInstance;
+};
+
+layout(buffer_reference, std430, buffer_reference_align = 16) readonly buffer Records
+{
+	DrawRecord records[];
+};
+
+layout(buffer_reference, std430, buffer_reference_align = 16) readonly buffer Batches
+{
+	DrawBatch batches[];
+};
+
+layout(buffer_reference, std430, buffer_reference_align = 4) writeonly buffer Commands
+{
+	DrawCommand commands[];
+};
+
+layout(buffer_reference, std430, buffer_reference_align = 4) writeonly buffer Counts
+{
+	uint counts[];
+};
+
+// must match CullConstants in drawcull.cpp
+layout(push_constant) uniform CullConstants
+{
+	vec4 cameraPosition;
+	Records records;
+	Batches batches;
+	Commands commands;
+	Counts counts;
+} cull;
+
+shared uint ranks[256];
+
+// must match isDrawVisible in drawlist.cpp; precise keeps the compiler from rearranging the math, so results are bit exact
+bool isVisible(DrawRecord record)
+{
+	precise vec3 p = record.center - cull.cameraPosition.xyz;
+	precise float r = record.radius;
+	precise float limit = 1 + r;
+
+	return abs(p.x) <= limit && abs(p.y) <= limit && p.z >= -r && p.z <= limit;
+}
+
+void main()
+{
+	DrawBatch batch = cull.batches.batches[gl_WorkGroupID.x];
+
+	uint thread = gl_LocalInvocationID.x;
+	uint count = 0;
+
+	for (uint i = 0; i < batch.recordCount; i += 256)
+	{
+		DrawRecord record;
+		bool visible = false;
+
+		if (i + thread < batch.recordCount)
+		{
+			record = cull.records.records[batch.firstRecord + i + thread];
+			visible = isVisible(record);
+		}
+
+		// inclusive prefix sum of the visibility flags
+		ranks[thread] = visible ? 1 : 0;
+		barrier();
+
+		for (uint offset = 1; offset < 256; offset *= 2)
+		{
+			uint previous = thread >= offset ? ranks[thread - offset] : 0;
+			barrier();
+
+			ranks[thread] += previous;
+			barrier();
+		}
+
+		if (visible)
+		{
+			DrawCommand command;
+			command.indexCount = record.indexCount;
+			command.instanceCount = 1;
+			command.firstIndex = record.indexOffset;
+			command.vertexOffset = record.vertexOffset;
+			command.firstInstance = batch.firstRecord + i + thread;
+
+			cull.commands.commands[batch.firstRecord + count + ranks[thread] - 1] = command;
+		}
+
+		count += ranks[255];
+
+		// ranks are overwritten by the next iteration
+		barrier();
+	}
+
+	if (thread == 0)
+		cull.counts.counts[gl_WorkGroupID.x] = count;
+}
@@ -0,0 +1,131 @@
+#version 450
+
+#extension GL_EXT_buffer_reference : require
+
+// Shades every pixel of the visibility buffer once: the triangle is fetched from the index and vertex buffers and
+// lit per vertex like triangle.vert.glsl, then interpolated like the forward path does; shading must stay in sync with it
+
+layout(location = 0) out vec4 outputColor;
+
+// must match VertexFormat/LightingMode in shaders.h
+layout(constant_id = 0) const int VERTEX_FORMAT = 0;
+layout(constant_id = 1) const int LIGHTING_MODE = 0;
+
+// must match Vertex in mesh.h
+struct Vertex
+{
+	float vx, vy, vz;
+	float nx, ny, nz;
+	float tu, tv;
+};
+
+// must match DrawRecord in drawlist.h
+struct DrawRecord
+{
+	vec3 center;
+	float radius;
+
+	uint indexOffset, indexCount;
+	int vertexOffset;
+	uint material;
+};
+
+layout(buffer_reference, std430, buffer_reference_align = 16) readonly buffer Vertices
+{
+	Vertex vertices[];
+};
+
+// 16-bit indices are read in pairs
+layout(buffer_reference, std430, buffer_reference_align = 4) readonly buffer Indices
+{
+	uint indices[];
+};
+
+layout(buffer_reference, std430, buffer_reference_align = 16) readonly buffer Records
+{
+	DrawRecord records[];
+};
+
+layout(buffer_reference, std430, buffer_reference_align = 16) readonly buffer Materials
+{
+	vec4 diffuse[];
+};
+
+// must match ResolveConstants in visibility.h
+layout(push_constant) uniform ResolveConstants
+{
+	vec4 cameraPosition;
+	Vertices vertices;
+	Indices indices;
+	Records records;
+	Materials materials;
+	uint width, height;
+	uint indexSize;
+	uint reserved;
+} resolve;
+
+layout(set = 0, binding = 0, rg32ui) uniform readonly uimage2D visibility;
+
+const int VERTEX_FORMAT_NO_NORMALS = 1;
+
+const int LIGHTING_MODE_NORMALS = 0;
+const int LIGHTING_MODE_LAMBERT = 1;
+
+uint getIndex(uint i)
+{
+	if (resolve.indexSize == 2)
+		return (resolve.indices.indices[i >> 1] >> ((i & 1) * 16)) & 0xffff;
+	else
+		return resolve.indices.indices[i];
+}
+
+vec4 shadeVertex(Vertex v, vec4 diffuse)
+{
+	vec3 n = (VERTEX_FORMAT == VERTEX_FORMAT_NO_NORMALS) ? vec3(0, 0, 1) : vec3(v.nx, v.ny, v.nz);
+
+	vec4 color;
+
+	if (LIGHTING_MODE == LIGHTING_MODE_NORMALS)
+		color = vec4(n * 0.5 + vec3(0.5), 1.0);
+	else if (LIGHTING_MODE == LIGHTING_MODE_LAMBERT)
+		color = vec4(vec3(max(dot(n, normalize(vec3(-1, 1, -1))), 0.0) * 0.8 + 0.2), 1.0);
+	else
+		color = vec4(0.8, 0.8, 0.8, 1.0);
+
+	return color * diffuse;
+}
+
+void main()
+{
+	uvec2 id = imageLoad(visibility, ivec2(gl_FragCoord.xy)).xy;
+
+	// background keeps the clear color of the pass
+	if (id.x == 0)
+		discard;
+
+	DrawRecord record = resolve.records.records[id.x - 1];
+	vec4 diffuse = resolve.materials.diffuse[record.material];
+
+	uint first = record.indexOffset + id.y * 3;
+
+	Vertex v0 = resolve.vertices.vertices[record.vertexOffset + int(getIndex(first + 0))];
+	Vertex v1 = resolve.vertices.vertices[record.vertexOffset + int(getIndex(first + 1))];
+	Vertex v2 = resolve.vertices.vertices[record.vertexOffset + int(getIndex(first + 2))];
+
+	// positions only subtract the camera and w is 1, so screen space barycentrics are the perspective correct ones;
+	// the forward pass flips y with a negative viewport height
+	vec2 p = vec2(gl_FragCoord.x / float(resolve.width) * 2.0 - 1.0, 1.0 - gl_FragCoord.y / float(resolve.height) * 2.0);
+
+	vec2 p0 = vec2(v0.vx, v0.vy) - resolve.cameraPosition.xy;
+	vec2 p1 = vec2(v1.vx, v1.vy) - resolve.cameraPosition.xy;
+	vec2 p2 = vec2(v2.vx, v2.vy) - resolve.cameraPosition.xy;
+
+	vec2 e1 = p1 - p0, e2 = p2 - p0, ep = p - p0;
+	float area = e1.x * e2.y - e1.y * e2.x;
+
+	float b1 = (ep.x * e2.y - ep.y * e2.x) / area;
+	float b2 = (e1.x * ep.y - e1.y * ep.x) / area;
+	float b0 = 1.0 - b1 - b2;
+
+	outputColor = shadeVertex(v0, diffuse) * b0 + shadeVertex(v1, diffuse) * b1 + shadeVertex(v2, diffuse) * b2;
+}
@@ -0,0 +1,69 @@
+#version 450
+
+#extension GL_EXT_buffer_reference : require
+
+// triangle.vert with vertices read from memory instead of vertex attributes; shading must stay in sync with it
+
+layout(location = 0) out vec4 color;
+
+// draw record index for visibility.frag.glsl; draws pass it as firstInstance
+layout(location = 1) flat out uint drawIndex;
+
+// for triangle.tex.frag.glsl
+layout(location = 2) out vec2 uv;
+
+// must match VertexFormat/LightingMode in shaders.h
+layout(constant_id = 0) const int VERTEX_FORMAT = 0;
+layout(constant_id = 1) const int LIGHTING_MODE = 0;
+
+// must match Vertex in mesh.h
+struct Vertex
+{
+	float vx, vy, vz;
+	float nx, ny, nz;
+	float tu, tv;
+};
+
+layout(buffer_reference, std430, buffer_reference_align = 16) readonly buffer Vertices
+{
+	Vertex vertices[];
+};
+
+// must match Globals in shaders.h
+layout(push_constant) uniform Globals
+{
+	vec4 cameraPosition;
+	vec4 diffuseColor;
+	Vertices vertices;
+} globals;
+
+const int VERTEX_FORMAT_NO_NORMALS = 1;
+
+const int LIGHTING_MODE_NORMALS = 0;
+const int LIGHTING_MODE_LAMBERT = 1;
+
+void main()
+{
+	// gl_VertexIndex includes the vertexOffset of the draw, which selects the mesh within the buffer
+	Vertex v = globals.vertices.vertices[gl_VertexIndex];
+
+	vec3 position = vec3(v.vx, v.vy, v.vz);
+	vec3 normal = vec3(v.nx, v.ny, v.nz);
+	vec2 texcoord = vec2(v.tu, v.tv);
+
+	gl_Position = vec4(position - globals.cameraPosition.xyz, 1.0);
+
+	vec3 n = (VERTEX_FORMAT == VERTEX_FORMAT_NO_NORMALS) ? vec3(0, 0, 1) : normal;
+
+	if (LIGHTING_MODE == LIGHTING_MODE_NORMALS)
+		color = vec4(n * 0.5 + vec3(0.5), 1.0);
+	else if (LIGHTING_MODE == LIGHTING_MODE_LAMBERT)
+		color = vec4(vec3(max(dot(n, normalize(vec3(-1, 1, -1))), 0.0) * 0.8 + 0.2), 1.0);
+	else
+		color = vec4(0.8, 0.8, 0.8, 1.0);
+
+	color *= globals.diffuseColor;
+
+	drawIndex = gl_InstanceIndex;
+	uv = texcoord;
+}
@@ -0,0 +1,16 @@
+#version 450
+
+// triangle.frag.glsl with the diffuse texture of the material; materials without one are bound to a white texture
+
+layout(location = 0) out vec4 outputColor;
+
+layout(location = 0) in vec4 color;
+layout(location = 2) in vec2 uv;
+
+layout(set = 0, binding = 0) uniform sampler2D diffuseTexture;
+
+void main()
+{
+	// OBJ texture coordinates start at the bottom left, images at the top left
+	outputColor = color * texture(diffuseTexture, vec2(uv.x, 1.0 - uv.y));
+}
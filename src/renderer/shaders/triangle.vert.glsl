@@ -6,6 +6,31 @@ layout(location = 2) in vec2 texcoord;
 
 layout(location = 0) out vec4 color;
 
+// draw record index for visibility.frag.glsl; draws pass it as firstInstance
+layout(location = 1) flat out uint drawIndex;
+
+// for triangle.tex.frag.glsl
+layout(location = 2) out vec2 uv;
+
+// must match VertexFormat/LightingMode in shaders.h
+layout(constant_id = 0) const int VERTEX_FORMAT = 0;
+layout(constant_id = 1) const int LIGHTING_MODE = 0;
+
+// must match PipelineVariant::benchmarkSeed; has no effect on the output
+layout(constant_id = 2) const int BENCHMARK_SEED = 0;
+
+// must match Globals in shaders.h
+layout(push_constant) uniform Globals
+{
+	vec4 cameraPosition;
+	vec4 diffuseColor;
+} globals;
+
+const int VERTEX_FORMAT_NO_NORMALS = 1;
+
+const int LIGHTING_MODE_NORMALS = 0;
+const int LIGHTING_MODE_LAMBERT = 1;
+
 mat4 rotationX( in float angle ) {
 	return mat4(	1.0,		0,			0,			0,
 			 		0, 	cos(angle),	-sin(angle),		0,
@@ -29,7 +54,19 @@ mat4 rotationZ( in float angle ) {
 
 void main()
 {
-	gl_Position = vec4(position + vec3(0, -0.95, 0.5), 1.0);
+	gl_Position = vec4(position - globals.cameraPosition.xyz, 1.0);
+
+	vec3 n = (VERTEX_FORMAT == VERTEX_FORMAT_NO_NORMALS) ? vec3(0, 0, 1) : normal;
+
+	if (LIGHTING_MODE == LIGHTING_MODE_NORMALS)
+		color = vec4(n * 0.5 + vec3(0.5), 1.0);
+	else if (LIGHTING_MODE == LIGHTING_MODE_LAMBERT)
+		color = vec4(vec3(max(dot(n, normalize(vec3(-1, 1, -1))), 0.0) * 0.8 + 0.2), 1.0);
+	else
+		color = vec4(0.8, 0.8, 0.8, 1.0);
+
+	color *= globals.diffuseColor;
 
-	color = vec4(normal * 0.5 + vec3(0.5), 1.0);
+	drawIndex = gl_InstanceIndex;
+	uv = texcoord;
 }
\ No newline at end of file
@@ -0,0 +1,13 @@
+#version 450
+
+// Geometry pass of visibility buffer rendering: stores what is visible, shading happens in resolve.frag.glsl.
+// gl_PrimitiveID is the triangle index within the draw and needs the geometryShader feature
+layout(location = 0) out uvec2 visibility;
+
+layout(location = 1) flat in uint drawIndex;
+
+void main()
+{
+	// 0 marks pixels without geometry
+	visibility = uvec2(drawIndex + 1, gl_PrimitiveID);
+}
@@ -0,0 +1,487 @@
+#ifndef _CRT_SECURE_NO_WARNINGS
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include "stats.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include <algorithm>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#pragma comment(lib, "ws2_32.lib")
+#else
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+// clients that don't finish their request in time are dropped
+static const double kClientTimeout = 1.0;
+
+void addSample(RollingHistogram& histogram, double value)
+{
+	if (histogram.samples.size() < kStatsWindow)
+		histogram.samples.push_back(value);
+	else
+		histogram.samples[histogram.next] = value;
+
+	histogram.next = (histogram.next + 1) % kStatsWindow;
+
+	histogram.count++;
+	histogram.sum += value;
+
+	for (size_t i = 0; i < kStatsBucketCount; i++)
+		histogram.buckets[i] += value <= kStatsBuckets[i];
+}
+
+double getPercentile(const RollingHistogram& histogram, double p)
+{
+	if (histogram.samples.empty())
+		return 0;
+
+	std::vector<double> sorted = histogram.samples;
+
+	size_t index = std::min(size_t(p * double(sorted.size())), sorted.size() - 1);
+	std::nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+
+	return sorted[index];
+}
+
+static void initHistogram(RollingHistogram& histogram)
+{
+	histogram.samples.clear();
+	histogram.samples.reserve(kStatsWindow);
+	histogram.next = 0;
+	histogram.count = 0;
+	histogram.sum = 0;
+
+	memset(histogram.buckets, 0, sizeof(histogram.buckets));
+}
+
+void initStats(Stats& stats)
+{
+	initHistogram(stats.frameTime);
+	initHistogram(stats.cpuTime);
+	initHistogram(stats.gpuTime);
+
+	stats.frames = 0;
+	stats.draws = 0;
+	stats.triangles = 0;
+	stats.uploadBytes = 0;
+
+	stats.heaps.clear();
+	stats.memoryBudget = false;
+}
+
+static void appendf(std::string& result, const char* format, ...)
+{
+	char buffer[512];
+
+	va_list args;
+	va_start(args, format);
+	int length = vsnprintf(buffer, sizeof(buffer), format, args);
+	va_end(args);
+
+	assert(length >= 0 && size_t(length) < sizeof(buffer));
+
+	result.append(buffer, length);
+}
+
+static const char* kHistogramNames[] = { "frame", "cpu", "gpu" };
+static const size_t kHistogramCount = sizeof(kHistogramNames) / sizeof(kHistogramNames[0]);
+
+static const RollingHistogram* getHistogram(const Stats& stats, size_t index)
+{
+	const RollingHistogram* histograms[] = { &stats.frameTime, &stats.cpuTime, &stats.gpuTime };
+
+	return histograms[index];
+}
+
+static void formatPrometheusHistogram(std::string& result, const char* name, const char* help, const RollingHistogram& histogram)
+{
+	appendf(result, "# HELP renderer_%s_seconds %s\n", name, help);
+	appendf(result, "# TYPE renderer_%s_seconds histogram\n", name);
+
+	for (size_t i = 0; i < kStatsBucketCount; i++)
+		appendf(result, "renderer_%s_seconds_bucket{le=\"%g\"} %llu\n", name, kStatsBuckets[i] / 1000, (unsigned long long)histogram.buckets[i]);
+
+	appendf(result, "renderer_%s_seconds_bucket{le=\"+Inf\"} %llu\n", name, (unsigned long long)histogram.count);
+	appendf(result, "renderer_%s_seconds_sum %g\n", name, histogram.sum / 1000);
+	appendf(result, "renderer_%s_seconds_count %llu\n", name, (unsigned long long)histogram.count);
+}
+
+static void formatPrometheusHeaps(std::string& result, const Stats& stats, const char* name, const char* help, size_t field)
+{
+	appendf(result, "# HELP renderer_heap_%s_bytes %s\n", name, help);
+	appendf(result, "# TYPE renderer_heap_%s_bytes gauge\n", name);
+
+	for (size_t i = 0; i < stats.heaps.size(); i++)
+	{
+		const HeapStats& heap = stats.heaps[i];
+		uint64_t values[] = { heap.size, heap.budget, heap.usage };
+
+		appendf(result, "renderer_heap_%s_bytes{heap=\"%d\",device_local=\"%d\"} %llu\n", name, int(i), heap.deviceLocal, (unsigned long long)values[field]);
+	}
+}
+
+void formatStatsHeader(std::string& result, const Stats& stats, StatsFormat format)
+{
+	if (format != StatsFormatCsv)
+		return;
+
+	result += "time,frames";
+
+	for (size_t i = 0; i < kHistogramCount; i++)
+		appendf(result, ",%s_avg_ms,%s_p50_ms,%s_p95_ms,%s_p99_ms,%s_max_ms", kHistogramNames[i], kHistogramNames[i], kHistogramNames[i], kHistogramNames[i], kHistogramNames[i]);
+
+	result += ",draws,triangles,upload_mb_per_s";
+
+	for (size_t i = 0; i < stats.heaps.size(); i++)
+		appendf(result, ",heap%d_usage_bytes,heap%d_budget_bytes", int(i), int(i));
+
+	result += "\n";
+}
+
+void formatStats(std::string& result, const Stats& stats, StatsFormat format, double time, double uploadRate)
+{
+	if (format == StatsFormatPrometheus)
+	{
+		formatPrometheusHistogram(result, "frame_time", "Time between frame starts", stats.frameTime);
+		formatPrometheusHistogram(result, "cpu_time", "CPU time from frame start to submit", stats.cpuTime);
+		formatPrometheusHistogram(result, "gpu_time", "GPU execution time of a frame", stats.gpuTime);
+
+		result += "# HELP renderer_frames_total Frames submitted\n# TYPE renderer_frames_total counter\n";
+		appendf(result, "renderer_frames_total %llu\n", (unsigned long long)stats.frames);
+
+		result += "# HELP renderer_draws Draw calls recorded in the last frame\n# TYPE renderer_draws gauge\n";
+		appendf(result, "renderer_draws %u\n", stats.draws);
+
+		result += "# HELP renderer_triangles Triangles drawn in the last frame, after culling\n# TYPE renderer_triangles gauge\n";
+		appendf(result, "renderer_triangles %llu\n", (unsigned long long)stats.triangles);
+
+		result += "# HELP renderer_upload_bytes_total Bytes uploaded to device local buffers\n# TYPE renderer_upload_bytes_total counter\n";
+		appendf(result, "renderer_upload_bytes_total %llu\n", (unsigned long long)stats.uploadBytes);
+
+		formatPrometheusHeaps(result, stats, "size", "Memory heap size", 0);
+
+		if (stats.memoryBudget)
+		{
+			formatPrometheusHeaps(result, stats, "budget", "Memory heap budget of the process", 1);
+			formatPrometheusHeaps(result, stats, "usage", "Memory heap usage of the process", 2);
+		}
+
+		return;
+	}
+
+	bool json = format == StatsFormatJson;
+
+	if (json)
+		appendf(result, "{\"time\":%.3f,\"frames\":%llu", time, (unsigned long long)stats.frames);
+	else
+		appendf(result, "%.3f,%llu", time, (unsigned long long)stats.frames);
+
+	for (size_t i = 0; i < kHistogramCount; i++)
+	{
+		const RollingHistogram& histogram = *getHistogram(stats, i);
+
+		double count = double(histogram.samples.size());
+		double sum = 0;
+
+		for (size_t j = 0; j < histogram.samples.size(); j++)
+			sum += histogram.samples[j];
+
+		double avg = count > 0 ? sum / count : 0;
+		double p50 = getPercentile(histogram, 0.5), p95 = getPercentile(histogram, 0.95), p99 = getPercentile(histogram, 0.99), max = getPercentile(histogram, 1);
+
+		if (json)
+			appendf(result, ",\"%s\":{\"avg\":%.3f,\"p50\":%.3f,\"p95\":%.3f,\"p99\":%.3f,\"max\":%.3f}", kHistogramNames[i], avg, p50, p95, p99, max);
+		else
+			appendf(result, ",%.3f,%.3f,%.3f,%.3f,%.3f", avg, p50, p95, p99, max);
+	}
+
+	if (json)
+		appendf(result, ",\"draws\":%u,\"triangles\":%llu,\"upload_mb_per_s\":%.3f,\"heaps\":[", stats.draws, (unsigned long long)stats.triangles, uploadRate);
+	else
+		appendf(result, ",%u,%llu,%.3f", stats.draws, (unsigned long long)stats.triangles, uploadRate);
+
+	for (size_t i = 0; i < stats.heaps.size(); i++)
+	{
+		const HeapStats& heap = stats.heaps[i];
+
+		if (json)
+			appendf(result, "%s{\"size\":%llu,\"budget\":%llu,\"usage\":%llu,\"device_local\":%s}", i ? "," : "",
+				(unsigned long long)heap.size, (unsigned long long)heap.budget, (unsigned long long)heap.usage, heap.deviceLocal ? "true" : "false");
+		else
+			appendf(result, ",%llu,%llu", (unsigned long long)heap.usage, (unsigned long long)heap.budget);
+	}
+
+	result += json ? "]}\n" : "\n";
+}
+
+void initStatsExporter(StatsExporter& exporter)
+{
+	exporter.file = NULL;
+	exporter.fileFormat = StatsFormatCsv;
+	exporter.interval = 0;
+	exporter.nextDump = 0;
+	exporter.lastDumpTime = 0;
+	exporter.lastDumpUploadBytes = 0;
+	exporter.listenSocket = -1;
+	exporter.clients.clear();
+	exporter.dumps = 0;
+	exporter.scrapes = 0;
+}
+
+bool openStatsFile(StatsExporter& exporter, const char* path, double interval)
+{
+	assert(!exporter.file);
+
+	exporter.file = fopen(path, "w");
+	if (!exporter.file)
+		return false;
+
+	size_t length = strlen(path);
+
+	exporter.fileFormat = (length >= 5 && strcmp(path + length - 5, ".json") == 0) ? StatsFormatJson : StatsFormatCsv;
+	exporter.interval = interval;
+	exporter.nextDump = interval;
+
+	return true;
+}
+
+static void closeSocket(intptr_t socket)
+{
+#ifdef _WIN32
+	closesocket(SOCKET(socket));
+#else
+	close(int(socket));
+#endif
+}
+
+static bool setNonBlocking(intptr_t socket)
+{
+#ifdef _WIN32
+	u_long mode = 1;
+	return ioctlsocket(SOCKET(socket), FIONBIO, &mode) == 0;
+#else
+	int flags = fcntl(int(socket), F_GETFL, 0);
+	return flags >= 0 && fcntl(int(socket), F_SETFL, flags | O_NONBLOCK) == 0;
+#endif
+}
+
+bool listenStats(StatsExporter& exporter, uint16_t port)
+{
+	assert(exporter.listenSocket == -1);
+
+#ifdef _WIN32
+	WSADATA data;
+	if (WSAStartup(MAKEWORD(2, 2), &data) != 0)
+		return false;
+
+	SOCKET handle = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (handle == INVALID_SOCKET)
+		return false;
+
+	intptr_t listenSocket = intptr_t(handle);
+#else
+	int handle = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (handle < 0)
+		return false;
+
+	intptr_t listenSocket = handle;
+
+	// restarted soak runs rebind the port right away
+	int reuse = 1;
+	setsockopt(handle, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+#endif
+
+	// only local scrapers; a remote collector can go through an agent on the machine
+	sockaddr_in address = {};
+	address.sin_family = AF_INET;
+	address.sin_port = htons(port);
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	if (bind(handle, (const sockaddr*)&address, sizeof(address)) != 0 || listen(handle, 4) != 0 || !setNonBlocking(listenSocket))
+	{
+		closeSocket(listenSocket);
+		return false;
+	}
+
+	exporter.listenSocket = listenSocket;
+
+	return true;
+}
+
+static bool isWouldBlock()
+{
+#ifdef _WIN32
+	return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+	return errno == EAGAIN || errno == EWOULDBLOCK;
+#endif
+}
+
+// sends as much of the response as the socket takes without blocking; returns false if the connection failed
+static bool sendResponse(StatsExporter::Client& client)
+{
+	while (client.sent < client.response.size())
+	{
+		const char* data = client.response.data() + client.sent;
+		size_t size = client.response.size() - client.sent;
+
+#if defined(_WIN32)
+		int sent = send(SOCKET(client.socket), data, int(size), 0);
+#elif defined(MSG_NOSIGNAL)
+		ssize_t sent = send(int(client.socket), data, size, MSG_NOSIGNAL);
+#else
+		ssize_t sent = send(int(client.socket), data, size, 0);
+#endif
+
+		if (sent <= 0)
+			return sent < 0 && isWouldBlock();
+
+		client.sent += size_t(sent);
+	}
+
+	return true;
+}
+
+static void serveClients(StatsExporter& exporter, const Stats& stats, double time)
+{
+	for (;;)
+	{
+#ifdef _WIN32
+		SOCKET handle = accept(SOCKET(exporter.listenSocket), NULL, NULL);
+		if (handle == INVALID_SOCKET)
+			break;
+#else
+		int handle = accept(int(exporter.listenSocket), NULL, NULL);
+		if (handle < 0)
+			break;
+#endif
+
+		StatsExporter::Client client = { intptr_t(handle), time, std::string(), std::string(), 0 };
+
+		if (setNonBlocking(client.socket))
+			exporter.clients.push_back(client);
+		else
+			closeSocket(client.socket);
+	}
+
+	for (size_t i = 0; i < exporter.clients.size(); )
+	{
+		StatsExporter::Client& client = exporter.clients[i];
+
+		// clients that stop reading get the same timeout as ones that never finish their request
+		bool closed = time - client.start > kClientTimeout;
+
+		if (client.response.empty())
+		{
+			char buffer[1024];
+
+#ifdef _WIN32
+			int received = recv(SOCKET(client.socket), buffer, sizeof(buffer), 0);
+#else
+			ssize_t received = recv(int(client.socket), buffer, sizeof(buffer), 0);
+#endif
+
+			if (received > 0)
+				client.request.append(buffer, size_t(received));
+
+			closed = closed || received == 0 || client.request.size() > 64 * 1024;
+
+			// any path is answered with the metrics; the request only has to be complete so that closing doesn't reset it
+			if (client.request.find("\r\n\r\n") != std::string::npos)
+			{
+				std::string body;
+				formatStats(body, stats, StatsFormatPrometheus, time, 0);
+
+				appendf(client.response, "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %d\r\nConnection: close\r\n\r\n", int(body.size()));
+				client.response += body;
+
+				exporter.scrapes++;
+			}
+		}
+
+		// responses usually fit the socket buffer; the rest waits for the next frame instead of spinning
+		if (!client.response.empty() && !sendResponse(client))
+			closed = true;
+
+		bool done = !client.response.empty() && client.sent == client.response.size();
+
+		if (done || closed)
+		{
+			closeSocket(client.socket);
+
+			exporter.clients[i] = exporter.clients.back();
+			exporter.clients.pop_back();
+		}
+		else
+			i++;
+	}
+}
+
+void dumpStats(StatsExporter& exporter, const Stats& stats, double time)
+{
+	if (!exporter.file)
+		return;
+
+	std::string text;
+
+	if (exporter.dumps == 0)
+		formatStatsHeader(text, stats, exporter.fileFormat);
+
+	double elapsed = time - exporter.lastDumpTime;
+	double uploadRate = elapsed > 0 ? double(stats.uploadBytes - exporter.lastDumpUploadBytes) / 1e6 / elapsed : 0;
+
+	formatStats(text, stats, exporter.fileFormat, time, uploadRate);
+
+	fwrite(text.data(), 1, text.size(), exporter.file);
+
+	// soak runs can be killed at any point; every dump is complete on disk
+	fflush(exporter.file);
+
+	exporter.lastDumpTime = time;
+	exporter.lastDumpUploadBytes = stats.uploadBytes;
+	exporter.dumps++;
+}
+
+void updateStatsExport(StatsExporter& exporter, const Stats& stats, double time)
+{
+	if (exporter.file && time >= exporter.nextDump)
+	{
+		dumpStats(exporter, stats, time);
+
+		exporter.nextDump = time + exporter.interval;
+	}
+
+	if (exporter.listenSocket != -1)
+		serveClients(exporter, stats, time);
+}
+
+void closeStatsExporter(StatsExporter& exporter)
+{
+	if (exporter.file)
+		fclose(exporter.file);
+
+	for (size_t i = 0; i < exporter.clients.size(); i++)
+		closeSocket(exporter.clients[i].socket);
+
+	if (exporter.listenSocket != -1)
+	{
+		closeSocket(exporter.listenSocket);
+
+#ifdef _WIN32
+		WSACleanup();
+#endif
+	}
+
+	initStatsExporter(exporter);
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+// Runtime statistics; independent of Vulkan so that histograms and exports can be driven with synthetic samples.
+// Times are in ms; exports convert them to seconds where the format expects it
+const size_t kStatsWindow = 1024;
+
+// cumulative histogram bounds, ms; roughly frame budgets from 1000 to 4 fps
+const double kStatsBuckets[] = { 1, 2, 4, 6.94, 8.33, 11.1, 16.7, 33.3, 50, 100, 250 };
+const size_t kStatsBucketCount = sizeof(kStatsBuckets) / sizeof(kStatsBuckets[0]);
+
+// Percentiles come from the last kStatsWindow samples; count, sum and buckets cover every sample since the start,
+// which is what a scraper needs to compute rates between scrapes
+struct RollingHistogram
+{
+	std::vector<double> samples;
+	size_t next;
+
+	uint64_t count;
+	double sum;
+	uint64_t buckets[kStatsBucketCount]; // samples <= kStatsBuckets[i]
+};
+
+struct HeapStats
+{
+	uint64_t size;
+	uint64_t budget; // size without VK_EXT_memory_budget
+	uint64_t usage; // 0 without VK_EXT_memory_budget
+	bool deviceLocal;
+};
+
+struct Stats
+{
+	RollingHistogram frameTime; // between frame starts
+	RollingHistogram cpuTime; // frame start to submit
+	RollingHistogram gpuTime; // GPU execution, from timestamps
+
+	uint64_t frames;
+
+	// last frame; draws count indirect draws once, triangles are after culling; with GPU culling they are read back
+	// from the last frame that completed, which trails by the number of queued frames
+	uint32_t draws;
+	uint64_t triangles;
+
+	uint64_t uploadBytes; // since the start
+
+	std::vector<HeapStats> heaps;
+	bool memoryBudget;
+};
+
+void addSample(RollingHistogram& histogram, double value);
+
+// p in [0, 1]; 0 if there are no samples
+double getPercentile(const RollingHistogram& histogram, double p);
+
+void initStats(Stats& stats);
+
+enum StatsFormat
+{
+	StatsFormatCsv, // one row per dump after a header row
+	StatsFormatJson, // one object per dump and line
+	StatsFormatPrometheus, // text exposition format
+};
+
+// Appends the current statistics; time is seconds since the start, uploadRate is MB/s since the previous dump
+void formatStats(std::string& result, const Stats& stats, StatsFormat format, double time, double uploadRate);
+void formatStatsHeader(std::string& result, const Stats& stats, StatsFormat format);
+
+// Periodic dumps to a file and/or a Prometheus endpoint on 127.0.0.1; scrapes are answered from updateStatsExport
+// without blocking, so the frame loop is never stalled by a slow client: responses the socket doesn't take at once are
+// sent over the following frames
+struct StatsExporter
+{
+	FILE* file;
+	StatsFormat fileFormat;
+	double interval; // s
+	double nextDump; // s
+
+	double lastDumpTime;
+	uint64_t lastDumpUploadBytes;
+
+	intptr_t listenSocket; // -1 if not serving
+
+	struct Client
+	{
+		intptr_t socket;
+		double start;
+		std::string request;
+		std::string response; // empty until the request is complete
+		size_t sent; // bytes of response the socket took so far
+	};
+
+	std::vector<Client> clients;
+
+	uint64_t dumps;
+	uint64_t scrapes;
+};
+
+void initStatsExporter(StatsExporter& exporter);
+
+// .json writes JSON, anything else CSV; returns false if the file can't be created
+bool openStatsFile(StatsExporter& exporter, const char* path, double interval);
+
+// returns false if the port can't be bound
+bool listenStats(StatsExporter& exporter, uint16_t port);
+
+// Writes one record to the file now, e.g. at exit; time is seconds since the start
+void dumpStats(StatsExporter& exporter, const Stats& stats, double time);
+
+// Dumps to the file when the interval elapsed and answers pending scrapes; time is seconds since the start
+void updateStatsExport(StatsExporter& exporter, const Stats& stats, double time);
+
+void closeStatsExporter(StatsExporter& exporter);
@@ -0,0 +1,375 @@
+#include "common.h"
+#include "streaming.h"
+
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+
+const uint32_t kStreamUploadBatches = 4;
+const uint32_t kStreamMaxLoads = 16;
+
+static uint32_t part1By2(uint32_t x)
+{
+	x &= 0x3ff;
+	x = (x | (x << 16)) & 0x030000ff;
+	x = (x | (x << 8)) & 0x0300f00f;
+	x = (x | (x << 4)) & 0x030c30c3;
+	x = (x | (x << 2)) & 0x09249249;
+	return x;
+}
+
+void buildStreamingMesh(StreamingMesh& result, const Mesh& mesh, uint32_t chunkTriangles)
+{
+	assert(chunkTriangles > 0 && chunkTriangles * 3 <= 65536);
+
+	size_t triangleCount = mesh.indices.size() / 3;
+
+	float minv[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+	float maxv[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+	for (size_t i = 0; i < mesh.vertices.size(); i++)
+	{
+		const float* p = &mesh.vertices[i].vx;
+
+		for (int k = 0; k < 3; k++)
+		{
+			minv[k] = std::min(minv[k], p[k]);
+			maxv[k] = std::max(maxv[k], p[k]);
+		}
+	}
+
+	float extent = std::max(maxv[0] - minv[0], std::max(maxv[1] - minv[1], maxv[2] - minv[2]));
+	float scale = extent > 0 ? 1023.f / extent : 0.f;
+
+	// triangles sorted along a Morton curve through their centroids give compact chunks without building a hierarchy
+	std::vector<std::pair<uint32_t, uint32_t> > order(triangleCount);
+
+	for (size_t i = 0; i < triangleCount; i++)
+	{
+		uint32_t code = 0;
+
+		for (int k = 0; k < 3; k++)
+		{
+			float c = 0;
+			for (int v = 0; v < 3; v++)
+				c += (&mesh.vertices[mesh.indices[i * 3 + v]].vx)[k];
+
+			code |= part1By2(uint32_t((c / 3 - minv[k]) * scale)) << k;
+		}
+
+		order[i] = std::make_pair(code, uint32_t(i));
+	}
+
+	std::sort(order.begin(), order.end());
+
+	result.vertices.clear();
+	result.indices.clear();
+	result.chunks.clear();
+	result.slotSize = 0;
+	result.hasNormals = mesh.hasNormals;
+
+	std::vector<uint32_t> remap(mesh.vertices.size(), ~0u);
+	std::vector<uint32_t> used;
+
+	for (size_t begin = 0; begin < triangleCount; begin += chunkTriangles)
+	{
+		size_t end = std::min(begin + chunkTriangles, triangleCount);
+
+		StreamChunk chunk = {};
+		chunk.vertexOffset = uint32_t(result.vertices.size());
+		chunk.indexOffset = uint32_t(result.indices.size());
+
+		for (size_t i = begin; i < end; i++)
+		{
+			uint32_t triangle = order[i].second;
+
+			for (int v = 0; v < 3; v++)
+			{
+				uint32_t index = mesh.indices[triangle * 3 + v];
+
+				if (remap[index] == ~0u)
+				{
+					remap[index] = chunk.vertexCount++;
+					used.push_back(index);
+					result.vertices.push_back(mesh.vertices[index]);
+				}
+
+				result.indices.push_back(uint16_t(remap[index]));
+			}
+		}
+
+		chunk.indexCount = uint32_t(result.indices.size()) - chunk.indexOffset;
+
+		float cminv[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+		float cmaxv[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+		for (uint32_t i = 0; i < chunk.vertexCount; i++)
+		{
+			const float* p = &result.vertices[chunk.vertexOffset + i].vx;
+
+			for (int k = 0; k < 3; k++)
+			{
+				cminv[k] = std::min(cminv[k], p[k]);
+				cmaxv[k] = std::max(cmaxv[k], p[k]);
+			}
+		}
+
+		for (int k = 0; k < 3; k++)
+			chunk.center[k] = (cminv[k] + cmaxv[k]) * 0.5f;
+
+		for (uint32_t i = 0; i < chunk.vertexCount; i++)
+		{
+			const float* p = &result.vertices[chunk.vertexOffset + i].vx;
+
+			float dx = p[0] - chunk.center[0], dy = p[1] - chunk.center[1], dz = p[2] - chunk.center[2];
+			chunk.radius = std::max(chunk.radius, sqrtf(dx * dx + dy * dy + dz * dz));
+		}
+
+		for (size_t i = 0; i < used.size(); i++)
+			remap[used[i]] = ~0u;
+
+		used.clear();
+
+		size_t size = chunk.vertexCount * sizeof(Vertex) + chunk.indexCount * sizeof(uint16_t);
+		result.slotSize = std::max(result.slotSize, size);
+
+		result.chunks.push_back(chunk);
+	}
+
+	// keeps slot offsets aligned for both vertex and index bindings
+	result.slotSize = (result.slotSize + 255) & ~size_t(255);
+}
+
+void createStreamer(Streamer& result, VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties, VkQueue queue, uint32_t familyIndex, uint32_t dstFamilyIndex, bool timelineSemaphores, const StreamingMesh& mesh, size_t budget, bool vertexPulling)
+{
+	result.device = device;
+	result.vertexPulling = vertexPulling;
+	result.queue = queue;
+	result.familyIndex = familyIndex;
+	result.dstFamilyIndex = dstFamilyIndex;
+
+	createTimeline(result.timeline, device, timelineSemaphores);
+
+	uint32_t slotCount = uint32_t(std::max(budget / mesh.slotSize, size_t(1)));
+
+	result.slotSize = mesh.slotSize;
+
+	VkBufferUsageFlags usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+	if (vertexPulling)
+		usage |= VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT_KHR;
+
+	createBuffer(result.pool, device, memoryProperties, slotCount * mesh.slotSize, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	result.maxLoads = kStreamMaxLoads;
+	result.uploadedBytes = 0;
+	result.uploads.resize(kStreamUploadBatches);
+
+	for (size_t i = 0; i < result.uploads.size(); i++)
+	{
+		StreamUpload& upload = result.uploads[i];
+
+		VkCommandPoolCreateInfo poolInfo = { VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+		poolInfo.queueFamilyIndex = familyIndex;
+
+		VK_CHECK(vkCreateCommandPool(device, &poolInfo, VK_NULL_HANDLE, &upload.commandPool));
+
+		VkCommandBufferAllocateInfo commandBufferInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
+		commandBufferInfo.commandPool = upload.commandPool;
+		commandBufferInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		commandBufferInfo.commandBufferCount = 1;
+
+		VK_CHECK(vkAllocateCommandBuffers(device, &commandBufferInfo, &upload.commandBuffer));
+
+		createBuffer(upload.staging, device, memoryProperties, result.maxLoads * mesh.slotSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+		upload.value = 0;
+		upload.chunks.clear();
+	}
+
+	createResidency(result.residency, uint32_t(mesh.chunks.size()), slotCount);
+
+	result.pendingAcquires.clear();
+	result.distances.resize(mesh.chunks.size());
+}
+
+void destroyStreamer(Streamer& streamer)
+{
+	VK_CHECK(vkQueueWaitIdle(streamer.queue));
+
+	for (size_t i = 0; i < streamer.uploads.size(); i++)
+	{
+		destroyBuffer(streamer.uploads[i].staging, streamer.device);
+		vkDestroyCommandPool(streamer.device, streamer.uploads[i].commandPool, VK_NULL_HANDLE);
+	}
+
+	streamer.uploads.clear();
+
+	destroyBuffer(streamer.pool, streamer.device);
+	destroyTimeline(streamer.timeline);
+}
+
+static void submitChunks(Streamer& streamer, StreamUpload& upload, const StreamingMesh& mesh)
+{
+	VK_CHECK(vkResetCommandPool(streamer.device, upload.commandPool, 0));
+
+	VkCommandBufferBeginInfo beginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	VK_CHECK(vkBeginCommandBuffer(upload.commandBuffer, &beginInfo));
+
+	std::vector<VkBufferCopy> regions(upload.chunks.size());
+	std::vector<VkBufferMemoryBarrier> releases;
+
+	for (size_t i = 0; i < upload.chunks.size(); i++)
+	{
+		const StreamChunk& chunk = mesh.chunks[upload.chunks[i]];
+
+		size_t vertexSize = chunk.vertexCount * sizeof(Vertex);
+		size_t indexSize = chunk.indexCount * sizeof(uint16_t);
+
+		char* staging = static_cast<char*>(upload.staging.data) + i * streamer.slotSize;
+
+		memcpy(staging, &mesh.vertices[chunk.vertexOffset], vertexSize);
+		memcpy(staging + vertexSize, &mesh.indices[chunk.indexOffset], indexSize);
+
+		regions[i].srcOffset = i * streamer.slotSize;
+		regions[i].dstOffset = VkDeviceSize(streamer.residency.chunks[upload.chunks[i]].slot) * streamer.slotSize;
+		regions[i].size = vertexSize + indexSize;
+
+		streamer.uploadedBytes += regions[i].size;
+
+		if (streamer.familyIndex != streamer.dstFamilyIndex)
+		{
+			VkBufferMemoryBarrier release = { VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER };
+			release.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			release.srcQueueFamilyIndex = streamer.familyIndex;
+			release.dstQueueFamilyIndex = streamer.dstFamilyIndex;
+			release.buffer = streamer.pool.buffer;
+			release.offset = regions[i].dstOffset;
+			release.size = regions[i].size;
+
+			releases.push_back(release);
+		}
+	}
+
+	vkCmdCopyBuffer(upload.commandBuffer, upload.staging.buffer, streamer.pool.buffer, uint32_t(regions.size()), regions.data());
+
+	if (!releases.empty())
+		vkCmdPipelineBarrier(upload.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, 0, uint32_t(releases.size()), releases.data(), 0, 0);
+
+	VK_CHECK(vkEndCommandBuffer(upload.commandBuffer));
+
+	upload.value = submitTimeline(streamer.timeline, streamer.queue, upload.commandBuffer);
+}
+
+void updateStreamer(Streamer& streamer, const StreamingMesh& mesh, const float camera[3], uint64_t frame, uint64_t completedFrame)
+{
+	uint64_t uploaded = getTimelineCompleted(streamer.timeline);
+
+	StreamUpload* idle = 0;
+
+	for (size_t i = 0; i < streamer.uploads.size(); i++)
+	{
+		StreamUpload& upload = streamer.uploads[i];
+
+		if (upload.value && upload.value <= uploaded)
+		{
+			for (size_t j = 0; j < upload.chunks.size(); j++)
+			{
+				uint32_t chunk = upload.chunks[j];
+
+				completeLoad(streamer.residency, chunk);
+
+				// the copy was observed complete on the host, so the acquire doesn't need a semaphore wait
+				if (streamer.familyIndex != streamer.dstFamilyIndex)
+				{
+					VkBufferMemoryBarrier acquire = { VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER };
+					acquire.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+					acquire.srcQueueFamilyIndex = streamer.familyIndex;
+					acquire.dstQueueFamilyIndex = streamer.dstFamilyIndex;
+					acquire.buffer = streamer.pool.buffer;
+					acquire.offset = VkDeviceSize(streamer.residency.chunks[chunk].slot) * streamer.slotSize;
+					acquire.size = mesh.chunks[chunk].vertexCount * sizeof(Vertex) + mesh.chunks[chunk].indexCount * sizeof(uint16_t);
+
+					streamer.pendingAcquires.push_back(acquire);
+				}
+			}
+
+			upload.chunks.clear();
+			upload.value = 0;
+		}
+
+		if (upload.value == 0 && !idle)
+			idle = &upload;
+	}
+
+	for (size_t i = 0; i < mesh.chunks.size(); i++)
+	{
+		const StreamChunk& chunk = mesh.chunks[i];
+
+		float dx = chunk.center[0] - camera[0], dy = chunk.center[1] - camera[1], dz = chunk.center[2] - camera[2];
+		streamer.distances[i] = std::max(sqrtf(dx * dx + dy * dy + dz * dz) - chunk.radius, 0.f);
+	}
+
+	updateResidency(streamer.residency, streamer.distances.data(), frame, completedFrame, idle ? streamer.maxLoads : 0, streamer.loads);
+
+	if (!streamer.loads.empty())
+	{
+		idle->chunks = streamer.loads;
+		submitChunks(streamer, *idle, mesh);
+	}
+}
+
+void acquireStreamedChunks(Streamer& streamer, VkCommandBuffer commandBuffer)
+{
+	if (streamer.pendingAcquires.empty())
+		return;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, 0, 0, 0, uint32_t(streamer.pendingAcquires.size()), streamer.pendingAcquires.data(), 0, 0);
+
+	streamer.pendingAcquires.clear();
+}
+
+uint32_t drawStreamedChunks(Streamer& streamer, const StreamingMesh& mesh, VkCommandBuffer commandBuffer, uint64_t& triangles)
+{
+	uint32_t draws = 0;
+	triangles = 0;
+
+	// pulled vertices are addressed by gl_VertexIndex, so the pool is bound once and slots are selected with the vertex
+	// and index offsets of each draw; slots are 256 byte aligned, which keeps both offsets whole
+	if (streamer.vertexPulling)
+		vkCmdBindIndexBuffer(commandBuffer, streamer.pool.buffer, 0, VK_INDEX_TYPE_UINT16);
+
+	for (size_t i = 0; i < mesh.chunks.size(); i++)
+	{
+		const ChunkResidency& residency = streamer.residency.chunks[i];
+
+		if (residency.state != ChunkResident)
+			continue;
+
+		const StreamChunk& chunk = mesh.chunks[i];
+
+		VkDeviceSize offset = VkDeviceSize(residency.slot) * streamer.slotSize;
+
+		draws++;
+		triangles += chunk.indexCount / 3;
+
+		if (streamer.vertexPulling)
+		{
+			uint32_t firstIndex = uint32_t((offset + chunk.vertexCount * sizeof(Vertex)) / sizeof(uint16_t));
+
+			vkCmdDrawIndexed(commandBuffer, chunk.indexCount, 1, firstIndex, int32_t(offset / sizeof(Vertex)), 0);
+			continue;
+		}
+
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &streamer.pool.buffer, &offset);
+		vkCmdBindIndexBuffer(commandBuffer, streamer.pool.buffer, offset + chunk.vertexCount * sizeof(Vertex), VK_INDEX_TYPE_UINT16);
+		vkCmdDrawIndexed(commandBuffer, chunk.indexCount, 1, 0, 0, 0);
+	}
+
+	return draws;
+}
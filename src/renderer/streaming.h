@@ -0,0 +1,81 @@
+#pragma once
+
+#include "mesh.h"
+#include "resources.h"
+#include "residency.h"
+
+// A mesh split into spatially coherent chunks; each chunk has its own vertices and chunk-local 16-bit indices, so any
+// chunk can be placed in any slot of the GPU pool
+struct StreamChunk
+{
+	float center[3];
+	float radius;
+
+	uint32_t vertexOffset, vertexCount; // into StreamingMesh::vertices
+	uint32_t indexOffset, indexCount; // into StreamingMesh::indices
+};
+
+struct StreamingMesh
+{
+	std::vector<Vertex> vertices;
+	std::vector<uint16_t> indices;
+	std::vector<StreamChunk> chunks;
+
+	size_t slotSize; // bytes needed by the largest chunk: vertices followed by indices
+	bool hasNormals;
+};
+
+// mesh indices have to be absolute (before selectIndexSize); chunkTriangles * 3 has to fit in 16 bits
+void buildStreamingMesh(StreamingMesh& result, const Mesh& mesh, uint32_t chunkTriangles);
+
+// GPU side: a single device local Buffer acts as the pool, split into equally sized slots; chunks are copied to their
+// slot on the transfer queue and become drawable when the copy is observed complete
+struct StreamUpload
+{
+	VkCommandPool commandPool;
+	VkCommandBuffer commandBuffer;
+
+	Buffer staging;
+
+	uint64_t value; // transfer timeline value signaled by the batch, 0 if idle
+	std::vector<uint32_t> chunks;
+};
+
+struct Streamer
+{
+	VkDevice device;
+
+	VkQueue queue;
+	uint32_t familyIndex;
+	uint32_t dstFamilyIndex;
+
+	Timeline timeline;
+
+	Buffer pool;
+	size_t slotSize;
+
+	bool vertexPulling; // the pool is read through its device address instead of vertex buffer bindings
+
+	uint32_t maxLoads; // chunks per upload batch
+	std::vector<StreamUpload> uploads;
+
+	Residency residency;
+
+	uint64_t uploadedBytes; // copied to the pool since creation
+
+	std::vector<VkBufferMemoryBarrier> pendingAcquires;
+	std::vector<float> distances;
+	std::vector<uint32_t> loads;
+};
+
+void createStreamer(Streamer& result, VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties, VkQueue queue, uint32_t familyIndex, uint32_t dstFamilyIndex, bool timelineSemaphores, const StreamingMesh& mesh, size_t budget, bool vertexPulling);
+void destroyStreamer(Streamer& streamer);
+
+// Retires finished uploads, updates residency for the camera position and starts new uploads; call once per frame before recording
+void updateStreamer(Streamer& streamer, const StreamingMesh& mesh, const float camera[3], uint64_t frame, uint64_t completedFrame);
+
+// Records ownership acquires for chunks that became resident in the last update; call before drawing
+void acquireStreamedChunks(Streamer& streamer, VkCommandBuffer commandBuffer);
+
+// Returns the number of draws; triangles is set to the number of triangles they cover
+uint32_t drawStreamedChunks(Streamer& streamer, const StreamingMesh& mesh, VkCommandBuffer commandBuffer, uint64_t& triangles);
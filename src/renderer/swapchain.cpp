@@ -0,0 +1,308 @@
+#include "common.h"
+#include "swapchain.h"
+#include "sync.h"
+
+#include <algorithm>
+
+VkImageView createImageView(VkDevice device, VkImage image, VkFormat format, VkImageAspectFlags aspectMask, uint32_t mipLevels)
+{
+	VkImageViewCreateInfo createInfo = { VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO };
+	createInfo.image = image;
+	createInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	createInfo.format = format;
+	createInfo.subresourceRange.aspectMask = aspectMask;
+	createInfo.subresourceRange.layerCount = 1;
+	createInfo.subresourceRange.levelCount = mipLevels;
+
+	VkImageView view = 0;
+	VK_CHECK(vkCreateImageView(device, &createInfo, VK_NULL_HANDLE, &view));
+
+	return view;
+}
+
+VkFramebuffer createFramebuffer(VkDevice device, VkRenderPass renderPass, const VkImageView* imageViews, uint32_t imageViewCount, uint32_t width, uint32_t height)
+{
+	VkFramebufferCreateInfo createInfo = { VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO };
+	createInfo.renderPass = renderPass;
+	createInfo.attachmentCount = imageViewCount;
+	createInfo.pAttachments = imageViews;
+	createInfo.width = width;
+	createInfo.height = height;
+	createInfo.layers = 1;
+
+	VkFramebuffer framebuffer = 0;
+	VK_CHECK(vkCreateFramebuffer(device, &createInfo, 0, &framebuffer));
+
+	return framebuffer;
+}
+
+VkSurfaceFormatKHR chooseSwapSurfaceFormat(VkSurfaceFormatKHR* formats, uint32_t formatCount) {
+	for (uint32_t i = 0; i < formatCount; i++) {
+		if (formats[i].format == VK_FORMAT_B8G8R8A8_SRGB && formats[i].colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR) {
+			return formats[i];
+		}
+	}
+
+	return formats[0];
+}
+
+VkSurfaceFormatKHR getSwapchainFormat(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface, uint32_t) {
+	uint32_t surfaceForamatsCount;
+	VK_CHECK(vkGetPhysicalDeviceSurfaceFormatsKHR(physicalDevice, surface, &surfaceForamatsCount, NULL));
+
+	std::vector<VkSurfaceFormatKHR> formats(surfaceForamatsCount);
+	VK_CHECK(vkGetPhysicalDeviceSurfaceFormatsKHR(physicalDevice, surface, &surfaceForamatsCount, formats.data()));
+
+	auto format = chooseSwapSurfaceFormat(formats.data(), surfaceForamatsCount);
+
+	return format;
+}
+
+VkPresentModeKHR getPresentMode(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface, VkPresentModeKHR requested)
+{
+	uint32_t presentModeCount = 0;
+	VK_CHECK(vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice, surface, &presentModeCount, NULL));
+
+	std::vector<VkPresentModeKHR> presentModes(presentModeCount);
+	VK_CHECK(vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice, surface, &presentModeCount, presentModes.data()));
+
+	for (uint32_t i = 0; i < presentModeCount; i++)
+	{
+		if (presentModes[i] == requested)
+			return requested;
+	}
+
+	// FIFO is the only mode every implementation has to support
+	return VK_PRESENT_MODE_FIFO_KHR;
+}
+
+static VkSwapchainKHR createSwapchain(VkDevice device, const VkSurfaceCapabilitiesKHR& surfaceCaps, VkSurfaceKHR surface, uint32_t familyIndex, VkSurfaceFormatKHR format, VkPresentModeKHR presentMode, uint32_t imageCount, VkSwapchainKHR oldSwapchain)
+{
+	VkCompositeAlphaFlagBitsKHR surfaceComposite =
+		(surfaceCaps.supportedCompositeAlpha & VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR)
+		? VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR
+		: (surfaceCaps.supportedCompositeAlpha & VK_COMPOSITE_ALPHA_PRE_MULTIPLIED_BIT_KHR)
+		? VK_COMPOSITE_ALPHA_PRE_MULTIPLIED_BIT_KHR
+		: (surfaceCaps.supportedCompositeAlpha & VK_COMPOSITE_ALPHA_POST_MULTIPLIED_BIT_KHR)
+		? VK_COMPOSITE_ALPHA_POST_MULTIPLIED_BIT_KHR
+		: VK_COMPOSITE_ALPHA_INHERIT_BIT_KHR;
+
+	VkSwapchainCreateInfoKHR createInfo = { VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR };
+	createInfo.surface = surface;
+	createInfo.minImageCount = imageCount;
+
+	createInfo.imageFormat = format.format;
+	createInfo.imageColorSpace = format.colorSpace;
+	createInfo.imageExtent.width = surfaceCaps.currentExtent.width;
+	createInfo.imageExtent.height = surfaceCaps.currentExtent.height;
+	createInfo.imageArrayLayers = 1;
+	createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+
+	createInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	createInfo.queueFamilyIndexCount = 1;
+	createInfo.pQueueFamilyIndices = &familyIndex;
+	createInfo.preTransform = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR;
+	createInfo.compositeAlpha = surfaceComposite;
+	createInfo.presentMode = presentMode;
+	createInfo.clipped = VK_TRUE;
+	createInfo.oldSwapchain = oldSwapchain;
+
+	VkSwapchainKHR swapchain = 0;
+	VK_CHECK(vkCreateSwapchainKHR(device, &createInfo, NULL, &swapchain));
+
+	return swapchain;
+}
+
+// currentExtent is 0xFFFFFFFF when the swapchain decides the surface size (Wayland); the window size is used then
+static VkExtent2D getSwapchainExtent(const VkSurfaceCapabilitiesKHR& surfaceCaps, uint32_t windowWidth, uint32_t windowHeight)
+{
+	if (surfaceCaps.currentExtent.width != 0xFFFFFFFF)
+		return surfaceCaps.currentExtent;
+
+	// a minimized window has no area, even if the surface allows a larger minimum
+	if (windowWidth == 0 || windowHeight == 0)
+	{
+		VkExtent2D empty = {0, 0};
+		return empty;
+	}
+
+	VkExtent2D extent = {windowWidth, windowHeight};
+	extent.width = std::max(surfaceCaps.minImageExtent.width, std::min(surfaceCaps.maxImageExtent.width, extent.width));
+	extent.height = std::max(surfaceCaps.minImageExtent.height, std::min(surfaceCaps.maxImageExtent.height, extent.height));
+
+	return extent;
+}
+
+static uint32_t getSwapchainImageCount(const VkSurfaceCapabilitiesKHR& surfaceCaps, uint32_t requested)
+{
+	// fewer images reduce latency, more images absorb frame time spikes at the cost of queueing
+	uint32_t imageCount = requested ? requested : surfaceCaps.minImageCount + 1;
+
+	imageCount = imageCount < surfaceCaps.minImageCount ? surfaceCaps.minImageCount : imageCount;
+	imageCount = (surfaceCaps.maxImageCount && imageCount > surfaceCaps.maxImageCount) ? surfaceCaps.maxImageCount : imageCount;
+
+	return imageCount;
+}
+
+static void createSwapchain(Swapchain& result, VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties, const VkSurfaceCapabilitiesKHR& surfaceCaps, VkSurfaceKHR surface, uint32_t familyIndex, VkSurfaceFormatKHR format, VkRenderPass renderPass,
+	VkPresentModeKHR presentMode, uint32_t imageCount, const SwapchainSettings& settings, VkSwapchainKHR oldSwapchain)
+{
+	uint32_t width = surfaceCaps.currentExtent.width;
+	uint32_t height = surfaceCaps.currentExtent.height;
+
+	// transient attachments only live during rendering; on tiled GPUs they stay in tile memory and their memory is never committed
+	Image color = {};
+	Image depth = {};
+
+	if (settings.samples != VK_SAMPLE_COUNT_1_BIT)
+		createImage(color, device, memoryProperties, width, height, format.format, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT, settings.samples);
+
+	if (settings.depthFormat != VK_FORMAT_UNDEFINED)
+		createImage(depth, device, memoryProperties, width, height, settings.depthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT, settings.samples);
+
+	VkSwapchainKHR swapchain = createSwapchain(device, surfaceCaps, surface, familyIndex, format, presentMode, imageCount, oldSwapchain);
+
+	VK_CHECK(vkGetSwapchainImagesKHR(device, swapchain, &imageCount, VK_NULL_HANDLE));
+
+	std::vector<VkImage> swapchainImages(imageCount);
+	VK_CHECK(vkGetSwapchainImagesKHR(device, swapchain, &imageCount, swapchainImages.data()));
+
+	std::vector<VkImageView> swapchainImageViews(imageCount);
+	for (uint32_t i = 0; i < imageCount; i++)
+	{
+		swapchainImageViews[i] = createImageView(device, swapchainImages[i], format.format);
+		assert(swapchainImageViews[i]);
+	}
+
+	// with dynamic rendering (renderPass == 0) image views are bound directly at vkCmdBeginRenderingKHR time
+	std::vector<VkFramebuffer> swapchainFramebuffers(renderPass ? imageCount : 0);
+	for (size_t i = 0; i < swapchainFramebuffers.size(); i++)
+	{
+		VkImageView attachments[3];
+		uint32_t attachmentCount = 0;
+
+		attachments[attachmentCount++] = color.imageView ? color.imageView : swapchainImageViews[i];
+
+		if (depth.imageView)
+			attachments[attachmentCount++] = depth.imageView;
+
+		if (color.imageView)
+			attachments[attachmentCount++] = swapchainImageViews[i];
+
+		swapchainFramebuffers[i] = createFramebuffer(device, renderPass, attachments, attachmentCount, width, height);
+		assert(swapchainFramebuffers[i]);
+	}
+
+	std::vector<VkSemaphore> releaseSemaphores(imageCount);
+	for (uint32_t i = 0; i < imageCount; i++)
+	{
+		VkSemaphoreCreateInfo semaphoreInfo = { VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO };
+		VK_CHECK(vkCreateSemaphore(device, &semaphoreInfo, NULL, &releaseSemaphores[i]));
+	}
+
+	result.swapchain = swapchain;
+
+	result.imageCount = imageCount;
+
+	result.images = swapchainImages;
+	result.imageViews = swapchainImageViews;
+	result.framebuffers = swapchainFramebuffers;
+	result.releaseSemaphores = releaseSemaphores;
+
+	result.width = width;
+	result.height = height;
+	result.presentMode = presentMode;
+
+	result.samples = settings.samples;
+	result.color = color;
+	result.depth = depth;
+}
+
+void createSwapchain(Swapchain& result, VkDevice device, VkPhysicalDevice physicalDevice, VkSurfaceKHR surface, uint32_t windowWidth, uint32_t windowHeight, uint32_t familyIndex, VkSurfaceFormatKHR format, VkRenderPass renderPass, const SwapchainSettings& settings, VkSwapchainKHR oldSwapchain)
+{
+	VkSurfaceCapabilitiesKHR surfaceCaps;
+	VK_CHECK(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physicalDevice, surface, &surfaceCaps));
+
+	// everything below sizes the swapchain from currentExtent
+	surfaceCaps.currentExtent = getSwapchainExtent(surfaceCaps, windowWidth, windowHeight);
+
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+	VkPresentModeKHR presentMode = getPresentMode(physicalDevice, surface, settings.presentMode);
+	uint32_t imageCount = getSwapchainImageCount(surfaceCaps, settings.imageCount);
+
+	createSwapchain(result, device, memoryProperties, surfaceCaps, surface, familyIndex, format, renderPass, presentMode, imageCount, settings, oldSwapchain);
+}
+
+void destroySwapchain(Swapchain& swapchain, VkDevice device)
+{
+	for (size_t i = 0; i < swapchain.framebuffers.size(); i++)
+	{
+		vkDestroyFramebuffer(device, swapchain.framebuffers[i], VK_NULL_HANDLE);
+	}
+
+	for (uint32_t i = 0; i < swapchain.imageCount; i++)
+	{
+		vkDestroyImageView(device, swapchain.imageViews[i], VK_NULL_HANDLE);
+	}
+
+	for (size_t i = 0; i < swapchain.releaseSemaphores.size(); i++)
+	{
+		vkDestroySemaphore(device, swapchain.releaseSemaphores[i], VK_NULL_HANDLE);
+	}
+
+	if (swapchain.color.image)
+		destroyImage(swapchain.color, device);
+
+	if (swapchain.depth.image)
+		destroyImage(swapchain.depth, device);
+
+	vkDestroySwapchainKHR(device, swapchain.swapchain, VK_NULL_HANDLE);
+}
+
+void deferDestroySwapchain(DeletionQueue& queue, uint64_t value, Swapchain& swapchain)
+{
+	for (size_t i = 0; i < swapchain.framebuffers.size(); i++)
+		deferDestroy(queue, value, VK_OBJECT_TYPE_FRAMEBUFFER, (uint64_t)swapchain.framebuffers[i]);
+
+	for (size_t i = 0; i < swapchain.imageViews.size(); i++)
+		deferDestroy(queue, value, VK_OBJECT_TYPE_IMAGE_VIEW, (uint64_t)swapchain.imageViews[i]);
+
+	for (size_t i = 0; i < swapchain.releaseSemaphores.size(); i++)
+		deferDestroy(queue, value, VK_OBJECT_TYPE_SEMAPHORE, (uint64_t)swapchain.releaseSemaphores[i]);
+
+	if (swapchain.color.image)
+		deferDestroyImage(queue, value, swapchain.color);
+
+	if (swapchain.depth.image)
+		deferDestroyImage(queue, value, swapchain.depth);
+
+	deferDestroy(queue, value, VK_OBJECT_TYPE_SWAPCHAIN_KHR, (uint64_t)swapchain.swapchain);
+}
+
+bool resizeSwapchain(Swapchain& result, DeletionQueue& deletionQueue, uint64_t value, VkDevice device, VkPhysicalDevice physicalDevice, VkSurfaceKHR surface, uint32_t windowWidth, uint32_t windowHeight, uint32_t familyIndex, VkSurfaceFormatKHR format, VkRenderPass renderPass, const SwapchainSettings& settings)
+{
+	VkSurfaceCapabilitiesKHR surfaceCaps;
+	VK_CHECK(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physicalDevice, surface, &surfaceCaps));
+
+	// everything below sizes the swapchain from currentExtent
+	surfaceCaps.currentExtent = getSwapchainExtent(surfaceCaps, windowWidth, windowHeight);
+
+	if (surfaceCaps.currentExtent.width == 0 || surfaceCaps.currentExtent.height == 0)
+		return false;
+
+	// callers only get here after a resize event or an out of date/suboptimal result, so recreate even if the extent matches
+	Swapchain old = result;
+
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+	// the present mode was validated when the swapchain was first created and surface support doesn't change
+	createSwapchain(result, device, memoryProperties, surfaceCaps, surface, familyIndex, format, renderPass, result.presentMode, getSwapchainImageCount(surfaceCaps, settings.imageCount), settings, old.swapchain);
+
+	deferDestroySwapchain(deletionQueue, value, old);
+
+	return true;
+}
+
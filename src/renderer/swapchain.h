@@ -0,0 +1,49 @@
+#pragma once
+
+#include "resources.h"
+
+struct SwapchainSettings
+{
+	VkPresentModeKHR presentMode; // FIFO, MAILBOX or IMMEDIATE; unsupported modes fall back to FIFO
+	uint32_t imageCount; // 0 selects minImageCount + 1; clamped to the surface limits
+
+	// with more than one sample, rendering goes to a multisampled color attachment that is resolved into the swapchain image
+	VkSampleCountFlagBits samples;
+	VkFormat depthFormat; // VK_FORMAT_UNDEFINED without depth
+};
+
+struct Swapchain {
+	VkSwapchainKHR swapchain;
+	std::vector<VkImage> images;
+	std::vector<VkImageView> imageViews;
+	std::vector<VkFramebuffer> framebuffers;
+	std::vector<VkSemaphore> releaseSemaphores; // one per image: an image isn't reacquired until its present has waited
+	uint32_t width, height;
+	uint32_t imageCount;
+	VkPresentModeKHR presentMode;
+
+	// Transient attachments shared by all images, contents are discarded at the end of rendering: color is only created
+	// with MSAA, depth if the settings ask for it. Framebuffer attachments are color (multisampled or the swapchain image),
+	// depth, and the swapchain image as resolve target with MSAA
+	VkSampleCountFlagBits samples;
+	Image color;
+	Image depth;
+};
+
+VkImageView createImageView(VkDevice device, VkImage image, VkFormat format, VkImageAspectFlags aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, uint32_t mipLevels = 1);
+VkFramebuffer createFramebuffer(VkDevice device, VkRenderPass renderPass, const VkImageView* imageViews, uint32_t imageViewCount, uint32_t width, uint32_t height);
+
+VkSurfaceFormatKHR getSwapchainFormat(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface, uint32_t familyIndex);
+VkPresentModeKHR getPresentMode(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface, VkPresentModeKHR requested);
+
+// windowWidth/windowHeight is the framebuffer size of the window, used where the surface has no fixed extent
+void createSwapchain(Swapchain& result, VkDevice device, VkPhysicalDevice physicalDevice, VkSurfaceKHR surface, uint32_t windowWidth, uint32_t windowHeight, uint32_t familyIndex, VkSurfaceFormatKHR format, VkRenderPass renderPass, const SwapchainSettings& settings, VkSwapchainKHR oldSwapchain = 0);
+void destroySwapchain(Swapchain& swapchain, VkDevice device);
+
+// Queues every object owned by the swapchain for destruction once the timeline reaches value
+void deferDestroySwapchain(DeletionQueue& queue, uint64_t value, Swapchain& swapchain);
+
+// Recreates the swapchain if the surface extent changed; returns false if the surface currently has no area (minimized window).
+// The previous swapchain is deferred for destruction until the timeline reaches value, so no device wait is necessary.
+bool resizeSwapchain(Swapchain& result, DeletionQueue& deletionQueue, uint64_t value, VkDevice device, VkPhysicalDevice physicalDevice, VkSurfaceKHR surface, uint32_t windowWidth, uint32_t windowHeight, uint32_t familyIndex, VkSurfaceFormatKHR format, VkRenderPass renderPass, const SwapchainSettings& settings);
+
@@ -0,0 +1,87 @@
+#include "common.h"
+#include "sync.h"
+#include "device.h"
+
+void createTimeline(Timeline& result, VkDevice device, bool timelineSemaphores)
+{
+	result.device = device;
+	result.semaphore = timelineSemaphores ? createTimelineSemaphore(device, 0) : 0;
+	result.submitted = 0;
+	result.completed = 0;
+}
+
+void destroyTimeline(Timeline& timeline)
+{
+	if (timeline.semaphore)
+		vkDestroySemaphore(timeline.device, timeline.semaphore, VK_NULL_HANDLE);
+
+	timeline.semaphore = 0;
+}
+
+uint64_t nextTimelineValue(Timeline& timeline)
+{
+	return ++timeline.submitted;
+}
+
+uint64_t getTimelineCompleted(Timeline& timeline)
+{
+#ifdef VK_KHR_timeline_semaphore
+	if (timeline.semaphore && timeline.completed < timeline.submitted)
+		VK_CHECK(vkGetSemaphoreCounterValueKHR(timeline.device, timeline.semaphore, &timeline.completed));
+#endif
+
+	return timeline.completed;
+}
+
+void waitTimeline(Timeline& timeline, uint64_t value)
+{
+	assert(value <= timeline.submitted);
+
+	if (value <= timeline.completed)
+		return;
+
+	assert(timeline.semaphore);
+	waitTimelineSemaphore(timeline.device, timeline.semaphore, value);
+
+	timeline.completed = value;
+}
+
+uint64_t submitTimeline(Timeline& timeline, VkQueue queue, VkCommandBuffer commandBuffer)
+{
+	VkSubmitInfo submitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &commandBuffer;
+
+	uint64_t signalValue = nextTimelineValue(timeline);
+
+#ifdef VK_KHR_timeline_semaphore
+	VkTimelineSemaphoreSubmitInfoKHR timelineInfo = { VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR };
+	timelineInfo.signalSemaphoreValueCount = 1;
+	timelineInfo.pSignalSemaphoreValues = &signalValue;
+
+	if (timeline.semaphore)
+	{
+		submitInfo.pNext = &timelineInfo;
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = &timeline.semaphore;
+	}
+#endif
+
+	VK_CHECK(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+
+	// without a timeline there is no way to tell when the work is done, so make it complete before returning
+	if (!timeline.semaphore)
+	{
+		VK_CHECK(vkQueueWaitIdle(queue));
+		markTimelineCompleted(timeline, signalValue);
+	}
+
+	return signalValue;
+}
+
+void markTimelineCompleted(Timeline& timeline, uint64_t value)
+{
+	assert(value <= timeline.submitted);
+
+	timeline.completed = value > timeline.completed ? value : timeline.completed;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "deletionqueue.h"
+
+// GPU progress of one queue as a monotonically increasing value: every submission signals the next value, and
+// everything submitted up to value N has completed once the timeline reaches N
+struct Timeline
+{
+	VkDevice device;
+	VkSemaphore semaphore; // 0 if timeline semaphores are unsupported; progress is then reported with markTimelineCompleted
+
+	uint64_t submitted; // value signaled by the last submission
+	uint64_t completed; // last value known to be reached
+};
+
+void createTimeline(Timeline& result, VkDevice device, bool timelineSemaphores);
+void destroyTimeline(Timeline& timeline);
+
+// Returns the value the next submission has to signal
+uint64_t nextTimelineValue(Timeline& timeline);
+
+uint64_t getTimelineCompleted(Timeline& timeline);
+void waitTimeline(Timeline& timeline, uint64_t value);
+
+// Submits commandBuffer signaling the next value and returns it; without a timeline semaphore the queue is drained instead
+uint64_t submitTimeline(Timeline& timeline, VkQueue queue, VkCommandBuffer commandBuffer);
+
+// Fallback for queues tracked with fences: records that value was reached
+void markTimelineCompleted(Timeline& timeline, uint64_t value);
@@ -0,0 +1,95 @@
+#include "tests.h"
+
+#include "common.h"
+#include "deletionqueue.h"
+
+#include <map>
+
+struct DestroyLog
+{
+	std::vector<uint64_t> handles; // in destruction order
+	std::map<uint64_t, int> counts;
+};
+
+static void recordDestroy(void* context, VkObjectType type, uint64_t handle)
+{
+	DestroyLog* log = static_cast<DestroyLog*>(context);
+
+	CHECK(type == VK_OBJECT_TYPE_BUFFER);
+
+	log->handles.push_back(handle);
+	log->counts[handle]++;
+}
+
+static bool destroyed(const DestroyLog& log, size_t offset, const uint64_t* expected, size_t count)
+{
+	if (log.handles.size() != offset + count)
+		return false;
+
+	for (size_t i = 0; i < count; ++i)
+		if (log.handles[offset + i] != expected[i])
+			return false;
+
+	return true;
+}
+
+void testDeletionQueue()
+{
+	DestroyLog log;
+
+	DeletionQueue queue;
+	createDeletionQueue(queue, recordDestroy, &log);
+
+	// values arrive out of order, like objects retired by different queues or by resizes between frames
+	deferDestroy(queue, 3, VK_OBJECT_TYPE_BUFFER, 0xa);
+	deferDestroy(queue, 1, VK_OBJECT_TYPE_BUFFER, 0xb);
+	deferDestroy(queue, 5, VK_OBJECT_TYPE_BUFFER, 0xc);
+	deferDestroy(queue, 2, VK_OBJECT_TYPE_BUFFER, 0xd);
+	deferDestroy(queue, 1, VK_OBJECT_TYPE_BUFFER, 0xe);
+	deferDestroy(queue, 4, VK_OBJECT_TYPE_BUFFER, 0xf);
+
+	// null handles are not queued
+	deferDestroy(queue, 1, VK_OBJECT_TYPE_BUFFER, 0);
+
+	CHECK(queue.entries.size() == 6);
+
+	CHECK(flushDeletionQueue(queue, 0) == 0);
+	CHECK(log.handles.empty());
+
+	static const uint64_t first[] = {0xb, 0xe};
+
+	CHECK(flushDeletionQueue(queue, 1) == 2);
+	CHECK(destroyed(log, 0, first, 2));
+
+	// flushing the same value again destroys nothing
+	CHECK(flushDeletionQueue(queue, 1) == 0);
+	CHECK(log.handles.size() == 2);
+
+	// retirement order, not value order
+	static const uint64_t second[] = {0xa, 0xd};
+
+	CHECK(flushDeletionQueue(queue, 3) == 2);
+	CHECK(destroyed(log, 2, second, 2));
+
+	// objects retired at a value that was already reached go with the next flush
+	deferDestroy(queue, 2, VK_OBJECT_TYPE_BUFFER, 0x10);
+
+	static const uint64_t third[] = {0x10};
+
+	CHECK(flushDeletionQueue(queue, 3) == 1);
+	CHECK(destroyed(log, 4, third, 1));
+
+	// shutdown flushes everything
+	static const uint64_t last[] = {0xc, 0xf};
+
+	CHECK(flushDeletionQueue(queue, ~0ull) == 2);
+	CHECK(destroyed(log, 5, last, 2));
+	CHECK(queue.entries.empty());
+
+	CHECK(log.counts.size() == 7);
+
+	for (std::map<uint64_t, int>::const_iterator it = log.counts.begin(); it != log.counts.end(); ++it)
+		CHECK(it->second == 1);
+
+	CHECK(flushDeletionQueue(queue, ~0ull) == 0);
+}
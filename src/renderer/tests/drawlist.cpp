@@ -0,0 +1,121 @@
+#include "tests.h"
+
+#include "drawlist.h"
+
+#include <float.h>
+#include <string.h>
+
+static bool sameCommand(const DrawCommand& command, uint32_t indexCount, uint32_t firstIndex, int32_t vertexOffset, uint32_t firstInstance)
+{
+	return command.indexCount == indexCount && command.instanceCount == 1 && command.firstIndex == firstIndex && command.vertexOffset == vertexOffset && command.firstInstance == firstInstance;
+}
+
+// record i has indexOffset 3i, indexCount 3 + i and vertexOffset 10i, so every command identifies its record
+static void addSubmesh(Mesh& mesh, uint32_t material, float x, float y, float z, float radius)
+{
+	uint32_t i = uint32_t(mesh.submeshes.size());
+
+	Submesh submesh = { i * 3, 3 + i, i * 10, material, { x, y, z }, radius };
+	mesh.submeshes.push_back(submesh);
+}
+
+void testDrawList()
+{
+	Mesh mesh;
+
+	// the camera sees |x|, |y| <= 1 + r and -r <= z <= 1 + r
+	addSubmesh(mesh, 0, 0, 0, 0.5f, 0); // 0: visible
+	addSubmesh(mesh, 0, 5, 0, 0.5f, 0); // 1: right of the view
+	addSubmesh(mesh, 0, 0, 0, -2, 0.5f); // 2: behind the camera
+	addSubmesh(mesh, 0, 0, 1.5f, 0.5f, 1); // 3: intersects the top
+	addSubmesh(mesh, 1, 0, 0, 3, 0); // 4: too far
+	addSubmesh(mesh, 1, 0, 0, 3, 2.5f); // 5: intersects the far plane
+	addSubmesh(mesh, 2, -0.5f, 0.5f, 1, FLT_MAX); // 6: unknown bounds
+	addSubmesh(mesh, 2, 9, 9, 9, 0); // 7: outside
+
+	// material 3 has one more full batch; records 8, 4103 (last of the batch) and 4105 are visible
+	for (uint32_t j = 0; j < kDrawBatchSize + 2; j++)
+	{
+		bool visible = j == 0 || j == kDrawBatchSize - 1 || j == kDrawBatchSize + 1;
+
+		addSubmesh(mesh, 3, visible ? 0.f : 100.f, 0, 0.5f, 0);
+	}
+
+	DrawList list;
+	buildDrawList(list, mesh);
+
+	CHECK(list.records.size() == 8 + kDrawBatchSize + 2);
+	CHECK(list.batches.size() == 5);
+
+	if (list.batches.size() != 5)
+		return;
+
+	static const uint32_t expectedBatches[5][3] = {
+		{0, 4, 0},
+		{4, 2, 1},
+		{6, 2, 2},
+		{8, kDrawBatchSize, 3},
+		{8 + kDrawBatchSize, 2, 3},
+	};
+
+	for (int i = 0; i < 5; i++)
+		CHECK(list.batches[i].firstRecord == expectedBatches[i][0] && list.batches[i].recordCount == expectedBatches[i][1] && list.batches[i].material == expectedBatches[i][2]);
+
+	std::vector<DrawCommand> commands(list.records.size());
+	std::vector<uint32_t> counts(list.batches.size());
+
+	// entries past the count of a batch have to keep the fill pattern
+	memset(&commands[0], 0xcd, commands.size() * sizeof(DrawCommand));
+
+	DrawCommand untouched;
+	memset(&untouched, 0xcd, sizeof(untouched));
+
+	float camera[3] = {0, 0, 0};
+
+	CHECK(cullDraws(&commands[0], &counts[0], list, camera) == 7);
+
+	CHECK(counts[0] == 2 && counts[1] == 1 && counts[2] == 1 && counts[3] == 2 && counts[4] == 1);
+
+	// visible records of a batch are compacted to its start, in record order
+	CHECK(sameCommand(commands[0], 3, 0, 0, 0));
+	CHECK(sameCommand(commands[1], 6, 9, 30, 3));
+	CHECK(memcmp(&commands[2], &untouched, sizeof(untouched)) == 0);
+	CHECK(memcmp(&commands[3], &untouched, sizeof(untouched)) == 0);
+	CHECK(sameCommand(commands[4], 8, 15, 50, 5));
+	CHECK(memcmp(&commands[5], &untouched, sizeof(untouched)) == 0);
+	CHECK(sameCommand(commands[6], 9, 18, 60, 6));
+	CHECK(memcmp(&commands[7], &untouched, sizeof(untouched)) == 0);
+	CHECK(sameCommand(commands[8], 11, 24, 80, 8));
+	CHECK(sameCommand(commands[9], 4106, 12309, 41030, 4103));
+	CHECK(memcmp(&commands[10], &untouched, sizeof(untouched)) == 0);
+	CHECK(sameCommand(commands[8 + kDrawBatchSize], 4108, 12315, 41050, 4105));
+	CHECK(memcmp(&commands[9 + kDrawBatchSize], &untouched, sizeof(untouched)) == 0);
+
+	// whole triangles of every visible record: 1 + 2 + 2 + 3 + 3 + 1368 + 1369
+	uint64_t triangles = 0;
+
+	CHECK(countDraws(triangles, &commands[0], &counts[0], list) == 7);
+	CHECK(triangles == 2748);
+
+	// another camera position rewrites the start of each batch and leaves the commands past the new counts
+	float right[3] = {5, 0, 0};
+
+	CHECK(cullDraws(&commands[0], &counts[0], list, right) == 2);
+
+	CHECK(counts[0] == 1 && counts[1] == 0 && counts[2] == 1 && counts[3] == 0 && counts[4] == 0);
+	CHECK(sameCommand(commands[0], 4, 3, 10, 1));
+	CHECK(sameCommand(commands[1], 6, 9, 30, 3));
+	CHECK(sameCommand(commands[4], 8, 15, 50, 5));
+	CHECK(sameCommand(commands[6], 9, 18, 60, 6));
+
+	// commands past the counts are stale and not counted
+	CHECK(countDraws(triangles, &commands[0], &counts[0], list) == 2);
+	CHECK(triangles == 4);
+
+	// counts that don't fit their batch are clamped
+	commands[5] = commands[4];
+	counts[1] = 100;
+
+	CHECK(countDraws(triangles, &commands[0], &counts[0], list) == 4);
+	CHECK(triangles == 8);
+}
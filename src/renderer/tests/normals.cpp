@@ -0,0 +1,201 @@
+#include "tests.h"
+
+#include "normals.h"
+#include "scenegen.h"
+
+#include <math.h>
+#include <string.h>
+
+// unit cube with 4 vertices per face and a separate range of texture coordinates for every face; with shared set,
+// faces use the 8 corners directly
+static void makeCube(Mesh& result, bool shared)
+{
+	static const int faces[6][4] = {
+	    {0, 4, 6, 2}, {1, 3, 7, 5}, // -x, +x
+	    {0, 1, 5, 4}, {2, 6, 7, 3}, // -y, +y
+	    {0, 2, 3, 1}, {4, 5, 7, 6}, // -z, +z
+	};
+
+	static const float uvs[4][2] = {{0, 0}, {1, 0}, {1, 1}, {0, 1}};
+
+	result.vertices.clear();
+	result.indices.clear();
+
+	if (shared)
+		for (int i = 0; i < 8; i++)
+		{
+			Vertex v = {float(i & 1), float((i >> 1) & 1), float((i >> 2) & 1), 0, 0, 0, 0, 0};
+			result.vertices.push_back(v);
+		}
+
+	for (int f = 0; f < 6; f++)
+	{
+		uint32_t quad[4];
+
+		for (int k = 0; k < 4; k++)
+		{
+			int i = faces[f][k];
+
+			if (shared)
+				quad[k] = uint32_t(i);
+			else
+			{
+				Vertex v = {float(i & 1), float((i >> 1) & 1), float((i >> 2) & 1), 0, 0, 0, uvs[k][0] + float(f), uvs[k][1]};
+
+				quad[k] = uint32_t(result.vertices.size());
+				result.vertices.push_back(v);
+			}
+		}
+
+		uint32_t triangles[6] = {quad[0], quad[1], quad[2], quad[0], quad[2], quad[3]};
+		result.indices.insert(result.indices.end(), triangles, triangles + 6);
+	}
+
+	Submesh submesh = {0, uint32_t(result.indices.size()), 0, 0, {0.5f, 0.5f, 0.5f}, 1};
+
+	result.submeshes.assign(1, submesh);
+	result.hasNormals = false;
+}
+
+static bool isNear(float a, float b)
+{
+	return fabsf(a - b) < 1e-5f;
+}
+
+// every corner has the normal of its face
+static bool isFlat(const Mesh& mesh)
+{
+	bool flat = true;
+
+	for (size_t i = 0; i < mesh.indices.size(); i += 3)
+	{
+		const Vertex& a = mesh.vertices[mesh.indices[i + 0]];
+		const Vertex& b = mesh.vertices[mesh.indices[i + 1]];
+		const Vertex& c = mesh.vertices[mesh.indices[i + 2]];
+
+		float e1[3] = {b.vx - a.vx, b.vy - a.vy, b.vz - a.vz};
+		float e2[3] = {c.vx - a.vx, c.vy - a.vy, c.vz - a.vz};
+		float n[3] = {e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0]};
+
+		for (int k = 0; k < 3; k++)
+		{
+			const Vertex& v = mesh.vertices[mesh.indices[i + k]];
+			flat &= isNear(v.nx, n[0]) && isNear(v.ny, n[1]) && isNear(v.nz, n[2]);
+		}
+	}
+
+	return flat;
+}
+
+// every vertex points away from the cube center along the diagonal
+static bool isSmooth(const Mesh& mesh)
+{
+	float d = 1 / sqrtf(3.f);
+	bool smooth = true;
+
+	for (size_t i = 0; i < mesh.vertices.size(); i++)
+	{
+		const Vertex& v = mesh.vertices[i];
+		smooth &= isNear(v.nx, v.vx ? d : -d) && isNear(v.ny, v.vy ? d : -d) && isNear(v.nz, v.vz ? d : -d);
+	}
+
+	return smooth;
+}
+
+static void testSmoothingAngle()
+{
+	// corner angles add up to 90 degrees on every face around a corner, so angle weighting averages faces evenly
+	NormalSettings flat = {60, NormalWeightAngle};
+	NormalSettings split = {100, NormalWeightAngle};
+	NormalSettings smooth = {180, NormalWeightAngle};
+
+	Mesh cube;
+
+	// faces meet at 90 degrees, so a 60 degree smoothing angle splits every corner into 3 vertices
+	makeCube(cube, true);
+	generateNormals(cube, flat, 1);
+
+	CHECK(cube.hasNormals);
+	CHECK(cube.vertices.size() == 24 && cube.indices.size() == 36);
+	CHECK(isFlat(cube));
+
+	// above 90 degrees, the corners are welded again
+	makeCube(cube, true);
+	generateNormals(cube, split, 1);
+
+	CHECK(cube.vertices.size() == 8 && cube.indices.size() == 36);
+	CHECK(isSmooth(cube));
+
+	makeCube(cube, true);
+	generateNormals(cube, smooth, 1);
+
+	CHECK(cube.vertices.size() == 8);
+	CHECK(isSmooth(cube));
+
+	// texture seams keep their vertices but don't split normals
+	makeCube(cube, false);
+	generateNormals(cube, flat, 1);
+
+	CHECK(cube.vertices.size() == 24);
+	CHECK(isFlat(cube));
+
+	makeCube(cube, false);
+	generateNormals(cube, split, 1);
+
+	CHECK(cube.vertices.size() == 24);
+	CHECK(isSmooth(cube));
+
+	makeCube(cube, false);
+	generateNormals(cube, smooth, 1);
+
+	CHECK(cube.vertices.size() == 24);
+	CHECK(isSmooth(cube));
+}
+
+static bool isSameMesh(const Mesh& lhs, const Mesh& rhs)
+{
+	return lhs.indices == rhs.indices && lhs.vertices.size() == rhs.vertices.size() && memcmp(&lhs.vertices[0], &rhs.vertices[0], lhs.vertices.size() * sizeof(Vertex)) == 0;
+}
+
+static void testThreads(const char* spec, const NormalSettings& settings)
+{
+	SceneSettings sceneSettings;
+	CHECK(parseSceneSettings(sceneSettings, spec));
+
+	Mesh scene;
+	generateScene(scene, sceneSettings);
+
+	Mesh single = scene;
+	generateNormals(single, settings, 1);
+
+	std::vector<Tangent> singleTangents;
+	generateTangents(singleTangents, single, 1);
+
+	// threads only kick in above 16K triangles each, so the scene has to be large enough to use all of them
+	for (uint32_t threadCount = 2; threadCount <= 8; threadCount *= 2)
+	{
+		Mesh threaded = scene;
+		generateNormals(threaded, settings, threadCount);
+
+		CHECK(isSameMesh(threaded, single));
+
+		std::vector<Tangent> tangents;
+		generateTangents(tangents, threaded, threadCount);
+
+		CHECK(tangents.size() == singleTangents.size() && memcmp(&tangents[0], &singleTangents[0], tangents.size() * sizeof(Tangent)) == 0);
+	}
+}
+
+void testNormals()
+{
+	testSmoothingAngle();
+
+	NormalSettings split = {45, NormalWeightArea};
+	NormalSettings smooth = {180, NormalWeightAngle};
+
+	testThreads("scene:tris=200K,vpt=0.6,meshes=2,instances=4", split);
+	testThreads("scene:tris=200K,vpt=0.6,meshes=2,instances=4", smooth);
+
+	// instances laid out randomly reference vertices all over the mesh from every thread
+	testThreads("scene:tris=200K,vpt=3,instances=16,layout=random", split);
+}
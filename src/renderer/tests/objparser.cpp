@@ -0,0 +1,301 @@
+#include "tests.h"
+
+#include "objparser.h"
+
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+static void parse(ObjFile& result, const char* text)
+{
+	// the parser terminates lines in place and needs the spare byte
+	std::vector<char> buffer(text, text + strlen(text) + 1);
+
+	objParseBuffer(result, &buffer[0], buffer.size() - 1);
+}
+
+static void testFaces()
+{
+	ObjFile file;
+	parse(file,
+	    "v 0 0 0\n"
+	    "v 1 0 0\n"
+	    "v 1 1 0\n"
+	    "v 0 1 0\n"
+	    "vt 0 0\n"
+	    "vt 1 1\n"
+	    "vn 0 0 1\n"
+	    "f 1/1/1 2/2/1 3/2/1 4/1/1\n");
+
+	CHECK(file.v_size == 12);
+	CHECK(file.vt_size == 6 && file.vt_stride == 3);
+	CHECK(file.vn_size == 3);
+
+	// the quad is triangulated as a fan
+	static const int expected[] = {
+		0, 0, 0, 1, 1, 0, 2, 1, 0,
+		0, 0, 0, 2, 1, 0, 3, 0, 0,
+	};
+
+	CHECK(file.f_size == 18 && file.f_stride == 9);
+	CHECK(file.f_size == 18 && memcmp(file.f, expected, sizeof(expected)) == 0);
+	CHECK(objValidate(file));
+}
+
+static void testIndexForms()
+{
+	ObjFile file;
+	parse(file,
+	    "v 0 0 0\n"
+	    "v 1 0 0\n"
+	    "v 1 1 0\n"
+	    "vn 0 0 1\n"
+	    "f 1 2 3\n"
+	    "f -3//-1 -2//-1 -1//-1\n");
+
+	// omitted indices are -1, relative indices count back from the last element
+	static const int expected[] = {
+		0, -1, -1, 1, -1, -1, 2, -1, -1,
+		0, -1, 0, 1, -1, 0, 2, -1, 0,
+	};
+
+	CHECK(file.f_size == 18 && memcmp(file.f, expected, sizeof(expected)) == 0);
+	CHECK(objValidate(file));
+}
+
+static void testInvalid()
+{
+	// references past the end are only known to be invalid once the file is parsed
+	ObjFile past;
+	parse(past, "v 0 0 0\nf 1 2 3\n");
+
+	CHECK(!objValidate(past));
+
+	// relative indices that resolve before the first element
+	ObjFile relative;
+	parse(relative, "v 0 0 0\nf -1 -2 -3\n");
+
+	CHECK(!objValidate(relative));
+
+	// truncated lines and garbage leave the file consistent
+	ObjFile garbage;
+	parse(garbage, "v 1\nvt\nf 1/\nf //\nusemtl\no\n\r\n");
+
+	CHECK(garbage.f_size == 0);
+	CHECK(objValidate(garbage));
+}
+
+static void testRanges()
+{
+	ObjFile file;
+	parse(file,
+	    "v 0 0 0\n"
+	    "v 1 0 0\n"
+	    "v 1 1 0\n"
+	    "f 1 2 3\n"
+	    "o box\n"
+	    "usemtl red\n"
+	    "f 1 2 3\n"
+	    "f 1 2 3\n"
+	    "g lid\n"
+	    "usemtl blue\n"
+	    "f 1 2 3\n");
+
+	CHECK(file.r_size == 3);
+	CHECK(file.m_size == 2);
+
+	if (file.r_size == 3 && file.m_size == 2)
+	{
+		CHECK(file.r[0].f_offset == 0 && file.r[0].object == 0 && file.r[0].material == -1);
+
+		CHECK(file.r[1].f_offset == 9 && strcmp(objName(file, file.r[1].object), "box") == 0);
+		CHECK(strcmp(objName(file, file.m[file.r[1].material].name), "red") == 0);
+
+		CHECK(file.r[2].f_offset == 27 && strcmp(objName(file, file.r[2].group), "lid") == 0);
+		CHECK(strcmp(objName(file, file.r[2].object), "box") == 0);
+		CHECK(strcmp(objName(file, file.m[file.r[2].material].name), "blue") == 0);
+	}
+
+	CHECK(objValidate(file));
+}
+
+static const unsigned int kAttributeSubsets[] = {
+	ObjAttributePositions,
+	ObjAttributePositions | ObjAttributeTexcoords,
+	ObjAttributePositions | ObjAttributeNormals,
+	ObjAttributeAll,
+};
+
+// every element of the restricted parse has the indices of the generic one for the attributes it parses
+static bool isSameFaces(const ObjFile& file, const ObjFile& generic, unsigned int attributes)
+{
+	size_t stride = file.f_stride / 3;
+
+	if (file.f_size / stride != generic.f_size / 3)
+		return false;
+
+	for (size_t i = 0; i < generic.f_size / 3; i++)
+	{
+		const int* element = &file.f[i * stride];
+		const int* expected = &generic.f[i * 3];
+
+		if (element[0] != expected[0])
+			return false;
+
+		if ((attributes & ObjAttributeTexcoords) && element[1] != expected[1])
+			return false;
+
+		if ((attributes & ObjAttributeNormals) && element[stride - 1] != expected[2])
+			return false;
+	}
+
+	return true;
+}
+
+static bool isSameRanges(const ObjFile& file, const ObjFile& generic)
+{
+	if (file.r_size != generic.r_size || file.m_size != generic.m_size)
+		return false;
+
+	for (size_t i = 0; i < generic.r_size; i++)
+	{
+		const ObjRange& range = file.r[i];
+		const ObjRange& expected = generic.r[i];
+
+		if (range.f_offset / file.f_stride != expected.f_offset / generic.f_stride || range.material != expected.material)
+			return false;
+
+		if (strcmp(objName(file, range.object), objName(generic, expected.object)) != 0 || strcmp(objName(file, range.group), objName(generic, expected.group)) != 0)
+			return false;
+	}
+
+	for (size_t i = 0; i < generic.m_size; i++)
+		if (strcmp(objName(file, file.m[i].name), objName(generic, generic.m[i].name)) != 0)
+			return false;
+
+	return true;
+}
+
+// parses text with every attribute subset and compares the results with the generic parse
+static void testAttributeSubsets(const char* text)
+{
+	ObjFile generic;
+	parse(generic, text);
+
+	for (size_t i = 0; i < sizeof(kAttributeSubsets) / sizeof(kAttributeSubsets[0]); i++)
+	{
+		unsigned int attributes = kAttributeSubsets[i];
+		bool texcoords = (attributes & ObjAttributeTexcoords) != 0;
+		bool normals = (attributes & ObjAttributeNormals) != 0;
+
+		std::vector<char> buffer(text, text + strlen(text) + 1);
+
+		ObjFile file;
+		objParseBuffer(file, &buffer[0], buffer.size() - 1, attributes);
+
+		CHECK(file.attributes == attributes);
+		CHECK(file.f_stride == size_t(3 * (1 + texcoords + normals)));
+
+		CHECK(file.v_size == generic.v_size && memcmp(file.v, generic.v, generic.v_size * sizeof(float)) == 0);
+
+		// texture coordinates lose w
+		if (texcoords)
+		{
+			bool same = file.vt_stride == 2 && file.vt_size / 2 == generic.vt_size / 3;
+
+			for (size_t j = 0; same && j < generic.vt_size / 3; j++)
+				same = file.vt[j * 2 + 0] == generic.vt[j * 3 + 0] && file.vt[j * 2 + 1] == generic.vt[j * 3 + 1];
+
+			CHECK(same);
+		}
+		else
+			CHECK(file.vt_size == 0);
+
+		if (normals)
+			CHECK(file.vn_size == generic.vn_size && memcmp(file.vn, generic.vn, generic.vn_size * sizeof(float)) == 0);
+		else
+			CHECK(file.vn_size == 0);
+
+		CHECK(isSameFaces(file, generic, attributes));
+		CHECK(isSameRanges(file, generic));
+		CHECK(file.mtllib_size == generic.mtllib_size);
+
+		// references to attributes that aren't parsed don't matter
+		if (attributes == ObjAttributeAll)
+			CHECK(objValidate(file) == objValidate(generic));
+	}
+}
+
+static void testAttributes()
+{
+	// the first face selects the specialized face parser; faces in other forms go through the fallback, including
+	// relative indices, polygons and a texture coordinate with w
+	testAttributeSubsets(
+	    "mtllib scene.mtl\n"
+	    "o quad\n"
+	    "v 0 0 0\n"
+	    "v 1 0 0\n"
+	    "v 1 1 0\n"
+	    "v 0 1 0\n"
+	    "vt 0 0 0.5\n"
+	    "vt 1 0\n"
+	    "vt 1 1\n"
+	    "vn 0 0 1\n"
+	    "vn 0 0 -1\n"
+	    "usemtl red\n"
+	    "f 1/1/1 2/2/1 3/3/1 4/1/2\n"
+	    "f 1 2 3\n"
+	    "g back\n"
+	    "f 1//2 3//2 2//2\n"
+	    "usemtl blue\n"
+	    "f -4/-3 -3/-2 -2/-1 -1/-1\n"
+	    "f -4/-3/-2 -3/-2/-1 -2/-1/-1\n");
+
+	static const char* const kFirstFaces[] = {"f 1 2 3\n", "f 1/1 2/2 3/3\n", "f 1//1 2//1 3//2\n"};
+
+	for (size_t i = 0; i < sizeof(kFirstFaces) / sizeof(kFirstFaces[0]); i++)
+	{
+		std::string text =
+		    "v 0 0 0\r\n"
+		    "v 1 0 0\r\n"
+		    "v 1 1 0\r\n"
+		    "# comment\r\n"
+		    "vt 0 0\r\n"
+		    "vt 1 0\r\n"
+		    "vt 1 1\r\n"
+		    "vn 0 0 1\r\n"
+		    "vn 0 0 -1\r\n";
+
+		text += kFirstFaces[i];
+		text +=
+		    "f 1/1/1 2/2/1 3/3/2\r\n"
+		    "f 3 2 1\r\n"
+		    "f 1/3 2/2 3/1\r\n"
+		    "f 1//2 2//2 3//1\r\n"
+		    "o rest\n"
+		    "f -1/-1/-1 -2/-2/-2 -3/-3/-1\n";
+
+		testAttributeSubsets(text.c_str());
+	}
+
+	// out of range references and broken elements end up the same in every parse
+	testAttributeSubsets(
+	    "v 0 0 0\n"
+	    "vt 0 0\n"
+	    "vn 0 0 1\n"
+	    "f 1/1/1 1/1/1 1/1/1\n"
+	    "f 1/2/1 1/1/1 1/1/1\n"
+	    "f 1/1/1 1/1/3 1/1/1\n"
+	    "f 1/1/ 1/1/1 1/1/1\n"
+	    "f 1/1/1/1 1 1\n");
+}
+
+void testObjParser()
+{
+	testFaces();
+	testIndexForms();
+	testInvalid();
+	testRanges();
+	testAttributes();
+}
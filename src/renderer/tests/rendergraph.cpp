@@ -0,0 +1,173 @@
+#include "tests.h"
+
+#include "common.h"
+#include "rendergraph.h"
+
+static bool checkBatch(const RenderGraph& graph, const char* test, uint32_t pass, VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask, size_t imageBarriers, size_t bufferBarriers)
+{
+	const GraphBarriers& batch = graph.batches[pass];
+
+	bool same = batch.srcStageMask == srcStageMask && batch.dstStageMask == dstStageMask && batch.imageBarriers.size() == imageBarriers && batch.bufferBarriers.size() == bufferBarriers;
+
+	if (!same)
+		printf("%s, batch %d: stages %x -> %x with %d image and %d buffer barriers, expected %x -> %x with %d and %d\n", test, pass,
+			batch.srcStageMask, batch.dstStageMask, int(batch.imageBarriers.size()), int(batch.bufferBarriers.size()),
+			srcStageMask, dstStageMask, int(imageBarriers), int(bufferBarriers));
+
+	return same;
+}
+
+static bool checkImageBarrier(const RenderGraph& graph, const char* test, uint32_t pass, size_t index, VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask, VkImageLayout oldLayout, VkImageLayout newLayout)
+{
+	if (index >= graph.batches[pass].imageBarriers.size())
+		return false;
+
+	const VkImageMemoryBarrier& barrier = graph.batches[pass].imageBarriers[index];
+
+	bool same = barrier.srcAccessMask == srcAccessMask && barrier.dstAccessMask == dstAccessMask && barrier.oldLayout == oldLayout && barrier.newLayout == newLayout;
+
+	if (!same)
+		printf("%s, batch %d, image barrier %d: access %x -> %x, layout %d -> %d, expected %x -> %x, %d -> %d\n", test, pass, int(index),
+			barrier.srcAccessMask, barrier.dstAccessMask, barrier.oldLayout, barrier.newLayout, srcAccessMask, dstAccessMask, oldLayout, newLayout);
+
+	return same;
+}
+
+void testRenderGraph()
+{
+	const VkPipelineStageFlags fragmentTests = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	const VkAccessFlags colorAccess = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	const VkAccessFlags depthAccess = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+	RenderGraph graph = {};
+
+	// the visibility frame: ids are written and read back in the resolve, which renders to the swapchain image
+	{
+		const char* test = "visibility frame";
+
+		resetRenderGraph(graph);
+
+		uint32_t ids = addGraphImage(graph, "ids", 16, 16, VK_FORMAT_R32G32_UINT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_STORAGE_BIT);
+		uint32_t depth = addGraphImage(graph, "depth", 16, 16, VK_FORMAT_D32_SFLOAT, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT);
+		uint32_t target = importGraphImage(graph, "swapchain", 0, VK_IMAGE_ASPECT_COLOR_BIT, UsageColorAttachment, true, UsagePresent);
+
+		uint32_t geometry = addGraphPass(graph, "geometry");
+		addGraphAccess(graph, geometry, ids, UsageColorAttachment);
+		addGraphAccess(graph, geometry, depth, UsageDepthAttachment);
+
+		uint32_t resolve = addGraphPass(graph, "resolve");
+		addGraphAccess(graph, resolve, ids, UsageFragmentStorageRead);
+		addGraphAccess(graph, resolve, target, UsageColorAttachment);
+
+		compileRenderGraph(graph);
+
+		CHECK(checkBatch(graph, test, 0, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | fragmentTests, 2, 0));
+		CHECK(checkImageBarrier(graph, test, 0, 0, 0, colorAccess, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL));
+		CHECK(checkImageBarrier(graph, test, 0, 1, 0, depthAccess, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL));
+
+		// both transitions go into one barrier
+		CHECK(checkBatch(graph, test, 1, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 2, 0));
+		CHECK(checkImageBarrier(graph, test, 1, 0, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL));
+		CHECK(checkImageBarrier(graph, test, 1, 1, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, colorAccess, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL));
+
+		CHECK(checkBatch(graph, test, 2, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 1, 0));
+		CHECK(checkImageBarrier(graph, test, 2, 0, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR));
+	}
+
+	// reads of a layout that is already visible need no barrier; the next write waits for all of them
+	{
+		const char* test = "read after read";
+
+		resetRenderGraph(graph);
+
+		uint32_t image = importGraphImage(graph, "image", 0, VK_IMAGE_ASPECT_COLOR_BIT, UsageNone, true);
+
+		uint32_t write = addGraphPass(graph, "write");
+		addGraphAccess(graph, write, image, UsageColorAttachment);
+
+		uint32_t read0 = addGraphPass(graph, "read 0");
+		addGraphAccess(graph, read0, image, UsageFragmentSampled);
+
+		uint32_t read1 = addGraphPass(graph, "read 1");
+		addGraphAccess(graph, read1, image, UsageFragmentSampled);
+
+		uint32_t rewrite = addGraphPass(graph, "rewrite");
+		addGraphAccess(graph, rewrite, image, UsageColorAttachment);
+
+		compileRenderGraph(graph);
+
+		CHECK(checkBatch(graph, test, read0, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 1, 0));
+		CHECK(checkBatch(graph, test, read1, 0, 0, 0, 0));
+		CHECK(checkBatch(graph, test, rewrite, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 1, 0));
+		CHECK(checkImageBarrier(graph, test, rewrite, 0, 0, colorAccess, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL));
+		CHECK(checkBatch(graph, test, uint32_t(graph.passes.size()), 0, 0, 0, 0));
+	}
+
+	// culling writes draw commands that the next frame's culling may only overwrite once they were consumed
+	{
+		const char* test = "indirect commands";
+
+		resetRenderGraph(graph);
+
+		uint32_t commands = importGraphBuffer(graph, "commands", VkBuffer(1), UsageIndirectRead);
+
+		uint32_t cull = addGraphPass(graph, "cull");
+		addGraphAccess(graph, cull, commands, UsageComputeStorageWrite);
+
+		uint32_t draw = addGraphPass(graph, "draw");
+		addGraphAccess(graph, draw, commands, UsageIndirectRead);
+
+		compileRenderGraph(graph);
+
+		CHECK(checkBatch(graph, test, cull, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1));
+		CHECK(checkBatch(graph, test, draw, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1));
+		CHECK(graph.batches[draw].bufferBarriers.size() == 1 && graph.batches[draw].bufferBarriers[0].srcAccessMask == VK_ACCESS_SHADER_WRITE_BIT && graph.batches[draw].bufferBarriers[0].dstAccessMask == VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+	}
+
+	// a, b and c live in passes 0-1, 1-2 and 2-3: c can reuse the memory of a, but has to wait for its last use
+	{
+		const char* test = "aliasing";
+
+		resetRenderGraph(graph);
+
+		uint32_t images[3];
+
+		for (int i = 0; i < 3; i++)
+		{
+			images[i] = addGraphImage(graph, "image", 16, 16, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+
+			graph.resources[images[i]].size = 100;
+			graph.resources[images[i]].alignment = 16;
+			graph.resources[images[i]].memoryTypeBits = 3;
+		}
+
+		for (int i = 0; i < 4; i++)
+		{
+			uint32_t pass = addGraphPass(graph, "pass");
+
+			if (i > 0)
+				addGraphAccess(graph, pass, images[i - 1], UsageFragmentSampled);
+
+			if (i < 3)
+				addGraphAccess(graph, pass, images[i], UsageColorAttachment);
+		}
+
+		compileRenderGraph(graph);
+
+		const GraphResource& a = graph.resources[images[0]];
+		const GraphResource& b = graph.resources[images[1]];
+		const GraphResource& c = graph.resources[images[2]];
+
+		bool placed = a.offset == 0 && b.offset == 112 && c.offset == 0 && graph.memorySize == 212 && graph.unaliasedSize == 300 && graph.memoryTypeBits == 3;
+
+		if (!placed)
+			printf("%s: offsets %d %d %d, %d bytes, expected 0 112 0, 212 bytes\n", test, int(a.offset), int(b.offset), int(c.offset), int(graph.memorySize));
+
+		CHECK(placed);
+
+		// pass 2 transitions b for reading and c for writing; c waits for the read of a in pass 1
+		CHECK(checkBatch(graph, test, 2, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 2, 0));
+		CHECK(checkImageBarrier(graph, test, 2, 1, 0, colorAccess, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL));
+	}
+
+}
@@ -0,0 +1,171 @@
+#include "tests.h"
+
+#include "residency.h"
+
+static bool sameLoads(const std::vector<uint32_t>& loads, const uint32_t* expected, size_t count)
+{
+	if (loads.size() != count)
+		return false;
+
+	for (size_t i = 0; i < count; ++i)
+		if (loads[i] != expected[i])
+			return false;
+
+	return true;
+}
+
+static void completeLoads(Residency& residency, const std::vector<uint32_t>& loads)
+{
+	for (size_t i = 0; i < loads.size(); ++i)
+		completeLoad(residency, loads[i]);
+}
+
+// 5 chunks share 3 slots, so only the 3 nearest chunks are wanted; uploads only start on frames where maxLoads allows them
+static void testEviction()
+{
+	Residency residency;
+	createResidency(residency, 5, 3);
+
+	std::vector<uint32_t> loads;
+
+	// frame 1: chunks 0-2 are nearest and go to the slots in the order they are popped
+	float frame1[] = {0, 1, 2, 3, 4};
+	updateResidency(residency, frame1, 1, 0, 16, loads);
+
+	static const uint32_t loads1[] = {0, 1, 2};
+
+	CHECK(sameLoads(loads, loads1, 3));
+	CHECK(residency.chunks[0].slot == 0 && residency.chunks[1].slot == 1 && residency.chunks[2].slot == 2);
+	CHECK(residency.stats.loadingChunks == 3 && residency.stats.wantedChunks == 3);
+
+	completeLoads(residency, loads);
+
+	CHECK(residency.stats.residentChunks == 3 && residency.stats.loadingChunks == 0);
+	CHECK(residency.chunks[3].state == ChunkUnloaded && residency.chunks[4].state == ChunkUnloaded);
+
+	// frames 2 and 3 have uploads in flight: the camera moves, but nothing is loaded or evicted, so chunk 1 is last
+	// wanted on frame 1 and chunk 2 on frame 2
+	float frame2[] = {0, 9, 1, 2, 9};
+	updateResidency(residency, frame2, 2, 1, 0, loads);
+
+	CHECK(loads.empty() && residency.stats.wantedChunks == 1);
+
+	float frame3[] = {0, 9, 9, 1, 2};
+	updateResidency(residency, frame3, 3, 2, 0, loads);
+
+	CHECK(loads.empty() && residency.stats.wantedChunks == 2);
+	CHECK(residency.stats.evictions == 0);
+
+	// frame 4: chunks 3 and 4 need slots; the least recently wanted chunks are evicted first, chunk 0 stays
+	updateResidency(residency, frame3, 4, 3, 16, loads);
+
+	CHECK(loads.empty());
+	CHECK(residency.stats.evictions == 2 && residency.stats.residentChunks == 1);
+	CHECK(residency.chunks[0].state == ChunkResident && residency.chunks[1].state == ChunkUnloaded && residency.chunks[2].state == ChunkUnloaded);
+	CHECK(residency.retiredSlots.size() == 2);
+
+	if (residency.retiredSlots.size() == 2)
+	{
+		CHECK(residency.retiredSlots[0].slot == 1 && residency.retiredSlots[0].frame == 4);
+		CHECK(residency.retiredSlots[1].slot == 2 && residency.retiredSlots[1].frame == 4);
+	}
+
+	// frame 5: frame 4 may still be drawing from the evicted slots, so they aren't reused and nothing more is evicted
+	updateResidency(residency, frame3, 5, 3, 16, loads);
+
+	CHECK(loads.empty());
+	CHECK(residency.stats.evictions == 2 && residency.retiredSlots.size() == 2 && residency.freeSlots.empty());
+
+	// frame 6: frame 4 completed, so both slots are free again
+	updateResidency(residency, frame3, 6, 4, 16, loads);
+
+	static const uint32_t loads6[] = {3, 4};
+
+	CHECK(sameLoads(loads, loads6, 2));
+	CHECK(residency.retiredSlots.empty());
+	CHECK(residency.chunks[3].state == ChunkLoading && residency.chunks[4].state == ChunkLoading);
+	CHECK(residency.chunks[3].slot != residency.chunks[4].slot);
+	CHECK(residency.chunks[3].slot == 1 || residency.chunks[3].slot == 2);
+	CHECK(residency.chunks[4].slot == 1 || residency.chunks[4].slot == 2);
+	CHECK(residency.chunks[0].slot == 0);
+
+	completeLoads(residency, loads);
+
+	CHECK(residency.stats.residentChunks == 3 && residency.stats.loads == 5 && residency.stats.evictions == 2);
+}
+
+// a chunk that is wanted every frame is never evicted, even when the camera keeps moving
+static void testWantedStayResident()
+{
+	Residency residency;
+	createResidency(residency, 4, 2);
+
+	std::vector<uint32_t> loads;
+
+	float frame1[] = {0, 1, 2, 3};
+	updateResidency(residency, frame1, 1, 0, 16, loads);
+	completeLoads(residency, loads);
+
+	float frame2[] = {0, 9, 1, 9};
+	updateResidency(residency, frame2, 2, 1, 16, loads);
+
+	CHECK(loads.empty());
+	CHECK(residency.chunks[0].state == ChunkResident && residency.chunks[1].state == ChunkUnloaded);
+	CHECK(residency.stats.evictions == 1);
+
+	// the retired slot isn't reused while frame 2 is in flight
+	updateResidency(residency, frame2, 3, 1, 16, loads);
+
+	CHECK(loads.empty() && residency.stats.evictions == 1);
+
+	updateResidency(residency, frame2, 4, 2, 16, loads);
+
+	static const uint32_t loads4[] = {2};
+
+	CHECK(sameLoads(loads, loads4, 1));
+	CHECK(residency.chunks[2].slot == 1 && residency.chunks[0].slot == 0);
+}
+
+// at most maxLoads chunks start loading per frame, nearest first; the rest stay wanted
+static void testMaxLoads()
+{
+	Residency residency;
+	createResidency(residency, 8, 8);
+
+	std::vector<uint32_t> loads;
+
+	float distances[] = {7, 6, 5, 4, 3, 2, 1, 0};
+
+	updateResidency(residency, distances, 1, 0, 3, loads);
+
+	static const uint32_t loads1[] = {7, 6, 5};
+
+	CHECK(sameLoads(loads, loads1, 3));
+	CHECK(residency.stats.wantedChunks == 8);
+
+	// loads in flight don't count against the next frame
+	updateResidency(residency, distances, 2, 0, 3, loads);
+
+	static const uint32_t loads2[] = {4, 3, 2};
+
+	CHECK(sameLoads(loads, loads2, 3));
+	CHECK(residency.stats.wantedChunks == 5 && residency.stats.loadingChunks == 6);
+
+	updateResidency(residency, distances, 3, 0, 3, loads);
+
+	static const uint32_t loads3[] = {1, 0};
+
+	CHECK(sameLoads(loads, loads3, 2));
+
+	updateResidency(residency, distances, 4, 0, 3, loads);
+
+	CHECK(loads.empty() && residency.stats.wantedChunks == 0 && residency.freeSlots.empty());
+	CHECK(residency.stats.loads == 8 && residency.stats.evictions == 0);
+}
+
+void testResidency()
+{
+	testEviction();
+	testWantedStayResident();
+	testMaxLoads();
+}
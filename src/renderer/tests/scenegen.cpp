@@ -0,0 +1,117 @@
+#include "tests.h"
+
+#include "scenegen.h"
+
+#include <string.h>
+
+static void testSpecs()
+{
+	SceneSettings settings;
+
+	CHECK(!isSceneSpec("mesh.obj"));
+	CHECK(!parseSceneSettings(settings, "mesh.obj"));
+
+	// every key is optional
+	CHECK(parseSceneSettings(settings, "scene:"));
+	CHECK(settings.triangleCount == 1000000 && settings.verticesPerTriangle == 0.5f && settings.meshCount == 1 && settings.instanceCount == 1);
+	CHECK(settings.layout == SceneLayoutGrid && settings.seed == 1);
+
+	CHECK(parseSceneSettings(settings, "scene:tris=10M,vpt=0.75,meshes=4,instances=256,layout=random,seed=7"));
+	CHECK(settings.triangleCount == 10000000 && settings.verticesPerTriangle == 0.75f && settings.meshCount == 4 && settings.instanceCount == 256);
+	CHECK(settings.layout == SceneLayoutRandom && settings.seed == 7);
+
+	// fractional counts, lowercase suffixes and a trailing separator
+	CHECK(parseSceneSettings(settings, "scene:tris=2.5k,instances=1K,layout=clusters,"));
+	CHECK(settings.triangleCount == 2500 && settings.instanceCount == 1000 && settings.layout == SceneLayoutClusters);
+
+	CHECK(parseSceneSettings(settings, "scene:layout=grid"));
+	CHECK(settings.layout == SceneLayoutGrid);
+
+	CHECK(!parseSceneSettings(settings, "scene:tris"));
+	CHECK(!parseSceneSettings(settings, "scene:size=1"));
+	CHECK(!parseSceneSettings(settings, "scene:layout=spiral"));
+	CHECK(!parseSceneSettings(settings, "scene:tris=0"));
+	CHECK(!parseSceneSettings(settings, "scene:tris=-5"));
+	CHECK(!parseSceneSettings(settings, "scene:meshes=0"));
+	CHECK(!parseSceneSettings(settings, "scene:instances=0"));
+
+	// indices are 32-bit
+	CHECK(parseSceneSettings(settings, "scene:tris=1431M"));
+	CHECK(!parseSceneSettings(settings, "scene:tris=1432M"));
+}
+
+static bool isInside(const Mesh& mesh)
+{
+	for (size_t i = 0; i < mesh.vertices.size(); i++)
+	{
+		const Vertex& v = mesh.vertices[i];
+
+		if (v.vx < -0.9f || v.vx > 0.9f || v.vy < -0.9f || v.vy > 0.9f || v.vz < -0.45f || v.vz > 0.45f)
+			return false;
+	}
+
+	return true;
+}
+
+static void testScene(const char* spec, size_t triangles, size_t vertices, uint32_t materials)
+{
+	SceneSettings settings;
+	CHECK(parseSceneSettings(settings, spec));
+
+	Mesh scene;
+	generateScene(scene, settings);
+
+	CHECK(scene.indices.size() == triangles * 3);
+	CHECK(scene.vertices.size() == vertices);
+	CHECK(scene.submeshes.size() == settings.instanceCount);
+	CHECK(scene.materials.size() == materials);
+	CHECK(scene.indexSize == sizeof(uint32_t) && scene.hasNormals);
+
+	// counts are rounded down to whole sphere grids, but stay close to the requested total
+	CHECK(triangles <= settings.triangleCount && triangles * 100 >= settings.triangleCount * 95);
+
+	bool sorted = true, ranges = true;
+	uint32_t indexOffset = 0;
+
+	for (size_t i = 0; i < scene.submeshes.size(); i++)
+	{
+		const Submesh& submesh = scene.submeshes[i];
+
+		sorted &= i == 0 || scene.submeshes[i - 1].material <= submesh.material;
+		ranges &= submesh.indexOffset == indexOffset && submesh.material < materials;
+
+		indexOffset += submesh.indexCount;
+	}
+
+	CHECK(sorted);
+	CHECK(ranges && indexOffset == scene.indices.size());
+
+	bool indices = true;
+
+	for (size_t i = 0; i < scene.indices.size(); i++)
+		indices &= scene.indices[i] < scene.vertices.size();
+
+	CHECK(indices);
+	CHECK(isInside(scene));
+
+	// output only depends on the settings
+	Mesh again;
+	generateScene(again, settings);
+
+	CHECK(again.indices == scene.indices);
+	CHECK(again.vertices.size() == scene.vertices.size() && memcmp(&again.vertices[0], &scene.vertices[0], scene.vertices.size() * sizeof(Vertex)) == 0);
+}
+
+void testSceneGen()
+{
+	testSpecs();
+
+	// 1250 triangles per instance make a 17 x 36 quad grid: 1224 triangles and 18 x 37 vertices
+	testScene("scene:tris=10K,instances=8", 8 * 1224, 8 * 18 * 37, 1);
+
+	// 500 triangles per instance: 11 x 22 quads, 484 triangles; vpt=3 gives every triangle its own vertices
+	testScene("scene:tris=10K,vpt=3,meshes=3,instances=20,layout=random", 20 * 484, 20 * 484 * 3, 3);
+
+	// 1000 triangles per instance: 15 x 33 quads, 990 triangles; meshes are capped by the instance count
+	testScene("scene:tris=4K,meshes=8,instances=4,layout=clusters,seed=5", 4 * 990, 4 * 16 * 34, 4);
+}
@@ -0,0 +1,223 @@
+#include "tests.h"
+
+#include "stats.h"
+
+#include <string.h>
+
+static bool contains(const std::string& text, const char* part)
+{
+	return text.find(part) != std::string::npos;
+}
+
+static size_t countChar(const std::string& text, char c)
+{
+	size_t count = 0;
+
+	for (size_t i = 0; i < text.size(); ++i)
+		count += text[i] == c;
+
+	return count;
+}
+
+static void testBuckets()
+{
+	Stats stats;
+	initStats(stats);
+
+	CHECK(getPercentile(stats.frameTime, 0.5) == 0);
+
+	// bounds are inclusive, and every bucket counts the samples of the buckets below it
+	double samples[] = {0.5, 1, 3, 20, 300};
+
+	for (size_t i = 0; i < sizeof(samples) / sizeof(samples[0]); ++i)
+		addSample(stats.frameTime, samples[i]);
+
+	RollingHistogram& histogram = stats.frameTime;
+
+	CHECK(histogram.count == 5 && histogram.sum == 324.5);
+	CHECK(histogram.buckets[0] == 2); // 1
+	CHECK(histogram.buckets[1] == 2); // 2
+	CHECK(histogram.buckets[2] == 3); // 4
+	CHECK(histogram.buckets[6] == 3); // 16.7
+	CHECK(histogram.buckets[7] == 4); // 33.3
+	CHECK(histogram.buckets[kStatsBucketCount - 1] == 4); // 250; 300 only shows up in the count
+
+	for (size_t i = 1; i < kStatsBucketCount; ++i)
+		CHECK(histogram.buckets[i] >= histogram.buckets[i - 1]);
+
+	CHECK(getPercentile(histogram, 0) == 0.5);
+	CHECK(getPercentile(histogram, 0.5) == 3);
+	CHECK(getPercentile(histogram, 1) == 300);
+}
+
+static void testWindow()
+{
+	Stats stats;
+	initStats(stats);
+
+	// two full windows; percentiles only see the second one, count, sum and buckets see both
+	for (size_t i = 0; i < kStatsWindow * 2; ++i)
+		addSample(stats.cpuTime, double(i));
+
+	RollingHistogram& histogram = stats.cpuTime;
+
+	CHECK(histogram.samples.size() == kStatsWindow);
+	CHECK(histogram.next == 0);
+	CHECK(histogram.count == kStatsWindow * 2);
+	CHECK(histogram.sum == double(kStatsWindow * 2) * double(kStatsWindow * 2 - 1) / 2);
+	CHECK(histogram.buckets[0] == 2); // 0 and 1
+
+	CHECK(getPercentile(histogram, 0) == double(kStatsWindow));
+	CHECK(getPercentile(histogram, 0.5) == double(kStatsWindow + kStatsWindow / 2));
+	CHECK(getPercentile(histogram, 0.99) == double(kStatsWindow + size_t(0.99 * kStatsWindow)));
+	CHECK(getPercentile(histogram, 1) == double(kStatsWindow * 2 - 1));
+
+	// a partial wrap replaces the oldest samples first
+	addSample(histogram, 5000);
+
+	CHECK(histogram.samples[0] == 5000 && histogram.next == 1);
+	CHECK(getPercentile(histogram, 0) == double(kStatsWindow + 1));
+	CHECK(getPercentile(histogram, 1) == 5000);
+}
+
+static void makeStats(Stats& stats)
+{
+	initStats(stats);
+
+	double samples[] = {0.5, 1, 3, 20, 300};
+
+	for (size_t i = 0; i < sizeof(samples) / sizeof(samples[0]); ++i)
+	{
+		addSample(stats.frameTime, samples[i]);
+		addSample(stats.cpuTime, samples[i] / 2);
+	}
+
+	stats.frames = 7;
+	stats.draws = 12;
+	stats.triangles = 34567;
+	stats.uploadBytes = 1 << 20;
+
+	HeapStats heaps[] = {
+		{8ull << 30, 6ull << 30, 1ull << 30, true},
+		{16ull << 30, 12ull << 30, 1ull << 20, false},
+	};
+
+	stats.heaps.assign(heaps, heaps + 2);
+}
+
+static void testPrometheus()
+{
+	Stats stats;
+	makeStats(stats);
+
+	std::string text;
+	formatStats(text, stats, StatsFormatPrometheus, 1.5, 0);
+
+	// buckets are in seconds and cumulative; +Inf matches the count
+	CHECK(contains(text, "# TYPE renderer_frame_time_seconds histogram\n"));
+	CHECK(contains(text, "renderer_frame_time_seconds_bucket{le=\"0.001\"} 2\n"));
+	CHECK(contains(text, "renderer_frame_time_seconds_bucket{le=\"0.004\"} 3\n"));
+	CHECK(contains(text, "renderer_frame_time_seconds_bucket{le=\"0.25\"} 4\n"));
+	CHECK(contains(text, "renderer_frame_time_seconds_bucket{le=\"+Inf\"} 5\n"));
+	CHECK(contains(text, "renderer_frame_time_seconds_sum 0.3245\n"));
+	CHECK(contains(text, "renderer_frame_time_seconds_count 5\n"));
+	CHECK(contains(text, "renderer_gpu_time_seconds_count 0\n"));
+
+	CHECK(contains(text, "renderer_frames_total 7\n"));
+	CHECK(contains(text, "renderer_draws 12\n"));
+	CHECK(contains(text, "renderer_triangles 34567\n"));
+	CHECK(contains(text, "renderer_upload_bytes_total 1048576\n"));
+	CHECK(contains(text, "renderer_heap_size_bytes{heap=\"1\",device_local=\"0\"} 17179869184\n"));
+
+	// budget and usage are only exported when the device reports them
+	CHECK(!contains(text, "renderer_heap_budget_bytes"));
+
+	stats.memoryBudget = true;
+
+	text.clear();
+	formatStats(text, stats, StatsFormatPrometheus, 1.5, 0);
+
+	CHECK(contains(text, "renderer_heap_budget_bytes{heap=\"0\",device_local=\"1\"} 6442450944\n"));
+	CHECK(contains(text, "renderer_heap_usage_bytes{heap=\"1\",device_local=\"0\"} 1048576\n"));
+
+	// every line is a comment or a sample with a value
+	size_t lineStart = 0;
+
+	while (lineStart < text.size())
+	{
+		size_t lineEnd = text.find('\n', lineStart);
+		CHECK(lineEnd != std::string::npos);
+
+		std::string line = text.substr(lineStart, lineEnd - lineStart);
+		CHECK(line[0] == '#' || line.find(' ') != std::string::npos);
+
+		lineStart = lineEnd + 1;
+	}
+
+	// headers only exist for CSV
+	std::string header;
+	formatStatsHeader(header, stats, StatsFormatPrometheus);
+
+	CHECK(header.empty());
+}
+
+static void testCsv()
+{
+	Stats stats;
+	makeStats(stats);
+
+	std::string header;
+	formatStatsHeader(header, stats, StatsFormatCsv);
+
+	std::string row;
+	formatStats(row, stats, StatsFormatCsv, 1.5, 2.25);
+
+	CHECK(header.compare(0, 12, "time,frames,") == 0);
+	CHECK(contains(header, ",frame_avg_ms,frame_p50_ms,frame_p95_ms,frame_p99_ms,frame_max_ms,"));
+	CHECK(contains(header, ",heap1_usage_bytes,heap1_budget_bytes\n"));
+
+	// one value per column
+	CHECK(countChar(header, ',') == countChar(row, ','));
+	CHECK(countChar(header, '\n') == 1 && countChar(row, '\n') == 1);
+
+	// avg, p50, p95, p99 and max of the frame times, then the cpu times
+	CHECK(row.compare(0, 10, "1.500,7,64") == 0);
+	CHECK(contains(row, ",64.900,3.000,300.000,300.000,300.000,32.450,1.500,150.000,150.000,150.000,"));
+	CHECK(contains(row, ",12,34567,2.250,1073741824,6442450944,1048576,12884901888\n"));
+}
+
+static void testJson()
+{
+	Stats stats;
+	makeStats(stats);
+
+	std::string header;
+	formatStatsHeader(header, stats, StatsFormatJson);
+
+	CHECK(header.empty());
+
+	std::string text;
+	formatStats(text, stats, StatsFormatJson, 1.5, 2.25);
+	formatStats(text, stats, StatsFormatJson, 2.5, 0);
+
+	// one complete object per line
+	CHECK(countChar(text, '\n') == 2);
+	CHECK(countChar(text, '{') == countChar(text, '}'));
+	CHECK(countChar(text, '[') == countChar(text, ']'));
+
+	CHECK(text.compare(0, 26, "{\"time\":1.500,\"frames\":7,\"") == 0);
+	CHECK(contains(text, "\"frame\":{\"avg\":64.900,\"p50\":3.000,\"p95\":300.000,\"p99\":300.000,\"max\":300.000}"));
+	CHECK(contains(text, "\"gpu\":{\"avg\":0.000,\"p50\":0.000,\"p95\":0.000,\"p99\":0.000,\"max\":0.000}"));
+	CHECK(contains(text, "\"draws\":12,\"triangles\":34567,\"upload_mb_per_s\":2.250,\"heaps\":["));
+	CHECK(contains(text, "{\"size\":8589934592,\"budget\":6442450944,\"usage\":1073741824,\"device_local\":true},{"));
+	CHECK(contains(text, "\"device_local\":false}]}\n{\"time\":2.500,"));
+}
+
+void testStats()
+{
+	testBuckets();
+	testWindow();
+	testPrometheus();
+	testCsv();
+	testJson();
+}
@@ -0,0 +1,50 @@
+#include "tests.h"
+
+#include <string.h>
+
+int testFailures = 0;
+
+struct TestGroup
+{
+	const char* name;
+	void (*run)();
+};
+
+static const TestGroup kTestGroups[] = {
+	{"objparser", testObjParser},
+	{"deletionqueue", testDeletionQueue},
+	{"rendergraph", testRenderGraph},
+	{"residency", testResidency},
+	{"drawlist", testDrawList},
+	{"scenegen", testSceneGen},
+	{"normals", testNormals},
+	{"vertexremap", testVertexRemap},
+	{"stats", testStats},
+};
+
+int main(int argc, const char** argv)
+{
+	// with a group name only that group runs, so that ctest reports groups separately
+	const char* filter = argc > 1 ? argv[1] : 0;
+	int groups = 0;
+
+	for (size_t i = 0; i < sizeof(kTestGroups) / sizeof(kTestGroups[0]); ++i)
+	{
+		if (filter && strcmp(filter, kTestGroups[i].name) != 0)
+			continue;
+
+		int failures = testFailures;
+		kTestGroups[i].run();
+
+		printf("%s: %s\n", kTestGroups[i].name, testFailures == failures ? "passed" : "FAILED");
+		groups++;
+	}
+
+	if (groups == 0)
+	{
+		printf("Unknown test group %s\n", filter);
+		return 1;
+	}
+
+	return testFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,27 @@
+// CPU-only tests; they need neither a GPU nor a window and run under ctest
+#pragma once
+
+#include <stdio.h>
+
+extern int testFailures;
+
+// records the failure and keeps going, so that one run reports every broken check
+#define CHECK(condition) \
+	do \
+	{ \
+		if (!(condition)) \
+		{ \
+			printf("%s(%d): check failed: %s\n", __FILE__, __LINE__, #condition); \
+			testFailures++; \
+		} \
+	} while (0)
+
+void testObjParser();
+void testDeletionQueue();
+void testRenderGraph();
+void testResidency();
+void testDrawList();
+void testSceneGen();
+void testNormals();
+void testVertexRemap();
+void testStats();
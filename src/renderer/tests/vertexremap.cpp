@@ -0,0 +1,103 @@
+#include "tests.h"
+
+#include "scenegen.h"
+#include "vertexremap.h"
+
+#include <string.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// numbers unique vertices in order of first occurrence, one vertex at a time
+static size_t remapSerial(std::vector<uint32_t>& remap, const void* vertices, size_t vertexCount, size_t vertexSize)
+{
+	const char* data = static_cast<const char*>(vertices);
+
+	std::unordered_map<std::string, uint32_t> numbers;
+	remap.resize(vertexCount);
+
+	for (size_t i = 0; i < vertexCount; i++)
+	{
+		std::string key(data + i * vertexSize, vertexSize);
+		std::unordered_map<std::string, uint32_t>::iterator it = numbers.find(key);
+
+		if (it == numbers.end())
+			it = numbers.insert(std::make_pair(key, uint32_t(numbers.size()))).first;
+
+		remap[i] = it->second;
+	}
+
+	return numbers.size();
+}
+
+static void testRemap(const void* vertices, size_t vertexCount, size_t vertexSize)
+{
+	std::vector<uint32_t> expected;
+	size_t expectedCount = remapSerial(expected, vertices, vertexCount, vertexSize);
+
+	// threads only kick in above 64K vertices each; odd counts leave ranges and partitions uneven
+	const uint32_t threadCounts[] = {1, 2, 3, 4, 7, 8, 16};
+
+	for (size_t i = 0; i < sizeof(threadCounts) / sizeof(threadCounts[0]); i++)
+	{
+		// repeated runs have to match as well; a race would show up as a different numbering
+		for (int run = 0; run < 2; run++)
+		{
+			std::vector<uint32_t> remap(vertexCount, ~0u);
+			size_t count = generateVertexRemap(remap.data(), vertices, vertexCount, vertexSize, threadCounts[i]);
+
+			CHECK(count == expectedCount);
+			CHECK(remap == expected);
+		}
+	}
+}
+
+// 32-bit random numbers from a fixed seed
+static uint32_t nextRandom(uint32_t& state)
+{
+	state = state * 1664525 + 1013904223;
+	return state >> 8;
+}
+
+void testVertexRemap()
+{
+	// corners of a scene, like normal generation welds them
+	SceneSettings settings;
+	CHECK(parseSceneSettings(settings, "scene:tris=200K,vpt=0.6,meshes=2,instances=4"));
+
+	Mesh scene;
+	generateScene(scene, settings);
+
+	std::vector<Vertex> corners(scene.indices.size());
+
+	for (size_t i = 0; i < scene.indices.size(); i++)
+		corners[i] = scene.vertices[scene.indices[i]];
+
+	testRemap(corners.data(), corners.size(), sizeof(Vertex));
+
+	// OBJ index triplets with a small range, so that most of them repeat in random order
+	uint32_t state = 1;
+	std::vector<uint32_t> triplets(700000 * 3);
+
+	for (size_t i = 0; i < triplets.size(); i++)
+		triplets[i] = nextRandom(state) % 64;
+
+	testRemap(triplets.data(), triplets.size() / 3, 12);
+
+	// every key unique, and every key the same, which puts all vertices into one partition
+	std::vector<uint32_t> keys(600000);
+
+	for (size_t i = 0; i < keys.size(); i++)
+		keys[i] = uint32_t(i * 7919);
+
+	testRemap(keys.data(), keys.size(), 4);
+
+	keys.assign(keys.size(), 42);
+
+	testRemap(keys.data(), keys.size(), 4);
+
+	// too small for threads
+	testRemap(triplets.data(), 1000, 12);
+	testRemap(triplets.data(), 0, 12);
+}
@@ -0,0 +1,685 @@
+#ifndef _CRT_SECURE_NO_WARNINGS
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include "texturefile.h"
+#include "bcn.h"
+#include "parallel.h"
+#include "timer.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+
+// rows per thread below which filtering a mip on more threads isn't worth it
+const uint32_t kMinRowsPerThread = 16;
+
+uint32_t getTextureBlockSize(uint32_t format)
+{
+	return format == TextureFormatRGBA8 ? 1 : 4;
+}
+
+uint32_t getTextureBlockBytes(uint32_t format)
+{
+	return format == TextureFormatBC1 ? 8 : (format == TextureFormatBC7 ? 16 : 4);
+}
+
+uint32_t getMipCount(uint32_t width, uint32_t height)
+{
+	uint32_t count = 1;
+
+	for (uint32_t size = width > height ? width : height; size > 1; size >>= 1)
+		count++;
+
+	return count;
+}
+
+static size_t getMipSize(uint32_t format, uint32_t width, uint32_t height)
+{
+	uint32_t blockSize = getTextureBlockSize(format);
+
+	return size_t((width + blockSize - 1) / blockSize) * ((height + blockSize - 1) / blockSize) * getTextureBlockBytes(format);
+}
+
+static bool loadTga(ImageRGBA& result, const unsigned char* data, size_t size)
+{
+	if (size < 18)
+		return false;
+
+	uint32_t idLength = data[0];
+	uint32_t colorMapType = data[1];
+	uint32_t imageType = data[2];
+	uint32_t width = data[12] | (data[13] << 8);
+	uint32_t height = data[14] | (data[15] << 8);
+	uint32_t bits = data[16];
+	bool topDown = (data[17] & 0x20) != 0;
+
+	bool rle = imageType == 10 || imageType == 11;
+	bool gray = imageType == 3 || imageType == 11;
+
+	// color mapped images are rare enough for textures that they aren't supported
+	if (colorMapType != 0 || (imageType != 2 && imageType != 3 && imageType != 10 && imageType != 11))
+		return false;
+
+	if (gray ? bits != 8 : (bits != 24 && bits != 32))
+		return false;
+
+	if (width == 0 || height == 0)
+		return false;
+
+	uint32_t pixelSize = bits / 8;
+
+	const unsigned char* pixels = data + 18 + idLength;
+	const unsigned char* end = data + size;
+
+	result.width = width;
+	result.height = height;
+	result.pixels.resize(size_t(width) * height * 4);
+
+	size_t pixelCount = size_t(width) * height;
+	size_t pixel = 0;
+
+	while (pixel < pixelCount)
+	{
+		// uncompressed images are one long raw packet
+		size_t count = pixelCount - pixel;
+		bool repeat = false;
+
+		if (rle)
+		{
+			if (pixels >= end)
+				return false;
+
+			count = (*pixels & 0x7f) + 1;
+			repeat = (*pixels & 0x80) != 0;
+			pixels++;
+
+			if (count > pixelCount - pixel)
+				return false;
+		}
+
+		if (size_t(end - pixels) < (repeat ? 1 : count) * pixelSize)
+			return false;
+
+		for (size_t i = 0; i < count; i++, pixel++)
+		{
+			const unsigned char* source = repeat ? pixels : pixels + i * pixelSize;
+
+			// rows are stored bottom up unless the descriptor says otherwise
+			size_t x = pixel % width, y = pixel / width;
+			unsigned char* target = &result.pixels[((topDown ? y : height - 1 - y) * width + x) * 4];
+
+			if (gray)
+				target[0] = target[1] = target[2] = source[0], target[3] = 255;
+			else
+				target[0] = source[2], target[1] = source[1], target[2] = source[0], target[3] = pixelSize == 4 ? source[3] : 255;
+		}
+
+		pixels += (repeat ? 1 : count) * pixelSize;
+	}
+
+	return true;
+}
+
+// skips whitespace and comments, then reads a decimal number
+static bool readPnmNumber(uint32_t& result, const unsigned char*& data, const unsigned char* end)
+{
+	while (data < end && (*data == ' ' || *data == '\t' || *data == '\r' || *data == '\n' || *data == '#'))
+	{
+		if (*data == '#')
+			while (data < end && *data != '\n')
+				data++;
+		else
+			data++;
+	}
+
+	if (data == end || *data < '0' || *data > '9')
+		return false;
+
+	result = 0;
+
+	while (data < end && *data >= '0' && *data <= '9' && result < 1000000)
+		result = result * 10 + (*data++ - '0');
+
+	return true;
+}
+
+static bool loadPnm(ImageRGBA& result, const unsigned char* data, size_t size)
+{
+	if (size < 2 || data[0] != 'P' || (data[1] != '5' && data[1] != '6'))
+		return false;
+
+	bool gray = data[1] == '5';
+
+	const unsigned char* end = data + size;
+	data += 2;
+
+	uint32_t width, height, maxValue;
+	if (!readPnmNumber(width, data, end) || !readPnmNumber(height, data, end) || !readPnmNumber(maxValue, data, end))
+		return false;
+
+	// a single whitespace character separates the header from the pixels
+	if (data == end || width == 0 || height == 0 || maxValue == 0 || maxValue > 255)
+		return false;
+
+	data++;
+
+	uint32_t channels = gray ? 1 : 3;
+
+	if (size_t(end - data) / channels / width < height)
+		return false;
+
+	result.width = width;
+	result.height = height;
+	result.pixels.resize(size_t(width) * height * 4);
+
+	for (size_t i = 0; i < size_t(width) * height; i++)
+	{
+		for (uint32_t c = 0; c < 3; c++)
+			result.pixels[i * 4 + c] = uint8_t(data[i * channels + (gray ? 0 : c)] * 255 / maxValue);
+
+		result.pixels[i * 4 + 3] = 255;
+	}
+
+	return true;
+}
+
+bool loadImage(ImageRGBA& result, const char* path)
+{
+	MappedFile file;
+	if (!mapFile(file, path))
+		return false;
+
+	const char* ext = strrchr(path, '.');
+	const unsigned char* data = static_cast<const unsigned char*>(file.data);
+
+	bool ok = ext && (strcmp(ext, ".tga") == 0 || strcmp(ext, ".TGA") == 0) ? loadTga(result, data, file.size) : loadPnm(result, data, file.size);
+
+	unmapFile(file);
+
+	return ok;
+}
+
+static float gLinearFromSrgb[256];
+static unsigned char gSrgbFromLinear[4096];
+
+static void initSrgbTables()
+{
+	struct Tables
+	{
+		Tables()
+		{
+			for (int i = 0; i < 256; i++)
+			{
+				float v = i / 255.f;
+				gLinearFromSrgb[i] = v <= 0.04045f ? v / 12.92f : powf((v + 0.055f) / 1.055f, 2.4f);
+			}
+
+			for (int i = 0; i < 4096; i++)
+			{
+				float v = (i + 0.5f) / 4096;
+				float s = v <= 0.0031308f ? v * 12.92f : 1.055f * powf(v, 1 / 2.4f) - 0.055f;
+				gSrgbFromLinear[i] = uint8_t(s * 255 + 0.5f);
+			}
+		}
+	};
+
+	// function statics are initialized once even when called from several threads
+	static Tables tables;
+	(void)tables;
+}
+
+static void downsampleRows(ImageRGBA& target, const ImageRGBA& source, uint32_t beginRow, uint32_t endRow)
+{
+	for (uint32_t y = beginRow; y < endRow; y++)
+	{
+		uint32_t y0 = y * 2, y1 = y * 2 + 1 < source.height ? y * 2 + 1 : source.height - 1;
+
+		for (uint32_t x = 0; x < target.width; x++)
+		{
+			uint32_t x0 = x * 2, x1 = x * 2 + 1 < source.width ? x * 2 + 1 : source.width - 1;
+
+			const unsigned char* p[4] = {
+				&source.pixels[(size_t(y0) * source.width + x0) * 4],
+				&source.pixels[(size_t(y0) * source.width + x1) * 4],
+				&source.pixels[(size_t(y1) * source.width + x0) * 4],
+				&source.pixels[(size_t(y1) * source.width + x1) * 4],
+			};
+
+			unsigned char* result = &target.pixels[(size_t(y) * target.width + x) * 4];
+
+			for (int c = 0; c < 3; c++)
+			{
+				float linear = (gLinearFromSrgb[p[0][c]] + gLinearFromSrgb[p[1][c]] + gLinearFromSrgb[p[2][c]] + gLinearFromSrgb[p[3][c]]) * 0.25f;
+				int index = int(linear * 4096);
+
+				result[c] = gSrgbFromLinear[index < 4095 ? index : 4095];
+			}
+
+			result[3] = uint8_t((p[0][3] + p[1][3] + p[2][3] + p[3][3] + 2) / 4);
+		}
+	}
+}
+
+void generateMips(std::vector<ImageRGBA>& result, const ImageRGBA& image, uint32_t threadCount)
+{
+	initSrgbTables();
+
+	uint32_t mipCount = getMipCount(image.width, image.height);
+
+	result.resize(mipCount);
+	result[0] = image;
+
+	for (uint32_t mip = 1; mip < mipCount; mip++)
+	{
+		const ImageRGBA& source = result[mip - 1];
+		ImageRGBA& target = result[mip];
+
+		target.width = source.width > 1 ? source.width / 2 : 1;
+		target.height = source.height > 1 ? source.height / 2 : 1;
+		target.pixels.resize(size_t(target.width) * target.height * 4);
+
+		uint32_t threads = target.height / kMinRowsPerThread < threadCount ? target.height / kMinRowsPerThread : threadCount;
+		threads = threads ? threads : 1;
+
+		parallelFor(threads, [&](uint32_t thread) {
+			downsampleRows(target, source, uint32_t(getRangeBegin(target.height, thread, threads)), uint32_t(getRangeBegin(target.height, thread + 1, threads)));
+		});
+	}
+}
+
+// 4x4 pixels at block (bx, by); pixels past the edge repeat the last row or column
+static void readBlock(unsigned char block[64], const ImageRGBA& image, uint32_t bx, uint32_t by)
+{
+	for (uint32_t y = 0; y < 4; y++)
+	{
+		uint32_t sy = by * 4 + y < image.height ? by * 4 + y : image.height - 1;
+
+		for (uint32_t x = 0; x < 4; x++)
+		{
+			uint32_t sx = bx * 4 + x < image.width ? bx * 4 + x : image.width - 1;
+
+			memcpy(&block[(y * 4 + x) * 4], &image.pixels[(size_t(sy) * image.width + sx) * 4], 4);
+		}
+	}
+}
+
+static void layoutMips(TextureData& result, uint32_t format, uint32_t width, uint32_t height, uint32_t mipCount)
+{
+	result.format = format;
+	result.width = width;
+	result.height = height;
+	result.mips.resize(mipCount);
+
+	uint64_t offset = 0;
+
+	for (uint32_t mip = 0; mip < mipCount; mip++)
+	{
+		uint32_t mipWidth = width >> mip ? width >> mip : 1;
+		uint32_t mipHeight = height >> mip ? height >> mip : 1;
+
+		result.mips[mip].offset = offset;
+		result.mips[mip].size = getMipSize(format, mipWidth, mipHeight);
+
+		offset += result.mips[mip].size;
+	}
+
+	result.data.resize(size_t(offset));
+}
+
+// block rows of all mips are numbered consecutively and taken from a shared counter, so small mips don't get threads of their own
+template <typename Task>
+static void forEachBlockRow(const TextureData& texture, uint32_t threadCount, Task task)
+{
+	uint32_t blockSize = getTextureBlockSize(texture.format);
+
+	std::vector<uint32_t> firstRow(texture.mips.size() + 1);
+
+	for (size_t mip = 0; mip < texture.mips.size(); mip++)
+	{
+		uint32_t mipHeight = texture.height >> mip ? texture.height >> mip : 1;
+		firstRow[mip + 1] = firstRow[mip] + (mipHeight + blockSize - 1) / blockSize;
+	}
+
+	std::atomic<uint32_t> nextRow(0);
+
+	uint32_t rowCount = firstRow.back();
+	uint32_t threads = rowCount / kMinRowsPerThread < threadCount ? rowCount / kMinRowsPerThread : threadCount;
+
+	parallelFor(threads ? threads : 1, [&](uint32_t) {
+		uint32_t mip = 0;
+
+		for (uint32_t row = nextRow++; row < rowCount; row = nextRow++)
+		{
+			// rows are taken in increasing order, so the mip only moves forward
+			while (row >= firstRow[mip + 1])
+				mip++;
+
+			task(mip, row - firstRow[mip]);
+		}
+	});
+}
+
+void encodeTexture(TextureData& result, const std::vector<ImageRGBA>& mips, TextureFormat format, uint32_t threadCount)
+{
+	assert(!mips.empty());
+
+	layoutMips(result, format, mips[0].width, mips[0].height, uint32_t(mips.size()));
+
+	if (format == TextureFormatRGBA8)
+	{
+		for (size_t mip = 0; mip < mips.size(); mip++)
+			memcpy(&result.data[size_t(result.mips[mip].offset)], mips[mip].pixels.data(), mips[mip].pixels.size());
+
+		return;
+	}
+
+	uint32_t blockBytes = getTextureBlockBytes(format);
+
+	forEachBlockRow(result, threadCount, [&](uint32_t mip, uint32_t by) {
+		const ImageRGBA& image = mips[mip];
+		uint32_t blocksX = (image.width + 3) / 4;
+
+		unsigned char* target = &result.data[size_t(result.mips[mip].offset) + size_t(by) * blocksX * blockBytes];
+
+		for (uint32_t bx = 0; bx < blocksX; bx++)
+		{
+			unsigned char pixels[64];
+			readBlock(pixels, image, bx, by);
+
+			if (format == TextureFormatBC1)
+				encodeBlockBC1(target + bx * blockBytes, pixels);
+			else
+				encodeBlockBC7(target + bx * blockBytes, pixels);
+		}
+	});
+}
+
+void decodeTexture(TextureData& result, const TextureData& texture, uint32_t threadCount)
+{
+	layoutMips(result, TextureFormatRGBA8, texture.width, texture.height, uint32_t(texture.mips.size()));
+
+	if (texture.format == TextureFormatRGBA8)
+	{
+		result.data = texture.data;
+		return;
+	}
+
+	uint32_t blockBytes = getTextureBlockBytes(texture.format);
+
+	forEachBlockRow(texture, threadCount, [&](uint32_t mip, uint32_t by) {
+		uint32_t mipWidth = texture.width >> mip ? texture.width >> mip : 1;
+		uint32_t mipHeight = texture.height >> mip ? texture.height >> mip : 1;
+		uint32_t blocksX = (mipWidth + 3) / 4;
+
+		const unsigned char* source = &texture.data[size_t(texture.mips[mip].offset) + size_t(by) * blocksX * blockBytes];
+		unsigned char* target = &result.data[size_t(result.mips[mip].offset)];
+
+		for (uint32_t bx = 0; bx < blocksX; bx++)
+		{
+			unsigned char pixels[64];
+
+			if (texture.format == TextureFormatBC1)
+				decodeBlockBC1(pixels, source + bx * blockBytes);
+			else
+				decodeBlockBC7(pixels, source + bx * blockBytes);
+
+			// edge blocks only write the pixels that are part of the mip
+			for (uint32_t y = 0; y < 4 && by * 4 + y < mipHeight; y++)
+				for (uint32_t x = 0; x < 4 && bx * 4 + x < mipWidth; x++)
+					memcpy(&target[((size_t(by) * 4 + y) * mipWidth + bx * 4 + x) * 4], &pixels[(y * 4 + x) * 4], 4);
+		}
+	});
+}
+
+bool writeTextureFile(const char* path, const TextureData& texture)
+{
+	TextureFileHeader header = {};
+	header.magic = kTextureFileMagic;
+	header.version = kTextureFileVersion;
+	header.format = texture.format;
+	header.width = texture.width;
+	header.height = texture.height;
+	header.mipCount = uint32_t(texture.mips.size());
+
+	FILE* file = fopen(path, "wb");
+	if (!file)
+		return false;
+
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+	ok = ok && fwrite(texture.mips.data(), sizeof(TextureFileMip), texture.mips.size(), file) == texture.mips.size();
+	ok = ok && fwrite(texture.data.data(), 1, texture.data.size(), file) == texture.data.size();
+
+	ok = (fclose(file) == 0) && ok;
+
+	if (!ok)
+		remove(path);
+
+	return ok;
+}
+
+bool readTextureFile(TextureData& result, const char* path)
+{
+	MappedFile file;
+	if (!mapFile(file, path))
+		return false;
+
+	const TextureFileHeader* header = static_cast<const TextureFileHeader*>(file.data);
+
+	bool valid = file.size >= sizeof(TextureFileHeader) &&
+		header->magic == kTextureFileMagic &&
+		header->version == kTextureFileVersion &&
+		header->format < TextureFormatCount &&
+		header->width > 0 && header->height > 0 && header->width <= 16384 && header->height <= 16384 &&
+		header->mipCount == getMipCount(header->width, header->height) &&
+		file.size - sizeof(TextureFileHeader) >= header->mipCount * sizeof(TextureFileMip);
+
+	if (valid)
+	{
+		// the layout is fully determined by the header; the table has to match it
+		layoutMips(result, header->format, header->width, header->height, header->mipCount);
+
+		const TextureFileMip* mips = reinterpret_cast<const TextureFileMip*>(header + 1);
+		size_t dataOffset = sizeof(TextureFileHeader) + header->mipCount * sizeof(TextureFileMip);
+
+		valid = memcmp(mips, result.mips.data(), header->mipCount * sizeof(TextureFileMip)) == 0 && file.size - dataOffset == result.data.size();
+
+		if (valid)
+			memcpy(result.data.data(), static_cast<const char*>(file.data) + dataOffset, result.data.size());
+	}
+
+	unmapFile(file);
+
+	return valid;
+}
+
+static bool hasAlpha(const ImageRGBA& image)
+{
+	for (size_t i = 3; i < image.pixels.size(); i += 4)
+		if (image.pixels[i] != 255)
+			return true;
+
+	return false;
+}
+
+static const char* getFileName(const char* path)
+{
+	const char* slash = strrchr(path, '/');
+	const char* backslash = strrchr(path, '\\');
+	const char* separator = slash > backslash ? slash : backslash;
+
+	return separator ? separator + 1 : path;
+}
+
+// creates every directory along the path; the ones that exist are left as is
+static bool createDirectories(const char* path)
+{
+	std::string prefix = path;
+
+	for (size_t i = 1; i < prefix.size(); i++)
+		if ((prefix[i] == '/' || prefix[i] == '\\') && !createDirectory(prefix.substr(0, i).c_str()))
+			return false;
+
+	return createDirectory(path);
+}
+
+bool loadTexture(TextureData& result, const char* path, const char* cacheDir, uint32_t threadCount)
+{
+	MappedFile source;
+	if (!mapFile(source, path))
+		return false;
+
+	uint64_t hash = hashBytes(source.data, source.size, kTextureFileVersion);
+
+	unmapFile(source);
+
+	char cachePath[512];
+	snprintf(cachePath, sizeof(cachePath), "%s/%s.%016llx.tex", cacheDir, getFileName(path), (unsigned long long)hash);
+
+	if (readTextureFile(result, cachePath))
+		return true;
+
+	ImageRGBA image;
+	if (!loadImage(image, path))
+		return false;
+
+	std::vector<ImageRGBA> mips;
+	generateMips(mips, image, threadCount);
+
+	encodeTexture(result, mips, hasAlpha(image) ? TextureFormatBC7 : TextureFormatBC1, threadCount);
+
+	// a cache that can't be written only costs the conversion next time
+	if (!createDirectories(cacheDir) || !writeTextureFile(cachePath, result))
+		printf("Warning: can't write texture cache %s\n", cachePath);
+
+	return true;
+}
+
+// xorshift noise over a few gradients and hard edges, so that blocks have smooth and sharp content; alpha varies too
+static void generateImage(ImageRGBA& result, uint32_t width, uint32_t height)
+{
+	result.width = width;
+	result.height = height;
+	result.pixels.resize(size_t(width) * height * 4);
+
+	uint32_t state = 0x9e3779b9;
+
+	for (uint32_t y = 0; y < height; y++)
+	{
+		for (uint32_t x = 0; x < width; x++)
+		{
+			state ^= state << 13;
+			state ^= state >> 17;
+			state ^= state << 5;
+
+			unsigned char* p = &result.pixels[(size_t(y) * width + x) * 4];
+
+			bool checker = ((x / 64) ^ (y / 64)) & 1;
+			int noise = int(state & 15) - 8;
+
+			p[0] = uint8_t(std::max(0, std::min(255, int(x * 255 / width) + noise)));
+			p[1] = uint8_t(std::max(0, std::min(255, int(y * 255 / height) + noise)));
+			p[2] = checker ? 200 : 40;
+			p[3] = uint8_t(128 + 127 * sinf(float(x + y) * 0.01f));
+		}
+	}
+}
+
+static double computePsnr(const unsigned char* a, const unsigned char* b, size_t pixelCount, int channels)
+{
+	double error = 0;
+
+	for (size_t i = 0; i < pixelCount; i++)
+		for (int c = 0; c < channels; c++)
+			error += double(a[i * 4 + c] - b[i * 4 + c]) * (a[i * 4 + c] - b[i * 4 + c]);
+
+	double mse = error / double(pixelCount * channels);
+
+	return mse > 0 ? 10 * log10(255.0 * 255.0 / mse) : 99.0;
+}
+
+bool benchmarkTextures(const char* path)
+{
+	ImageRGBA image;
+
+	if (path)
+	{
+		if (!loadImage(image, path))
+		{
+			printf("Failed to load %s\n", path);
+			return false;
+		}
+	}
+	else
+		generateImage(image, 2048, 2048);
+
+	uint32_t threadCount = getThreadCount();
+	double pixels = 0;
+
+	printf("%s: %dx%d, %d mips, %d threads\n", path ? path : "generated", image.width, image.height, getMipCount(image.width, image.height), threadCount);
+
+	double start = getTimeMs();
+	std::vector<ImageRGBA> reference;
+	generateMips(reference, image, 1);
+	double serialTime = getTimeMs() - start;
+
+	start = getTimeMs();
+	std::vector<ImageRGBA> mips;
+	generateMips(mips, image, threadCount);
+	double parallelTime = getTimeMs() - start;
+
+	bool matches = true;
+
+	for (size_t i = 0; i < mips.size(); i++)
+	{
+		matches &= mips[i].pixels == reference[i].pixels;
+		pixels += double(mips[i].width) * mips[i].height;
+	}
+
+	printf("Mips:   %8.2f ms 1 thread, %8.2f ms %d threads, %.2fx%s\n", serialTime, parallelTime, threadCount, serialTime / parallelTime, matches ? "" : " (MISMATCH)");
+
+	TextureFormat formats[] = { TextureFormatBC1, TextureFormatBC7 };
+	const char* names[] = { "BC1", "BC7" };
+
+	for (size_t f = 0; f < 2; f++)
+	{
+		start = getTimeMs();
+		TextureData serial;
+		encodeTexture(serial, mips, formats[f], 1);
+		double encodeSerial = getTimeMs() - start;
+
+		start = getTimeMs();
+		TextureData texture;
+		encodeTexture(texture, mips, formats[f], threadCount);
+		double encodeParallel = getTimeMs() - start;
+
+		start = getTimeMs();
+		TextureData decoded;
+		decodeTexture(decoded, texture, threadCount);
+		double decodeTime = getTimeMs() - start;
+
+		bool same = serial.data == texture.data;
+
+		// BC1 drops alpha, so it is compared on color only
+		double psnr = computePsnr(image.pixels.data(), decoded.data.data(), size_t(image.width) * image.height, formats[f] == TextureFormatBC1 ? 3 : 4);
+
+		const char* tempPath = "texbench.tex";
+
+		TextureData loaded;
+		bool roundTrip = writeTextureFile(tempPath, texture) && readTextureFile(loaded, tempPath) && loaded.data == texture.data && loaded.format == texture.format;
+		remove(tempPath);
+
+		printf("%s:    encode %8.2f ms 1 thread, %8.2f ms %d threads (%.2f Mpix/s), decode %6.2f ms (%.2f Mpix/s), %.2f dB, %.2f MB%s%s\n", names[f],
+			encodeSerial, encodeParallel, threadCount, pixels / 1e3 / encodeParallel, decodeTime, pixels / 1e3 / decodeTime, psnr, double(texture.data.size()) / 1e6,
+			same ? "" : " (MISMATCH)", roundTrip ? "" : " (FILE MISMATCH)");
+
+		matches &= same && roundTrip;
+	}
+
+	return matches;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "files.h"
+
+#include <vector>
+
+// Texture container: a full mip chain in one format, from the largest mip to 1x1. Block compressed mips are rows of
+// 4x4 blocks; blocks at the right and bottom edges repeat the edge pixels. Every mip can be copied to an image as is.
+//
+// Layout: TextureFileHeader, mipCount TextureFileMip entries, mip data
+const uint32_t kTextureFileMagic = 0x52584554; // 'TEXR'
+const uint32_t kTextureFileVersion = 1;
+
+// All formats are sRGB color; alpha is linear
+enum TextureFormat
+{
+	TextureFormatRGBA8,
+	TextureFormatBC1, // opaque, 8 bytes per block
+	TextureFormatBC7, // with alpha, 16 bytes per block
+
+	TextureFormatCount
+};
+
+struct TextureFileHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t format;
+
+	uint32_t width;
+	uint32_t height;
+	uint32_t mipCount;
+};
+
+struct TextureFileMip
+{
+	uint64_t offset; // from the start of the mip data
+	uint64_t size;
+};
+
+// 8-bit RGBA pixels, rows top to bottom
+struct ImageRGBA
+{
+	uint32_t width, height;
+	std::vector<unsigned char> pixels;
+};
+
+struct TextureData
+{
+	uint32_t format;
+	uint32_t width, height;
+
+	std::vector<TextureFileMip> mips;
+	std::vector<unsigned char> data;
+};
+
+// 1 for uncompressed formats, 4 for block compressed ones
+uint32_t getTextureBlockSize(uint32_t format);
+// Bytes per block, or per pixel for uncompressed formats
+uint32_t getTextureBlockBytes(uint32_t format);
+uint32_t getMipCount(uint32_t width, uint32_t height);
+
+// Reads .tga (uncompressed or RLE; 8-bit gray, 24 or 32-bit color) and binary .ppm/.pgm files with 8-bit channels
+bool loadImage(ImageRGBA& result, const char* path);
+
+// Full mip chain including the image itself; 2x2 box filter in linear space for color and as is for alpha. Rows of a mip
+// are filtered in parallel, mips one after another
+void generateMips(std::vector<ImageRGBA>& result, const ImageRGBA& image, uint32_t threadCount);
+
+// Blocks of all mips are encoded in parallel; the result doesn't depend on threadCount
+void encodeTexture(TextureData& result, const std::vector<ImageRGBA>& mips, TextureFormat format, uint32_t threadCount);
+
+// Decodes block compressed textures to TextureFormatRGBA8, e.g. for devices without BC support
+void decodeTexture(TextureData& result, const TextureData& texture, uint32_t threadCount);
+
+bool writeTextureFile(const char* path, const TextureData& texture);
+// Validates the header and mip table against the file size and the format
+bool readTextureFile(TextureData& result, const char* path);
+
+// Loads the texture for an image from cacheDir, or converts the image and writes it there. Cache entries are named by
+// the hash of the image contents, so edited images are converted again. Opaque images are stored as BC1, images with
+// alpha as BC7
+bool loadTexture(TextureData& result, const char* path, const char* cacheDir, uint32_t threadCount);
+
+// Measures mip generation, BC1/BC7 encode and decode throughput with 1 and all threads and reports PSNR of the top mip;
+// uses a generated image if path is 0. Returns false if the threaded results differ or the container doesn't round trip
+bool benchmarkTextures(const char* path);
@@ -0,0 +1,211 @@
+#include "common.h"
+#include "textures.h"
+#include "texturefile.h"
+#include "mesh.h"
+#include "timer.h"
+
+#include <string.h>
+
+#include <map>
+#include <string>
+#include <thread>
+
+static const char* kTextureCacheDir = "textures/cache";
+
+static VkFormat getTextureFormat(uint32_t format)
+{
+	switch (format)
+	{
+	case TextureFormatBC1:
+		return VK_FORMAT_BC1_RGB_SRGB_BLOCK;
+	case TextureFormatBC7:
+		return VK_FORMAT_BC7_SRGB_BLOCK;
+	default:
+		return VK_FORMAT_R8G8B8A8_SRGB;
+	}
+}
+
+VkDescriptorSetLayout createMaterialSetLayout(VkDevice device)
+{
+	VkDescriptorSetLayoutBinding binding = { 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT };
+
+	VkDescriptorSetLayoutCreateInfo createInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO };
+	createInfo.bindingCount = 1;
+	createInfo.pBindings = &binding;
+
+	VkDescriptorSetLayout setLayout = 0;
+	VK_CHECK(vkCreateDescriptorSetLayout(device, &createInfo, 0, &setLayout));
+
+	return setLayout;
+}
+
+static VkSampler createSampler(VkDevice device)
+{
+	// trilinear; anisotropic filtering would need the samplerAnisotropy feature
+	VkSamplerCreateInfo createInfo = { VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO };
+	createInfo.magFilter = VK_FILTER_LINEAR;
+	createInfo.minFilter = VK_FILTER_LINEAR;
+	createInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+	createInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	createInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	createInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	createInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+	VkSampler sampler = 0;
+	VK_CHECK(vkCreateSampler(device, &createInfo, 0, &sampler));
+
+	return sampler;
+}
+
+static void createTextureImage(MaterialTextures& textures, const VkPhysicalDeviceMemoryProperties& memoryProperties, Uploader& uploader, const TextureData& texture)
+{
+	Image image = {};
+	createImage(image, textures.device, memoryProperties, texture.width, texture.height, getTextureFormat(texture.format),
+		VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_SAMPLE_COUNT_1_BIT, uint32_t(texture.mips.size()));
+
+	uploadImage(uploader, image, texture.data.data(), texture.data.size(), getTextureBlockSize(texture.format), getTextureBlockBytes(texture.format));
+
+	textures.images.push_back(image);
+	textures.memorySize += image.memorySize;
+}
+
+static std::string getDirectory(const char* path)
+{
+	const char* slash = strrchr(path, '/');
+	const char* backslash = strrchr(path, '\\');
+	const char* separator = slash > backslash ? slash : backslash;
+
+	return separator ? std::string(path, separator + 1) : std::string();
+}
+
+void createMaterialTextures(MaterialTextures& result, VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties, Uploader& uploader, VkDescriptorSetLayout setLayout,
+	const Mesh& mesh, const char* meshPath, bool compressed)
+{
+	result.device = device;
+	result.sampler = createSampler(device);
+	result.memorySize = 0;
+
+	TextureData white = {};
+	white.format = TextureFormatRGBA8;
+	white.width = white.height = 1;
+	white.mips.resize(1);
+	white.mips[0].size = 4;
+	white.data.assign(4, 255);
+
+	createTextureImage(result, memoryProperties, uploader, white);
+
+	std::string directory = getDirectory(meshPath);
+
+	// materials often share textures; every image is loaded once
+	std::map<std::string, uint32_t> loaded;
+	std::vector<uint32_t> materialImages(mesh.materials.size());
+
+	double start = getTimeMs();
+	uint32_t formatCounts[TextureFormatCount] = {};
+
+	for (size_t i = 0; i < mesh.materials.size(); i++)
+	{
+		const std::string& name = mesh.materials[i].diffuseTexture;
+
+		if (name.empty())
+			continue;
+
+		std::map<std::string, uint32_t>::iterator it = loaded.find(name);
+
+		if (it != loaded.end())
+		{
+			materialImages[i] = it->second;
+			continue;
+		}
+
+		std::string path = directory + name;
+
+		TextureData texture;
+		if (!loadTexture(texture, path.c_str(), kTextureCacheDir, std::thread::hardware_concurrency()))
+		{
+			printf("Warning: failed to load texture %s\n", path.c_str());
+
+			loaded[name] = 0;
+			continue;
+		}
+
+		formatCounts[texture.format]++;
+
+		if (texture.format != TextureFormatRGBA8 && !compressed)
+		{
+			TextureData decoded;
+			decodeTexture(decoded, texture, std::thread::hardware_concurrency());
+
+			texture.format = decoded.format;
+			texture.mips.swap(decoded.mips);
+			texture.data.swap(decoded.data);
+		}
+
+		materialImages[i] = loaded[name] = uint32_t(result.images.size());
+
+		createTextureImage(result, memoryProperties, uploader, texture);
+	}
+
+	if (result.images.size() > 1)
+		printf("Textures: %d loaded in %.2f ms, %d BC1, %d BC7, %.2f MB%s\n", int(result.images.size() - 1), getTimeMs() - start,
+			formatCounts[TextureFormatBC1], formatCounts[TextureFormatBC7], double(result.memorySize) / 1e6, compressed ? "" : " (decoded to RGBA8, no BC support)");
+
+	uint32_t setCount = uint32_t(mesh.materials.size()) + 1;
+
+	VkDescriptorPoolSize poolSize = { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, setCount };
+
+	VkDescriptorPoolCreateInfo poolInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
+	poolInfo.maxSets = setCount;
+	poolInfo.poolSizeCount = 1;
+	poolInfo.pPoolSizes = &poolSize;
+
+	VK_CHECK(vkCreateDescriptorPool(device, &poolInfo, 0, &result.descriptorPool));
+
+	std::vector<VkDescriptorSetLayout> setLayouts(setCount, setLayout);
+	std::vector<VkDescriptorSet> sets(setCount);
+
+	VkDescriptorSetAllocateInfo allocateInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
+	allocateInfo.descriptorPool = result.descriptorPool;
+	allocateInfo.descriptorSetCount = setCount;
+	allocateInfo.pSetLayouts = setLayouts.data();
+
+	VK_CHECK(vkAllocateDescriptorSets(device, &allocateInfo, sets.data()));
+
+	std::vector<VkDescriptorImageInfo> imageInfos(setCount);
+	std::vector<VkWriteDescriptorSet> writes(setCount);
+
+	for (uint32_t i = 0; i < setCount; i++)
+	{
+		// the last set is the default one
+		const Image& image = result.images[i < mesh.materials.size() ? materialImages[i] : 0];
+
+		imageInfos[i].sampler = result.sampler;
+		imageInfos[i].imageView = image.imageView;
+		imageInfos[i].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+		writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[i].dstSet = sets[i];
+		writes[i].dstBinding = 0;
+		writes[i].descriptorCount = 1;
+		writes[i].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		writes[i].pImageInfo = &imageInfos[i];
+	}
+
+	vkUpdateDescriptorSets(device, setCount, writes.data(), 0, 0);
+
+	result.defaultSet = sets.back();
+
+	sets.pop_back();
+	result.sets.swap(sets);
+}
+
+void destroyMaterialTextures(MaterialTextures& textures)
+{
+	for (size_t i = 0; i < textures.images.size(); i++)
+		destroyImage(textures.images[i], textures.device);
+
+	vkDestroyDescriptorPool(textures.device, textures.descriptorPool, VK_NULL_HANDLE);
+	vkDestroySampler(textures.device, textures.sampler, VK_NULL_HANDLE);
+
+	textures = MaterialTextures();
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "resources.h"
+
+struct Mesh;
+
+// Diffuse textures of the mesh materials, with one descriptor set per material for triangle.tex.frag.glsl (set 0,
+// binding 0). Textures are converted to BC1/BC7 with mips once and cached (see loadTexture); devices without BC support
+// get them decoded to RGBA8. Materials without a texture, or with one that can't be loaded, use a 1x1 white texture
+struct MaterialTextures
+{
+	VkDevice device;
+
+	VkDescriptorPool descriptorPool;
+	VkSampler sampler;
+
+	std::vector<Image> images; // images[0] is the white texture
+	std::vector<VkDescriptorSet> sets; // one per material
+	VkDescriptorSet defaultSet; // white texture, for draws without a material such as streamed chunks
+
+	VkDeviceSize memorySize;
+};
+
+// Layout of the material sets; pipeline layouts for triangle.tex.frag.glsl are created with it before the textures exist
+VkDescriptorSetLayout createMaterialSetLayout(VkDevice device);
+
+// Texture paths are relative to meshPath; images are uploaded through the uploader, so the consumer acquires them with
+// the mesh buffers
+void createMaterialTextures(MaterialTextures& result, VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties, Uploader& uploader, VkDescriptorSetLayout setLayout,
+	const Mesh& mesh, const char* meshPath, bool compressed);
+void destroyMaterialTextures(MaterialTextures& textures);
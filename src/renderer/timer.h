@@ -0,0 +1,10 @@
+#pragma once
+
+#include <chrono>
+
+// Monotonic time in milliseconds, for measuring intervals; the epoch is unspecified
+inline double getTimeMs()
+{
+	using namespace std::chrono;
+	return duration<double, std::milli>(steady_clock::now().time_since_epoch()).count();
+}
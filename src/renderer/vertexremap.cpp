@@ -0,0 +1,282 @@
+#include "vertexremap.h"
+#include "mesh.h"
+#include "scenegen.h"
+#include "objparser.h"
+#include "parallel.h"
+#include "timer.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+#include <meshoptimizer.h>
+
+// below this, threads cost more than they save
+const size_t kMinVerticesPerThread = 64 * 1024;
+
+// a few partitions per thread even out partitions that end up with more unique vertices than others
+const uint32_t kPartitionsPerThread = 4;
+const uint32_t kMaxPartitions = 256;
+
+// MurmurHash2 over 32-bit words, with a final mix so that the high bits that select the partition depend on every word
+static uint32_t hashVertex(const unsigned char* vertex, size_t vertexSize)
+{
+	const uint32_t m = 0x5bd1e995;
+
+	uint32_t h = 0;
+
+	for (size_t i = 0; i < vertexSize; i += 4)
+	{
+		uint32_t k;
+		memcpy(&k, vertex + i, 4);
+
+		k *= m;
+		k ^= k >> 24;
+		k *= m;
+
+		h *= m;
+		h ^= k;
+	}
+
+	h ^= h >> 13;
+	h *= m;
+	h ^= h >> 15;
+
+	return h;
+}
+
+static uint32_t getPartition(uint32_t hash, uint32_t partitionCount)
+{
+	return uint32_t((uint64_t(hash) * partitionCount) >> 32);
+}
+
+size_t generateVertexRemap(uint32_t* remap, const void* vertices, size_t vertexCount, size_t vertexSize, uint32_t threadCount)
+{
+	assert(vertexSize > 0 && vertexSize % 4 == 0);
+	assert(vertexCount <= ~0u);
+
+	threadCount = uint32_t(std::min(std::max(vertexCount / kMinVerticesPerThread, size_t(1)), size_t(std::max(threadCount, 1u))));
+
+	if (threadCount == 1)
+		return meshopt_generateVertexRemap(remap, 0, vertexCount, vertices, vertexCount, vertexSize);
+
+	const unsigned char* data = static_cast<const unsigned char*>(vertices);
+
+	uint32_t partitionCount = std::min(threadCount * kPartitionsPerThread, kMaxPartitions);
+
+	// partition of every vertex, and how many vertices of every range go to every partition
+	std::vector<uint8_t> partitions(vertexCount);
+	std::vector<size_t> offsets(size_t(threadCount) * partitionCount);
+
+	parallelFor(threadCount, [&](uint32_t thread) {
+		size_t begin = getRangeBegin(vertexCount, thread, threadCount);
+		size_t end = getRangeBegin(vertexCount, thread + 1, threadCount);
+
+		size_t* counts = &offsets[size_t(thread) * partitionCount];
+
+		for (size_t i = begin; i < end; i++)
+		{
+			uint32_t partition = getPartition(hashVertex(data + i * vertexSize, vertexSize), partitionCount);
+
+			partitions[i] = uint8_t(partition);
+			counts[partition]++;
+		}
+	});
+
+	// partitions are laid out one after another, with the vertices of every range in range order; vertices of a
+	// partition are thus in increasing order, and the first one a table sees is the first occurrence
+	std::vector<size_t> partitionBegin(partitionCount + 1);
+	size_t offset = 0;
+
+	for (uint32_t p = 0; p < partitionCount; p++)
+	{
+		partitionBegin[p] = offset;
+
+		for (uint32_t t = 0; t < threadCount; t++)
+		{
+			size_t count = offsets[size_t(t) * partitionCount + p];
+			offsets[size_t(t) * partitionCount + p] = offset;
+			offset += count;
+		}
+	}
+
+	partitionBegin[partitionCount] = offset;
+
+	std::vector<uint32_t> order(vertexCount);
+
+	parallelFor(threadCount, [&](uint32_t thread) {
+		size_t begin = getRangeBegin(vertexCount, thread, threadCount);
+		size_t end = getRangeBegin(vertexCount, thread + 1, threadCount);
+
+		size_t* next = &offsets[size_t(thread) * partitionCount];
+
+		for (size_t i = begin; i < end; i++)
+			order[next[partitions[i]]++] = uint32_t(i);
+	});
+
+	// first occurrence of every vertex; partitions are taken from a shared counter so that large ones don't hold up a thread
+	std::vector<uint32_t> first(vertexCount);
+	std::atomic<uint32_t> nextPartition(0);
+
+	parallelFor(threadCount, [&](uint32_t) {
+		std::vector<uint32_t> table;
+
+		for (uint32_t p = nextPartition++; p < partitionCount; p = nextPartition++)
+		{
+			size_t count = partitionBegin[p + 1] - partitionBegin[p];
+
+			// at most half full, so probe sequences stay short
+			size_t capacity = 16;
+			while (capacity < count * 2)
+				capacity *= 2;
+
+			table.assign(capacity, ~0u);
+
+			size_t mask = capacity - 1;
+
+			for (size_t j = partitionBegin[p]; j < partitionBegin[p + 1]; j++)
+			{
+				uint32_t index = order[j];
+				const unsigned char* vertex = data + size_t(index) * vertexSize;
+
+				for (size_t slot = hashVertex(vertex, vertexSize) & mask;; slot = (slot + 1) & mask)
+				{
+					uint32_t entry = table[slot];
+
+					if (entry == ~0u)
+					{
+						table[slot] = index;
+						first[index] = index;
+						break;
+					}
+
+					if (memcmp(data + size_t(entry) * vertexSize, vertex, vertexSize) == 0)
+					{
+						first[index] = entry;
+						break;
+					}
+				}
+			}
+		}
+	});
+
+	// unique vertices are numbered in order with a prefix sum over the ranges
+	std::vector<size_t> uniqueBegin(threadCount + 1);
+
+	parallelFor(threadCount, [&](uint32_t thread) {
+		size_t begin = getRangeBegin(vertexCount, thread, threadCount);
+		size_t end = getRangeBegin(vertexCount, thread + 1, threadCount);
+
+		size_t unique = 0;
+
+		for (size_t i = begin; i < end; i++)
+			unique += first[i] == i;
+
+		uniqueBegin[thread + 1] = unique;
+	});
+
+	for (uint32_t t = 0; t < threadCount; t++)
+		uniqueBegin[t + 1] += uniqueBegin[t];
+
+	parallelFor(threadCount, [&](uint32_t thread) {
+		size_t begin = getRangeBegin(vertexCount, thread, threadCount);
+		size_t end = getRangeBegin(vertexCount, thread + 1, threadCount);
+
+		uint32_t next = uint32_t(uniqueBegin[thread]);
+
+		for (size_t i = begin; i < end; i++)
+			if (first[i] == i)
+				remap[i] = next++;
+	});
+
+	// duplicates take the number of their first occurrence, which may be in another range, so this waits for all ranges
+	parallelFor(threadCount, [&](uint32_t thread) {
+		size_t begin = getRangeBegin(vertexCount, thread, threadCount);
+		size_t end = getRangeBegin(vertexCount, thread + 1, threadCount);
+
+		for (size_t i = begin; i < end; i++)
+			if (first[i] != i)
+				remap[i] = remap[first[i]];
+	});
+
+	return uniqueBegin[threadCount];
+}
+
+static bool benchmarkRemap(const char* name, const void* vertices, size_t vertexCount, size_t vertexSize)
+{
+	std::vector<uint32_t> reference(vertexCount);
+
+	double start = getTimeMs();
+	size_t referenceCount = meshopt_generateVertexRemap(reference.data(), 0, vertexCount, vertices, vertexCount, vertexSize);
+	double baseline = getTimeMs() - start;
+
+	printf("%s: %d -> %d vertices, %d bytes each\n", name, int(vertexCount), int(referenceCount), int(vertexSize));
+	printf("  meshopt:    %8.2f ms, %6.2f M vertices/s\n", baseline, double(vertexCount) / 1e3 / baseline);
+
+	std::vector<uint32_t> threadCounts;
+
+	for (uint32_t threads = 1; threads < getThreadCount(); threads *= 2)
+		threadCounts.push_back(threads);
+
+	threadCounts.push_back(getThreadCount());
+
+	bool matches = true;
+
+	std::vector<uint32_t> remap(vertexCount);
+
+	for (size_t i = 0; i < threadCounts.size(); i++)
+	{
+		memset(remap.data(), 0xff, remap.size() * sizeof(uint32_t));
+
+		start = getTimeMs();
+		size_t count = generateVertexRemap(remap.data(), vertices, vertexCount, vertexSize, threadCounts[i]);
+		double time = getTimeMs() - start;
+
+		bool same = count == referenceCount && remap == reference;
+
+		printf("  %2d threads: %8.2f ms, %6.2f M vertices/s, %.2fx%s\n", threadCounts[i], time, double(vertexCount) / 1e3 / time, baseline / time,
+			same ? "" : " (MISMATCH)");
+
+		matches &= same;
+	}
+
+	return matches;
+}
+
+bool benchmarkVertexRemap(const char* path)
+{
+	Mesh mesh;
+
+	SceneSettings sceneSettings;
+	if (isSceneSpec(path) ? !parseSceneSettings(sceneSettings, path) : !loadMesh(mesh, path))
+	{
+		printf("Failed to load %s\n", path);
+		return false;
+	}
+
+	if (isSceneSpec(path))
+		generateScene(mesh, sceneSettings);
+
+	// the same vertex stream loadObj deduplicates: one vertex per corner
+	std::vector<Vertex> corners(mesh.indices.size());
+
+	for (size_t i = 0; i < mesh.indices.size(); i++)
+		corners[i] = mesh.vertices[mesh.indices[i]];
+
+	bool matches = benchmarkRemap("Vertex bytes", corners.data(), corners.size(), sizeof(Vertex));
+
+	// OBJ corners can be keyed on their v/vt/vn indices instead, which is less data per key but may keep vertices
+	// that only have the same bytes apart
+	if (!isSceneSpec(path) && !isMeshFile(path))
+	{
+		ObjFile file;
+		if (objParseFile(file, path))
+			matches &= benchmarkRemap("Index triplets", file.f, file.f_size / 3, sizeof(int) * 3);
+	}
+
+	return matches;
+}
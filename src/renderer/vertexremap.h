@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Parallel vertex deduplication with the same output as meshopt_generateVertexRemap: unique vertices are numbered in
+// order of first occurrence and every vertex maps to the number of its first occurrence. Vertices are compared as raw
+// bytes, so any fixed-size key works, e.g. 32-byte vertices or OBJ v/vt/vn index triplets.
+//
+// Vertices are split into partitions by hash, and every partition is deduplicated by one thread in an open-addressing
+// table of its own, so threads never contend; numbering is done afterwards with a prefix sum over unique vertices.
+// vertexSize has to be a multiple of 4. Small inputs and threadCount 1 use meshopt_generateVertexRemap.
+// Returns the number of unique vertices
+size_t generateVertexRemap(uint32_t* remap, const void* vertices, size_t vertexCount, size_t vertexSize, uint32_t threadCount);
+
+// Times meshopt_generateVertexRemap against generateVertexRemap with 1, 2, 4, ... threads on the corners of the mesh
+// (.obj, .mesh or a scene spec), and on the index triplets of .obj files. Returns false if any remap differs
+bool benchmarkVertexRemap(const char* path);
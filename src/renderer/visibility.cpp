@@ -0,0 +1,624 @@
+#include "common.h"
+#include "shaders.h"
+#include "visibility.h"
+#include "scenegen.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static const uint32_t kVisibilityImageSize = 1024;
+static const uint32_t kVisibilityFrames = 20;
+
+// color and optional depth, cleared on load; attachments stay in their attachment layouts outside of the pass
+static VkRenderPass createTargetRenderPass(VkDevice device, VkFormat colorFormat, VkFormat depthFormat)
+{
+	VkAttachmentDescription attachments[2] = {};
+	attachments[0].format = colorFormat;
+	attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
+	attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	attachments[0].initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	attachments[0].finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+	// depth is only needed during the pass
+	attachments[1].format = depthFormat;
+	attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
+	attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	attachments[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	attachments[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	attachments[1].initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+	attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+	VkAttachmentReference colorAttachment = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+	VkAttachmentReference depthAttachment = { 1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+
+	VkSubpassDescription subpass = {};
+	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpass.colorAttachmentCount = 1;
+	subpass.pColorAttachments = &colorAttachment;
+	subpass.pDepthStencilAttachment = depthFormat != VK_FORMAT_UNDEFINED ? &depthAttachment : 0;
+
+	VkRenderPassCreateInfo createInfo = { VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO };
+	createInfo.subpassCount = 1;
+	createInfo.pSubpasses = &subpass;
+	createInfo.attachmentCount = depthFormat != VK_FORMAT_UNDEFINED ? 2 : 1;
+	createInfo.pAttachments = attachments;
+
+	VkRenderPass renderPass = 0;
+	VK_CHECK(vkCreateRenderPass(device, &createInfo, VK_NULL_HANDLE, &renderPass));
+
+	return renderPass;
+}
+
+static VkFramebuffer createTargetFramebuffer(VkDevice device, VkRenderPass renderPass, VkImageView colorView, VkImageView depthView, uint32_t width, uint32_t height)
+{
+	VkImageView attachments[] = { colorView, depthView };
+
+	VkFramebufferCreateInfo createInfo = { VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO };
+	createInfo.renderPass = renderPass;
+	createInfo.attachmentCount = depthView ? 2 : 1;
+	createInfo.pAttachments = attachments;
+	createInfo.width = width;
+	createInfo.height = height;
+	createInfo.layers = 1;
+
+	VkFramebuffer framebuffer = 0;
+	VK_CHECK(vkCreateFramebuffer(device, &createInfo, 0, &framebuffer));
+
+	return framebuffer;
+}
+
+static void beginTargetPass(VkCommandBuffer commandBuffer, VkRenderPass renderPass, VkFramebuffer framebuffer, VkImageView colorView, VkImageView depthView, uint32_t width, uint32_t height, const VkClearValue& clearColor)
+{
+	VkClearValue clearDepth = {};
+	clearDepth.depthStencil.depth = 1.f;
+
+	if (renderPass)
+	{
+		VkClearValue clearValues[] = { clearColor, clearDepth };
+
+		VkRenderPassBeginInfo passBeginInfo = { VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO };
+		passBeginInfo.renderPass = renderPass;
+		passBeginInfo.framebuffer = framebuffer;
+		passBeginInfo.renderArea.extent.width = width;
+		passBeginInfo.renderArea.extent.height = height;
+		passBeginInfo.clearValueCount = depthView ? 2 : 1;
+		passBeginInfo.pClearValues = clearValues;
+
+		vkCmdBeginRenderPass(commandBuffer, &passBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		return;
+	}
+
+#ifdef VK_KHR_dynamic_rendering
+	VkRenderingAttachmentInfoKHR colorAttachment = { VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR };
+	colorAttachment.imageView = colorView;
+	colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	colorAttachment.clearValue = clearColor;
+
+	VkRenderingAttachmentInfoKHR depthAttachment = { VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR };
+	depthAttachment.imageView = depthView;
+	depthAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+	depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	depthAttachment.clearValue = clearDepth;
+
+	VkRenderingInfoKHR renderingInfo = { VK_STRUCTURE_TYPE_RENDERING_INFO_KHR };
+	renderingInfo.renderArea.extent.width = width;
+	renderingInfo.renderArea.extent.height = height;
+	renderingInfo.layerCount = 1;
+	renderingInfo.colorAttachmentCount = 1;
+	renderingInfo.pColorAttachments = &colorAttachment;
+	renderingInfo.pDepthAttachment = depthView ? &depthAttachment : 0;
+
+	vkCmdBeginRenderingKHR(commandBuffer, &renderingInfo);
+#else
+	assert(!"Dynamic rendering is not available in this build");
+#endif
+}
+
+static void endTargetPass(VkCommandBuffer commandBuffer, VkRenderPass renderPass)
+{
+	if (renderPass)
+		vkCmdEndRenderPass(commandBuffer);
+#ifdef VK_KHR_dynamic_rendering
+	else
+		vkCmdEndRenderingKHR(commandBuffer);
+#endif
+}
+
+static VkImageMemoryBarrier targetBarrier(VkImage image, VkImageAspectFlags aspectMask, VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask, VkImageLayout oldLayout, VkImageLayout newLayout)
+{
+	VkImageMemoryBarrier barrier = { VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+	barrier.srcAccessMask = srcAccessMask;
+	barrier.dstAccessMask = dstAccessMask;
+	barrier.oldLayout = oldLayout;
+	barrier.newLayout = newLayout;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = image;
+	barrier.subresourceRange.aspectMask = aspectMask;
+	barrier.subresourceRange.levelCount = 1;
+	barrier.subresourceRange.layerCount = 1;
+
+	return barrier;
+}
+
+static void createTargets(VisibilityBuffer& buffer, const VkPhysicalDeviceMemoryProperties& memoryProperties, uint32_t width, uint32_t height)
+{
+	VkDevice device = buffer.device;
+
+	createImage(buffer.ids, device, memoryProperties, width, height, kVisibilityFormat, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_STORAGE_BIT);
+	createImage(buffer.depth, device, memoryProperties, width, height, kVisibilityDepthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT);
+
+	buffer.framebuffer = buffer.renderPass ? createTargetFramebuffer(device, buffer.renderPass, buffer.ids.imageView, buffer.depth.imageView, width, height) : 0;
+
+	// one set per image; a pool per size keeps replacing it trivial
+	VkDescriptorPoolSize poolSize = { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1 };
+
+	VkDescriptorPoolCreateInfo poolInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
+	poolInfo.maxSets = 1;
+	poolInfo.poolSizeCount = 1;
+	poolInfo.pPoolSizes = &poolSize;
+
+	VK_CHECK(vkCreateDescriptorPool(device, &poolInfo, 0, &buffer.descriptorPool));
+
+	VkDescriptorSetAllocateInfo allocateInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
+	allocateInfo.descriptorPool = buffer.descriptorPool;
+	allocateInfo.descriptorSetCount = 1;
+	allocateInfo.pSetLayouts = &buffer.setLayout;
+
+	VK_CHECK(vkAllocateDescriptorSets(device, &allocateInfo, &buffer.descriptorSet));
+
+	VkDescriptorImageInfo imageInfo = { VK_NULL_HANDLE, buffer.ids.imageView, VK_IMAGE_LAYOUT_GENERAL };
+
+	VkWriteDescriptorSet write = { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
+	write.dstSet = buffer.descriptorSet;
+	write.dstBinding = 0;
+	write.descriptorCount = 1;
+	write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	write.pImageInfo = &imageInfo;
+
+	vkUpdateDescriptorSets(device, 1, &write, 0, 0);
+}
+
+void createVisibilityBuffer(VisibilityBuffer& result, VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties, bool dynamicRendering, Uploader& uploader, const DrawList& list, const Mesh& mesh, uint32_t width, uint32_t height)
+{
+	assert(!list.records.empty() && !mesh.materials.empty());
+
+	result.device = device;
+
+	result.renderPass = dynamicRendering ? 0 : createTargetRenderPass(device, kVisibilityFormat, kVisibilityDepthFormat);
+
+	RenderTargetInfo target = { result.renderPass, kVisibilityFormat, kVisibilityDepthFormat, VK_SAMPLE_COUNT_1_BIT };
+	result.target = target;
+
+	VkDescriptorSetLayoutBinding binding = { 0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_FRAGMENT_BIT };
+
+	VkDescriptorSetLayoutCreateInfo setLayoutInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO };
+	setLayoutInfo.bindingCount = 1;
+	setLayoutInfo.pBindings = &binding;
+
+	VK_CHECK(vkCreateDescriptorSetLayout(device, &setLayoutInfo, 0, &result.setLayout));
+
+	VkPushConstantRange pushConstantRange = { VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(ResolveConstants) };
+
+	VkPipelineLayoutCreateInfo layoutInfo = { VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO };
+	layoutInfo.setLayoutCount = 1;
+	layoutInfo.pSetLayouts = &result.setLayout;
+	layoutInfo.pushConstantRangeCount = 1;
+	layoutInfo.pPushConstantRanges = &pushConstantRange;
+
+	VK_CHECK(vkCreatePipelineLayout(device, &layoutInfo, 0, &result.resolveLayout));
+
+	// materials are read by index, so only the colors are uploaded
+	std::vector<float> diffuse(mesh.materials.size() * 4);
+	for (size_t i = 0; i < mesh.materials.size(); i++)
+		memcpy(&diffuse[i * 4], mesh.materials[i].diffuse, sizeof(mesh.materials[i].diffuse));
+
+	VkBufferUsageFlags usage = VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT_KHR | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+	createBuffer(result.records, device, memoryProperties, list.records.size() * sizeof(DrawRecord), usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	createBuffer(result.materials, device, memoryProperties, diffuse.size() * sizeof(float), usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	uploadBuffer(uploader, result.records, list.records.data(), list.records.size() * sizeof(DrawRecord));
+	uploadBuffer(uploader, result.materials, diffuse.data(), diffuse.size() * sizeof(float));
+
+	createTargets(result, memoryProperties, width, height);
+}
+
+void destroyVisibilityBuffer(VisibilityBuffer& buffer)
+{
+	VkDevice device = buffer.device;
+
+	destroyImage(buffer.ids, device);
+	destroyImage(buffer.depth, device);
+
+	if (buffer.framebuffer)
+		vkDestroyFramebuffer(device, buffer.framebuffer, VK_NULL_HANDLE);
+
+	vkDestroyDescriptorPool(device, buffer.descriptorPool, VK_NULL_HANDLE);
+	vkDestroyPipelineLayout(device, buffer.resolveLayout, VK_NULL_HANDLE);
+	vkDestroyDescriptorSetLayout(device, buffer.setLayout, VK_NULL_HANDLE);
+
+	if (buffer.renderPass)
+		vkDestroyRenderPass(device, buffer.renderPass, VK_NULL_HANDLE);
+
+	destroyBuffer(buffer.records, device);
+	destroyBuffer(buffer.materials, device);
+}
+
+void resizeVisibilityBuffer(VisibilityBuffer& buffer, const VkPhysicalDeviceMemoryProperties& memoryProperties, DeletionQueue& deletionQueue, uint64_t value, uint32_t width, uint32_t height)
+{
+	if (buffer.ids.width == width && buffer.ids.height == height)
+		return;
+
+	deferDestroyImage(deletionQueue, value, buffer.ids);
+	deferDestroyImage(deletionQueue, value, buffer.depth);
+
+	if (buffer.framebuffer)
+		deferDestroy(deletionQueue, value, VK_OBJECT_TYPE_FRAMEBUFFER, (uint64_t)buffer.framebuffer);
+
+	// the set goes with its pool
+	deferDestroy(deletionQueue, value, VK_OBJECT_TYPE_DESCRIPTOR_POOL, (uint64_t)buffer.descriptorPool);
+
+	createTargets(buffer, memoryProperties, width, height);
+}
+
+void beginVisibilityPass(VisibilityBuffer& buffer, VkCommandBuffer commandBuffer)
+{
+	VkClearValue clearIds = {};
+
+	beginTargetPass(commandBuffer, buffer.renderPass, buffer.framebuffer, buffer.ids.imageView, buffer.depth.imageView, buffer.ids.width, buffer.ids.height, clearIds);
+}
+
+void endVisibilityPass(VisibilityBuffer& buffer, VkCommandBuffer commandBuffer)
+{
+	endTargetPass(commandBuffer, buffer.renderPass);
+}
+
+void resolveVisibility(const VisibilityBuffer& buffer, VkCommandBuffer commandBuffer, VkPipeline pipeline, const float camera[3], uint64_t vertexAddress, uint64_t indexAddress, uint32_t indexSize)
+{
+	ResolveConstants constants = { { camera[0], camera[1], camera[2], 0.f } };
+	constants.vertices = vertexAddress;
+	constants.indices = indexAddress;
+	constants.records = getBufferAddress(buffer.device, buffer.records);
+	constants.materials = getBufferAddress(buffer.device, buffer.materials);
+	constants.width = buffer.ids.width;
+	constants.height = buffer.ids.height;
+	constants.indexSize = indexSize;
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, buffer.resolveLayout, 0, 1, &buffer.descriptorSet, 0, 0);
+	vkCmdPushConstants(commandBuffer, buffer.resolveLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(constants), &constants);
+
+	vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+}
+
+// One draw per record with the record index as firstInstance, like the culled draws of the renderer
+static void drawRecords(VkCommandBuffer commandBuffer, const DrawList& list, const Mesh& mesh, VkPipelineLayout layout)
+{
+	uint32_t currentMaterial = ~0u;
+
+	for (size_t i = 0; i < list.records.size(); i++)
+	{
+		const DrawRecord& record = list.records[i];
+
+		if (record.material != currentMaterial)
+		{
+			const Material& material = mesh.materials[record.material];
+			vkCmdPushConstants(commandBuffer, layout, VK_SHADER_STAGE_VERTEX_BIT, offsetof(Globals, diffuseColor), sizeof(material.diffuse), material.diffuse);
+
+			currentMaterial = record.material;
+		}
+
+		vkCmdDrawIndexed(commandBuffer, record.indexCount, 1, record.indexOffset, record.vertexOffset, uint32_t(i));
+	}
+}
+
+static void copyToReadback(VkCommandBuffer commandBuffer, const Image& image, const Buffer& readback, VkDeviceSize offset)
+{
+	VkImageMemoryBarrier copyBarrier = targetBarrier(image.image, VK_IMAGE_ASPECT_COLOR_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+		VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, 0, 0, 0, 1, &copyBarrier);
+
+	VkBufferImageCopy region = {};
+	region.bufferOffset = offset;
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.layerCount = 1;
+	region.imageExtent = { image.width, image.height, 1 };
+
+	vkCmdCopyImageToBuffer(commandBuffer, image.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readback.buffer, 1, &region);
+}
+
+bool benchmarkVisibility(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties, VkQueue queue, uint32_t familyIndex, float timestampPeriod, bool dynamicRendering,
+	VkShaderModule vs, VkShaderModule fs, VkShaderModule visibilityFS, VkShaderModule resolveVS, VkShaderModule resolveFS, VkPipelineLayout layout, uint32_t objectCount)
+{
+	// randomly placed instances overlap a lot, so forward shading runs for most pixels several times
+	SceneSettings settings = { uint64_t(objectCount) * 4096, 0.5f, 16, objectCount, SceneLayoutRandom, 1 };
+
+	Mesh mesh;
+	generateScene(mesh, settings);
+	selectIndexSize(mesh);
+
+	DrawList list;
+	buildDrawList(list, mesh);
+
+	printf("Shading %d objects, %d triangles, %dx%d\n", int(list.records.size()), int(mesh.indices.size() / 3), kVisibilityImageSize, kVisibilityImageSize);
+
+	VkBufferUsageFlags addressUsage = VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT_KHR;
+	VkMemoryPropertyFlags hostVisible = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+	Buffer vb = {};
+	createBuffer(vb, device, memoryProperties, mesh.vertices.size() * sizeof(Vertex), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | addressUsage, hostVisible);
+	memcpy(vb.data, mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex));
+
+	// the resolve reads 16-bit indices in pairs, so the size is rounded up to a whole pair
+	Buffer ib = {};
+	createBuffer(ib, device, memoryProperties, (mesh.indices.size() * mesh.indexSize + 3) & ~size_t(3), VK_BUFFER_USAGE_INDEX_BUFFER_BIT | addressUsage, hostVisible);
+
+	if (mesh.indexSize == sizeof(uint16_t))
+	{
+		std::vector<uint16_t> indices16(mesh.indices.begin(), mesh.indices.end());
+		memcpy(ib.data, indices16.data(), indices16.size() * sizeof(uint16_t));
+	}
+	else
+		memcpy(ib.data, mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t));
+
+	Uploader uploader;
+	createUploader(uploader, device, memoryProperties, queue, familyIndex, familyIndex, false, 8 * 1024 * 1024);
+
+	VisibilityBuffer visibility;
+	createVisibilityBuffer(visibility, device, memoryProperties, dynamicRendering, uploader, list, mesh, kVisibilityImageSize, kVisibilityImageSize);
+
+	// uploads ran on the same queue and were waited for on the host
+	waitTimeline(uploader.timeline, uploader.timeline.submitted);
+
+	// forward shading needs its own depth buffer; the resolve only writes color
+	const VkFormat colorFormat = VK_FORMAT_R8G8B8A8_UNORM;
+
+	VkRenderPass forwardPass = dynamicRendering ? 0 : createTargetRenderPass(device, colorFormat, kVisibilityDepthFormat);
+	VkRenderPass resolvePass = dynamicRendering ? 0 : createTargetRenderPass(device, colorFormat, VK_FORMAT_UNDEFINED);
+
+	RenderTargetInfo forwardTarget = { forwardPass, colorFormat, kVisibilityDepthFormat, VK_SAMPLE_COUNT_1_BIT };
+	RenderTargetInfo resolveTarget = { resolvePass, colorFormat, VK_FORMAT_UNDEFINED, VK_SAMPLE_COUNT_1_BIT };
+
+	Image color = {};
+	createImage(color, device, memoryProperties, kVisibilityImageSize, kVisibilityImageSize, colorFormat, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+
+	Image depth = {};
+	createImage(depth, device, memoryProperties, kVisibilityImageSize, kVisibilityImageSize, kVisibilityDepthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT);
+
+	VkFramebuffer forwardFramebuffer = forwardPass ? createTargetFramebuffer(device, forwardPass, color.imageView, depth.imageView, color.width, color.height) : 0;
+	VkFramebuffer resolveFramebuffer = resolvePass ? createTargetFramebuffer(device, resolvePass, color.imageView, 0, color.width, color.height) : 0;
+
+	uint32_t vertexFormat = mesh.hasNormals ? VertexFormatFull : VertexFormatNoNormals;
+
+	PipelineVariant variant = { vertexFormat, LightingModeLambert, VertexInputAttributes };
+	PipelineVariant resolveVariant = { vertexFormat, LightingModeLambert, VertexInputPulled };
+
+	VkPipeline forwardPipeline = createGraphicsPipeline(device, 0, forwardTarget, vs, fs, layout, variant);
+	VkPipeline geometryPipeline = createGraphicsPipeline(device, 0, visibility.target, vs, visibilityFS, layout, variant);
+	VkPipeline resolvePipeline = createGraphicsPipeline(device, 0, resolveTarget, resolveVS, resolveFS, visibility.resolveLayout, resolveVariant);
+	assert(forwardPipeline && geometryPipeline && resolvePipeline);
+
+	size_t imageSize = size_t(color.width) * color.height * 4;
+
+	Buffer readback = {};
+	createBuffer(readback, device, memoryProperties, imageSize * 2, VK_BUFFER_USAGE_TRANSFER_DST_BIT, hostVisible);
+
+	VkCommandPoolCreateInfo poolInfo = { VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+	poolInfo.queueFamilyIndex = familyIndex;
+
+	VkCommandPool commandPool = 0;
+	VK_CHECK(vkCreateCommandPool(device, &poolInfo, 0, &commandPool));
+
+	VkCommandBufferAllocateInfo allocateInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
+	allocateInfo.commandPool = commandPool;
+	allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocateInfo.commandBufferCount = 1;
+
+	VkCommandBuffer commandBuffer = 0;
+	VK_CHECK(vkAllocateCommandBuffers(device, &allocateInfo, &commandBuffer));
+
+	// forward pass; geometry pass; resolve
+	VkQueryPoolCreateInfo queryInfo = { VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO };
+	queryInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	queryInfo.queryCount = 5;
+
+	VkQueryPool queryPool = 0;
+	VK_CHECK(vkCreateQueryPool(device, &queryInfo, 0, &queryPool));
+
+	// the scene fits the view volume of a camera at the origin, see generateScene
+	float camera[3] = { 0.f, 0.f, -0.5f };
+
+	Globals globals = { { camera[0], camera[1], camera[2], 0.f }, { 1.f, 1.f, 1.f, 1.f }, 0 };
+
+	VkViewport viewport = { 0, float(color.height), float(color.width), -float(color.height), 0, 1 };
+	VkRect2D scissor = { {0, 0}, {color.width, color.height} };
+
+	VkClearValue clearColor = {};
+	VkDeviceSize offset = 0;
+
+	double forwardTime = 1e9, geometryTime = 1e9, resolveTime = 1e9;
+
+	for (uint32_t frame = 0; frame < kVisibilityFrames; frame++)
+	{
+		VK_CHECK(vkResetCommandPool(device, commandPool, 0));
+
+		VkCommandBufferBeginInfo beginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+		VK_CHECK(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+
+		VkMemoryBarrier uploadBarrier = { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+		uploadBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		uploadBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 1, &uploadBarrier, 0, 0, 0, 0);
+
+		vkCmdResetQueryPool(commandBuffer, queryPool, 0, 5);
+
+		// color is copied out after each pass, so its contents are discarded before the next one
+		VkImageMemoryBarrier forwardBarriers[] =
+		{
+			targetBarrier(color.image, VK_IMAGE_ASPECT_COLOR_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL),
+			targetBarrier(depth.image, VK_IMAGE_ASPECT_DEPTH_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+				VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL),
+		};
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+			VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, 0, 0, 0, 0, 0, ARRAYSIZE(forwardBarriers), forwardBarriers);
+
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, 0);
+
+		beginTargetPass(commandBuffer, forwardPass, forwardFramebuffer, color.imageView, depth.imageView, color.width, color.height, clearColor);
+
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, forwardPipeline);
+		vkCmdPushConstants(commandBuffer, layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(globals), &globals);
+
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vb.buffer, &offset);
+		vkCmdBindIndexBuffer(commandBuffer, ib.buffer, 0, mesh.indexSize == sizeof(uint16_t) ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32);
+
+		drawRecords(commandBuffer, list, mesh, layout);
+
+		endTargetPass(commandBuffer, forwardPass);
+
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, 1);
+
+		copyToReadback(commandBuffer, color, readback, 0);
+
+		// the same draws write ids instead of colors, followed by one fullscreen resolve
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, 2);
+
+		// the previous contents are cleared; the barriers order the pass after the resolve and depth writes of earlier iterations
+		VkImageMemoryBarrier geometryBarriers[] =
+		{
+			targetBarrier(visibility.ids.image, VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL),
+			targetBarrier(visibility.depth.image, VK_IMAGE_ASPECT_DEPTH_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+				VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL),
+		};
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+			VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, 0, 0, 0, 0, 0, ARRAYSIZE(geometryBarriers), geometryBarriers);
+
+		beginVisibilityPass(visibility, commandBuffer);
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, geometryPipeline);
+
+		drawRecords(commandBuffer, list, mesh, layout);
+
+		endVisibilityPass(visibility, commandBuffer);
+
+		VkImageMemoryBarrier idsBarrier = targetBarrier(visibility.ids.image, VK_IMAGE_ASPECT_COLOR_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+			VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL);
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, 0, 0, 0, 1, &idsBarrier);
+
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, 3);
+
+		VkImageMemoryBarrier resolveBarrier = targetBarrier(color.image, VK_IMAGE_ASPECT_COLOR_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+			VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, 0, 0, 0, 0, 1, &resolveBarrier);
+
+		beginTargetPass(commandBuffer, resolvePass, resolveFramebuffer, color.imageView, 0, color.width, color.height, clearColor);
+
+		resolveVisibility(visibility, commandBuffer, resolvePipeline, camera, getBufferAddress(device, vb), getBufferAddress(device, ib), mesh.indexSize);
+
+		endTargetPass(commandBuffer, resolvePass);
+
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, 4);
+
+		copyToReadback(commandBuffer, color, readback, imageSize);
+
+		VkMemoryBarrier hostBarrier = { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+		hostBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &hostBarrier, 0, 0, 0, 0);
+
+		VK_CHECK(vkEndCommandBuffer(commandBuffer));
+
+		VkSubmitInfo submitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &commandBuffer;
+
+		VK_CHECK(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		VK_CHECK(vkQueueWaitIdle(queue));
+
+		uint64_t timestamps[5] = {};
+		VK_CHECK(vkGetQueryPoolResults(device, queryPool, 0, 5, sizeof(timestamps), timestamps, sizeof(timestamps[0]), VK_QUERY_RESULT_64_BIT));
+
+		double forward = double(timestamps[1] - timestamps[0]) * timestampPeriod * 1e-6;
+		double geometry = double(timestamps[3] - timestamps[2]) * timestampPeriod * 1e-6;
+		double resolve = double(timestamps[4] - timestamps[3]) * timestampPeriod * 1e-6;
+
+		forwardTime = forwardTime < forward ? forwardTime : forward;
+		geometryTime = geometryTime < geometry ? geometryTime : geometry;
+		resolveTime = resolveTime < resolve ? resolveTime : resolve;
+	}
+
+	printf("forward   : %7.3f ms\n", forwardTime);
+	printf("visibility: %7.3f ms (geometry %.3f ms, resolve %.3f ms), %.2fx\n", geometryTime + resolveTime, geometryTime, resolveTime, forwardTime / (geometryTime + resolveTime));
+
+	// both paths see the same triangle per pixel; the resolve interpolates with its own barycentrics, so colors may
+	// differ by rounding, and sliver triangles may be off by more
+	const unsigned char* reference = static_cast<const unsigned char*>(readback.data);
+	const unsigned char* pixels = reference + imageSize;
+
+	size_t covered = 0, mismatches = 0;
+
+	for (size_t i = 0; i < imageSize; i += 4)
+	{
+		int difference = 0;
+
+		for (int k = 0; k < 4; k++)
+		{
+			int channel = abs(int(reference[i + k]) - int(pixels[i + k]));
+			difference = difference < channel ? channel : difference;
+		}
+
+		covered += (reference[i + 0] | reference[i + 1] | reference[i + 2]) != 0;
+		mismatches += difference > 2;
+	}
+
+	printf("%d/%d pixels differ from forward shading (%d covered)\n", int(mismatches), int(imageSize / 4), int(covered));
+
+	vkDestroyQueryPool(device, queryPool, VK_NULL_HANDLE);
+	vkDestroyCommandPool(device, commandPool, VK_NULL_HANDLE);
+
+	vkDestroyPipeline(device, forwardPipeline, VK_NULL_HANDLE);
+	vkDestroyPipeline(device, geometryPipeline, VK_NULL_HANDLE);
+	vkDestroyPipeline(device, resolvePipeline, VK_NULL_HANDLE);
+
+	if (forwardFramebuffer)
+		vkDestroyFramebuffer(device, forwardFramebuffer, VK_NULL_HANDLE);
+	if (resolveFramebuffer)
+		vkDestroyFramebuffer(device, resolveFramebuffer, VK_NULL_HANDLE);
+	if (forwardPass)
+		vkDestroyRenderPass(device, forwardPass, VK_NULL_HANDLE);
+	if (resolvePass)
+		vkDestroyRenderPass(device, resolvePass, VK_NULL_HANDLE);
+
+	destroyImage(color, device);
+	destroyImage(depth, device);
+	destroyBuffer(readback, device);
+
+	destroyVisibilityBuffer(visibility);
+	destroyUploader(uploader);
+
+	destroyBuffer(vb, device);
+	destroyBuffer(ib, device);
+
+	return mismatches * 1000 <= covered;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "drawlist.h"
+#include "resources.h"
+
+struct DeletionQueue;
+
+// Visibility buffer rendering: the geometry pass (visibility.frag.glsl) only stores the draw record and triangle of the
+// closest surface per pixel, and a fullscreen resolve pass (resolve.frag.glsl) fetches that triangle through buffer
+// device addresses and shades every pixel once, however much overdraw the geometry pass had. Draws have to pass their
+// record index as firstInstance, like DrawCommand does
+const VkFormat kVisibilityFormat = VK_FORMAT_R32G32_UINT;
+const VkFormat kVisibilityDepthFormat = VK_FORMAT_D32_SFLOAT;
+
+struct VisibilityBuffer
+{
+	VkDevice device;
+
+	RenderTargetInfo target; // geometry pass pipelines are created for this
+	VkRenderPass renderPass; // 0 with dynamic rendering; owned, target.renderPass refers to it
+
+	Image ids; // draw record index + 1, 0 where nothing was drawn; triangle index within the draw
+	Image depth;
+	VkFramebuffer framebuffer;
+
+	// the resolve pass reads ids as a storage image; the set is replaced along with the images
+	VkDescriptorSetLayout setLayout;
+	VkDescriptorPool descriptorPool;
+	VkDescriptorSet descriptorSet;
+	VkPipelineLayout resolveLayout;
+
+	Buffer records;
+	Buffer materials;
+};
+
+// must match ResolveConstants in resolve.frag.glsl
+struct ResolveConstants
+{
+	float cameraPosition[4];
+
+	uint64_t vertices;
+	uint64_t indices;
+	uint64_t records;
+	uint64_t materials;
+
+	uint32_t width, height;
+	uint32_t indexSize;
+	uint32_t reserved;
+};
+
+// records and material colors are uploaded through the uploader; its acquires have to cover the fragment shader stage
+void createVisibilityBuffer(VisibilityBuffer& result, VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties, bool dynamicRendering, Uploader& uploader, const DrawList& list, const Mesh& mesh, uint32_t width, uint32_t height);
+void destroyVisibilityBuffer(VisibilityBuffer& buffer);
+
+// Recreates the images if the size changed; the previous ones may be in use by frames in flight and are destroyed once the timeline reaches value
+void resizeVisibilityBuffer(VisibilityBuffer& buffer, const VkPhysicalDeviceMemoryProperties& memoryProperties, DeletionQueue& deletionQueue, uint64_t value, uint32_t width, uint32_t height);
+
+// Begins the geometry pass with ids and depth cleared; the caller binds a pipeline created for buffer.target and draws.
+// ids and depth have to be in attachment layouts; the resolve reads ids in VK_IMAGE_LAYOUT_GENERAL
+void beginVisibilityPass(VisibilityBuffer& buffer, VkCommandBuffer commandBuffer);
+void endVisibilityPass(VisibilityBuffer& buffer, VkCommandBuffer commandBuffer);
+
+// Records the fullscreen resolve into the rendering that is currently active; pipeline uses resolve.vert/resolve.frag,
+// resolveLayout and PipelineVariant::vertexInput = VertexInputPulled, as it has no vertex input
+void resolveVisibility(const VisibilityBuffer& buffer, VkCommandBuffer commandBuffer, VkPipeline pipeline, const float camera[3], uint64_t vertexAddress, uint64_t indexAddress, uint32_t indexSize);
+
+// Renders an overlapping generated scene with objectCount objects offscreen with depth tested forward shading and with the
+// visibility buffer, timing both on the GPU; returns false if more than 0.1% of the covered pixels differ by more than rounding.
+// vs/fs are triangle.vert/triangle.frag and layout is the layout of createPipelineLayout
+bool benchmarkVisibility(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties, VkQueue queue, uint32_t familyIndex, float timestampPeriod, bool dynamicRendering,
+	VkShaderModule vs, VkShaderModule fs, VkShaderModule visibilityFS, VkShaderModule resolveVS, VkShaderModule resolveFS, VkPipelineLayout layout, uint32_t objectCount);